@@ -45,6 +45,7 @@ SOFTWARE.
 #include "../../../Bricks/time/chrono.h"
 #include "../../../Bricks/strings/printf.h"
 #include "../../../Bricks/util/accumulative_scoped_deleter.h"
+#include "../../../Bricks/util/metrics.h"
 
 namespace current {
 namespace http {
@@ -406,10 +407,17 @@ class HTTPServerPOSIX final {
         }
         std::function<void(Request)> handler;
         URLPathArgs url_path_args;
+        current::metrics::Histogram* handler_ns = nullptr;
+        current::metrics::Counter* not_found = nullptr;
         {
           // TODO(dkorolev): Read-write lock for performance?
           std::lock_guard<std::mutex> lock(mutex_);
           FindHandler(connection->HTTPRequest().URL().path, handler, url_path_args);
+          if (handler) {
+            handler_ns = &RouteHandlerNSMetric(url_path_args.base_path);
+          } else {
+            not_found = &NotFoundMetric();
+          }
         }
         if (handler) {
           // OK, here's the tricky part with error handling and exceptions in this multithreaded world.
@@ -430,6 +438,7 @@ class HTTPServerPOSIX final {
           //
           // It is the job of the user of this library to ensure no exceptions leave their code.
           // In practice, a top-level try-catch for `const current::Exception& e` is good enough.
+          const uint64_t begin_ns = current::metrics::NowNS();
           try {
             handler(Request(std::move(connection), url_path_args));
           } catch (const current::Exception& e) {  // LCOV_EXCL_LINE
@@ -438,7 +447,9 @@ class HTTPServerPOSIX final {
             // DO NOT COUNT ON IT.
             std::cerr << "HTTP route failed in user code: " << e.what() << '\n';  // LCOV_EXCL_LINE
           }
+          handler_ns->Record(current::metrics::NowNS() - begin_ns);
         } else {
+          not_found->Add();
           connection->SendHTTPResponse(current::net::DefaultNotFoundMessage(),
                                        HTTPResponseCode.NotFound,
                                        current::net::constants::kDefaultHTMLContentType);
@@ -456,6 +467,26 @@ class HTTPServerPOSIX final {
     }
   }
 
+  // The time spent in the handler of the route, in the server thread. Keyed by the registered route, not by the URL,
+  // so that the number of the metrics stays bounded. Must be called with `mutex_` locked.
+  current::metrics::Histogram& RouteHandlerNSMetric(const std::string& route) {
+    current::metrics::Histogram*& placeholder = route_handler_ns_metrics_[route];
+    if (!placeholder) {
+      placeholder = &current::metrics::Registry().GetHistogram("current_http_handler_ns",
+                                                               {{"port", std::to_string(port_)}, {"route", route}});
+    }
+    return *placeholder;
+  }
+
+  // Must be called with `mutex_` locked.
+  current::metrics::Counter& NotFoundMetric() {
+    if (!not_found_metric_) {
+      not_found_metric_ =
+          &current::metrics::Registry().GetCounter("current_http_not_found_total", {{"port", std::to_string(port_)}});
+    }
+    return *not_found_metric_;
+  }
+
   void ValidateRoute(const std::string& path) {
     if (path.empty() || path[0] != '/') {
       CURRENT_THROW(PathDoesNotStartWithSlash("HTTP URL path does not start with a slash: `" + path + "`."));
@@ -531,6 +562,9 @@ class HTTPServerPOSIX final {
 
   std::map<std::string, std::map<size_t, std::function<void(Request)>>> handlers_;
   std::vector<std::unique_ptr<StaticFileServer>> static_file_servers_;
+
+  std::map<std::string, current::metrics::Histogram*> route_handler_ns_metrics_;
+  current::metrics::Counter* not_found_metric_ = nullptr;
 };
 
 }  // namespace http
@@ -26,9 +26,28 @@ SOFTWARE.
 #define BLOCKS_MMQ_MMPQ_H
 
 // MMPQ is an in-memory priority queue, with the external interface loosely resembling the one of the original MMQ.
-
+//
+// Messages published in order, via `Publish()`, take the fast path: the publisher reserves the timestamp and the index
+// together, in a tiny critical section of its own, and appends the message to an intrusive lock-free
+// multiple-producers-single-consumer list. Only the messages published via `PublishIntoTheFuture()` go through
+// the ordered set guarded by the main mutex, which the consumer thread locks too.
+//
+// The consumer thread drains all the ready messages, up to `max_batch_size`, and passes them to the consumer
+// in the order of their timestamps. If the consumer defines an `OnBatchEnd()` method, it is called after each batch,
+// so that the consumer can flush whatever it has accumulated.
+//
+// The number of messages published in order and not yet consumed can be bounded by `max_queue_size`.
+// On overflow, depending on `overflow_policy`, either the publisher is blocked until the consumer catches up,
+// or the oldest messages are dropped by the consumer thread before the next batch is delivered.
+// The messages published into the future do not count towards the limit, as they are not ready to be consumed,
+// and blocking on them could block forever. The `Stats()` method exposes the counters of the queue.
+
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <condition_variable>
+#include <deque>
+#include <iterator>
 #include <mutex>
 #include <thread>
 #include <set>
@@ -40,6 +59,67 @@ SOFTWARE.
 namespace current {
 namespace mmq {
 
+namespace impl {
+
+template <typename T>
+constexpr bool HasOnBatchEnd(char) {
+  return false;
+}
+
+template <typename T>
+constexpr auto HasOnBatchEnd(int) -> decltype(std::declval<T>().OnBatchEnd(), bool()) {
+  return true;
+}
+
+template <typename T, bool HAS_ON_BATCH_END>
+struct CallOnBatchEndImpl {
+  static void Call(T&) {}
+};
+
+template <typename T>
+struct CallOnBatchEndImpl<T, true> {
+  static void Call(T& consumer) { consumer.OnBatchEnd(); }
+};
+
+template <typename T>
+void CallOnBatchEndIfDefined(T& consumer) {
+  CallOnBatchEndImpl<T, HasOnBatchEnd<T>(0)>::Call(consumer);
+}
+
+}  // namespace current::mmq::impl
+
+enum class MMPQOverflowPolicy : int { Block = 0, DropOldest = 1 };
+
+struct MMPQParameters {
+  // The maximum number of messages to pass to the consumer between two `OnBatchEnd()` calls.
+  size_t max_batch_size = 1024u;
+  // The maximum number of messages published in order and not yet consumed. Zero stands for unbounded.
+  size_t max_queue_size = 0u;
+  MMPQOverflowPolicy overflow_policy = MMPQOverflowPolicy::Block;
+
+  MMPQParameters& SetMaxBatchSize(size_t value) {
+    max_batch_size = value;
+    return *this;
+  }
+  MMPQParameters& SetMaxQueueSize(size_t value) {
+    max_queue_size = value;
+    return *this;
+  }
+  MMPQParameters& SetOverflowPolicy(MMPQOverflowPolicy value) {
+    overflow_policy = value;
+    return *this;
+  }
+};
+
+struct MMPQStats {
+  size_t published = 0u;                  // Messages published in order.
+  size_t published_into_the_future = 0u;  // Messages published into the future.
+  size_t consumed = 0u;                   // Messages passed to the consumer.
+  size_t dropped = 0u;                    // Messages dropped due to `MMPQOverflowPolicy::DropOldest`.
+  size_t blocked = 0u;                    // Publishes that had to wait due to `MMPQOverflowPolicy::Block`.
+  size_t queued = 0u;                     // Messages published in order and not yet consumed or dropped.
+};
+
 template <typename MESSAGE, typename CONSUMER, size_t DEFAULT_BUFFER_SIZE = 1024, bool DROP_ON_OVERFLOW = false>
 class MMPQ {
   static_assert(current::ss::IsEntrySubscriber<CONSUMER, MESSAGE>::value, "");
@@ -52,10 +132,19 @@ class MMPQ {
   // by the instance of MMPQ. See "Blocks/SS/ss.h" and its test for possible callee signatures.
   using consumer_t = CONSUMER;
 
-  MMPQ(consumer_t& consumer) : consumer_(consumer), consumer_thread_(&MMPQ::ConsumerThread, this) {
+  MMPQ(consumer_t& consumer, const MMPQParameters& parameters = MMPQParameters())
+      : consumer_(consumer),
+        max_batch_size_(std::max(parameters.max_batch_size, static_cast<size_t>(1))),
+        max_queue_size_(parameters.max_queue_size),
+        overflow_policy_(parameters.overflow_policy),
+        fast_list_head_(new FastListNode()),
+        fast_list_tail_(fast_list_head_),
+        consumer_thread_(&MMPQ::ConsumerThread, this) {
     consumer_thread_created_ = true;
   }
 
+  MMPQ(consumer_t& consumer, size_t max_batch_size) : MMPQ(consumer, MMPQParameters().SetMaxBatchSize(max_batch_size)) {}
+
   // The destructor waits for the consumer thread to terminate, which implies committing all the queued messages.
   ~MMPQ() {
     if (consumer_thread_created_) {
@@ -64,12 +153,20 @@ class MMPQ {
         std::lock_guard<std::mutex> lock(mutex_);
         destructing_ = true;
         condition_variable_.notify_all();
+        space_available_.notify_all();
       }
       consumer_thread_.join();
     }
+    while (fast_list_head_) {
+      FastListNode* next = fast_list_head_->next.load();
+      delete fast_list_head_;
+      fast_list_head_ = next;
+    }
   }
 
   // Adds a message to the buffer. Supports both copy and move semantics. THREAD SAFE.
+  // The `MLS` template parameter tells whether the caller already holds the mutex, via `WithLockedMutex()`.
+  // The publishes made with the mutex already locked never block on overflow.
 
   // NOTE(dkorolev): `std::enable_if_t<std::is_same<message_t, current::decay<T>>::value, idxts_t>` can't convert
   // `const char*` into an `std::string`, which is essential, as, unlike MMQ, MMPQ is not an `ss::EntryPublisher<>`.
@@ -103,68 +200,304 @@ class MMPQ {
     DoUpdateHead<MLS>(current::time::DefaultTimeArgument());
   }
 
+  // Runs `f()` with the mutex locked, for the caller to make a series of `MutexLockStatus::AlreadyLocked` calls
+  // with no other publisher of messages into the future interleaving with them.
+  template <typename F>
+  void WithLockedMutex(F&& f) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    f();
+  }
+
+  MMPQStats Stats() const {
+    MMPQStats stats;
+    stats.published = published_;
+    stats.published_into_the_future = published_into_the_future_;
+    stats.consumed = consumed_;
+    stats.dropped = dropped_;
+    stats.blocked = blocked_;
+    stats.queued = queued_;
+    return stats;
+  }
+
  private:
   MMPQ(const MMPQ&) = delete;
   MMPQ(MMPQ&&) = delete;
   void operator=(const MMPQ&) = delete;
   void operator=(MMPQ&&) = delete;
 
-  template <current::locks::MutexLockStatus MLS = current::locks::MutexLockStatus::NeedToLock, class T, typename US>
+  // The `Entry` struct keeps the entries along with their timestamps.
+  struct Entry {
+    idxts_t index_timestamp;
+    message_t message_body;
+    // Whether the entry was published in order, and thus counts towards `max_queue_size`.
+    bool in_order = false;
+    Entry() = default;
+    Entry(Entry&&) = default;
+    Entry& operator=(Entry&&) = default;
+    Entry(message_t&& message_body, idxts_t index_timestamp, bool in_order)
+        : index_timestamp(index_timestamp), message_body(std::move(message_body)), in_order(in_order) {}
+    bool operator<(const Entry& rhs) const {
+      return index_timestamp.us < rhs.index_timestamp.us ||
+             (index_timestamp.us == rhs.index_timestamp.us && index_timestamp.index < rhs.index_timestamp.index);
+    }
+  };
+
+  // The node of the intrusive multiple-producers-single-consumer list of the messages published in order.
+  // The head of the list is the stub node, the entry of which has already been consumed.
+  struct FastListNode {
+    std::atomic<FastListNode*> next;
+    Entry entry;
+    FastListNode() : next(nullptr) {}
+    explicit FastListNode(Entry&& entry) : next(nullptr), entry(std::move(entry)) {}
+  };
+
+  // Every publisher registers itself for the duration of the call, in the counter of the current epoch.
+  // Once the consumer has read the head timestamp, it flips the epoch, and waits for the publishers registered
+  // in the previous one to complete. After this, every message timestamped up to the head is visible to it.
+  // The epoch may flip between reading it and registering, possibly more than once, in which case the publisher
+  // would sit in the counter the consumer is not waiting on. Hence the registration is retried until it sticks.
+  class PublisherScope {
+   public:
+    explicit PublisherScope(MMPQ* self) {
+      while (true) {
+        const uint64_t epoch = self->epoch_.load();
+        counter_ = &self->publishers_[epoch & 1u];
+        ++*counter_;
+        if (self->epoch_.load() == epoch) {
+          return;
+        }
+        --*counter_;
+      }
+    }
+    ~PublisherScope() { --*counter_; }
+
+   private:
+    std::atomic_size_t* counter_;
+  };
+
+  // Advances the head timestamp, and assigns the next index if `NEXT_INDEX` is set. Must hold `reserve_mutex_`.
+  // The index and the timestamp are assigned in the same step, so that the indexes of the messages published in order
+  // follow their timestamps, no matter how the concurrent publishers interleave.
+  template <bool NEXT_INDEX, typename US>
+  idxts_t ReserveIndexAndTimestamp(const US us) {
+    const std::chrono::microseconds head(head_us_.load());
+    const auto timestamp = current::time::GetTimestampFromLockedSection(us, head);
+    if (!(timestamp > head)) {
+      CURRENT_THROW(ss::InconsistentTimestampException(head + std::chrono::microseconds(1), timestamp));
+    }
+    head_us_ = timestamp.count();
+    return idxts_t(NEXT_INDEX ? ++last_index_ : last_index_.load(), timestamp);
+  }
+
+  template <current::locks::MutexLockStatus MLS, class T, typename US>
   idxts_t DoPublish(T&& message, const US us) {
-    locks::SmartMutexLockGuard<MLS> lock(mutex_);
-    const auto timestamp = current::time::GetTimestampFromLockedSection(us);
-    if (!(timestamp > last_idx_ts_.us)) {
-      CURRENT_THROW(ss::InconsistentTimestampException(last_idx_ts_.us + std::chrono::microseconds(1), timestamp));
+    // Count the message before it becomes visible to the consumer thread, which decrements the counter.
+    // With `MMPQOverflowPolicy::Block`, the slot is reserved atomically, so that `max_queue_size` is a hard bound.
+    if (max_queue_size_ && overflow_policy_ == MMPQOverflowPolicy::Block &&
+        MLS == current::locks::MutexLockStatus::NeedToLock) {
+      if (!ReserveQueueSlot()) {
+        // The queue is being destructed, and the consumer thread is gone or about to be; drop the message.
+        return idxts_t();
+      }
+    } else {
+      ++queued_;
+    }
+    idxts_t result;
+    try {
+      const PublisherScope scope(this);
+      {
+        std::lock_guard<std::mutex> lock(reserve_mutex_);
+        result = ReserveIndexAndTimestamp<true>(us);
+      }
+      FastListNode* node = new FastListNode(Entry(std::move(message), result, true));
+      FastListNode* previous = fast_list_tail_.exchange(node);
+      previous->next.store(node);
+    } catch (...) {
+      // Give the slot back, and let a publisher blocked on it know, as no consumed message would wake it up.
+      --queued_;
+      NotifyPublishersWaitingForSpace<MLS>();
+      throw;
     }
-    ++last_idx_ts_.index;
-    last_idx_ts_.us = timestamp;
-    queue_.emplace(std::move(message), last_idx_ts_);
-    condition_variable_.notify_all();
-    return last_idx_ts_;
+    ++published_;
+    WakeUpConsumerIfWaiting<MLS>();
+    return result;
   }
 
-  template <current::locks::MutexLockStatus MLS = current::locks::MutexLockStatus::NeedToLock, class T, typename US>
+  template <current::locks::MutexLockStatus MLS, class T, typename US>
   idxts_t DoPublishIntoTheFuture(T&& message, const US us) {
-    locks::SmartMutexLockGuard<MLS> lock(mutex_);
-    const auto timestamp = current::time::GetTimestampFromLockedSection(us);
-    if (!(timestamp > last_idx_ts_.us)) {
-      CURRENT_THROW(ss::InconsistentTimestampException(last_idx_ts_.us + std::chrono::microseconds(1), timestamp));
+    idxts_t result;
+    {
+      const PublisherScope scope(this);
+      locks::SmartMutexLockGuard<MLS> lock(mutex_);
+      // Keep the head from advancing until the message is in `future_`, or it may end up behind the head.
+      std::lock_guard<std::mutex> reserve_lock(reserve_mutex_);
+      const int64_t head = head_us_.load();
+      const auto timestamp = current::time::GetTimestampFromLockedSection(us, std::chrono::microseconds(head));
+      if (!(timestamp.count() > head)) {
+        CURRENT_THROW(ss::InconsistentTimestampException(std::chrono::microseconds(head + 1), timestamp));
+      }
+      result = idxts_t(++last_index_, std::chrono::microseconds(head));
+      // Don't update the head timestamp.
+      future_.emplace(std::move(message), idxts_t(result.index, timestamp), false);
+      future_size_ = future_.size();
     }
-    ++last_idx_ts_.index;
-    // Don't update the timestamp.
-    queue_.emplace(std::move(message), idxts_t(last_idx_ts_.index, timestamp));
-    condition_variable_.notify_all();
-    return last_idx_ts_;
+    ++published_into_the_future_;
+    WakeUpConsumerIfWaiting<MLS>();
+    return result;
   }
 
-  template <current::locks::MutexLockStatus MLS = current::locks::MutexLockStatus::NeedToLock, typename US>
+  template <current::locks::MutexLockStatus MLS, typename US>
   void DoUpdateHead(const US us) {
-    locks::SmartMutexLockGuard<MLS> lock(mutex_);
-    const auto timestamp = current::time::GetTimestampFromLockedSection(us);
-    if (!(timestamp > last_idx_ts_.us)) {
-      CURRENT_THROW(ss::InconsistentTimestampException(last_idx_ts_.us + std::chrono::microseconds(1), timestamp));
+    {
+      const PublisherScope scope(this);
+      std::lock_guard<std::mutex> lock(reserve_mutex_);
+      ReserveIndexAndTimestamp<false>(us);
     }
-    last_idx_ts_.us = timestamp;
-    condition_variable_.notify_all();
+    WakeUpConsumerIfWaiting<MLS>();
   }
 
-  void ConsumerThread() {
+  // Reserves the slot for one more in-order message, waiting for the consumer to free one up if necessary.
+  // Returns false if the queue is being destructed, so that the blocked publisher does not publish anymore.
+  bool ReserveQueueSlot() {
+    size_t queued = queued_.load();
+    bool blocked = false;
     while (true) {
-      std::unique_lock<std::mutex> lock(mutex_);
+      if (queued < max_queue_size_) {
+        if (queued_.compare_exchange_weak(queued, queued + 1u)) {
+          return true;
+        }
+      } else {
+        if (!blocked) {
+          blocked = true;
+          ++blocked_;
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        ++publishers_waiting_;
+        space_available_.wait(lock, [this]() { return queued_ < max_queue_size_ || destructing_; });
+        --publishers_waiting_;
+        if (destructing_) {
+          return false;
+        }
+        queued = queued_.load();
+      }
+    }
+  }
+
+  template <current::locks::MutexLockStatus MLS>
+  void NotifyPublishersWaitingForSpace() {
+    if (publishers_waiting_) {
+      locks::SmartMutexLockGuard<MLS> lock(mutex_);
+      space_available_.notify_all();
+    }
+  }
+
+  // Saves on locking the mutex and on `notify` calls while the consumer thread is busy.
+  template <current::locks::MutexLockStatus MLS>
+  void WakeUpConsumerIfWaiting() {
+    ++version_;
+    if (consumer_waiting_) {
+      locks::SmartMutexLockGuard<MLS> lock(mutex_);
+      condition_variable_.notify_one();
+    }
+  }
 
-      condition_variable_.wait(lock,
-                               [this] {
-                                 return (!queue_.empty() && queue_.begin()->index_timestamp.us <= last_idx_ts_.us) ||
-                                        destructing_;
-                               });
+  // Moves the messages published in order, and the messages from the future which are ready, into `pending_`,
+  // which is kept ordered by timestamps. Returns the head timestamp, up to which the messages can be consumed.
+  std::chrono::microseconds CollectPendingEntries() {
+    const int64_t head = head_us_.load();
+    const size_t previous_epoch = (epoch_++) & 1u;
+    while (publishers_[previous_epoch]) {
+      std::this_thread::yield();
+    }
+
+    // Take every node appended before this point. A node may be appended, but not yet linked; wait for it then.
+    FastListNode* const tail = fast_list_tail_.load();
+    while (fast_list_head_ != tail) {
+      FastListNode* next = fast_list_head_->next.load();
+      if (!next) {
+        std::this_thread::yield();
+        continue;
+      }
+      delete fast_list_head_;
+      fast_list_head_ = next;
+      InsertPendingEntry(std::move(next->entry));
+    }
+
+    if (future_size_) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      while (!future_.empty() && future_.begin()->index_timestamp.us.count() <= head) {
+        auto it = future_.begin();
+        InsertPendingEntry(std::move(const_cast<Entry&>(*it)));
+        future_.erase(it);
+      }
+      future_size_ = future_.size();
+    }
 
-      if (destructing_) {
-        return;  // LCOV_EXCL_LINE
+    if (max_queue_size_ && overflow_policy_ == MMPQOverflowPolicy::DropOldest) {
+      for (auto it = pending_.begin(); queued_ > max_queue_size_ && it != pending_.end();) {
+        if (it->in_order) {
+          it = pending_.erase(it);
+          --queued_;
+          ++dropped_;
+        } else {
+          ++it;
+        }
       }
+    }
+
+    return std::chrono::microseconds(head);
+  }
 
-      auto it = queue_.begin();
-      consumer_(std::move(const_cast<Entry&>(*it).message_body), it->index_timestamp, last_idx_ts_);
-      queue_.erase(it);
+  // The entries come nearly ordered, so insert each one from the back.
+  void InsertPendingEntry(Entry&& entry) {
+    auto it = pending_.end();
+    while (it != pending_.begin() && entry < *std::prev(it)) {
+      --it;
+    }
+    pending_.insert(it, std::move(entry));
+  }
+
+  bool HasReadyEntry(std::chrono::microseconds head) const {
+    return !pending_.empty() && pending_.front().index_timestamp.us <= head;
+  }
+
+  void ConsumerThread() {
+    uint64_t version_seen = 0u;
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (version_ == version_seen && !destructing_) {
+          consumer_waiting_ = true;
+          if (version_ == version_seen) {
+            condition_variable_.wait(lock);
+          }
+          consumer_waiting_ = false;
+        }
+        if (destructing_) {
+          return;  // LCOV_EXCL_LINE
+        }
+      }
+      version_seen = version_;
+
+      const auto head = CollectPendingEntries();
+      while (HasReadyEntry(head)) {
+        size_t in_order = 0u;
+        size_t batch_size = 0u;
+        const idxts_t last_idx_ts(last_index_, head);
+        while (batch_size < max_batch_size_ && HasReadyEntry(head)) {
+          Entry& entry = pending_.front();
+          in_order += entry.in_order ? 1u : 0u;
+          consumer_(std::move(entry.message_body), entry.index_timestamp, last_idx_ts);
+          pending_.pop_front();
+          ++batch_size;
+        }
+        consumed_ += batch_size;
+        if (in_order) {
+          queued_ -= in_order;
+          NotifyPublishersWaitingForSpace<current::locks::MutexLockStatus::NeedToLock>();
+        }
+        impl::CallOnBatchEndIfDefined(consumer_);
+      }
     }
   }
 
@@ -173,24 +506,52 @@ class MMPQ {
   // The instance of the consuming side of the FIFO buffer.
   consumer_t& consumer_;
 
-  // The `Entry` struct keeps the entries along with their timestamps.
-  struct Entry {
-    idxts_t index_timestamp;
-    message_t message_body;
-    Entry() = default;
-    Entry(Entry&&) = default;
-    Entry(message_t&& message_body, idxts_t index_timestamp)
-        : index_timestamp(index_timestamp), message_body(std::move(message_body)) {}
-    bool operator<(const Entry& rhs) const { return index_timestamp.us < rhs.index_timestamp.us; }
-  };
+  // The maximum number of messages to dispatch between two `OnBatchEnd()` calls.
+  const size_t max_batch_size_;
+
+  // The limit on the number of in-order messages, and what to do when it is reached.
+  const size_t max_queue_size_;
+  const MMPQOverflowPolicy overflow_policy_;
+
+  // The head timestamp, and the last index assigned. Advanced by the publishers under `reserve_mutex_`,
+  // read by the consumer thread with no lock.
+  std::atomic<int64_t> head_us_{-1};
+  std::atomic<uint64_t> last_index_{0u};
+  std::mutex reserve_mutex_;
+
+  // The messages published in order: the consumer-owned head, and the tail appended to by the publishers.
+  FastListNode* fast_list_head_;
+  std::atomic<FastListNode*> fast_list_tail_;
+
+  // The messages published into the future, guarded by `mutex_`.
+  std::multiset<Entry> future_;
+  std::atomic_size_t future_size_{0u};
+
+  // The messages collected by the consumer thread and not yet consumed, ordered by timestamps.
+  std::deque<Entry> pending_;
+
+  // The publishers in flight, per epoch. See `PublisherScope`.
+  std::atomic<uint64_t> epoch_{0u};
+  std::atomic_size_t publishers_[2]{{0u}, {0u}};
+
+  // Incremented on every change the consumer thread should react to.
+  std::atomic<uint64_t> version_{0u};
+  std::atomic_bool consumer_waiting_{false};
+  std::atomic_size_t publishers_waiting_{0u};
+
+  std::atomic_size_t published_{0u};
+  std::atomic_size_t published_into_the_future_{0u};
+  std::atomic_size_t consumed_{0u};
+  std::atomic_size_t dropped_{0u};
+  std::atomic_size_t blocked_{0u};
+  std::atomic_size_t queued_{0u};
 
-  std::set<Entry> queue_;
-  idxts_t last_idx_ts_ = idxts_t(0, std::chrono::microseconds(-1));
   std::mutex mutex_;
   std::condition_variable condition_variable_;
+  std::condition_variable space_available_;
 
   // For safe thread destruction.
-  bool destructing_ = false;
+  std::atomic_bool destructing_{false};
 
   // The thread in which the consuming process is running.
   std::thread consumer_thread_;
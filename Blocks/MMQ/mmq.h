@@ -46,6 +46,7 @@ SOFTWARE.
 //      thread, MMQ DOES GUARANTEE that the order of messages published from this thread will be respected.
 //  Default behavior of MMQ is non-dropping and can be controlled via the `DROP_ON_OVERFLOW` template argument.
 
+#include <atomic>
 #include <chrono>
 #include <condition_variable>
 #include <mutex>
@@ -193,7 +194,7 @@ class MMQImpl {
     std::lock_guard<std::mutex> lock(mutex_);
     if (circular_buffer_[head_].status == Entry::FREE) {
       // Regular case.
-      const auto timestamp = current::time::GetTimestampFromLockedSection(us);
+      const auto timestamp = current::time::GetTimestampFromLockedSection(us, last_idx_ts_.us);
       if (!(timestamp > last_idx_ts_.us)) {
         CURRENT_THROW(ss::InconsistentTimestampException(last_idx_ts_.us + std::chrono::microseconds(1), timestamp));
       }
@@ -220,7 +221,7 @@ class MMQImpl {
     if (destructing_) {
       return std::make_pair(false, 0u);  // LCOV_EXCL_LINE
     }
-    const auto timestamp = current::time::GetTimestampFromLockedSection(us);
+    const auto timestamp = current::time::GetTimestampFromLockedSection(us, last_idx_ts_.us);
     if (!(timestamp > last_idx_ts_.us)) {
       CURRENT_THROW(ss::InconsistentTimestampException(last_idx_ts_.us + std::chrono::microseconds(1), timestamp));
     }
@@ -281,8 +282,235 @@ class MMQImpl {
   std::thread consumer_thread_;
 };
 
+namespace impl {
+
+// Waits for `ready()` to hold by spinning first, then yielding, and only then parking on a condition variable.
+// `Notify()` is cheap when nobody is parked, which is the common case under load.
+class SpinThenParkWaiter {
+ public:
+  template <typename F>
+  void Wait(F&& ready) {
+    for (size_t i = 0; i < kSpins; ++i) {
+      if (ready()) {
+        return;
+      }
+    }
+    for (size_t i = 0; i < kYields; ++i) {
+      if (ready()) {
+        return;
+      }
+      std::this_thread::yield();
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    ++parked_;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    condition_variable_.wait(lock, ready);
+    --parked_;
+  }
+
+  // Must be called after the state `ready()` checks for has been updated.
+  void Notify() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (parked_) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      condition_variable_.notify_all();
+    }
+  }
+
+ private:
+  constexpr static size_t kSpins = 1000u;
+  constexpr static size_t kYields = 100u;
+
+  std::atomic_size_t parked_{0u};
+  std::mutex mutex_;
+  std::condition_variable condition_variable_;
+};
+
+}  // namespace current::mmq::impl
+
+// `LockFreeMMQImpl` is the drop-in alternative to `MMQImpl`, with no mutex on the publish or on the consume path.
+//
+// Each slot of the ring carries a sequence number, which tells whether the slot is free for the publisher
+// of the certain position, or holds the message ready for the consumer. Publishers claim positions with
+// a compare-and-swap, and, as the timestamps must be strictly increasing in the order of positions,
+// the index and the timestamp of each message are assigned in a brief in-order handoff between publishers.
+// A message failing the timestamp check still occupies its slot, which the consumer then skips.
+//
+// The overflow semantics is the same as the one of `MMQImpl`: with `DROP_ON_OVERFLOW` the message is discarded,
+// otherwise the publisher waits for a free slot. Waiting, on both sides, spins first, and parks eventually.
 template <typename MESSAGE, typename CONSUMER, size_t DEFAULT_BUFFER_SIZE = 1024, bool DROP_ON_OVERFLOW = false>
-using MMQ = ss::EntryPublisher<MMQImpl<MESSAGE, CONSUMER, DEFAULT_BUFFER_SIZE, DROP_ON_OVERFLOW>, MESSAGE>;
+class LockFreeMMQImpl {
+  static_assert(current::ss::IsEntrySubscriber<CONSUMER, MESSAGE>::value, "");
+
+ public:
+  using message_t = MESSAGE;
+  using consumer_t = CONSUMER;
+
+  LockFreeMMQImpl(consumer_t& consumer, size_t buffer_size = DEFAULT_BUFFER_SIZE)
+      : consumer_(consumer), circular_buffer_size_(buffer_size), circular_buffer_(circular_buffer_size_) {
+    for (size_t i = 0; i < circular_buffer_size_; ++i) {
+      circular_buffer_[i].sequence = i;
+    }
+    consumer_thread_ = std::thread(&LockFreeMMQImpl::ConsumerThread, this);
+  }
+
+  // The destructor waits for the consumer thread to terminate, which implies committing all the queued messages.
+  ~LockFreeMMQImpl() {
+    CURRENT_ASSERT(consumer_thread_.joinable());
+    destructing_ = true;
+    ready_to_consume_.Notify();
+    ready_to_publish_.Notify();
+    consumer_thread_.join();
+  }
+
+ protected:
+  template <current::locks::MutexLockStatus MLS, typename US>
+  idxts_t DoPublish(const message_t& message, const US timestamp) {
+    message_t copy(message);
+    return DoPublish<MLS>(std::move(copy), timestamp);
+  }
+
+  template <current::locks::MutexLockStatus MLS, typename US>
+  idxts_t DoPublish(message_t&& message, const US us) {
+    size_t position;
+    if (!ClaimPosition(position)) {
+      return idxts_t();
+    }
+    Entry& entry = circular_buffer_[position % circular_buffer_size_];
+
+    // Wait for the publisher of the previous position to assign its index and timestamp, and assign own ones.
+    while (handoff_position_.load(std::memory_order_acquire) != position) {
+      std::this_thread::yield();
+    }
+    const int64_t last_us = last_us_.load(std::memory_order_relaxed);
+    const auto timestamp = current::time::GetTimestampFromLockedSection(us, std::chrono::microseconds(last_us));
+    const bool valid = (timestamp.count() > last_us);
+    if (valid) {
+      entry.index_timestamp = idxts_t(last_index_.load(std::memory_order_relaxed) + 1u, timestamp);
+      last_index_.store(entry.index_timestamp.index, std::memory_order_relaxed);
+      last_us_.store(timestamp.count(), std::memory_order_relaxed);
+    }
+    handoff_position_.store(position + 1u, std::memory_order_release);
+
+    entry.skip = !valid;
+    if (valid) {
+      entry.message_body = std::move(message);
+    }
+    const idxts_t result = entry.index_timestamp;
+    entry.sequence.store(position + 1u, std::memory_order_release);
+    ready_to_consume_.Notify();
+
+    if (!valid) {
+      CURRENT_THROW(ss::InconsistentTimestampException(std::chrono::microseconds(last_us + 1), timestamp));
+    }
+    return result;
+  }
+
+ private:
+  LockFreeMMQImpl(const LockFreeMMQImpl&) = delete;
+  LockFreeMMQImpl(LockFreeMMQImpl&&) = delete;
+  void operator=(const LockFreeMMQImpl&) = delete;
+  void operator=(LockFreeMMQImpl&&) = delete;
+
+  // Claims the next position in the ring. Returns `false` if the message should be dropped.
+  bool ClaimPosition(size_t& position) {
+    position = enqueue_position_.load(std::memory_order_relaxed);
+    while (true) {
+      Entry& entry = circular_buffer_[position % circular_buffer_size_];
+      const size_t sequence = entry.sequence.load(std::memory_order_acquire);
+      if (sequence == position) {
+        if (enqueue_position_.compare_exchange_weak(position, position + 1u, std::memory_order_relaxed)) {
+          return true;
+        }
+      } else if (sequence < position) {
+        // The ring is full: the slot still holds the message from the previous lap.
+        if (DROP_ON_OVERFLOW) {
+          return false;
+        }
+        ready_to_publish_.Wait([this, &entry, sequence]() {
+          return entry.sequence.load(std::memory_order_acquire) != sequence || destructing_;
+        });
+        if (destructing_) {
+          return false;  // LCOV_EXCL_LINE
+        }
+        position = enqueue_position_.load(std::memory_order_relaxed);
+      } else {
+        // Another publisher has claimed this position.
+        position = enqueue_position_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  void ConsumerThread() {
+    size_t position = 0u;
+    while (true) {
+      Entry& entry = circular_buffer_[position % circular_buffer_size_];
+      ready_to_consume_.Wait([this, &entry, position]() {
+        return entry.sequence.load(std::memory_order_acquire) == position + 1u || destructing_;
+      });
+      if (destructing_) {
+        return;  // LCOV_EXCL_LINE
+      }
+      if (!entry.skip) {
+        idxts_t last_idx_ts(last_index_.load(std::memory_order_relaxed),
+                            std::chrono::microseconds(last_us_.load(std::memory_order_relaxed)));
+        if (last_idx_ts.index < entry.index_timestamp.index) {
+          last_idx_ts = entry.index_timestamp;
+        }
+        consumer_(std::move(entry.message_body), entry.index_timestamp, last_idx_ts);
+      }
+      // Free the slot for the publisher of the next lap.
+      entry.sequence.store(position + circular_buffer_size_, std::memory_order_release);
+      ready_to_publish_.Notify();
+      ++position;
+    }
+  }
+
+  // The instance of the consuming side of the FIFO buffer.
+  consumer_t& consumer_;
+
+  // The capacity of the circular buffer for intermediate messages.
+  const size_t circular_buffer_size_;
+
+  // The `Entry` struct keeps the entries along with their timestamps and the sequence numbers of the slots.
+  // The slot for position `p` is free for its publisher when `sequence == p`, and is ready for the consumer
+  // when `sequence == p + 1`; once consumed, it becomes free for position `p + circular_buffer_size_`.
+  struct Entry {
+    std::atomic_size_t sequence{0u};
+    idxts_t index_timestamp;
+    message_t message_body;
+    bool skip = false;
+  };
+
+  std::vector<Entry> circular_buffer_;
+  std::atomic_size_t enqueue_position_{0u};
+
+  // The position whose publisher is next to assign the index and the timestamp, and the last assigned ones.
+  std::atomic_size_t handoff_position_{0u};
+  std::atomic<uint64_t> last_index_{0u};
+  std::atomic<int64_t> last_us_{-1};
+
+  impl::SpinThenParkWaiter ready_to_consume_;
+  impl::SpinThenParkWaiter ready_to_publish_;
+
+  // For safe thread destruction.
+  std::atomic_bool destructing_{false};
+
+  // The thread in which the consuming process is running.
+  std::thread consumer_thread_;
+};
+
+// Set `LOCK_FREE` to use the lock-free ring buffer of `LockFreeMMQImpl` instead of the mutex-guarded one.
+template <typename MESSAGE,
+          typename CONSUMER,
+          size_t DEFAULT_BUFFER_SIZE = 1024,
+          bool DROP_ON_OVERFLOW = false,
+          bool LOCK_FREE = false>
+using MMQ =
+    ss::EntryPublisher<typename std::conditional<LOCK_FREE,
+                                                 LockFreeMMQImpl<MESSAGE, CONSUMER, DEFAULT_BUFFER_SIZE, DROP_ON_OVERFLOW>,
+                                                 MMQImpl<MESSAGE, CONSUMER, DEFAULT_BUFFER_SIZE, DROP_ON_OVERFLOW>>::type,
+                       MESSAGE>;
 
 }  // namespace mmq
 }  // namespace current
@@ -76,6 +76,19 @@ TEST(InMemoryMQ, SmokeTest) {
     EXPECT_EQ(0u, c.dropped_messages_);
   }
 
+  {
+    Consumer c;
+    MMQ<std::string, Consumer, 1024, false, true> mmq(c);
+    mmq.Publish("one");
+    mmq.Publish("two");
+    mmq.Publish("three");
+    while (c.processed_messages_ != 3) {
+      std::this_thread::yield();
+    }
+    EXPECT_EQ("one\ntwo\nthree\n", c.messages_);
+    EXPECT_EQ(0u, c.dropped_messages_);
+  }
+
   {
     Consumer c;
     MMPQ<std::string, Consumer> mmpq(c);
@@ -118,13 +131,14 @@ struct SuspendableConsumerImpl {
 
 using SuspendableConsumer = current::ss::EntrySubscriber<SuspendableConsumerImpl, std::string>;
 
-TEST(InMemoryMQ, DropOnOverflowTest) {
+template <bool LOCK_FREE>
+void RunDropOnOverflowTest() {
   current::time::ResetToZero();
 
   SuspendableConsumer c;
 
   // Queue with 10 at most messages in the buffer.
-  MMQ<std::string, SuspendableConsumer, 10, true> mmq(c);
+  MMQ<std::string, SuspendableConsumer, 10, true, LOCK_FREE> mmq(c);
 
   // Suspend the consumer temporarily while the first 25 messages are published.
   c.suspend_processing_ = true;
@@ -168,14 +182,19 @@ TEST(InMemoryMQ, DropOnOverflowTest) {
   EXPECT_EQ(11u, std::set<std::string>(begin(c.messages_), end(c.messages_)).size());
 }
 
-TEST(InMemoryMQ, WaitOnOverflowTest) {
+TEST(InMemoryMQ, DropOnOverflowTest) { RunDropOnOverflowTest<false>(); }
+
+TEST(InMemoryMQ, LockFreeDropOnOverflowTest) { RunDropOnOverflowTest<true>(); }
+
+template <bool LOCK_FREE>
+void RunWaitOnOverflowTest() {
   current::time::ResetToZero();
 
   SuspendableConsumer c;
   c.SetProcessingDelayMillis(1u);
 
   // Queue with 10 events in the buffer. Don't drop events on overflow.
-  MMQ<std::string, SuspendableConsumer, 10, false> mmq(c);
+  MMQ<std::string, SuspendableConsumer, 10, false, LOCK_FREE> mmq(c);
 
   const auto producer = [&](char prefix, size_t count) {
     for (size_t i = 0; i < count; ++i) {
@@ -210,6 +229,10 @@ TEST(InMemoryMQ, WaitOnOverflowTest) {
   EXPECT_EQ(100u, std::set<std::string>(c.messages_.begin(), c.messages_.end()).size());
 }
 
+TEST(InMemoryMQ, WaitOnOverflowTest) { RunWaitOnOverflowTest<false>(); }
+
+TEST(InMemoryMQ, LockFreeWaitOnOverflowTest) { RunWaitOnOverflowTest<true>(); }
+
 TEST(InMemoryMQ, TimeShouldNotGoBack) {
   current::time::ResetToZero();
 
@@ -238,6 +261,19 @@ TEST(InMemoryMQ, TimeShouldNotGoBack) {
     EXPECT_EQ("one\nthree\n", c.messages_);
   }
 
+  {
+    Consumer c;
+    MMQ<std::string, Consumer, 1024, false, true> mmq(c);
+    mmq.Publish("one", std::chrono::microseconds(1));
+    mmq.Publish("three", std::chrono::microseconds(3));
+    ASSERT_THROW(mmq.Publish("two", std::chrono::microseconds(2)), current::ss::InconsistentTimestampException);
+    mmq.Publish("four", std::chrono::microseconds(4));
+    while (c.processed_messages_ != 3) {
+      std::this_thread::yield();
+    }
+    EXPECT_EQ("one\nthree\nfour\n", c.messages_);
+  }
+
   {
     Consumer c;
     MMPQ<std::string, Consumer> mmpq(c);
@@ -390,3 +426,269 @@ TEST(InMemoryMQ, MMPQSupportsUpdateHead) {
   EXPECT_EQ("three @ 3, seven @ 7, ace @ 100, king @ 101, queen @ 102, jack @ 103, joker @ 1000",
             current::strings::Join(c.messages_by_timestamps_, ", "));
 }
+
+TEST(InMemoryMQ, MMPQDeliversReadyMessagesInBatches) {
+  current::time::ResetToZero();
+
+  struct ConsumerImpl {
+    std::vector<std::string> messages_;
+    std::vector<std::string> batches_;
+    std::atomic_size_t processed_batches_;
+    ConsumerImpl() : processed_batches_(0u) {}
+    EntryResponse operator()(const std::string& s, idxts_t, idxts_t) {
+      messages_.push_back(s);
+      return EntryResponse::More;
+    }
+    void OnBatchEnd() {
+      batches_.push_back(current::strings::Join(messages_, ','));
+      messages_.clear();
+      ++processed_batches_;
+    }
+  };
+
+  using Consumer = current::ss::EntrySubscriber<ConsumerImpl, std::string>;
+
+  {
+    Consumer c;
+    MMPQ<std::string, Consumer> mmpq(c);
+
+    // The messages published into the future become ready all at once, and are delivered as a single batch.
+    mmpq.PublishIntoTheFuture("one", std::chrono::microseconds(1));
+    mmpq.PublishIntoTheFuture("two", std::chrono::microseconds(2));
+    mmpq.PublishIntoTheFuture("three", std::chrono::microseconds(3));
+    mmpq.UpdateHead(std::chrono::microseconds(3));
+    while (c.processed_batches_ != 1) {
+      std::this_thread::yield();
+    }
+    EXPECT_EQ("one,two,three", current::strings::Join(c.batches_, ' '));
+  }
+
+  {
+    Consumer c;
+    MMPQ<std::string, Consumer> mmpq(c, 2u);
+
+    // With the maximum batch size of two, three ready messages make two batches.
+    mmpq.PublishIntoTheFuture("one", std::chrono::microseconds(1));
+    mmpq.PublishIntoTheFuture("two", std::chrono::microseconds(2));
+    mmpq.PublishIntoTheFuture("three", std::chrono::microseconds(3));
+    mmpq.UpdateHead(std::chrono::microseconds(3));
+    while (c.processed_batches_ != 2) {
+      std::this_thread::yield();
+    }
+    EXPECT_EQ("one,two three", current::strings::Join(c.batches_, ' '));
+  }
+}
+
+TEST(InMemoryMQ, MMPQConcurrentPublishersPreserveIndexAndTimestampOrder) {
+  current::time::ResetToZero();
+
+  struct ConsumerImpl {
+    idxts_t last = idxts_t(0u, std::chrono::microseconds(-1));
+    size_t out_of_order_messages_ = 0u;
+    std::atomic_size_t processed_messages_;
+    ConsumerImpl() : processed_messages_(0u) {}
+    EntryResponse operator()(const std::string&, idxts_t current, idxts_t) {
+      // Both the indexes and the timestamps must follow the order of delivery.
+      if (!(current.index == last.index + 1u && current.us > last.us)) {
+        ++out_of_order_messages_;
+      }
+      last = current;
+      ++processed_messages_;
+      return EntryResponse::More;
+    }
+  };
+
+  using Consumer = current::ss::EntrySubscriber<ConsumerImpl, std::string>;
+
+  Consumer c;
+  MMPQ<std::string, Consumer> mmpq(c);
+
+  std::vector<std::thread> producers;
+  for (size_t i = 0; i < 4; ++i) {
+    producers.emplace_back([&mmpq]() {
+      for (size_t j = 0; j < 1000; ++j) {
+        mmpq.Publish("message");
+      }
+    });
+  }
+  for (auto& p : producers) {
+    p.join();
+  }
+
+  // Wait for the counters to be updated, which happens after each batch is passed to the consumer.
+  while (mmpq.Stats().consumed != 4000u) {
+    std::this_thread::yield();
+  }
+  EXPECT_EQ(4000u, c.processed_messages_);
+  EXPECT_EQ(0u, c.out_of_order_messages_);
+
+  const auto stats = mmpq.Stats();
+  EXPECT_EQ(4000u, stats.published);
+  EXPECT_EQ(4000u, stats.consumed);
+  EXPECT_EQ(0u, stats.dropped);
+  EXPECT_EQ(0u, stats.queued);
+}
+
+struct BlockableMMPQConsumerImpl {
+  std::vector<std::string> messages_;
+  std::atomic_bool suspend_processing_;
+  std::atomic_bool entered_;
+  std::atomic_size_t processed_messages_;
+  BlockableMMPQConsumerImpl() : suspend_processing_(false), entered_(false), processed_messages_(0u) {}
+  EntryResponse operator()(const std::string& s, idxts_t, idxts_t) {
+    entered_ = true;
+    while (suspend_processing_) {
+      std::this_thread::yield();
+    }
+    messages_.push_back(s);
+    ++processed_messages_;
+    return EntryResponse::More;
+  }
+};
+
+using BlockableMMPQConsumer = current::ss::EntrySubscriber<BlockableMMPQConsumerImpl, std::string>;
+
+TEST(InMemoryMQ, MMPQBlocksPublishersOnOverflow) {
+  current::time::ResetToZero();
+
+  BlockableMMPQConsumer c;
+  MMPQ<std::string, BlockableMMPQConsumer> mmpq(
+      c, current::mmq::MMPQParameters().SetMaxQueueSize(5u).SetOverflowPolicy(current::mmq::MMPQOverflowPolicy::Block));
+
+  c.suspend_processing_ = true;
+  for (int i = 1; i <= 5; ++i) {
+    mmpq.Publish(current::ToString(i));
+  }
+
+  // The sixth message does not fit, and its publisher is blocked until the consumer catches up.
+  std::atomic_bool published_sixth(false);
+  std::thread publisher([&mmpq, &published_sixth]() {
+    mmpq.Publish("6");
+    published_sixth = true;
+  });
+  while (mmpq.Stats().blocked != 1u) {
+    std::this_thread::yield();
+  }
+  EXPECT_FALSE(published_sixth);
+
+  c.suspend_processing_ = false;
+  publisher.join();
+  EXPECT_TRUE(published_sixth);
+
+  while (c.processed_messages_ != 6u) {
+    std::this_thread::yield();
+  }
+  EXPECT_EQ("1,2,3,4,5,6", current::strings::Join(c.messages_, ','));
+  EXPECT_EQ(0u, mmpq.Stats().dropped);
+}
+
+TEST(InMemoryMQ, MMPQMaxQueueSizeIsAHardBound) {
+  current::time::ResetToZero();
+
+  BlockableMMPQConsumer c;
+  MMPQ<std::string, BlockableMMPQConsumer> mmpq(
+      c, current::mmq::MMPQParameters().SetMaxQueueSize(5u).SetOverflowPolicy(current::mmq::MMPQOverflowPolicy::Block));
+
+  // Have many publishers blocked at once, so that they all wake up together when the consumer catches up.
+  c.suspend_processing_ = true;
+  std::atomic_size_t max_queued(0u);
+  std::vector<std::thread> publishers;
+  for (size_t i = 0; i < 8; ++i) {
+    publishers.emplace_back([&mmpq, &max_queued]() {
+      for (size_t j = 0; j < 100; ++j) {
+        mmpq.Publish("message");
+        size_t queued = mmpq.Stats().queued;
+        size_t max = max_queued;
+        while (queued > max && !max_queued.compare_exchange_weak(max, queued)) {
+        }
+      }
+    });
+  }
+  while (mmpq.Stats().blocked < 4u) {
+    std::this_thread::yield();
+  }
+  c.suspend_processing_ = false;
+  for (auto& p : publishers) {
+    p.join();
+  }
+
+  while (c.processed_messages_ != 800u) {
+    std::this_thread::yield();
+  }
+  EXPECT_LE(max_queued, 5u);
+  EXPECT_EQ(0u, mmpq.Stats().dropped);
+}
+
+TEST(InMemoryMQ, MMPQDropsOldestMessagesOnOverflow) {
+  current::time::ResetToZero();
+
+  BlockableMMPQConsumer c;
+  MMPQ<std::string, BlockableMMPQConsumer> mmpq(
+      c,
+      current::mmq::MMPQParameters().SetMaxQueueSize(5u).SetOverflowPolicy(current::mmq::MMPQOverflowPolicy::DropOldest));
+
+  // Have the consumer stuck on the first message while ten more are published.
+  c.suspend_processing_ = true;
+  mmpq.Publish("0");
+  while (!c.entered_) {
+    std::this_thread::yield();
+  }
+  for (int i = 1; i <= 10; ++i) {
+    mmpq.Publish(current::ToString(i));
+  }
+  EXPECT_EQ(11u, mmpq.Stats().queued);
+
+  // Once the consumer resumes, the five oldest of the ten messages are dropped.
+  c.suspend_processing_ = false;
+  while (mmpq.Stats().consumed != 6u) {
+    std::this_thread::yield();
+  }
+  EXPECT_EQ("0,6,7,8,9,10", current::strings::Join(c.messages_, ','));
+
+  const auto stats = mmpq.Stats();
+  EXPECT_EQ(11u, stats.published);
+  EXPECT_EQ(6u, stats.consumed);
+  EXPECT_EQ(5u, stats.dropped);
+  EXPECT_EQ(0u, stats.queued);
+}
+
+TEST(InMemoryMQ, LockFreeMMQConcurrentPublishers) {
+  current::time::ResetToZero();
+
+  struct ConsumerImpl {
+    idxts_t last = idxts_t(0u, std::chrono::microseconds(-1));
+    size_t out_of_order_messages_ = 0u;
+    std::atomic_size_t processed_messages_;
+    ConsumerImpl() : processed_messages_(0u) {}
+    EntryResponse operator()(const std::string&, idxts_t current, idxts_t) {
+      if (!(current.index == last.index + 1u && current.us > last.us)) {
+        ++out_of_order_messages_;
+      }
+      last = current;
+      ++processed_messages_;
+      return EntryResponse::More;
+    }
+  };
+
+  using Consumer = current::ss::EntrySubscriber<ConsumerImpl, std::string>;
+
+  Consumer c;
+  MMQ<std::string, Consumer, 16, false, true> mmq(c);
+
+  std::vector<std::thread> producers;
+  for (size_t i = 0; i < 16; ++i) {
+    producers.emplace_back([&mmq]() {
+      for (size_t j = 0; j < 250; ++j) {
+        mmq.Publish("message");
+      }
+    });
+  }
+  for (auto& p : producers) {
+    p.join();
+  }
+
+  while (c.processed_messages_ != 4000u) {
+    std::this_thread::yield();
+  }
+  EXPECT_EQ(0u, c.out_of_order_messages_);
+}
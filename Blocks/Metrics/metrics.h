@@ -0,0 +1,127 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2015 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+// The HTTP route exposing the metrics of `Bricks/util/metrics.h`:
+//
+//   HTTP(port).Register("/metrics", current::metrics::HTTPRoute);
+//
+// Responds with `MetricsSnapshot` in JSON, or, given `?format=prometheus` or `Accept: text/plain`,
+// in the Prometheus text exposition format.
+//
+// The metrics Current itself maintains:
+// * `current_stream_published_total`, `current_stream_publish_ns`, `current_stream_size`,
+//   `current_stream_subscribers`, `current_stream_delivered_total` and `current_stream_subscriber_lag`,
+//   labeled by the `namespace` and `entry` of the Sherlock stream.
+// * `current_storage_transaction_wait_ns` and `current_storage_transaction_held_ns`, the time transactions
+//   spend waiting for and holding the storage mutex, labeled by `mode`, `read_write` or `read_only`.
+// * `current_http_handler_ns`, labeled by `port` and `route`, and `current_http_not_found_total`, labeled by `port`.
+
+#ifndef BLOCKS_METRICS_METRICS_H
+#define BLOCKS_METRICS_METRICS_H
+
+#include "../../port.h"
+
+#include "../HTTP/api.h"
+
+#include "../../Bricks/util/metrics.h"
+#include "../../TypeSystem/struct.h"
+
+namespace current {
+namespace metrics {
+
+CURRENT_STRUCT(CounterValue) {
+  CURRENT_FIELD(name, std::string);
+  CURRENT_FIELD(labels, (std::map<std::string, std::string>));
+  CURRENT_FIELD(value, uint64_t, 0u);
+};
+
+CURRENT_STRUCT(GaugeValue) {
+  CURRENT_FIELD(name, std::string);
+  CURRENT_FIELD(labels, (std::map<std::string, std::string>));
+  CURRENT_FIELD(value, int64_t, 0);
+};
+
+CURRENT_STRUCT(HistogramValue) {
+  CURRENT_FIELD(name, std::string);
+  CURRENT_FIELD(labels, (std::map<std::string, std::string>));
+  CURRENT_FIELD(count, uint64_t, 0u);
+  CURRENT_FIELD(sum, uint64_t, 0u);
+  CURRENT_FIELD(p50, uint64_t, 0u);
+  CURRENT_FIELD(p99, uint64_t, 0u);
+  CURRENT_FIELD(p999, uint64_t, 0u);
+};
+
+CURRENT_STRUCT(MetricsSnapshot) {
+  CURRENT_FIELD(counters, std::vector<CounterValue>);
+  CURRENT_FIELD(gauges, std::vector<GaugeValue>);
+  CURRENT_FIELD(histograms, std::vector<HistogramValue>);
+};
+
+inline MetricsSnapshot Snapshot(const std::vector<MetricValues>& metrics) {
+  MetricsSnapshot snapshot;
+  for (const auto& metric : metrics) {
+    if (metric.type == MetricType::Counter) {
+      CounterValue counter;
+      counter.name = metric.name;
+      counter.labels = metric.labels;
+      counter.value = metric.counter;
+      snapshot.counters.push_back(std::move(counter));
+    } else if (metric.type == MetricType::Gauge) {
+      GaugeValue gauge;
+      gauge.name = metric.name;
+      gauge.labels = metric.labels;
+      gauge.value = metric.gauge;
+      snapshot.gauges.push_back(std::move(gauge));
+    } else {
+      HistogramValue histogram;
+      histogram.name = metric.name;
+      histogram.labels = metric.labels;
+      histogram.count = metric.histogram.count;
+      histogram.sum = metric.histogram.sum;
+      histogram.p50 = metric.histogram.Percentile(0.5);
+      histogram.p99 = metric.histogram.Percentile(0.99);
+      histogram.p999 = metric.histogram.Percentile(0.999);
+      snapshot.histograms.push_back(std::move(histogram));
+    }
+  }
+  return snapshot;
+}
+
+inline MetricsSnapshot Snapshot() { return Snapshot(Registry().Snapshot()); }
+
+inline void HTTPRoute(Request request) {
+  if (request.method != "GET") {
+    request(current::net::DefaultMethodNotAllowedMessage(), HTTPResponseCode.MethodNotAllowed);
+  } else if (request.url.query["format"] == "prometheus" ||
+             request.headers.GetOrDefault("Accept", "").find("text/plain") != std::string::npos) {
+    request(PrometheusText(Registry().Snapshot()), HTTPResponseCode.OK, "text/plain; version=0.0.4");
+  } else {
+    request(Snapshot());
+  }
+}
+
+}  // namespace metrics
+}  // namespace current
+
+#endif  // BLOCKS_METRICS_METRICS_H
@@ -0,0 +1,149 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2015 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+#include "metrics.h"
+
+#include <thread>
+
+#include "../../TypeSystem/Serialization/json.h"
+
+#include "../../Bricks/strings/printf.h"
+
+#include "../../Bricks/dflags/dflags.h"
+#include "../../3rdparty/gtest/gtest-main-with-dflags.h"
+
+DEFINE_int32(metrics_test_port, PickPortForUnitTest(), "Local port to run the test.");
+
+TEST(Metrics, ShardedAcrossThreads) {
+  using namespace current::metrics;
+
+  Counter& counter = Registry().GetCounter("test_sharded_total");
+  Histogram& histogram = Registry().GetHistogram("test_sharded_ns");
+
+  std::vector<std::thread> threads;
+  for (size_t t = 0u; t < 4u; ++t) {
+    threads.emplace_back([&counter, &histogram]() {
+      for (uint64_t i = 1u; i <= 1000u; ++i) {
+        counter.Add();
+        histogram.Record(i);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_EQ(4000u, counter.Value());
+  const HistogramValues values = histogram.Values();
+  EXPECT_EQ(4000u, values.count);
+  EXPECT_EQ(4u * 500500u, values.sum);
+  EXPECT_NEAR(500.0, static_cast<double>(values.Percentile(0.5)), 500.0 / 8);
+  EXPECT_NEAR(990.0, static_cast<double>(values.Percentile(0.99)), 990.0 / 8);
+}
+
+TEST(Metrics, Registry) {
+  using namespace current::metrics;
+
+  Gauge& gauge = Registry().GetGauge("test_registry_gauge", {{"shard", "a"}});
+  gauge.Set(42);
+  gauge.Add(-2);
+  EXPECT_EQ(40, Registry().GetGauge("test_registry_gauge", {{"shard", "a"}}).Value());
+  EXPECT_EQ(&gauge, &Registry().GetGauge("test_registry_gauge", {{"shard", "a"}}));
+  EXPECT_NE(&gauge, &Registry().GetGauge("test_registry_gauge", {{"shard", "b"}}));
+
+  ASSERT_THROW(Registry().GetCounter("test_registry_gauge"), MetricTypeMismatchException);
+}
+
+TEST(Metrics, PrometheusText) {
+  using namespace current::metrics;
+
+  MetricValues counter;
+  counter.name = "requests_total";
+  counter.labels = {{"route", "/\"quoted\""}};
+  counter.type = MetricType::Counter;
+  counter.counter = 3u;
+
+  MetricValues gauge;
+  gauge.name = "queue_size";
+  gauge.type = MetricType::Gauge;
+  gauge.gauge = -1;
+
+  MetricValues histogram;
+  histogram.name = "latency_ns";
+  histogram.labels = {{"route", "/"}};
+  histogram.type = MetricType::Histogram;
+  histogram.histogram.count = 2u;
+  histogram.histogram.sum = 11u;
+  histogram.histogram.buckets[LogLinearHistogram::BucketIndex(5u)] = 1u;
+  histogram.histogram.buckets[LogLinearHistogram::BucketIndex(6u)] = 1u;
+
+  EXPECT_EQ(
+      "# TYPE requests_total counter\n"
+      "requests_total{route=\"/\\\"quoted\\\"\"} 3\n"
+      "# TYPE queue_size gauge\n"
+      "queue_size -1\n"
+      "# TYPE latency_ns summary\n"
+      "latency_ns{route=\"/\",quantile=\"0.5\"} 6\n"
+      "latency_ns{route=\"/\",quantile=\"0.99\"} 6\n"
+      "latency_ns{route=\"/\",quantile=\"0.999\"} 6\n"
+      "latency_ns_sum{route=\"/\"} 11\n"
+      "latency_ns_count{route=\"/\"} 2\n",
+      PrometheusText({counter, gauge, histogram}));
+}
+
+TEST(Metrics, HTTPRoute) {
+  using namespace current::metrics;
+
+  const auto scope = HTTP(FLAGS_metrics_test_port).Register("/metrics", HTTPRoute) +
+                     HTTP(FLAGS_metrics_test_port).Register("/ok", [](Request r) { r("OK\n"); });
+
+  const std::string base_url = current::strings::Printf("http://localhost:%d", FLAGS_metrics_test_port);
+  EXPECT_EQ("OK\n", HTTP(GET(base_url + "/ok")).body);
+  EXPECT_EQ(404, static_cast<int>(HTTP(GET(base_url + "/not_found")).code));
+
+  const auto snapshot = ParseJSON<MetricsSnapshot>(HTTP(GET(base_url + "/metrics")).body);
+  const std::string port = current::ToString(FLAGS_metrics_test_port);
+  bool found_ok = false;
+  for (const auto& histogram : snapshot.histograms) {
+    if (histogram.name == "current_http_handler_ns" && histogram.labels.at("port") == port &&
+        histogram.labels.at("route") == "/ok") {
+      EXPECT_EQ(1u, histogram.count);
+      found_ok = true;
+    }
+  }
+  EXPECT_TRUE(found_ok);
+  bool found_not_found = false;
+  for (const auto& counter : snapshot.counters) {
+    if (counter.name == "current_http_not_found_total" && counter.labels.at("port") == port) {
+      EXPECT_EQ(1u, counter.value);
+      found_not_found = true;
+    }
+  }
+  EXPECT_TRUE(found_not_found);
+
+  const std::string expected = "current_http_not_found_total{port=\"" + port + "\"} 1\n";
+  EXPECT_NE(std::string::npos, HTTP(GET(base_url + "/metrics?format=prometheus")).body.find(expected));
+  EXPECT_NE(std::string::npos,
+            HTTP(GET(base_url + "/metrics").SetHeader("Accept", "text/plain")).body.find(expected));
+}
@@ -27,13 +27,18 @@ SOFTWARE.
 // The file is replayed at startup to check its integriry and to extract the most recent index/timestamp.
 // Each iterator opens the same file again, to read its first N lines.
 // Iterators never outlive the persister.
+// For a `Variant` entry, the index of the type it holds is kept in memory along with the offset of each entry,
+// so that the iterator from `IterateOfType<T>()` seeks over the entries of other types instead of parsing them.
 
 #ifndef BLOCKS_PERSISTENCE_FILE_H
 #define BLOCKS_PERSISTENCE_FILE_H
 
 #include <atomic>
+#include <cstring>
 #include <fstream>
 #include <functional>
+#include <type_traits>
+#include <unordered_map>
 
 #include "exceptions.h"
 
@@ -61,6 +66,74 @@ constexpr char kHeadFormatString[] = "%020lld";
 
 typedef int64_t head_value_t;
 
+// The index of the type held by a `Variant` entry in its type list, or `variant::kUnknownTypeIndex`.
+template <typename ENTRY, typename TYPE_LIST>
+struct VariantEntryTypeIndex;
+
+template <typename ENTRY, typename... TYPES>
+struct VariantEntryTypeIndex<ENTRY, TypeListImpl<TYPES...>> {
+  struct TypeIndexOfObject {
+    size_t& result;
+    template <typename T>
+    void operator()(const T&) {
+      result = variant::TypeIndex<T, TYPES...>::value;
+    }
+  };
+
+  static size_t FromEntry(const ENTRY& entry) {
+    size_t result = variant::kUnknownTypeIndex;
+    if (entry) {
+      entry.Call(TypeIndexOfObject{result});
+    }
+    return result;
+  }
+
+  // The JSON of a `Variant` starts with the name of the type of its object, `{"Name":`. The types with the same
+  // name from different namespaces are ambiguous, and the entries of those types are always parsed.
+  static size_t FromJSON(const char* json) {
+    static const std::unordered_map<std::string, size_t> indexes = []() {
+      const char* names[] = {reflection::CurrentTypeName<TYPES, reflection::NameFormat::Z>()...};
+      std::unordered_map<std::string, size_t> result;
+      for (size_t i = 0u; i < sizeof...(TYPES); ++i) {
+        if (!result.emplace(names[i], i).second) {
+          result[names[i]] = variant::kUnknownTypeIndex;
+        }
+      }
+      return result;
+    }();
+    if (json[0] == '{' && json[1] == '"') {
+      const char* name = json + 2;
+      if (const char* end = std::strchr(name, '"')) {
+        const auto cit = indexes.find(std::string(name, end));
+        if (cit != indexes.end()) {
+          return cit->second;
+        }
+      }
+    }
+    return variant::kUnknownTypeIndex;
+  }
+
+  // Which types of the type list hold a `TYPE`, or `nullptr` for no filtering if `TYPE` is the entry type itself.
+  template <typename TYPE>
+  static const std::vector<bool>* TypeFilter() {
+    static const std::vector<bool> matches({std::is_base_of<TYPE, TYPES>::value...});
+    return std::is_same<TYPE, ENTRY>::value ? nullptr : &matches;
+  }
+};
+
+template <typename ENTRY, bool IS_VARIANT = IS_CURRENT_VARIANT(ENTRY)>
+struct EntryTypeIndex {
+  static size_t FromEntry(const ENTRY&) { return variant::kUnknownTypeIndex; }
+  static size_t FromJSON(const char*) { return variant::kUnknownTypeIndex; }
+  template <typename TYPE>
+  static const std::vector<bool>* TypeFilter() {
+    return nullptr;
+  }
+};
+
+template <typename ENTRY>
+struct EntryTypeIndex<ENTRY, true> : VariantEntryTypeIndex<ENTRY, typename ENTRY::typelist_t> {};
+
 // An iterator to read a file line by line, extracting tab-separated `idxts_t index` and `const char* data`.
 // Validates the entries come in the right order of 0-based indexes, and with strictly increasing timestamps.
 template <typename ENTRY>
@@ -134,10 +207,11 @@ class FilePersister {
     std::fstream head_rewriter;
 
     // `offset.size() == end.next_index`, and `offset[i]` is the offset in bytes where the line for index `i` begins.
-    std::mutex& mutex_ref;  // Guards `offset`, `head_offset` and `timestamp`.
+    std::mutex& mutex_ref;  // Guards `offset`, `head_offset`, `timestamp` and `type_index`.
     std::vector<std::streampos> offset;
     std::streamoff head_offset;
     std::vector<std::chrono::microseconds> timestamp;
+    std::vector<size_t> type_index;  // The `EntryTypeIndex` of each entry.
 
     // Just `std::atomic<end_t> end;` won't work in g++ until 5.1, ref.
     // http://stackoverflow.com/questions/29824570/segfault-in-stdatomic-load/29824840#29824840
@@ -179,7 +253,7 @@ class FilePersister {
         struct_schema.AddType<ENTRY>();
         const auto signature = JSON(ss::StreamSignature(namespace_name, struct_schema.GetSchemaInfo()));
         while (cit.ProcessNextEntry(
-            [&](const idxts_t& current, const char*) {
+            [&](const idxts_t& current, const char* json) {
               CURRENT_ASSERT(current.index == offset.size());
               CURRENT_ASSERT(current.index == timestamp.size());
               if (!(current.us > head)) {
@@ -187,6 +261,7 @@ class FilePersister {
               }
               offset.push_back(current_offset);
               timestamp.push_back(current.us);
+              type_index.push_back(EntryTypeIndex<ENTRY>::FromJSON(json));
               current_offset = fi.tellg();
               head = current.us;
               head_offset = 0;
@@ -266,8 +341,9 @@ class FilePersister {
              const std::string& filename,
              uint64_t i,
              std::streampos offset,
-             uint64_t index_at_offset)
-        : file_persister_impl_(file_persister_impl, [this]() { valid_ = false; }), i_(i) {
+             uint64_t index_at_offset,
+             const std::vector<bool>* type_filter)
+        : file_persister_impl_(file_persister_impl, [this]() { valid_ = false; }), i_(i), type_filter_(type_filter) {
       if (!filename.empty()) {
         fi_ = std::make_unique<std::ifstream>(filename);
         cit_ = std::make_unique<IteratorOverFileOfPersistedEntries<ENTRY>>(*fi_, offset, index_at_offset);
@@ -282,6 +358,24 @@ class FilePersister {
             PersistenceFileNoLongerAvailable(file_persister_impl_.ObjectAccessorDespitePossiblyDestructing().filename));
       }
       Entry result;
+      if (type_filter_) {
+        size_t type_index;
+        std::streampos offset;
+        {
+          std::lock_guard<std::mutex> lock(file_persister_impl_->mutex_ref);
+          type_index = file_persister_impl_->type_index[i_];
+          offset = file_persister_impl_->offset[i_];
+          result.idx_ts = idxts_t(i_, file_persister_impl_->timestamp[i_]);
+        }
+        if (type_index != variant::kUnknownTypeIndex && !(*type_filter_)[type_index]) {
+          // Not of the type iterated over, leave the entry uninitialized.
+          return result;
+        }
+        if (cit_->Next().index != i_) {
+          // Seek over the entries skipped.
+          cit_ = std::make_unique<IteratorOverFileOfPersistedEntries<ENTRY>>(*fi_, offset, i_);
+        }
+      }
       bool found = false;
       while (!found) {
         if (!(cit_->ProcessNextEntry(
@@ -318,8 +412,9 @@ class FilePersister {
     ScopeOwnedBySomeoneElse<FilePersisterImpl> file_persister_impl_;
     bool valid_ = true;
     std::unique_ptr<std::ifstream> fi_;
-    std::unique_ptr<IteratorOverFileOfPersistedEntries<ENTRY>> cit_;
+    mutable std::unique_ptr<IteratorOverFileOfPersistedEntries<ENTRY>> cit_;
     uint64_t i_;
+    const std::vector<bool>* type_filter_;  // Which types of the `Variant` entry to parse, or `nullptr` for all.
   };
 
   class IteratorUnsafe final {
@@ -334,7 +429,8 @@ class FilePersister {
                    const std::string& filename,
                    uint64_t i,
                    std::streampos offset,
-                   uint64_t)
+                   uint64_t,
+                   const std::vector<bool>*)
         : file_persister_impl_(file_persister_impl, [this]() { valid_ = false; }), i_(i), current_offset_(offset) {
       if (!filename.empty()) {
         fi_ = std::make_unique<std::ifstream>(filename);
@@ -396,11 +492,13 @@ class FilePersister {
     explicit IterableRangeImpl(ScopeOwned<FilePersisterImpl>& file_persister_impl,
                                uint64_t begin,
                                uint64_t end,
-                               std::streampos begin_offset)
+                               std::streampos begin_offset,
+                               const std::vector<bool>* type_filter = nullptr)
         : file_persister_impl_(file_persister_impl, [this]() { valid_ = false; }),
           begin_(begin),
           end_(end),
-          begin_offset_(begin_offset) {}
+          begin_offset_(begin_offset),
+          type_filter_(type_filter) {}
 
     ITERATOR begin() const {
       if (!valid_) {
@@ -408,9 +506,11 @@ class FilePersister {
             PersistenceFileNoLongerAvailable(file_persister_impl_.ObjectAccessorDespitePossiblyDestructing().filename));
       }
       if (begin_ == end_) {
-        return ITERATOR(file_persister_impl_, "", 0, 0, 0);  // No need in accessing the file for a null iterator.
+        // No need in accessing the file for a null iterator.
+        return ITERATOR(file_persister_impl_, "", 0, 0, 0, nullptr);
       } else {
-        return ITERATOR(file_persister_impl_, file_persister_impl_->filename, begin_, begin_offset_, begin_);
+        return ITERATOR(
+            file_persister_impl_, file_persister_impl_->filename, begin_, begin_offset_, begin_, type_filter_);
       }
     }
     ITERATOR end() const {
@@ -419,10 +519,11 @@ class FilePersister {
             PersistenceFileNoLongerAvailable(file_persister_impl_.ObjectAccessorDespitePossiblyDestructing().filename));
       }
       if (begin_ == end_) {
-        return ITERATOR(file_persister_impl_, "", 0, 0, 0);  // No need in accessing the file for a null iterator.
+        // No need in accessing the file for a null iterator.
+        return ITERATOR(file_persister_impl_, "", 0, 0, 0, nullptr);
       } else {
-        return ITERATOR(
-            file_persister_impl_, "", end_, 0, 0);  // No need in accessing the file for a no-op `end` iterator.
+        // No need in accessing the file for a no-op `end` iterator.
+        return ITERATOR(file_persister_impl_, "", end_, 0, 0, nullptr);
       }
     }
 
@@ -434,6 +535,7 @@ class FilePersister {
     const uint64_t begin_;
     const uint64_t end_;
     const std::streampos begin_offset_;
+    const std::vector<bool>* type_filter_;
   };
 
   template <current::locks::MutexLockStatus MLS, typename E, typename US>
@@ -441,7 +543,7 @@ class FilePersister {
     current::locks::SmartMutexLockGuard<MLS> lock(file_persister_impl_->mutex_ref);
 
     end_t iterator = file_persister_impl_->end.load();
-    const auto timestamp = current::time::GetTimestampFromLockedSection(us);
+    const auto timestamp = current::time::GetTimestampFromLockedSection(us, iterator.head);
     if (!(timestamp > iterator.head)) {
       CURRENT_THROW(ss::InconsistentTimestampException(iterator.head + std::chrono::microseconds(1), timestamp));
     }
@@ -452,6 +554,7 @@ class FilePersister {
     CURRENT_ASSERT(file_persister_impl_->timestamp.size() == iterator.next_index);
     file_persister_impl_->offset.push_back(file_persister_impl_->appender.tellp());
     file_persister_impl_->timestamp.push_back(timestamp);
+    file_persister_impl_->type_index.push_back(EntryTypeIndex<ENTRY>::FromEntry(entry));
 
     file_persister_impl_->appender << JSON(current) << '\t' << JSON(std::forward<E>(entry)) << std::endl;
     ++iterator.next_index;
@@ -466,7 +569,7 @@ class FilePersister {
     current::locks::SmartMutexLockGuard<MLS> lock(file_persister_impl_->mutex_ref);
 
     end_t iterator = file_persister_impl_->end.load();
-    const auto timestamp = current::time::GetTimestampFromLockedSection(us);
+    const auto timestamp = current::time::GetTimestampFromLockedSection(us, iterator.head);
     if (!(timestamp > iterator.head)) {
       CURRENT_THROW(ss::InconsistentTimestampException(iterator.head + std::chrono::microseconds(1), timestamp));
     }
@@ -549,6 +652,35 @@ class FilePersister {
 
   template <ss::IterationMode IM>
   IterableRange<IM> Iterate(uint64_t begin_index, uint64_t end_index) const {
+    return IterateImpl<IM>(begin_index, end_index, nullptr);
+  }
+
+  // Iterates over the entries of a `Variant` holding a `TYPE`. The entries of other types are not read from the file,
+  // and are returned with their `idx_ts` only, the `entry` left uninitialized.
+  template <typename TYPE>
+  IterableRange<ss::IterationMode::Safe> IterateOfType(uint64_t begin_index, uint64_t end_index) const {
+    return IterateImpl<ss::IterationMode::Safe>(
+        begin_index, end_index, EntryTypeIndex<ENTRY>::template TypeFilter<TYPE>());
+  }
+
+  template <ss::IterationMode IM>
+  IterableRange<IM> Iterate(std::chrono::microseconds from, std::chrono::microseconds till) const {
+    if (till.count() > 0 && till < from) {
+      CURRENT_THROW(InvalidIterableRangeException());
+    }
+    const auto index_range = IndexRangeByTimestampRange(from, till);
+    if (index_range.first != static_cast<uint64_t>(-1)) {
+      return Iterate<IM>(index_range.first, index_range.second);
+    } else {  // No entries found in the given range.
+      return IterableRange<IM>(file_persister_impl_, 0, 0, 0);
+    }
+  }
+
+ private:
+  template <ss::IterationMode IM>
+  IterableRange<IM> IterateImpl(uint64_t begin_index,
+                                uint64_t end_index,
+                                const std::vector<bool>* type_filter) const {
     const uint64_t current_size = file_persister_impl_->end.load().next_index;
     if (end_index == static_cast<uint64_t>(-1)) {
       end_index = current_size;
@@ -566,23 +698,10 @@ class FilePersister {
     std::lock_guard<std::mutex> lock(file_persister_impl_->mutex_ref);
     CURRENT_ASSERT(file_persister_impl_->offset.size() >=
                    current_size);  // "Greater" is OK, `Iterate()` is multithreaded. -- D.K.
-    return IterableRange<IM>(file_persister_impl_, begin_index, end_index, file_persister_impl_->offset[begin_index]);
+    return IterableRange<IM>(
+        file_persister_impl_, begin_index, end_index, file_persister_impl_->offset[begin_index], type_filter);
   }
 
-  template <ss::IterationMode IM>
-  IterableRange<IM> Iterate(std::chrono::microseconds from, std::chrono::microseconds till) const {
-    if (till.count() > 0 && till < from) {
-      CURRENT_THROW(InvalidIterableRangeException());
-    }
-    const auto index_range = IndexRangeByTimestampRange(from, till);
-    if (index_range.first != static_cast<uint64_t>(-1)) {
-      return Iterate<IM>(index_range.first, index_range.second);
-    } else {  // No entries found in the given range.
-      return IterableRange<IM>(file_persister_impl_, 0, 0, 0);
-    }
-  }
-
- private:
   mutable ScopeOwnedByMe<FilePersisterImpl> file_persister_impl_;
 };
 
@@ -24,16 +24,19 @@ SOFTWARE.
 *******************************************************************************/
 
 // A simple, reference, implementation of an in-memory persister.
-// Store all entries in an `std::vector<std::pair<std::chrono::microseconds, ENTRY>>`,
-// and accesses this vector by indexes from under a mutex when iterating over the entries.
+// Stores all entries in an append-only log of `std::pair<std::chrono::microseconds, ENTRY>`, split into chunks
+// that are never reallocated. The publishers are serialized by the mutex, while the readers access the entries
+// below the atomically published size without locking.
 // Iterators never outlive the persister.
 
 #ifndef BLOCKS_PERSISTENCE_MEMORY_H
 #define BLOCKS_PERSISTENCE_MEMORY_H
 
-#include <deque>
+#include <atomic>
 #include <functional>
+#include <memory>
 #include <mutex>
+#include <type_traits>
 
 #include "exceptions.h"
 
@@ -52,13 +55,69 @@ namespace impl {
 template <typename ENTRY>
 class MemoryPersister {
  private:
+  // The entries live in chunks of geometrically growing sizes: the first one holds `2^kFirstChunkSizeLog2` entries,
+  // and each next one is twice as large as the previous one. Since the entries never move, and since
+  // the chunk to hold an entry is allocated before the entry is published, the entries with indexes below `size`
+  // are safe to read without grabbing the mutex.
   struct Container {
     using entry_t = std::pair<std::chrono::microseconds, ENTRY>;
-    std::mutex& mutex_ref;  // Guards `entries` and `head`.
-    std::deque<entry_t> entries;
+    using storage_t = typename std::aligned_storage<sizeof(entry_t), alignof(entry_t)>::type;
+    constexpr static size_t kFirstChunkSizeLog2 = 10u;
+    constexpr static size_t kMaxChunks = 64u - kFirstChunkSizeLog2;
+
+    std::mutex& mutex_ref;  // Serializes appending the entries, and guards `head`.
+    std::atomic<uint64_t> size;
+    std::unique_ptr<storage_t[]> chunks[kMaxChunks];
     std::chrono::microseconds head = std::chrono::microseconds(-1);
 
-    Container(std::mutex& mutex_ref) : mutex_ref(mutex_ref) {}
+    Container(std::mutex& mutex_ref) : mutex_ref(mutex_ref), size(0u) {}
+
+    ~Container() {
+      const uint64_t total = size.load();
+      for (uint64_t i = 0u; i < total; ++i) {
+        At(i).~entry_t();
+      }
+    }
+
+    // Thread-safe for `index < size`, without the mutex.
+    const entry_t& At(uint64_t index) const {
+      size_t chunk;
+      uint64_t offset;
+      Locate(index, chunk, offset);
+      return *reinterpret_cast<const entry_t*>(&chunks[chunk][offset]);
+    }
+    entry_t& At(uint64_t index) { return const_cast<entry_t&>(static_cast<const Container*>(this)->At(index)); }
+
+    // Must be called from under the mutex.
+    template <typename... ARGS>
+    void Append(ARGS&&... args) {
+      const uint64_t index = size.load(std::memory_order_relaxed);
+      size_t chunk;
+      uint64_t offset;
+      Locate(index, chunk, offset);
+      if (!offset) {
+        chunks[chunk].reset(new storage_t[static_cast<size_t>(1u) << (kFirstChunkSizeLog2 + chunk)]);
+      }
+      new (&chunks[chunk][offset]) entry_t(std::forward<ARGS>(args)...);
+      size.store(index + 1u, std::memory_order_release);
+    }
+
+    const entry_t& Back() const { return At(size.load(std::memory_order_acquire) - 1u); }
+
+    static void Locate(uint64_t index, size_t& chunk, uint64_t& offset) {
+      const uint64_t x = index + (static_cast<uint64_t>(1u) << kFirstChunkSizeLog2);
+      size_t log2 = 0u;
+      for (size_t shift = 32u; shift; shift >>= 1) {
+        if (x >> (log2 + shift)) {
+          log2 += shift;
+        }
+      }
+      chunk = log2 - kFirstChunkSizeLog2;
+      offset = x - (static_cast<uint64_t>(1u) << log2);
+    }
+
+    Container(const Container&) = delete;
+    void operator=(const Container&) = delete;
   };
 
  public:
@@ -82,8 +141,7 @@ class MemoryPersister {
       if (!valid_) {
         CURRENT_THROW(PersistenceMemoryBlockNoLongerAvailable());
       }
-      std::lock_guard<std::mutex> lock(container_->mutex_ref);
-      return Entry(i_, container_->entries[i_]);
+      return Entry(i_, container_->At(i_));
     }
     Iterator& operator++() {
       if (!valid_) {
@@ -111,8 +169,7 @@ class MemoryPersister {
       if (!valid_) {
         CURRENT_THROW(PersistenceMemoryBlockNoLongerAvailable());
       }
-      std::lock_guard<std::mutex> lock(container_->mutex_ref);
-      const auto& entry = container_->entries[i_];
+      const auto& entry = container_->At(i_);
       return JSON(idxts_t(i_, entry.first)) + '\t' + JSON(entry.second);
     }
     IteratorUnsafe& operator++() {
@@ -163,12 +220,12 @@ class MemoryPersister {
   idxts_t DoPublish(E&& entry, const US us) {
     current::locks::SmartMutexLockGuard<MLS> lock(container_->mutex_ref);
     const auto head = container_->head;
-    const auto timestamp = current::time::GetTimestampFromLockedSection(us);
+    const auto timestamp = current::time::GetTimestampFromLockedSection(us, head);
     if (!(timestamp > head)) {
       CURRENT_THROW(ss::InconsistentTimestampException(head + std::chrono::microseconds(1), timestamp));
     }
-    const auto index = static_cast<uint64_t>(container_->entries.size());
-    container_->entries.emplace_back(timestamp, std::forward<E>(entry));
+    const auto index = container_->size.load(std::memory_order_relaxed);
+    container_->Append(timestamp, std::forward<E>(entry));
     container_->head = timestamp;
     return idxts_t(index, timestamp);
   }
@@ -176,30 +233,25 @@ class MemoryPersister {
   template <current::locks::MutexLockStatus MLS, typename US>
   void DoUpdateHead(const US us) {
     current::locks::SmartMutexLockGuard<MLS> lock(container_->mutex_ref);
-    const auto timestamp = current::time::GetTimestampFromLockedSection(us);
     const auto head = container_->head;
+    const auto timestamp = current::time::GetTimestampFromLockedSection(us, head);
     if (!(timestamp > head)) {
       CURRENT_THROW(ss::InconsistentTimestampException(head + std::chrono::microseconds(1), timestamp));
     }
     container_->head = timestamp;
   }
 
-  template <current::locks::MutexLockStatus MLS>
-  bool Empty() const noexcept {
-    current::locks::SmartMutexLockGuard<MLS> lock(container_->mutex_ref);
-    return container_->entries.empty();
-  }
+  // `Empty()`, `Size()`, and `LastPublishedIndexAndTimestamp()` do not need the mutex.
+  template <current::locks::MutexLockStatus>
+  bool Empty() const noexcept { return !container_->size.load(std::memory_order_acquire); }
 
-  template <current::locks::MutexLockStatus MLS>
-  uint64_t Size() const noexcept {
-    current::locks::SmartMutexLockGuard<MLS> lock(container_->mutex_ref);
-    return static_cast<uint64_t>(container_->entries.size());
-  }
+  template <current::locks::MutexLockStatus>
+  uint64_t Size() const noexcept { return container_->size.load(std::memory_order_acquire); }
 
   idxts_t LastPublishedIndexAndTimestamp() const {
-    std::lock_guard<std::mutex> lock(container_->mutex_ref);
-    if (!container_->entries.empty()) {
-      return idxts_t(container_->entries.size() - 1, container_->entries.back().first);
+    const uint64_t size = container_->size.load(std::memory_order_acquire);
+    if (size) {
+      return idxts_t(size - 1, container_->At(size - 1).first);
     } else {
       CURRENT_THROW(NoEntriesPublishedYet());
     }
@@ -207,8 +259,9 @@ class MemoryPersister {
 
   head_optidxts_t HeadAndLastPublishedIndexAndTimestamp() const noexcept {
     std::lock_guard<std::mutex> lock(container_->mutex_ref);
-    if (!container_->entries.empty()) {
-      return head_optidxts_t(container_->head, container_->entries.size() - 1, container_->entries.back().first);
+    const uint64_t size = container_->size.load(std::memory_order_relaxed);
+    if (size) {
+      return head_optidxts_t(container_->head, size - 1, container_->At(size - 1).first);
     } else {
       return head_optidxts_t(container_->head);
     }
@@ -223,23 +276,18 @@ class MemoryPersister {
   std::pair<uint64_t, uint64_t> IndexRangeByTimestampRange(std::chrono::microseconds from,
                                                            std::chrono::microseconds till) const {
     std::pair<uint64_t, uint64_t> result{static_cast<uint64_t>(-1), static_cast<uint64_t>(-1)};
-    std::lock_guard<std::mutex> lock(container_->mutex_ref);
-    const auto begin_it =
-        std::lower_bound(container_->entries.begin(),
-                         container_->entries.end(),
-                         from,
-                         [](const typename Container::entry_t& e, std::chrono::microseconds t) { return e.first < t; });
-    if (begin_it != container_->entries.end()) {
-      result.first = std::distance(container_->entries.begin(), begin_it);
+    const Container& container = *container_;
+    const uint64_t size = container.size.load(std::memory_order_acquire);
+    const uint64_t begin =
+        FirstIndexSuchThat(container, size, [from](std::chrono::microseconds t) { return !(t < from); });
+    if (begin != size) {
+      result.first = begin;
     }
     if (till.count() > 0) {
-      const auto end_it = std::upper_bound(
-          container_->entries.begin(),
-          container_->entries.end(),
-          till,
-          [](std::chrono::microseconds t, const typename Container::entry_t& e) { return t < e.first; });
-      if (end_it != container_->entries.end()) {
-        result.second = std::distance(container_->entries.begin(), end_it);
+      const uint64_t end =
+          FirstIndexSuchThat(container, size, [till](std::chrono::microseconds t) { return till < t; });
+      if (end != size) {
+        result.second = end;
       }
     }
     return result;
@@ -252,10 +300,7 @@ class MemoryPersister {
 
   template <ss::IterationMode IM>
   IterableRange<IM> Iterate(uint64_t begin, uint64_t end) const {
-    const uint64_t size = [this]() {
-      std::lock_guard<std::mutex> lock(container_->mutex_ref);
-      return static_cast<uint64_t>(container_->entries.size());
-    }();
+    const uint64_t size = container_->size.load(std::memory_order_acquire);
 
     if (end == static_cast<uint64_t>(-1)) {
       end = size;
@@ -277,6 +322,12 @@ class MemoryPersister {
     return IterableRange<IM>(container_, begin, end);
   }
 
+  // The entries are in memory already, so there is no parsing to skip for the entries not holding a `TYPE`.
+  template <typename TYPE>
+  IterableRange<ss::IterationMode::Safe> IterateOfType(uint64_t begin, uint64_t end) const {
+    return Iterate<ss::IterationMode::Safe>(begin, end);
+  }
+
   template <ss::IterationMode IM>
   IterableRange<IM> Iterate(std::chrono::microseconds from, std::chrono::microseconds till) const {
     if (till.count() > 0 && till < from) {
@@ -291,6 +342,23 @@ class MemoryPersister {
   }
 
  private:
+  // The index of the first entry, among the first `size` ones, the timestamp of which satisfies `predicate`,
+  // or `size` if there is none. The timestamps are strictly increasing, so it's a binary search.
+  template <typename PREDICATE>
+  static uint64_t FirstIndexSuchThat(const Container& container, uint64_t size, PREDICATE&& predicate) {
+    uint64_t begin = 0u;
+    uint64_t end = size;
+    while (begin < end) {
+      const uint64_t middle = begin + (end - begin) / 2u;
+      if (predicate(container.At(middle).first)) {
+        end = middle;
+      } else {
+        begin = middle + 1u;
+      }
+    }
+    return begin;
+  }
+
   mutable ScopeOwnedByMe<Container> container_;
 };
 
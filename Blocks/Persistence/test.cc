@@ -25,7 +25,9 @@ SOFTWARE.
 
 #include "../../port.h"
 
+#include <atomic>
 #include <string>
+#include <thread>
 
 #define CURRENT_MOCK_TIME  // `SetNow()`.
 
@@ -53,6 +55,12 @@ CURRENT_STRUCT(StorableString) {
   CURRENT_CONSTRUCTOR(StorableString)(const std::string& s) : s(s) {}
 };
 
+CURRENT_STRUCT(StorableInteger) {
+  CURRENT_FIELD(i, int32_t, 0);
+  CURRENT_DEFAULT_CONSTRUCTOR(StorableInteger) {}
+  CURRENT_CONSTRUCTOR(StorableInteger)(int32_t i) : i(i) {}
+};
+
 }  // namespace persistence_test
 
 TEST(PersistenceLayer, Memory) {
@@ -293,6 +301,64 @@ TEST(PersistenceLayer, MemoryIteratorCanNotOutliveMemoryBlock) {
   t.join();
 }
 
+TEST(PersistenceLayer, MemoryConcurrentReadsWhilePublishing) {
+  using namespace persistence_test;
+  using IMPL = current::persistence::Memory<std::string>;
+
+  // Enough entries to span several chunks of the in-memory log.
+  const uint64_t N = 10000u;
+
+  std::mutex mutex;
+  const auto namespace_name = current::ss::StreamNamespaceName("namespace", "entry_name");
+  IMPL impl(mutex, namespace_name);
+
+  std::thread publisher([&impl, N]() {
+    for (uint64_t i = 0u; i < N; ++i) {
+      impl.Publish(current::ToString(i), std::chrono::microseconds(i + 1u));
+    }
+  });
+
+  // Readers iterate over what has been published so far, without waiting for the publisher.
+  std::vector<std::thread> readers;
+  std::atomic_size_t errors(0u);
+  for (int t = 0; t < 4; ++t) {
+    readers.emplace_back([&impl, &errors, N]() {
+      uint64_t seen = 0u;
+      while (seen < N) {
+        const uint64_t size = impl.Size();
+        if (size > seen) {
+          for (const auto& e : impl.Iterate(seen, size)) {
+            if (e.idx_ts.index != seen || e.idx_ts.us.count() != static_cast<int64_t>(seen + 1u) ||
+                e.entry != current::ToString(seen)) {
+              ++errors;
+            }
+            ++seen;
+          }
+        } else {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+
+  publisher.join();
+  for (auto& reader : readers) {
+    reader.join();
+  }
+  EXPECT_EQ(0u, static_cast<size_t>(errors));
+
+  EXPECT_EQ(N, impl.Size());
+  EXPECT_EQ(N - 1u, impl.LastPublishedIndexAndTimestamp().index);
+  // The lookups by timestamp are binary searches over the chunks.
+  EXPECT_EQ("1024", (*impl.Iterate(std::chrono::microseconds(1025), std::chrono::microseconds(1026)).begin()).entry);
+  EXPECT_EQ("3071", (*impl.Iterate(std::chrono::microseconds(3072)).begin()).entry);
+  std::vector<std::string> last_two;
+  for (const auto& e : impl.Iterate(std::chrono::microseconds(N - 1u))) {
+    last_two.push_back(e.entry);
+  }
+  EXPECT_EQ("9998,9999", Join(last_two, ","));
+}
+
 TEST(PersistenceLayer, File) {
   current::time::ResetToZero();
 
@@ -902,6 +968,76 @@ void IteratorPerformanceTest(IMPL& impl, bool publish = true) {
 
 }  // namespace persistence_test
 
+TEST(PersistenceLayer, FileIterateOfType) {
+  current::time::ResetToZero();
+
+  using namespace persistence_test;
+
+  using entry_t = Variant<StorableString, StorableInteger>;
+  using IMPL = current::persistence::File<entry_t>;
+
+  const auto namespace_name = current::ss::StreamNamespaceName("namespace", "entry_name");
+  const std::string persistence_file_name = current::FileSystem::JoinPath(FLAGS_persistence_test_tmpdir, "data");
+  const auto file_remover = current::FileSystem::ScopedRmFile(persistence_file_name);
+
+  const auto IterateOfType = [](const IMPL& impl) -> std::string {
+    std::vector<std::string> result;
+    for (const auto& e : impl.IterateOfType<StorableInteger>(0, impl.Size())) {
+      if (Exists<StorableInteger>(e.entry)) {
+        result.push_back(Printf("%d:%d", static_cast<int>(e.idx_ts.index), Value<StorableInteger>(e.entry).i));
+      } else {
+        EXPECT_FALSE(Exists(e.entry));  // The entries of other types are not parsed.
+        result.push_back(Printf("%d:-", static_cast<int>(e.idx_ts.index)));
+      }
+      EXPECT_EQ(static_cast<int64_t>(e.idx_ts.index + 1u) * 100, e.idx_ts.us.count());
+    }
+    return Join(result, ' ');
+  };
+
+  {
+    std::mutex mutex;
+    IMPL impl(mutex, namespace_name, persistence_file_name);
+    for (int i = 0; i < 6; ++i) {
+      current::time::SetNow(std::chrono::microseconds((i + 1) * 100));
+      if (i % 3 == 0) {
+        impl.Publish(StorableInteger(i));
+      } else {
+        impl.Publish(StorableString(current::ToString(i)));
+      }
+    }
+    EXPECT_EQ("0:0 1:- 2:- 3:3 4:- 5:-", IterateOfType(impl));
+
+    std::vector<std::string> all_entries;
+    for (const auto& e : impl.IterateOfType<entry_t>(0, impl.Size())) {
+      all_entries.push_back(JSON<JSONFormat::Minimalistic>(e.entry));
+    }
+    EXPECT_EQ(
+        "{\"StorableInteger\":{\"i\":0}} {\"StorableString\":{\"s\":\"1\"}} {\"StorableString\":{\"s\":\"2\"}} "
+        "{\"StorableInteger\":{\"i\":3}} {\"StorableString\":{\"s\":\"4\"}} {\"StorableString\":{\"s\":\"5\"}}",
+        Join(all_entries, ' '));
+  }
+
+  // Break the JSON of a `StorableString` entry: the iteration over the `StorableInteger`-s should not notice,
+  // as the types of the entries are told by their names when the file is replayed.
+  std::string contents = current::FileSystem::ReadFileAsString(persistence_file_name);
+  const size_t pos = contents.find("{\"s\":\"4\"}");
+  ASSERT_NE(std::string::npos, pos);
+  contents.replace(pos, strlen("{\"s\":\"4\"}"), "{\"s\":4}");
+  current::FileSystem::WriteStringToFile(contents, persistence_file_name.c_str());
+
+  {
+    std::mutex mutex;
+    IMPL impl(mutex, namespace_name, persistence_file_name);
+    EXPECT_EQ("0:0 1:- 2:- 3:3 4:- 5:-", IterateOfType(impl));
+    const auto IterateAll = [&impl]() {
+      for (const auto& e : impl.Iterate()) {
+        static_cast<void>(e);
+      }
+    };
+    ASSERT_THROW(IterateAll(), JSONSchemaException);
+  }
+}
+
 TEST(PersistenceLayer, MemoryIteratorPerformanceTest) {
   using namespace persistence_test;
   using IMPL = current::persistence::Memory<StorableString>;
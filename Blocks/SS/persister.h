@@ -116,6 +116,13 @@ class EntryPersister : public GenericEntryPersister<ENTRY>, public IMPL {
   }
   template <IterationMode IM = IterationMode::Safe>
   IterableRange<IM> Iterate() const { return IMPL::template Iterate<IM>(0, static_cast<uint64_t>(-1)); }
+
+  // For the subscribers to a single type of a `Variant` entry. The entries not holding a `TYPE` may be left
+  // uninitialized, for the persister to not deserialize them.
+  template <typename TYPE>
+  IterableRange<IterationMode::Safe> IterateOfType(uint64_t begin, uint64_t end) const {
+    return IMPL::template IterateOfType<TYPE>(begin, end);
+  }
 };
 
 // For `static_assert`-s.
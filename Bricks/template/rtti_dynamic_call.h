@@ -25,12 +25,15 @@ SOFTWARE.
 #ifndef BRICKS_TEMPLATE_RTTI_DYNAMIC_CALL_H
 #define BRICKS_TEMPLATE_RTTI_DYNAMIC_CALL_H
 
+#include <atomic>
 #include <string>
 #include <tuple>
 #include <typeindex>
 #include <typeinfo>
+#include <type_traits>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "decay.h"
 #include "is_tuple.h"
@@ -147,16 +150,146 @@ struct RTTIDispatcher<DispatcherInputType::RValueReference, BASE, F, DERIVED, AR
   }
 };
 
+// The types which know their own dense integer id are dispatched via a flat table, with no hashing involved.
+// Such a type exposes `static size_t CurrentStaticRTTITypeID()`, and its polymorphic base exposes the virtual
+// `size_t CurrentRTTITypeID() const`, which returns the id of the actual type of the object.
+// Non-templated `CURRENT_STRUCT`-s do so. The ids are assigned once per type, on first use.
+constexpr size_t kUnknownRTTITypeID = static_cast<size_t>(-1);
+
+inline size_t NextRTTITypeID() {
+  static std::atomic<size_t> next_id(0u);
+  return next_id++;
+}
+
+template <typename T>
+size_t RTTITypeID() {
+  static const size_t id = NextRTTITypeID();
+  return id;
+}
+
+template <typename T>
+constexpr bool HasStaticRTTITypeID(char) {
+  return false;
+}
+
+template <typename T>
+constexpr auto HasStaticRTTITypeID(int) -> decltype(T::CurrentStaticRTTITypeID(), bool()) {
+  return true;
+}
+
+template <typename BASE>
+constexpr bool HasRTTITypeIDMethod(char) {
+  return false;
+}
+
+template <typename BASE>
+constexpr auto HasRTTITypeIDMethod(int) -> decltype(std::declval<const BASE&>().CurrentRTTITypeID(), bool()) {
+  return true;
+}
+
+template <typename BASE, bool>
+struct RTTITypeIDOfObjectImpl {
+  static size_t Get(const BASE&) { return kUnknownRTTITypeID; }
+};
+
+template <typename BASE>
+struct RTTITypeIDOfObjectImpl<BASE, true> {
+  static size_t Get(const BASE& ref) { return ref.CurrentRTTITypeID(); }
+};
+
+template <typename BASE>
+size_t RTTITypeIDOfObject(const BASE& ref) {
+  return RTTITypeIDOfObjectImpl<BASE, HasRTTITypeIDMethod<BASE>(0)>::Get(ref);
+}
+
+// The handlers for the flat table. The exact type of the object is confirmed before the call,
+// so `static_cast<>` is used instead of `dynamic_cast<>`.
+template <DispatcherInputType, typename BASE, typename F, typename... ARGS>
+struct RTTITypeIDHandler;
+
+template <typename BASE, typename F, typename... ARGS>
+struct RTTITypeIDHandler<DispatcherInputType::ConstReference, BASE, F, ARGS...> {
+  using handler_t = void (*)(const BASE&, F&&, ARGS&&...);
+  template <typename DERIVED>
+  static void Handle(const BASE& ref, F&& f, ARGS&&... args) {
+    f(static_cast<const DERIVED&>(ref), std::forward<ARGS>(args)...);
+  }
+};
+
+template <typename BASE, typename F, typename... ARGS>
+struct RTTITypeIDHandler<DispatcherInputType::Reference, BASE, F, ARGS...> {
+  using handler_t = void (*)(BASE&, F&&, ARGS&&...);
+  template <typename DERIVED>
+  static void Handle(BASE& ref, F&& f, ARGS&&... args) {
+    f(static_cast<DERIVED&>(ref), std::forward<ARGS>(args)...);
+  }
+};
+
+template <typename BASE, typename F, typename... ARGS>
+struct RTTITypeIDHandler<DispatcherInputType::RValueReference, BASE, F, ARGS...> {
+  using handler_t = void (*)(BASE&&, F&&, ARGS&&...);
+  template <typename DERIVED>
+  static void Handle(BASE&& ref, F&& f, ARGS&&... args) {
+    f(std::move(static_cast<DERIVED&>(ref)), std::forward<ARGS>(args)...);
+  }
+};
+
+template <DispatcherInputType DISPATCHER_INPUT_TYPE, typename BASE, typename F, typename... ARGS>
+struct RTTITypeIDTableEntry {
+  const std::type_info* type = nullptr;
+  typename RTTITypeIDHandler<DISPATCHER_INPUT_TYPE, BASE, F, ARGS...>::handler_t handler = nullptr;
+};
+
 template <DispatcherInputType DISPATCHER_INPUT_TYPE, typename BASE, typename F, typename... ARGS>
 using RTTIHandlersMap =
     std::unordered_map<std::type_index, std::unique_ptr<RTTIDispatcherBase<DISPATCHER_INPUT_TYPE, BASE, F, ARGS...>>>;
 
+template <DispatcherInputType DISPATCHER_INPUT_TYPE, typename BASE, typename F, typename... ARGS>
+struct RTTIHandlers {
+  RTTIHandlersMap<DISPATCHER_INPUT_TYPE, BASE, F, ARGS...> map;
+  std::vector<RTTITypeIDTableEntry<DISPATCHER_INPUT_TYPE, BASE, F, ARGS...>> table;
+};
+
+template <typename T, typename BASE, bool>
+struct RegisterRTTITypeIDHandlerImpl {
+  template <typename HANDLERS>
+  static void DoIt(HANDLERS&) {}
+};
+
+template <typename T, typename BASE>
+struct RegisterRTTITypeIDHandlerImpl<T, BASE, true> {
+  template <DispatcherInputType DISPATCHER_INPUT_TYPE, typename F, typename... ARGS>
+  static void DoIt(RTTIHandlers<DISPATCHER_INPUT_TYPE, BASE, F, ARGS...>& handlers) {
+    const size_t id = T::CurrentStaticRTTITypeID();
+    if (id != kUnknownRTTITypeID) {
+      if (handlers.table.size() <= id) {
+        handlers.table.resize(id + 1u);
+      }
+      // A non-Current type derived from a `CURRENT_STRUCT` shares the id of the latter.
+      // The first of them keeps the slot, the object of the other one would fail the type check and use the map.
+      auto& entry = handlers.table[id];
+      if (!entry.type) {
+        entry.type = &typeid(T);
+        entry.handler =
+            &RTTITypeIDHandler<DISPATCHER_INPUT_TYPE, BASE, F, ARGS...>::template Handle<current::decay<T>>;
+      }
+    }
+  }
+};
+
+template <typename T, typename BASE>
+using RegisterRTTITypeIDHandler =
+    RegisterRTTITypeIDHandlerImpl<T,
+                                  BASE,
+                                  HasStaticRTTITypeID<T>(0) && HasRTTITypeIDMethod<BASE>(0) &&
+                                      std::is_base_of<BASE, T>::value>;
+
 template <DispatcherInputType, typename TYPELIST, typename BASE, typename F, typename... ARGS>
 struct PopulateRTTIHandlers;
 
 template <DispatcherInputType DISPATCHER_INPUT_TYPE, typename BASE, typename F, typename... ARGS>
 struct PopulateRTTIHandlers<DISPATCHER_INPUT_TYPE, std::tuple<>, BASE, F, ARGS...> {
-  static void DoIt(RTTIHandlersMap<DISPATCHER_INPUT_TYPE, BASE, F, ARGS...>&) {}
+  static void DoIt(RTTIHandlers<DISPATCHER_INPUT_TYPE, BASE, F, ARGS...>&) {}
 };
 
 template <DispatcherInputType DISPATCHER_INPUT_TYPE,
@@ -166,10 +299,11 @@ template <DispatcherInputType DISPATCHER_INPUT_TYPE,
           typename F,
           typename... ARGS>
 struct PopulateRTTIHandlers<DISPATCHER_INPUT_TYPE, std::tuple<T, TS...>, BASE, F, ARGS...> {
-  static void DoIt(RTTIHandlersMap<DISPATCHER_INPUT_TYPE, BASE, F, ARGS...>& map) {
+  static void DoIt(RTTIHandlers<DISPATCHER_INPUT_TYPE, BASE, F, ARGS...>& handlers) {
     // TODO(dkorolev): Check for duplicate types in input type list? Throw an exception?
-    map[std::type_index(typeid(T))].reset(new RTTIDispatcher<DISPATCHER_INPUT_TYPE, BASE, F, T, ARGS...>());
-    PopulateRTTIHandlers<DISPATCHER_INPUT_TYPE, std::tuple<TS...>, BASE, F, ARGS...>::DoIt(map);
+    handlers.map[std::type_index(typeid(T))].reset(new RTTIDispatcher<DISPATCHER_INPUT_TYPE, BASE, F, T, ARGS...>());
+    RegisterRTTITypeIDHandler<T, BASE>::DoIt(handlers);
+    PopulateRTTIHandlers<DISPATCHER_INPUT_TYPE, std::tuple<TS...>, BASE, F, ARGS...>::DoIt(handlers);
   }
 };
 
@@ -177,7 +311,7 @@ struct PopulateRTTIHandlers<DISPATCHER_INPUT_TYPE, std::tuple<T, TS...>, BASE, F
 // TODO(dkorolev): Revisit this once we will be retiring `std::tuple<>`'s use as typelist.
 template <DispatcherInputType DISPATCHER_INPUT_TYPE, typename BASE, typename F, typename... ARGS>
 struct PopulateRTTIHandlers<DISPATCHER_INPUT_TYPE, TypeListImpl<>, BASE, F, ARGS...> {
-  static void DoIt(RTTIHandlersMap<DISPATCHER_INPUT_TYPE, BASE, F, ARGS...>&) {}
+  static void DoIt(RTTIHandlers<DISPATCHER_INPUT_TYPE, BASE, F, ARGS...>&) {}
 };
 
 template <DispatcherInputType DISPATCHER_INPUT_TYPE,
@@ -187,26 +321,45 @@ template <DispatcherInputType DISPATCHER_INPUT_TYPE,
           typename F,
           typename... ARGS>
 struct PopulateRTTIHandlers<DISPATCHER_INPUT_TYPE, TypeListImpl<T, TS...>, BASE, F, ARGS...> {
-  static void DoIt(RTTIHandlersMap<DISPATCHER_INPUT_TYPE, BASE, F, ARGS...>& map) {
+  static void DoIt(RTTIHandlers<DISPATCHER_INPUT_TYPE, BASE, F, ARGS...>& handlers) {
     // TODO(dkorolev): Check for duplicate types in input type list? Throw an exception?
-    map[std::type_index(typeid(T))].reset(new RTTIDispatcher<DISPATCHER_INPUT_TYPE, BASE, F, T, ARGS...>());
-    PopulateRTTIHandlers<DISPATCHER_INPUT_TYPE, TypeListImpl<TS...>, BASE, F, ARGS...>::DoIt(map);
+    handlers.map[std::type_index(typeid(T))].reset(new RTTIDispatcher<DISPATCHER_INPUT_TYPE, BASE, F, T, ARGS...>());
+    RegisterRTTITypeIDHandler<T, BASE>::DoIt(handlers);
+    PopulateRTTIHandlers<DISPATCHER_INPUT_TYPE, TypeListImpl<TS...>, BASE, F, ARGS...>::DoIt(handlers);
   }
 };
 
 template <DispatcherInputType DISPATCHER_INPUT_TYPE, typename TYPELIST, typename BASE, typename F, typename... ARGS>
-struct RTTIPopulatedHandlers {
+struct RTTIPopulatedHandlers : RTTIHandlers<DISPATCHER_INPUT_TYPE, BASE, F, ARGS...> {
   static_assert(is_std_tuple<TYPELIST>::value || IsTypeList<TYPELIST>::value, "");
-  RTTIHandlersMap<DISPATCHER_INPUT_TYPE, BASE, F, ARGS...> map;
-  RTTIPopulatedHandlers() { PopulateRTTIHandlers<DISPATCHER_INPUT_TYPE, TYPELIST, BASE, F, ARGS...>::DoIt(map); }
+  RTTIPopulatedHandlers() { PopulateRTTIHandlers<DISPATCHER_INPUT_TYPE, TYPELIST, BASE, F, ARGS...>::DoIt(*this); }
 };
 
 template <DispatcherInputType DISPATCHER_INPUT_TYPE, typename TYPELIST, typename BASE, typename F, typename... ARGS>
-const RTTIDispatcherBase<DISPATCHER_INPUT_TYPE, BASE, F, ARGS...>* RTTIFindHandler(const std::type_info& type) {
-  static_assert(is_std_tuple<TYPELIST>::value || IsTypeList<TYPELIST>::value, "");
+const RTTIHandlers<DISPATCHER_INPUT_TYPE, BASE, F, ARGS...>& RTTIGetHandlers() {
   static RTTIPopulatedHandlers<DISPATCHER_INPUT_TYPE, TYPELIST, BASE, F, ARGS...> singleton;
-  const auto handler = singleton.map.find(std::type_index(type));
-  if (handler != singleton.map.end()) {
+  return singleton;
+}
+
+// Returns the handler from the flat table, or `nullptr` if the type of the object should be looked up in the map.
+template <DispatcherInputType DISPATCHER_INPUT_TYPE, typename BASE, typename F, typename... ARGS>
+typename RTTITypeIDHandler<DISPATCHER_INPUT_TYPE, BASE, F, ARGS...>::handler_t RTTIFindHandlerByTypeID(
+    const RTTIHandlers<DISPATCHER_INPUT_TYPE, BASE, F, ARGS...>& handlers, const BASE& ref) {
+  const size_t id = RTTITypeIDOfObject(ref);
+  if (id < handlers.table.size()) {
+    const auto& entry = handlers.table[id];
+    if (entry.type && *entry.type == typeid(ref)) {
+      return entry.handler;
+    }
+  }
+  return nullptr;
+}
+
+template <DispatcherInputType DISPATCHER_INPUT_TYPE, typename BASE, typename F, typename... ARGS>
+const RTTIDispatcherBase<DISPATCHER_INPUT_TYPE, BASE, F, ARGS...>* RTTIFindHandler(
+    const RTTIHandlers<DISPATCHER_INPUT_TYPE, BASE, F, ARGS...>& handlers, const std::type_info& type) {
+  const auto handler = handlers.map.find(std::type_index(type));
+  if (handler != handlers.map.end()) {
     return handler->second.get();
   } else {
     CURRENT_THROW(SpecificUnlistedTypeException<BASE>());  // LCOV_EXCL_LINE
@@ -218,18 +371,33 @@ template <typename TYPELIST, typename BASE>
 struct RTTIDynamicCallWrapper {
   template <typename... REST>
   static void RunHandle(const BASE& ref, REST&&... rest) {
-    RTTIFindHandler<DispatcherInputType::ConstReference, TYPELIST, BASE, REST...>(typeid(ref))
-        ->HandleByConstReference(ref, std::forward<REST>(rest)...);
+    const auto& handlers = RTTIGetHandlers<DispatcherInputType::ConstReference, TYPELIST, BASE, REST...>();
+    const auto handler = RTTIFindHandlerByTypeID(handlers, ref);
+    if (handler) {
+      handler(ref, std::forward<REST>(rest)...);
+    } else {
+      RTTIFindHandler(handlers, typeid(ref))->HandleByConstReference(ref, std::forward<REST>(rest)...);
+    }
   }
   template <typename... REST>
   static void RunHandle(BASE& ref, REST&&... rest) {
-    RTTIFindHandler<DispatcherInputType::Reference, TYPELIST, BASE, REST...>(typeid(ref))
-        ->HandleByReference(ref, std::forward<REST>(rest)...);
+    const auto& handlers = RTTIGetHandlers<DispatcherInputType::Reference, TYPELIST, BASE, REST...>();
+    const auto handler = RTTIFindHandlerByTypeID(handlers, ref);
+    if (handler) {
+      handler(ref, std::forward<REST>(rest)...);
+    } else {
+      RTTIFindHandler(handlers, typeid(ref))->HandleByReference(ref, std::forward<REST>(rest)...);
+    }
   }
   template <typename... REST>
   static void RunHandle(BASE&& ref, REST&&... rest) {
-    RTTIFindHandler<DispatcherInputType::RValueReference, TYPELIST, BASE, REST...>(typeid(ref))
-        ->HandleByRValueReference(std::move(ref), std::forward<REST>(rest)...);
+    const auto& handlers = RTTIGetHandlers<DispatcherInputType::RValueReference, TYPELIST, BASE, REST...>();
+    const auto handler = RTTIFindHandlerByTypeID(handlers, ref);
+    if (handler) {
+      handler(std::move(ref), std::forward<REST>(rest)...);
+    } else {
+      RTTIFindHandler(handlers, typeid(ref))->HandleByRValueReference(std::move(ref), std::forward<REST>(rest)...);
+    }
   }
 };
 
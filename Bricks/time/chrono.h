@@ -101,26 +101,24 @@ void SleepUntil(T) {}
 
 // Since chrono::system_clock is not monotonic, and chrono::steady_clock is not guaranteed to be Epoch,
 // use a simple wrapper around chrono::system_clock to make it strictly increasing.
-struct EpochClockGuaranteeingMonotonicity {
-  mutable std::atomic<int64_t> monotonic_now_us;
-
-  EpochClockGuaranteeingMonotonicity() : monotonic_now_us(0ll) {}
-
-  inline std::chrono::microseconds Now() const {
-    int64_t now, previous_now;
-    do {
-      now = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch())
-                .count();
-      previous_now = monotonic_now_us.load();
-      if (!(now > previous_now)) {
-        now = previous_now + 1;
-      }
-    } while (!monotonic_now_us.compare_exchange_strong(previous_now, now));
-    return std::chrono::microseconds(now);
+// The guarantee is per thread: each thread keeps its own last returned value, so that concurrent calls to `Now()`
+// never contend. The timestamps that must increase strictly across threads, such as the ones of the entries
+// published into a stream, are taken via `GetTimestampFromLockedSection()` from under the lock of the publisher.
+struct PerThreadEpochClockGuaranteeingMonotonicity {
+  int64_t monotonic_now_us = 0ll;
+
+  inline std::chrono::microseconds Now() {
+    const int64_t now =
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch())
+            .count();
+    monotonic_now_us = std::max(now, monotonic_now_us + 1);
+    return std::chrono::microseconds(monotonic_now_us);
   }
 };
 
-inline std::chrono::microseconds Now() { return Singleton<EpochClockGuaranteeingMonotonicity>().Now(); }
+inline std::chrono::microseconds Now() {
+  return ThreadLocalSingleton<PerThreadEpochClockGuaranteeingMonotonicity>().Now();
+}
 
 template <typename T>
 inline void SleepUntil(T moment) {
@@ -170,9 +168,23 @@ enum class SecondsToMicrosecondsPadding : bool { Lower = false, Upper = true };
 
 struct DefaultTimeArgument {};
 
-inline std::chrono::microseconds GetTimestampFromLockedSection(DefaultTimeArgument) { return Now(); }
+// Returns the timestamp for the next entry, given the timestamp of the last one, to be called from under the lock
+// guarding that last timestamp. With no explicit timestamp provided, it is `Now()`, unless it would not be greater
+// than `last`, which may well be if `last` was taken by another thread. The explicit timestamps are returned as is,
+// for the caller to validate them.
+inline std::chrono::microseconds GetTimestampFromLockedSection(DefaultTimeArgument, std::chrono::microseconds last) {
+#ifdef CURRENT_MOCK_TIME
+  static_cast<void>(last);
+  return Now();
+#else
+  return std::max(Now(), last + std::chrono::microseconds(1));
+#endif  // CURRENT_MOCK_TIME
+}
 
-inline std::chrono::microseconds GetTimestampFromLockedSection(std::chrono::microseconds us) { return us; }
+inline std::chrono::microseconds GetTimestampFromLockedSection(std::chrono::microseconds us,
+                                                               std::chrono::microseconds) {
+  return us;
+}
 
 }  // namespace current::time
 
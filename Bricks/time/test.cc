@@ -24,6 +24,7 @@ SOFTWARE.
 
 #include <thread>
 #include <chrono>
+#include <vector>
 
 #include "chrono.h"
 
@@ -46,6 +47,40 @@ TEST(Time, SmokeTest) {
   EXPECT_LE(dt, 50000 + allowed_skew);
 }
 
+TEST(Time, StrictlyIncreasingWithinEachThread) {
+  std::vector<std::thread> threads;
+  std::vector<int> increasing(4, true);  // Not `std::vector<bool>`, as the threads write into it concurrently.
+  for (size_t t = 0; t < increasing.size(); ++t) {
+    threads.emplace_back([&increasing, t]() {
+      std::chrono::microseconds last = current::time::Now();
+      for (int i = 0; i < 10000; ++i) {
+        const std::chrono::microseconds now = current::time::Now();
+        if (!(now > last)) {
+          increasing[t] = false;  // LCOV_EXCL_LINE
+        }
+        last = now;
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  for (int b : increasing) {
+    EXPECT_TRUE(b);
+  }
+}
+
+TEST(Time, TimestampFromLockedSection) {
+  const std::chrono::microseconds now = current::time::Now();
+  // Strictly greater than the last timestamp, even if the last one is ahead of `Now()`.
+  const std::chrono::microseconds ahead = now + std::chrono::seconds(1);
+  EXPECT_EQ(ahead + std::chrono::microseconds(1),
+            current::time::GetTimestampFromLockedSection(current::time::DefaultTimeArgument(), ahead));
+  EXPECT_GT(current::time::GetTimestampFromLockedSection(current::time::DefaultTimeArgument(), now), now);
+  // The explicitly provided timestamps are returned as is.
+  EXPECT_EQ(now, current::time::GetTimestampFromLockedSection(now, ahead));
+}
+
 #else
 
 #ifndef CURRENT_COVERAGE_REPORT_MODE
@@ -0,0 +1,417 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2015 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+// The in-process metrics registry: counters, gauges and histograms, keyed by name and labels.
+//
+// Metrics are created on first access, and are never destroyed, so the references returned by the registry
+// can be cached by the instrumented code, which then never touches the registry mutex again.
+// Counters and histograms are sharded across threads: each thread writes into its own shard with relaxed atomics,
+// and the shards are summed up on read. Gauges hold a single value, as setting it from different threads
+// has no meaningful sum.
+//
+// `current::metrics::Registry().Snapshot()` returns the values of all the metrics, and `PrometheusText()`
+// renders them in the Prometheus text exposition format, histograms as summaries. See `Blocks/Metrics/metrics.h`
+// for the HTTP route exposing them.
+
+#ifndef BRICKS_UTIL_METRICS_H
+#define BRICKS_UTIL_METRICS_H
+
+#include "../port.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "singleton.h"
+
+#include "../exception.h"
+
+#ifndef CURRENT_METRICS_SHARDS
+#define CURRENT_METRICS_SHARDS 8
+#endif
+
+namespace current {
+namespace metrics {
+
+constexpr static size_t kShards = CURRENT_METRICS_SHARDS;
+
+struct MetricTypeMismatchException : Exception {
+  using Exception::Exception;
+};
+
+inline uint64_t NowNS() {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+// The shard of the calling thread. Threads are assigned shards round robin, on their first write into any metric.
+struct ThreadShard {
+  const size_t index;
+  ThreadShard() : index(Next()++ % kShards) {}
+  static std::atomic<size_t>& Next() {
+    static std::atomic<size_t> next(0u);
+    return next;
+  }
+};
+
+inline size_t ThreadShardIndex() { return ThreadLocalSingleton<ThreadShard>().index; }
+
+// The log-linear bucketing of values, as in HDR histograms: `2^SUB_BUCKETS_LOG2` buckets per each power of two.
+template <size_t SUB_BUCKETS_LOG2>
+struct LogLinearBuckets {
+  constexpr static size_t kSubBucketsLog2 = SUB_BUCKETS_LOG2;
+  constexpr static size_t kSubBuckets = (1u << kSubBucketsLog2);
+  constexpr static size_t kBuckets = (64u - kSubBucketsLog2 + 1u) * kSubBuckets;
+
+  static size_t BucketIndex(uint64_t value) {
+    if (value < kSubBuckets) {
+      return static_cast<size_t>(value);
+    }
+    size_t msb = 0u;
+    for (size_t shift = 32u; shift; shift >>= 1) {
+      if (value >> (msb + shift)) {
+        msb += shift;
+      }
+    }
+    const size_t sub_bucket = static_cast<size_t>(value >> (msb - kSubBucketsLog2)) & (kSubBuckets - 1u);
+    return (msb - kSubBucketsLog2 + 1u) * kSubBuckets + sub_bucket;
+  }
+
+  // The middle of the range of values which fall into the bucket.
+  static uint64_t BucketValue(size_t index) {
+    if (index < kSubBuckets) {
+      return index;
+    }
+    const size_t shift = index / kSubBuckets - 1u;
+    const uint64_t lower = static_cast<uint64_t>(kSubBuckets + index % kSubBuckets) << shift;
+    return lower + ((static_cast<uint64_t>(1u) << shift) >> 1);
+  }
+
+  // The `p`-th quantile of `total` values, distributed over `buckets`.
+  static uint64_t Percentile(const std::vector<uint64_t>& buckets, uint64_t total, double p) {
+    const uint64_t rank = std::min(total, static_cast<uint64_t>(p * total) + 1u);
+    uint64_t seen = 0u;
+    for (size_t i = 0u; i < buckets.size(); ++i) {
+      seen += buckets[i];
+      if (seen >= rank) {
+        return BucketValue(i);
+      }
+    }
+    return 0u;
+  }
+};
+
+template <size_t SUB_BUCKETS_LOG2>
+constexpr size_t LogLinearBuckets<SUB_BUCKETS_LOG2>::kSubBucketsLog2;
+template <size_t SUB_BUCKETS_LOG2>
+constexpr size_t LogLinearBuckets<SUB_BUCKETS_LOG2>::kSubBuckets;
+template <size_t SUB_BUCKETS_LOG2>
+constexpr size_t LogLinearBuckets<SUB_BUCKETS_LOG2>::kBuckets;
+
+// Eight buckets per each power of two, so the precision is 1/8.
+using LogLinearHistogram = LogLinearBuckets<3u>;
+
+// A monotonically increasing counter.
+class Counter final {
+ public:
+  Counter() {
+    for (auto& shard : shards_) {
+      shard.value.store(0u, std::memory_order_relaxed);
+    }
+  }
+
+  void Add(uint64_t delta = 1u) { shards_[ThreadShardIndex()].value.fetch_add(delta, std::memory_order_relaxed); }
+
+  uint64_t Value() const {
+    uint64_t result = 0u;
+    for (const auto& shard : shards_) {
+      result += shard.value.load(std::memory_order_relaxed);
+    }
+    return result;
+  }
+
+ private:
+  // Padded to a cache line, so that the threads writing into different shards do not contend.
+  struct Shard {
+    std::atomic<uint64_t> value;
+    char padding[64 - sizeof(std::atomic<uint64_t>)];
+  };
+  Shard shards_[kShards];
+
+  Counter(const Counter&) = delete;
+  void operator=(const Counter&) = delete;
+};
+
+// A value that can go up and down, such as the size of a queue.
+class Gauge final {
+ public:
+  Gauge() : value_(0) {}
+
+  void Set(int64_t value) { value_.store(value, std::memory_order_relaxed); }
+  void Add(int64_t delta) { value_.fetch_add(delta, std::memory_order_relaxed); }
+  int64_t Value() const { return value_.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<int64_t> value_;
+
+  Gauge(const Gauge&) = delete;
+  void operator=(const Gauge&) = delete;
+};
+
+struct HistogramValues {
+  uint64_t count = 0u;
+  uint64_t sum = 0u;
+  std::vector<uint64_t> buckets = std::vector<uint64_t>(LogLinearHistogram::kBuckets, 0u);
+
+  uint64_t Percentile(double p) const { return LogLinearHistogram::Percentile(buckets, count, p); }
+};
+
+// The distribution of values, most commonly durations in nanoseconds, with the precision of 1/8.
+class Histogram final {
+ public:
+  Histogram() {
+    for (auto& shard : shards_) {
+      shard.count.store(0u, std::memory_order_relaxed);
+      shard.sum.store(0u, std::memory_order_relaxed);
+      for (auto& bucket : shard.buckets) {
+        bucket.store(0u, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  void Record(uint64_t value) {
+    Shard& shard = shards_[ThreadShardIndex()];
+    shard.count.fetch_add(1u, std::memory_order_relaxed);
+    shard.sum.fetch_add(value, std::memory_order_relaxed);
+    shard.buckets[LogLinearHistogram::BucketIndex(value)].fetch_add(1u, std::memory_order_relaxed);
+  }
+
+  // The values are read while other threads keep writing, so `count` may be off by a few from the sum of `buckets`.
+  HistogramValues Values() const {
+    HistogramValues result;
+    for (const auto& shard : shards_) {
+      result.count += shard.count.load(std::memory_order_relaxed);
+      result.sum += shard.sum.load(std::memory_order_relaxed);
+      for (size_t i = 0u; i < LogLinearHistogram::kBuckets; ++i) {
+        result.buckets[i] += shard.buckets[i].load(std::memory_order_relaxed);
+      }
+    }
+    return result;
+  }
+
+ private:
+  struct Shard {
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> sum;
+    std::atomic<uint64_t> buckets[LogLinearHistogram::kBuckets];
+  };
+  Shard shards_[kShards];
+
+  Histogram(const Histogram&) = delete;
+  void operator=(const Histogram&) = delete;
+};
+
+// The `std::lock_guard` which records the time spent waiting for the mutex and the time the mutex was held.
+template <typename MUTEX>
+class TimedLockGuard final {
+ public:
+  TimedLockGuard(MUTEX& mutex, Histogram& wait_ns, Histogram& held_ns)
+      : mutex_(mutex), held_ns_(held_ns), wait_begin_ns_(NowNS()) {
+    mutex_.lock();
+    locked_ns_ = NowNS();
+    wait_ns.Record(locked_ns_ - wait_begin_ns_);
+  }
+
+  ~TimedLockGuard() {
+    held_ns_.Record(NowNS() - locked_ns_);
+    mutex_.unlock();
+  }
+
+ private:
+  MUTEX& mutex_;
+  Histogram& held_ns_;
+  const uint64_t wait_begin_ns_;
+  uint64_t locked_ns_;
+
+  TimedLockGuard(const TimedLockGuard&) = delete;
+  void operator=(const TimedLockGuard&) = delete;
+};
+
+using Labels = std::map<std::string, std::string>;
+
+enum class MetricType : int { Counter = 0, Gauge = 1, Histogram = 2 };
+
+struct MetricValues {
+  std::string name;
+  Labels labels;
+  MetricType type;
+  uint64_t counter = 0u;
+  int64_t gauge = 0;
+  HistogramValues histogram;
+};
+
+class MetricsRegistry final {
+ public:
+  Counter& GetCounter(const std::string& name, const Labels& labels = Labels()) {
+    return Get(name, labels, MetricType::Counter, counters_);
+  }
+
+  Gauge& GetGauge(const std::string& name, const Labels& labels = Labels()) {
+    return Get(name, labels, MetricType::Gauge, gauges_);
+  }
+
+  Histogram& GetHistogram(const std::string& name, const Labels& labels = Labels()) {
+    return Get(name, labels, MetricType::Histogram, histograms_);
+  }
+
+  // All the metrics, ordered by name, then by labels.
+  std::vector<MetricValues> Snapshot() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<MetricValues> result;
+    for (const auto& name : types_) {
+      const std::pair<std::string, Labels> begin(name.first, Labels());
+      switch (name.second) {
+        case MetricType::Counter:
+          for (auto cit = counters_.lower_bound(begin); cit != counters_.end() && cit->first.first == name.first;
+               ++cit) {
+            result.push_back(Values(cit->first, MetricType::Counter));
+            result.back().counter = cit->second->Value();
+          }
+          break;
+        case MetricType::Gauge:
+          for (auto cit = gauges_.lower_bound(begin); cit != gauges_.end() && cit->first.first == name.first; ++cit) {
+            result.push_back(Values(cit->first, MetricType::Gauge));
+            result.back().gauge = cit->second->Value();
+          }
+          break;
+        case MetricType::Histogram:
+          for (auto cit = histograms_.lower_bound(begin); cit != histograms_.end() && cit->first.first == name.first;
+               ++cit) {
+            result.push_back(Values(cit->first, MetricType::Histogram));
+            result.back().histogram = cit->second->Values();
+          }
+          break;
+      }
+    }
+    return result;
+  }
+
+ private:
+  template <typename T>
+  using metrics_t = std::map<std::pair<std::string, Labels>, std::unique_ptr<T>>;
+
+  template <typename T>
+  T& Get(const std::string& name, const Labels& labels, MetricType type, metrics_t<T>& metrics) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto emplaced = types_.emplace(name, type);
+    if (emplaced.first->second != type) {
+      CURRENT_THROW(MetricTypeMismatchException(name));
+    }
+    std::unique_ptr<T>& placeholder = metrics[std::make_pair(name, labels)];
+    if (!placeholder) {
+      placeholder = std::make_unique<T>();
+    }
+    return *placeholder;
+  }
+
+  static MetricValues Values(const std::pair<std::string, Labels>& key, MetricType type) {
+    MetricValues result;
+    result.name = key.first;
+    result.labels = key.second;
+    result.type = type;
+    return result;
+  }
+
+  mutable std::mutex mutex_;
+  std::map<std::string, MetricType> types_;
+  metrics_t<Counter> counters_;
+  metrics_t<Gauge> gauges_;
+  metrics_t<Histogram> histograms_;
+};
+
+inline MetricsRegistry& Registry() { return Singleton<MetricsRegistry>(); }
+
+// The Prometheus text exposition format, version 0.0.4. Histograms are exported as summaries,
+// with the 0.5, 0.99 and 0.999 quantiles.
+inline std::string PrometheusText(const std::vector<MetricValues>& metrics) {
+  const auto escape = [](const std::string& s) {
+    std::string result;
+    for (const char c : s) {
+      if (c == '\\' || c == '"') {
+        result += '\\';
+        result += c;
+      } else if (c == '\n') {
+        result += "\\n";
+      } else {
+        result += c;
+      }
+    }
+    return result;
+  };
+  const auto labels = [&escape](const Labels& labels, const char* quantile) {
+    std::string result;
+    for (const auto& label : labels) {
+      result += (result.empty() ? "" : ",") + label.first + "=\"" + escape(label.second) + '"';
+    }
+    if (quantile) {
+      result += (result.empty() ? "" : ",") + std::string("quantile=\"") + quantile + '"';
+    }
+    return result.empty() ? result : '{' + result + '}';
+  };
+  std::ostringstream os;
+  const std::string* previous_name = nullptr;
+  for (const auto& metric : metrics) {
+    if (!previous_name || *previous_name != metric.name) {
+      const char* type = metric.type == MetricType::Counter ? "counter"
+                                                            : (metric.type == MetricType::Gauge ? "gauge" : "summary");
+      os << "# TYPE " << metric.name << ' ' << type << '\n';
+      previous_name = &metric.name;
+    }
+    if (metric.type == MetricType::Counter) {
+      os << metric.name << labels(metric.labels, nullptr) << ' ' << metric.counter << '\n';
+    } else if (metric.type == MetricType::Gauge) {
+      os << metric.name << labels(metric.labels, nullptr) << ' ' << metric.gauge << '\n';
+    } else {
+      const HistogramValues& histogram = metric.histogram;
+      os << metric.name << labels(metric.labels, "0.5") << ' ' << histogram.Percentile(0.5) << '\n';
+      os << metric.name << labels(metric.labels, "0.99") << ' ' << histogram.Percentile(0.99) << '\n';
+      os << metric.name << labels(metric.labels, "0.999") << ' ' << histogram.Percentile(0.999) << '\n';
+      os << metric.name << "_sum" << labels(metric.labels, nullptr) << ' ' << histogram.sum << '\n';
+      os << metric.name << "_count" << labels(metric.labels, nullptr) << ' ' << histogram.count << '\n';
+    }
+  }
+  return os.str();
+}
+
+}  // namespace metrics
+}  // namespace current
+
+#endif  // BRICKS_UTIL_METRICS_H
@@ -25,15 +25,24 @@ SOFTWARE.
 #ifndef EVENT_COLLECTOR_H
 #define EVENT_COLLECTOR_H
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <functional>
+#include <iterator>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <ostream>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include "../Blocks/HTTP/api.h"
 #include "../Bricks/time/chrono.h"
 
+#include "../Sherlock/sherlock.h"
+
 #include "../TypeSystem/struct.h"
 #include "../TypeSystem/Serialization/json.h"
 
@@ -62,6 +71,17 @@ CURRENT_STRUCT(LogEntryWithHeaders) {
   // TODO(dkorolev): Resolve geolocation from IP?
 };
 
+// Collects the events sent to `route` into `ostream`, one JSON per line, with strictly increasing `t`.
+// The HTTP handlers only build the entries and append them to per-thread shards; a single writer thread merges
+// the shards in the order of `t` and writes them out in batches.
+// With `flush_interval` of zero, each request is responded to by the writer thread once its entry is written and
+// flushed. All the entries accumulated meanwhile are written and flushed together, so it's one flush per batch.
+// With a positive `flush_interval`, the requests are responded to immediately, and `ostream` is flushed
+// no more often than once per `flush_interval`.
+// Alternatively, the events can be published directly into a Sherlock stream, with `t` as their timestamps,
+// starting past the head of the stream. The stream should be dedicated to this collector; if anything else does
+// publish into it, the entries which can no longer go at their `t` are published right past the head instead,
+// with their `t` set to match, and the `t`-s of the entries that follow continue from there.
 class EventCollectorHTTPServer {
  public:
   EventCollectorHTTPServer(int http_port,
@@ -69,41 +89,47 @@ class EventCollectorHTTPServer {
                            std::chrono::microseconds tick_interval_us,
                            const std::string& route = "/log",
                            const std::string& response_text = "OK\n",
+                           std::function<void(const LogEntryWithHeaders&)> callback = {},
+                           std::chrono::microseconds flush_interval = std::chrono::microseconds(0))
+      : EventCollectorHTTPServer(http_port,
+                                 [&ostream](const LogEntryWithHeaders& entry) { ostream << JSON(entry) << '\n'; },
+                                 [&ostream]() { ostream.flush(); },
+                                 0u,
+                                 tick_interval_us,
+                                 route,
+                                 response_text,
+                                 callback,
+                                 flush_interval) {}
+
+  // Each request is responded to once its entry is published into the stream.
+  template <template <typename> class PERSISTENCE_LAYER>
+  EventCollectorHTTPServer(int http_port,
+                           current::sherlock::Stream<LogEntryWithHeaders, PERSISTENCE_LAYER>& stream,
+                           std::chrono::microseconds tick_interval_us,
+                           const std::string& route = "/log",
+                           const std::string& response_text = "OK\n",
                            std::function<void(const LogEntryWithHeaders&)> callback = {})
-      : http_port_(http_port),
-        ostream_(ostream),
-        route_(route),
-        response_text_(response_text),
-        callback_(callback),
-        tick_interval_us_(tick_interval_us),
-        send_ticks_(tick_interval_us_.count() > 0),
-        last_event_t_(0u),
-        events_pushed_(0u),
-        timer_thread_(&EventCollectorHTTPServer::TimerThreadFunction, this),
-        http_route_scope_(HTTP(http_port_)
-                              .Register(route_,
-                                        [this](Request r) {
-                                          LogEntryWithHeaders entry;
-                                          {
-                                            const auto now = current::time::Now();
-                                            std::lock_guard<std::mutex> lock(mutex_);
-                                            entry.t = now.count();
-                                            entry.m = r.method;
-                                            entry.u = r.url.ComposeURLWithoutParameters();
-                                            entry.q = r.url.AllQueryParameters();
-                                            entry.h = r.headers.AsMap();
-                                            entry.c = r.headers.CookiesAsString();
-                                            entry.b = r.body;
-                                            entry.f = r.url.fragment;
-                                            ostream_ << JSON(entry) << std::endl;
-                                            ++events_pushed_;
-                                            last_event_t_ = now;
-                                            if (callback_) {
-                                              callback_(entry);
-                                            }
-                                          }
-                                          r(response_text_);
-                                        })) {}
+      : EventCollectorHTTPServer(http_port,
+                                 [&stream](LogEntryWithHeaders& entry) {
+                                   while (true) {
+                                     try {
+                                       stream.Publish(entry, std::chrono::microseconds(entry.t));
+                                       return;
+                                     } catch (const current::ss::InconsistentTimestampException&) {
+                                       entry.t = std::max(
+                                           entry.t,
+                                           static_cast<uint64_t>(stream.Persister().CurrentHead().count()) + 1u);
+                                     }
+                                   }
+                                 },
+                                 []() {},
+                                 static_cast<uint64_t>(std::max(stream.Persister().CurrentHead().count(),
+                                                                static_cast<int64_t>(0))),
+                                 tick_interval_us,
+                                 route,
+                                 response_text,
+                                 callback,
+                                 std::chrono::microseconds(0)) {}
 
   EventCollectorHTTPServer(const EventCollectorHTTPServer&) = delete;
   EventCollectorHTTPServer(EventCollectorHTTPServer&&) = delete;
@@ -111,29 +137,28 @@ class EventCollectorHTTPServer {
   void operator=(EventCollectorHTTPServer&&) = delete;
 
   ~EventCollectorHTTPServer() {
+    http_route_scope_ = nullptr;
     send_ticks_ = false;
     timer_thread_.join();
+    {
+      std::lock_guard<std::mutex> lock(writer_mutex_);
+      writer_stopping_ = true;
+      writer_condition_variable_.notify_one();
+    }
+    writer_thread_.join();
   }
 
   void Join() { HTTP(http_port_).Join(); }
 
   void TimerThreadFunction() {
-    { std::lock_guard<std::mutex> lock(mutex_); }
     while (send_ticks_) {
       const std::chrono::microseconds sleep_us = [&]() {
-        std::lock_guard<std::mutex> lock(mutex_);
         const std::chrono::microseconds now = current::time::Now();
-        const std::chrono::microseconds dt = now - last_event_t_;
+        const std::chrono::microseconds dt = now - std::chrono::microseconds(last_t_);
         if (dt >= tick_interval_us_) {
           LogEntryWithHeaders entry;
-          entry.t = now.count();
           entry.m = "TICK";
-          ostream_ << JSON(entry) << std::endl;
-          ++events_pushed_;
-          last_event_t_ = now;
-          if (callback_) {
-            callback_(entry);
-          }
+          Push(std::move(entry));
           return std::chrono::microseconds(0);
         } else {
           return tick_interval_us_ - dt + std::chrono::microseconds(1);
@@ -148,17 +173,182 @@ class EventCollectorHTTPServer {
   size_t EventsPushed() const { return events_pushed_; }
 
  private:
-  std::mutex mutex_;
+  EventCollectorHTTPServer(int http_port,
+                           std::function<void(LogEntryWithHeaders&)> write,
+                           std::function<void()> flush,
+                           uint64_t last_t,
+                           std::chrono::microseconds tick_interval_us,
+                           const std::string& route,
+                           const std::string& response_text,
+                           std::function<void(const LogEntryWithHeaders&)> callback,
+                           std::chrono::microseconds flush_interval)
+      : http_port_(http_port),
+        write_(write),
+        flush_(flush),
+        route_(route),
+        response_text_(response_text),
+        callback_(callback),
+        tick_interval_us_(tick_interval_us),
+        flush_interval_(flush_interval),
+        send_ticks_(tick_interval_us_.count() > 0),
+        last_t_(last_t),
+        events_pushed_(0u),
+        shards_(std::max(std::thread::hardware_concurrency(), 1u)),
+        pending_(0u),
+        writer_stopping_(false),
+        writer_thread_(&EventCollectorHTTPServer::WriterThreadFunction, this),
+        timer_thread_(&EventCollectorHTTPServer::TimerThreadFunction, this),
+        http_route_scope_(HTTP(http_port_)
+                              .Register(route_,
+                                        [this](Request r) {
+                                          LogEntryWithHeaders entry;
+                                          entry.m = r.method;
+                                          entry.u = r.url.ComposeURLWithoutParameters();
+                                          entry.q = r.url.AllQueryParameters();
+                                          entry.h = r.headers.AsMap();
+                                          entry.c = r.headers.CookiesAsString();
+                                          entry.b = r.body;
+                                          entry.f = r.url.fragment;
+                                          if (!flush_interval_.count()) {
+                                            Push(std::move(entry), std::make_unique<Request>(std::move(r)));
+                                          } else {
+                                            Push(std::move(entry));
+                                            r(response_text_);
+                                          }
+                                        })) {}
+
+  // An entry along with the request to respond to once it is written and flushed, if any.
+  struct PendingEntry {
+    LogEntryWithHeaders entry;
+    std::unique_ptr<Request> request;
+    PendingEntry(LogEntryWithHeaders&& entry, std::unique_ptr<Request>&& request)
+        : entry(std::move(entry)), request(std::move(request)) {}
+  };
+
+  // Entries are appended to the shard of the calling thread, so that concurrent requests rarely contend.
+  struct Shard {
+    std::mutex mutex;
+    std::vector<PendingEntry> entries;
+  };
+
+  // Assigns `t` to the entry and appends it to the shard of the calling thread.
+  void Push(LogEntryWithHeaders&& entry, std::unique_ptr<Request>&& request = nullptr) {
+    Shard& shard = shards_[std::hash<std::thread::id>()(std::this_thread::get_id()) % shards_.size()];
+    uint64_t t;
+    bool wake_up_writer;
+    {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      // Assigning `t` under the lock of the shard guarantees the writer, which grabs the locks of all the shards
+      // to take their entries, never misses an entry with a smaller `t` than the ones it has taken.
+      const uint64_t now = static_cast<uint64_t>(current::time::Now().count());
+      uint64_t last = last_t_;
+      do {
+        t = std::max(now, last + 1u);
+      } while (!last_t_.compare_exchange_weak(last, t));
+      entry.t = t;
+      shard.entries.emplace_back(std::move(entry), std::move(request));
+      wake_up_writer = (pending_++ == 0u);
+    }
+    if (wake_up_writer) {
+      std::lock_guard<std::mutex> lock(writer_mutex_);
+      writer_condition_variable_.notify_one();
+    }
+  }
+
+  void WriterThreadFunction() {
+    std::vector<PendingEntry> batch;
+    std::chrono::microseconds last_flush = current::time::Now();
+    bool unflushed = false;
+    while (true) {
+      bool stopping;
+      {
+        std::unique_lock<std::mutex> lock(writer_mutex_);
+        const auto ready = [this]() { return pending_ || writer_stopping_; };
+        if (unflushed) {
+          writer_condition_variable_.wait_for(lock, flush_interval_, ready);
+        } else {
+          writer_condition_variable_.wait(lock, ready);
+        }
+        stopping = writer_stopping_;
+      }
+
+      batch.clear();
+      {
+        // All the locks are held together, so that no entry with a `t` smaller than the ones taken can land
+        // in a shard which has already been drained, and be written after them, in the next batch.
+        std::vector<std::unique_lock<std::mutex>> locks;
+        locks.reserve(shards_.size());
+        for (auto& shard : shards_) {
+          locks.emplace_back(shard.mutex);
+        }
+        for (auto& shard : shards_) {
+          pending_ -= shard.entries.size();
+          std::move(shard.entries.begin(), shard.entries.end(), std::back_inserter(batch));
+          shard.entries.clear();
+        }
+      }
+      std::sort(batch.begin(), batch.end(), [](const PendingEntry& lhs, const PendingEntry& rhs) {
+        return lhs.entry.t < rhs.entry.t;
+      });
+
+      for (auto& e : batch) {
+        write_(e.entry);
+        if (callback_) {
+          callback_(e.entry);
+        }
+        ++events_pushed_;
+        // The entry may have been published past its `t`, with `t` moved forward; keep `last_t_` past it too.
+        uint64_t last = last_t_;
+        while (last < e.entry.t && !last_t_.compare_exchange_weak(last, e.entry.t)) {
+        }
+      }
+
+      if (!batch.empty()) {
+        unflushed = true;
+      }
+      const std::chrono::microseconds now = current::time::Now();
+      if (unflushed && (stopping || !flush_interval_.count() || now - last_flush >= flush_interval_)) {
+        flush_();
+        last_flush = now;
+        unflushed = false;
+      }
+
+      for (auto& e : batch) {
+        if (e.request) {
+          try {
+            (*e.request)(response_text_);
+          } catch (const current::Exception&) {
+            // The client is gone, and there is no one to respond to.
+          }
+        }
+      }
+
+      if (stopping && batch.empty()) {
+        break;
+      }
+    }
+  }
+
   const int http_port_;
-  std::ostream& ostream_;
+  const std::function<void(LogEntryWithHeaders&)> write_;  // Writes into the `ostream` or publishes, may move `t`.
+  const std::function<void()> flush_;
   const std::string route_;
   const std::string response_text_;
   std::function<void(const LogEntryWithHeaders&)> callback_;
 
   const std::chrono::microseconds tick_interval_us_;
+  const std::chrono::microseconds flush_interval_;
   std::atomic_bool send_ticks_;
-  std::chrono::microseconds last_event_t_;
+  std::atomic<uint64_t> last_t_;  // The `t` of the most recent entry, or the head of the stream to publish into.
   std::atomic_size_t events_pushed_;
+
+  std::vector<Shard> shards_;
+  std::atomic_size_t pending_;  // The total number of entries in all the shards.
+  std::mutex writer_mutex_;
+  std::condition_variable writer_condition_variable_;
+  bool writer_stopping_;
+
+  std::thread writer_thread_;
   std::thread timer_thread_;
   HTTPRoutesScope http_route_scope_;
 };
@@ -25,6 +25,7 @@ SOFTWARE.
 
 #include "../port.h"
 
+#include <algorithm>
 #include <string>
 #include <sstream>
 #include <thread>
@@ -33,6 +34,7 @@ SOFTWARE.
 
 #include "event_collector.h"
 
+#include "../Bricks/strings/join.h"
 #include "../Bricks/strings/printf.h"
 
 #include "../Bricks/dflags/dflags.h"
@@ -134,3 +136,124 @@ TEST(EventCollector, Headers) {
   EXPECT_EQ("bar", e.h["foo"]);
   EXPECT_EQ("meh", e.h["baz"]);
 }
+
+TEST(EventCollector, ConcurrentEventsAreStrictlyOrdered) {
+  current::time::ResetToZero();
+  current::time::SetNow(std::chrono::microseconds(1000));
+
+  std::ostringstream os;
+  {
+    EventCollectorHTTPServer collector(FLAGS_event_collector_test_port, os, std::chrono::microseconds(0), "/log", "OK");
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+      threads.emplace_back([i]() {
+        for (int j = 0; j < 25; ++j) {
+          const auto url = Printf("http://localhost:%d/log?i=%d&j=%d", FLAGS_event_collector_test_port, i, j);
+          EXPECT_EQ("OK", HTTP(GET(url)).body);
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    EXPECT_EQ(100u, collector.EventsPushed());
+  }
+
+  // Mock time does not move, yet each `t` is greater than the previous one.
+  std::istringstream is(os.str());
+  std::string line;
+  uint64_t previous_t = 0u;
+  size_t lines = 0u;
+  while (std::getline(is, line)) {
+    const auto e = ParseJSON<LogEntryWithHeaders>(line);
+    EXPECT_GT(e.t, previous_t);
+    previous_t = e.t;
+    ++lines;
+  }
+  EXPECT_EQ(100u, lines);
+  EXPECT_EQ(1099u, previous_t);
+}
+
+TEST(EventCollector, BufferedOutput) {
+  current::time::ResetToZero();
+
+  struct FlushCountingBuffer : std::stringbuf {
+    std::atomic_size_t flushes{0u};
+    int sync() override {
+      ++flushes;
+      return std::stringbuf::sync();
+    }
+  };
+  FlushCountingBuffer buffer;
+  std::ostream os(&buffer);
+  {
+    EventCollectorHTTPServer collector(FLAGS_event_collector_test_port,
+                                       os,
+                                       std::chrono::microseconds(0),
+                                       "/log",
+                                       "OK",
+                                       nullptr,
+                                       std::chrono::hours(1));
+    for (int i = 0; i < 10; ++i) {
+      EXPECT_EQ("OK", HTTP(GET(Printf("http://localhost:%d/log?i=%d", FLAGS_event_collector_test_port, i))).body);
+    }
+    while (collector.EventsPushed() < 10u) {
+      std::this_thread::yield();
+    }
+    // Written, but not flushed, as the flush interval has not passed yet.
+    EXPECT_EQ(0u, buffer.flushes);
+  }
+  // Flushed upon shutdown.
+  EXPECT_EQ(1u, buffer.flushes);
+  const std::string output = buffer.str();
+  EXPECT_EQ(10u, static_cast<size_t>(std::count(output.begin(), output.end(), '\n')));
+}
+
+TEST(EventCollector, PublishesIntoStream) {
+  current::time::ResetToZero();
+  current::time::SetNow(std::chrono::microseconds(1000));
+
+  current::sherlock::Stream<LogEntryWithHeaders> stream;
+  {
+    EventCollectorHTTPServer collector(FLAGS_event_collector_test_port, stream, std::chrono::microseconds(0));
+    EXPECT_EQ("OK\n", HTTP(GET(Printf("http://localhost:%d/log?x=1", FLAGS_event_collector_test_port))).body);
+    EXPECT_EQ("OK\n", HTTP(POST(Printf("http://localhost:%d/log", FLAGS_event_collector_test_port), "meh")).body);
+    // The request is responded to once its entry is in the stream.
+    EXPECT_EQ(2u, stream.Persister().Size());
+  }
+
+  std::vector<std::string> entries;
+  uint64_t expected_t = 1000u;
+  for (const auto& e : stream.Persister().Iterate()) {
+    EXPECT_EQ(expected_t++, e.entry.t);
+    EXPECT_EQ(e.entry.t, static_cast<uint64_t>(e.idx_ts.us.count()));
+    entries.push_back(e.entry.m + ' ' + e.entry.u + ' ' + e.entry.b);
+  }
+  ASSERT_EQ(2u, entries.size());
+  EXPECT_EQ("GET /log ", entries[0]);
+  EXPECT_EQ("POST /log meh", entries[1]);
+}
+
+TEST(EventCollector, PublishesIntoStreamPastItsHead) {
+  current::time::ResetToZero();
+  current::time::SetNow(std::chrono::microseconds(1000));
+
+  // The stream already has an entry timestamped ahead of the current time, say, from before the clock was adjusted.
+  current::sherlock::Stream<LogEntryWithHeaders> stream;
+  stream.Publish(LogEntryWithHeaders(), std::chrono::microseconds(5000));
+  {
+    EventCollectorHTTPServer collector(FLAGS_event_collector_test_port, stream, std::chrono::microseconds(0));
+    EXPECT_EQ("OK\n", HTTP(GET(Printf("http://localhost:%d/log?x=1", FLAGS_event_collector_test_port))).body);
+    // Something else publishes into the stream, ahead of the next `t`.
+    stream.Publish(LogEntryWithHeaders(), std::chrono::microseconds(10000));
+    EXPECT_EQ("OK\n", HTTP(GET(Printf("http://localhost:%d/log?x=2", FLAGS_event_collector_test_port))).body);
+    EXPECT_EQ(4u, stream.Persister().Size());
+  }
+
+  std::vector<std::string> entries;
+  for (const auto& e : stream.Persister().Iterate()) {
+    entries.push_back(current::ToString(e.idx_ts.us.count()) + ':' + current::ToString(e.entry.t));
+  }
+  // The second entry could not go at its `t`, and its `t` is the timestamp it was published at instead.
+  EXPECT_EQ("5000:0 5001:5001 10000:0 10001:10001", current::strings::Join(entries, ' '));
+}
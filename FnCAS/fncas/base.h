@@ -71,7 +71,9 @@ enum class JIT {
   CLANG,          // JIT via `clang++`.
   AS,             // JIT via `as`.
   NASM,           // JIT via `nasm`.
-  Default = AS    // The JIT used by default by the optimization algorithms.
+  Tape,           // The expression flattened into a linear tape of instructions, interpreted in-process.
+  X64,            // JIT via x86-64 machine code emitted in-process, no external tools required.
+  Default = X64   // The JIT used by default by the optimization algorithms.
 };
 
 template <JIT>
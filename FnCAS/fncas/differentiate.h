@@ -66,13 +66,28 @@ std::vector<double_t> approximate_gradient(F f,
   return g;
 }
 
+// Whether the derivative is identically zero, i.e. the node does not depend on the variable.
+// The graph keeps `0 * x`, as it is `NaN` for an infinite `x`, but a term multiplied by an identically zero derivative
+// is not a part of the derivative, so the differentiator itself skips such terms, keeping the derivatives compact.
+inline bool is_zero_derivative(const V& d) { return node_is_value(d.index(), 0); }
+
 inline node_index_t d_op(MathOperation operation, const V& a, const V& b, const V& da, const V& db) {
   static const size_t n = static_cast<size_t>(MathOperation::end);
   static const std::function<V(const V&, const V&, const V&, const V&)> differentiator[n] = {
       [](const V&, const V&, const V& da, const V& db) { return da + db; },
-      [](const V&, const V&, const V& da, const V& db) { return da - db; },
-      [](const V& a, const V& b, const V& da, const V& db) { return a * db + b * da; },
-      [](const V& a, const V& b, const V& da, const V& db) { return (b * da - a * db) / (b * b); }};
+      [](const V&, const V&, const V& da, const V& db) { return is_zero_derivative(da) ? V(-1.0) * db : da - db; },
+      [](const V& a, const V& b, const V& da, const V& db) {
+        if (is_zero_derivative(da)) {
+          return is_zero_derivative(db) ? da : a * db;
+        }
+        return is_zero_derivative(db) ? b * da : a * db + b * da;
+      },
+      [](const V& a, const V& b, const V& da, const V& db) {
+        if (is_zero_derivative(db)) {
+          return is_zero_derivative(da) ? da : da / b;
+        }
+        return is_zero_derivative(da) ? V(-1.0) * a * db / (b * b) : (b * da - a * db) / (b * b);
+      }};
   return operation < MathOperation::end ? differentiator[static_cast<size_t>(operation)](a, b, da, db).index() : 0;
 }
 
@@ -164,8 +179,11 @@ inline node_index_t differentiate_node(node_index_t index, size_t var_index, siz
           const node_index_t x = f.argument_index();
           const node_index_t dx = growing_vector_access(df, x, static_cast<node_index_t>(-1));
           CURRENT_ASSERT(dx != -1);
+          // All the derivatives of functions are linear in `dx`, except the one which throws.
           growing_vector_access(df, dependent_i, static_cast<node_index_t>(-1)) =
-              d_f(f.function(), from_index(dependent_i), from_index(x), from_index(dx));
+              (dx == zero_index && f.function() != MathFunction::unit_step)
+                  ? zero_index
+                  : d_f(f.function(), from_index(dependent_i), from_index(x), from_index(dx));
         } else {
           CURRENT_ASSERT(false);
           return 0;
@@ -178,6 +196,102 @@ inline node_index_t differentiate_node(node_index_t index, size_t var_index, siz
   return result;
 }
 
+// differentiate_reverse() computes the nodes of the full gradient of `index` in a single backward sweep.
+// The adjoint of each node, `d (node[index]) / d (node[i])`, is itself recorded as a node. Thus the total number
+// of new nodes is proportional to the size of the graph, not to its size times `dim`, as it is with forward-mode
+// `differentiate_node()`. Returns the node indexes of `d (node[index]) / d (x[i])` for `i` in `[0, dim)`.
+inline std::vector<node_index_t> differentiate_reverse(node_index_t index, size_t dim) {
+  // Topologically sort the nodes `index` depends on. Same manual stack technique as in `differentiate_node()`.
+  std::vector<node_index_t> order;
+  {
+    std::vector<int8_t> visited;
+    std::stack<node_index_t> stack;
+    stack.push(index);
+    while (!stack.empty()) {
+      const node_index_t i = stack.top();
+      stack.pop();
+      const node_index_t dependent_i = ~i;
+      if (i > dependent_i) {
+        if (!growing_vector_access(visited, i, static_cast<int8_t>(false))) {
+          visited[i] = true;
+          node_impl& f = node_vector_singleton()[i];
+          if (f.type() == NodeType::operation) {
+            stack.push(~i);
+            stack.push(f.lhs_index());
+            stack.push(f.rhs_index());
+          } else if (f.type() == NodeType::function) {
+            stack.push(~i);
+            stack.push(f.argument_index());
+          } else {
+            order.push_back(i);
+          }
+        }
+      } else {
+        order.push_back(dependent_i);
+      }
+    }
+  }
+
+  // `adjoint[i]` is the node index of the adjoint of node `i`, -1 if node `i` does not contribute.
+  // NOTE: New nodes are created below, so no references to `node_vector_singleton()` elements are held across them.
+  std::vector<node_index_t> adjoint(static_cast<size_t>(index + 1), static_cast<node_index_t>(-1));
+  std::vector<node_index_t> result(dim, static_cast<node_index_t>(-1));
+  const auto accumulate = [](node_index_t& target, const V& contribution) {
+    target = (target == -1) ? contribution.index() : (V(from_index(target)) + contribution).index();
+  };
+  adjoint[index] = V(1.0).index();
+  for (auto cit = order.rbegin(); cit != order.rend(); ++cit) {
+    const node_index_t i = *cit;
+    if (adjoint[i] == -1) {
+      continue;
+    }
+    const V a = from_index(adjoint[i]);
+    node_impl f = node_vector_singleton()[i];
+    if (f.type() == NodeType::variable) {
+      const int32_t v = f.variable();
+      CURRENT_ASSERT(v >= 0 && static_cast<size_t>(v) < dim);
+      accumulate(result[v], a);
+    } else if (f.type() == NodeType::operation) {
+      const node_index_t l = f.lhs_index();
+      const node_index_t r = f.rhs_index();
+      const V lhs = from_index(l);
+      const V rhs = from_index(r);
+      switch (f.operation()) {
+        case MathOperation::add:
+          accumulate(adjoint[l], a);
+          accumulate(adjoint[r], a);
+          break;
+        case MathOperation::subtract:
+          accumulate(adjoint[l], a);
+          accumulate(adjoint[r], V(-1.0) * a);
+          break;
+        case MathOperation::multiply:
+          accumulate(adjoint[l], a * rhs);
+          accumulate(adjoint[r], a * lhs);
+          break;
+        case MathOperation::divide:
+          accumulate(adjoint[l], a / rhs);
+          accumulate(adjoint[r], V(-1.0) * a * from_index(i) / rhs);
+          break;
+        default:
+          CURRENT_ASSERT(false);
+      }
+    } else if (f.type() == NodeType::function) {
+      // `d_f()` is linear in its `dx` argument, so passing the adjoint as `dx` yields the contribution.
+      const node_index_t x = f.argument_index();
+      accumulate(adjoint[x], from_index(d_f(f.function(), from_index(i), from_index(x), a)));
+    }
+  }
+
+  const node_index_t zero_index = V(0.0).index();
+  for (node_index_t& r : result) {
+    if (r == -1) {
+      r = zero_index;
+    }
+  }
+  return result;
+}
+
 template <JIT>
 struct g_impl;
 
@@ -188,6 +302,17 @@ struct g_super : noncopyable {
   virtual size_t dim() const = 0;
   // The number of external `double_t` "registers" required to compute it, for compiled versions.
   virtual size_t heap_size() const { return 0; }
+
+  // Same as for `f_super`: whether `evaluate()` may be called from several threads at once.
+  virtual bool supports_concurrent_evaluation() const { return false; }
+  // Writes `dim()` values of the gradient into `gradient`, using the caller-provided scratch `heap`
+  // of at least `heap_size()` doubles. Returns the value of the function itself.
+  virtual double_t evaluate(const double_t* x, double_t* heap, double_t* gradient) const {
+    static_cast<void>(x);
+    static_cast<void>(heap);
+    static_cast<void>(gradient);
+    CURRENT_THROW(exceptions::FnCASSharedEvaluationNotSupportedException());
+  }
 };
 
 template <>
@@ -212,12 +337,14 @@ template <>
 struct g_impl<JIT::Blueprint> : g_super {
   V f_;               // `f_` holds the node index for the value of the preprocessed expression.
   std::vector<V> g_;  // `g_[i]` holds the node index for the value of the derivative by variable `i`.
+  // The gradient is built in reverse mode, see `differentiate_reverse()`.
   g_impl(const X& x_ref, const V& f) : f_(f) {
     CURRENT_ASSERT(&x_ref == internals_singleton().x_ptr_);
-    const size_t dim = internals_singleton().dim_;
-    g_.resize(dim);
-    for (size_t i = 0; i < dim; ++i) {
-      g_[i] = f_.template differentiate<X>(x_ref, i);
+    static_cast<void>(x_ref);
+    const std::vector<node_index_t> g = differentiate_reverse(f_.index(), internals_singleton().dim_);
+    g_.resize(g.size());
+    for (size_t i = 0; i < g.size(); ++i) {
+      g_[i] = from_index(g[i]);
     }
   }
   explicit g_impl(const V& f) : g_impl(*internals_singleton().x_ptr_, f) {}
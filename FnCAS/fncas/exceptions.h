@@ -41,6 +41,16 @@ struct FnCASException : current::Exception {
 // This is not allowed. FnCAS keeps global state per thread, which leads to this constraint.
 struct FnCASConcurrentEvaluationAttemptException : FnCASException {};
 
+// This exception is thrown when a function or gradient that refers to the thread-local expression graph,
+// such as a blueprint, is evaluated via the thread-safe `evaluate()` interface with an external heap.
+struct FnCASSharedEvaluationNotSupportedException : FnCASException {};
+
+// This exception is thrown when the memory for the in-process JIT-compiled code can not be allocated,
+// or can not be made executable.
+struct FnCASExecutableMemoryException : FnCASException {
+  using FnCASException::FnCASException;
+};
+
 // Exceptions for attempting to differentiate a function that doesn't have a derivative.
 struct FnCASFunctionNonDifferentiable : FnCASException {};
 struct FnCASZeroOrOneIsNonDifferentiable : FnCASFunctionNonDifferentiable {};
@@ -57,6 +67,12 @@ struct BacktrackingException : FnCASOptimizationException {
   using FnCASOptimizationException::FnCASOptimizationException;
 };
 
+// This exception is thrown when the Wolfe line search in `mathutil.h` finds no step satisfying
+// the sufficient decrease condition with a normal value of the function.
+struct WolfeLineSearchException : FnCASOptimizationException {
+  using FnCASOptimizationException::FnCASOptimizationException;
+};
+
 }  // namespace fncas::exceptions
 }  // namespace fncas
 
@@ -32,6 +32,7 @@
 #include "node.h"
 #include "differentiate.h"
 #include "optimize.h"
+#include "tape.h"
 #include "jit.h"
 
 #endif  // FNCAS_FNCAS_FNCAS_H
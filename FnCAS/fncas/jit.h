@@ -32,6 +32,8 @@
 
 #define FNCAS_JIT_COMPILED
 
+#include <cerrno>
+#include <cstring>
 #include <sstream>
 #include <stack>
 #include <string>
@@ -39,6 +41,7 @@
 #include <iostream>
 
 #include <dlfcn.h>
+#include <sys/mman.h>
 
 #include "../../Bricks/strings/printf.h"
 #include "../../Bricks/file/file.h"
@@ -62,13 +65,57 @@ inline const char* operation_as_assembler_opcode(MathOperation operation) {
   return operation < MathOperation::end ? representation[static_cast<size_t>(operation)] : "?";
 }
 
+// A block of `mmap`-ed memory holding the machine code emitted in-process by `JITImplementation<JIT::X64>`.
+// Writable while the code is being copied in, executable and read-only afterwards.
+class executable_memory final {
+ public:
+  executable_memory() = default;
+  explicit executable_memory(const std::vector<uint8_t>& code) : size_(code.size()) {
+    CURRENT_ASSERT(size_);
+    void* ptr = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED) {
+      CURRENT_THROW(exceptions::FnCASExecutableMemoryException(std::string("mmap: ") + std::strerror(errno)));
+    }
+    std::memcpy(ptr, code.data(), size_);
+    if (::mprotect(ptr, size_, PROT_READ | PROT_EXEC)) {
+      const int error = errno;
+      ::munmap(ptr, size_);
+      CURRENT_THROW(exceptions::FnCASExecutableMemoryException(std::string("mprotect: ") + std::strerror(error)));
+    }
+    ptr_ = static_cast<uint8_t*>(ptr);
+  }
+  executable_memory(executable_memory&& rhs) : ptr_(rhs.ptr_), size_(rhs.size_) {
+    rhs.ptr_ = nullptr;
+    rhs.size_ = 0;
+  }
+  executable_memory(const executable_memory&) = delete;
+  void operator=(const executable_memory&) = delete;
+  void operator=(executable_memory&&) = delete;
+  ~executable_memory() {
+    if (ptr_) {
+      ::munmap(ptr_, size_);
+    }
+  }
+
+  template <typename F>
+  F at(size_t offset) const {
+    CURRENT_ASSERT(offset < size_);
+    return reinterpret_cast<F>(ptr_ + offset);
+  }
+
+ private:
+  uint8_t* ptr_ = nullptr;
+  size_t size_ = 0;
+};
+
 struct compiled_expression final : noncopyable {
   typedef long long (*DIM)();
   typedef long long (*HEAP_SIZE)();
   typedef double (*FUNCTION)(const double* x, double* a);
-  typedef void (*GRADIENT)(const double* x, double* a);
+  typedef double (*GRADIENT)(const double* x, double* a);  // Returns the value of the function too.
 
   void* lib_;
+  executable_memory code_;
   DIM dim_;
   HEAP_SIZE heap_size_;
   FUNCTION function_;
@@ -92,6 +139,22 @@ struct compiled_expression final : noncopyable {
     CURRENT_ASSERT(heap_size_);
   }
 
+  // The entry points emitted in-process, at the given offsets of `code`. The absent one is `npos`.
+  static constexpr size_t npos = static_cast<size_t>(-1);
+  compiled_expression(executable_memory&& code,
+                      size_t dim_offset,
+                      size_t heap_size_offset,
+                      size_t function_offset,
+                      size_t gradient_offset,
+                      const gradient_indexes_t& gradient_indexes = gradient_indexes_t())
+      : lib_(nullptr),
+        code_(std::move(code)),
+        dim_(code_.at<DIM>(dim_offset)),
+        heap_size_(code_.at<HEAP_SIZE>(heap_size_offset)),
+        function_(function_offset != npos ? code_.at<FUNCTION>(function_offset) : nullptr),
+        gradient_(gradient_offset != npos ? code_.at<GRADIENT>(gradient_offset) : nullptr),
+        gradient_indexes_(gradient_indexes) {}
+
   ~compiled_expression() {
     if (lib_) {
       dlclose(lib_);
@@ -106,11 +169,13 @@ struct compiled_expression final : noncopyable {
 
   compiled_expression(compiled_expression&& rhs)
       : lib_(std::move(rhs.lib_)),
+        code_(std::move(rhs.code_)),
         dim_(std::move(rhs.dim_)),
         heap_size_(std::move(rhs.heap_size_)),
         function_(std::move(rhs.function_)),
         gradient_(std::move(rhs.gradient_)),
-        lib_filename_(std::move(rhs.lib_filename_)) {
+        lib_filename_(std::move(rhs.lib_filename_)),
+        gradient_indexes_(std::move(rhs.gradient_indexes_)) {
     rhs.lib_ = nullptr;
   }
 
@@ -128,6 +193,12 @@ struct compiled_expression final : noncopyable {
     return function_(x, &heap[0]);
   }
 
+  // Thread-safe: the caller provides the heap of at least `heap_size()` doubles.
+  double compute_compiled_f(const double* x, double* heap) const {
+    CURRENT_ASSERT(function_);
+    return function_(x, heap);
+  }
+
   double compute_compiled_f(const std::vector<double>& x) const { return compute_compiled_f(&x[0]); }
 
   std::vector<double> compute_compiled_g(const double* x) const {
@@ -157,6 +228,16 @@ struct compiled_expression final : noncopyable {
 
   std::vector<double> compute_compiled_g(const std::vector<double>& x) const { return compute_compiled_g(&x[0]); }
 
+  // Thread-safe: the caller provides the heap of at least `heap_size()` doubles. Returns the value of the function.
+  double compute_compiled_g(const double* x, double* heap, double* gradient) const {
+    CURRENT_ASSERT(gradient_);
+    const double f = gradient_(x, heap);
+    for (size_t i = 0; i < gradient_indexes_.size(); ++i) {
+      gradient[i] = heap[gradient_indexes_[i]];
+    }
+    return f;
+  }
+
   node_index_t dim() const { return dim_ ? static_cast<size_t>(dim_()) : 0; }
   size_t heap_size() const { return heap_size_ ? static_cast<size_t>(heap_size_()) : 0; }
 
@@ -701,6 +782,215 @@ class JITImplementation<JIT::CLANG> final {
   }
 };
 
+// In-process x86-64 code generation: the same `eval_f` / `eval_g` / `dim` / `heap_size` entry points as the
+// NASM and AS back-ends emit, with the same register usage (`x` in `rdi`, the heap in `rsi`, SSE2 scalar math),
+// but written as machine code straight into an executable buffer. No files, no external tools, no `dlopen`.
+template <>
+class JITImplementation<JIT::X64> final {
+ public:
+  using FUNCTION_OF_ONE_ARGUMENT = double (*)(double);
+
+  JITImplementation() = default;
+
+  // Returns the offset of the entry point.
+  size_t compile_eval_f(node_index_t index) {
+    const size_t offset = code.size();
+    emit({0x55});              // push rbp
+    emit({0x48, 0x89, 0xe5});  // mov rbp, rsp
+    generate_x64_code_for_node(index);
+    emit_load_xmm(0, index);   // The return value is `a[index]`.
+    emit({0x48, 0x89, 0xec});  // mov rsp, rbp
+    emit({0x5d});              // pop rbp
+    emit({0xc3});              // ret
+    return offset;
+  }
+
+  size_t compile_eval_g(node_index_t f_index, const std::vector<node_index_t>& g_indexes) {
+    CURRENT_ASSERT(g_indexes.size() == internals_singleton().dim_);
+    const size_t offset = code.size();
+    emit({0x55});
+    emit({0x48, 0x89, 0xe5});
+    generate_x64_code_for_node(f_index);
+    for (size_t i = 0; i < g_indexes.size(); ++i) {
+      generate_x64_code_for_node(g_indexes[i]);
+    }
+    emit_load_xmm(0, f_index);
+    emit({0x48, 0x89, 0xec});
+    emit({0x5d});
+    emit({0xc3});
+    return offset;
+  }
+
+  size_t compile_dim() { return compile_return_constant(static_cast<int64_t>(internals_singleton().dim_)); }
+  size_t compile_heap_size() { return compile_return_constant(static_cast<int64_t>(max_dim + 1)); }
+
+  executable_memory finalize() { return executable_memory(code); }
+
+ private:
+  std::vector<uint8_t> code;
+  std::vector<bool> computed;
+  node_index_t max_dim = 0;
+
+  void emit(std::initializer_list<uint8_t> bytes) { code.insert(code.end(), bytes); }
+
+  void emit_int32(int32_t value) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+    code.insert(code.end(), bytes, bytes + sizeof(value));
+  }
+
+  void emit_int64(int64_t value) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+    code.insert(code.end(), bytes, bytes + sizeof(value));
+  }
+
+  static int32_t displacement(node_index_t index) {
+    CURRENT_ASSERT(index >= 0 && index < (1ll << 28));
+    return static_cast<int32_t>(index * 8);
+  }
+
+  // movabs rax, imm64
+  void emit_mov_rax_immediate(int64_t value) {
+    emit({0x48, 0xb8});
+    emit_int64(value);
+  }
+
+  void emit_mov_rax_immediate(double value) {
+    int64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    emit_mov_rax_immediate(bits);
+  }
+
+  // movsd xmm{0,1}, [rsi + index * 8]
+  void emit_load_xmm(int xmm, node_index_t index) {
+    emit({0xf2, 0x0f, 0x10, static_cast<uint8_t>(xmm ? 0x8e : 0x86)});
+    emit_int32(displacement(index));
+  }
+
+  // movsd [rsi + index * 8], xmm0
+  void emit_store_xmm0(node_index_t index) {
+    emit({0xf2, 0x0f, 0x11, 0x86});
+    emit_int32(displacement(index));
+  }
+
+  // mov [rsi + index * 8], rax
+  void emit_store_rax(node_index_t index) {
+    emit({0x48, 0x89, 0x86});
+    emit_int32(displacement(index));
+  }
+
+  size_t compile_return_constant(int64_t value) {
+    const size_t offset = code.size();
+    emit_mov_rax_immediate(value);
+    emit({0xc3});  // ret
+    return offset;
+  }
+
+  static FUNCTION_OF_ONE_ARGUMENT function_address(MathFunction function) {
+    static const FUNCTION_OF_ONE_ARGUMENT address[static_cast<size_t>(MathFunction::end)] = {
+        nullptr,
+        static_cast<FUNCTION_OF_ONE_ARGUMENT>(std::sqrt),
+        static_cast<FUNCTION_OF_ONE_ARGUMENT>(std::exp),
+        static_cast<FUNCTION_OF_ONE_ARGUMENT>(std::log),
+        static_cast<FUNCTION_OF_ONE_ARGUMENT>(std::sin),
+        static_cast<FUNCTION_OF_ONE_ARGUMENT>(std::cos),
+        static_cast<FUNCTION_OF_ONE_ARGUMENT>(std::tan),
+        static_cast<FUNCTION_OF_ONE_ARGUMENT>(std::asin),
+        static_cast<FUNCTION_OF_ONE_ARGUMENT>(std::acos),
+        static_cast<FUNCTION_OF_ONE_ARGUMENT>(std::atan),
+        nullptr,
+        nullptr};
+    return function < MathFunction::end ? address[static_cast<size_t>(function)] : nullptr;
+  }
+
+  // generate_x64_code_for_node() appends the machine code to evaluate the expression to the buffer.
+  // Mirrors `generate_nasm_code_for_node()` instruction by instruction.
+  void generate_x64_code_for_node(node_index_t index) {
+    std::stack<node_index_t> stack;
+    stack.push(index);
+    while (!stack.empty()) {
+      const node_index_t i = stack.top();
+      stack.pop();
+      const node_index_t dependent_i = ~i;
+      if (i > dependent_i) {
+        max_dim = std::max(max_dim, static_cast<node_index_t>(i));
+        if (computed.size() <= static_cast<size_t>(i)) {
+          computed.resize(static_cast<size_t>(i) + 1);
+        }
+        if (!computed[i]) {
+          computed[i] = true;
+          node_impl& node = node_vector_singleton()[i];
+          if (node.type() == NodeType::variable) {
+            const int32_t v = node.variable();
+            CURRENT_ASSERT(v >= 0 && v < (1 << 28));
+            emit({0x48, 0x8b, 0x87});  // mov rax, [rdi + v * 8]
+            emit_int32(v * 8);
+            emit_store_rax(i);
+          } else if (node.type() == NodeType::value) {
+            emit_mov_rax_immediate(static_cast<double>(node.value()));
+            emit_store_rax(i);
+          } else if (node.type() == NodeType::operation) {
+            stack.push(~i);
+            stack.push(node.lhs_index());
+            stack.push(node.rhs_index());
+          } else if (node.type() == NodeType::function) {
+            stack.push(~i);
+            stack.push(node.argument_index());
+          } else {
+            CURRENT_ASSERT(false);
+          }
+        }
+      } else {
+        node_impl& node = node_vector_singleton()[dependent_i];
+        if (node.type() == NodeType::operation) {
+          static const uint8_t opcode[static_cast<size_t>(MathOperation::end)] = {
+              0x58,  // addsd
+              0x5c,  // subsd
+              0x59,  // mulsd
+              0x5e,  // divsd
+          };
+          CURRENT_ASSERT(node.operation() < MathOperation::end);
+          emit_load_xmm(0, node.lhs_index());
+          emit_load_xmm(1, node.rhs_index());
+          emit({0xf2, 0x0f, opcode[static_cast<size_t>(node.operation())], 0xc1});  // op xmm0, xmm1
+          emit_store_xmm0(dependent_i);
+        } else if (node.type() == NodeType::function) {
+          emit_load_xmm(0, node.argument_index());
+          if (node.function() == MathFunction::sqr) {
+            emit({0xf2, 0x0f, 0x59, 0xc0});  // mulsd xmm0, xmm0
+            emit_store_xmm0(dependent_i);
+          } else if (node.function() == MathFunction::unit_step) {
+            emit_mov_rax_immediate(0.0);
+            emit({0x66, 0x48, 0x0f, 0x6e, 0xc8});  // movq xmm1, rax
+            emit({0x66, 0x0f, 0x2e, 0xc1});        // ucomisd xmm0, xmm1
+            emit({0x72, 0x0a});                    // jb +10, skipping the next `movabs`.
+            emit_mov_rax_immediate(1.0);
+            emit_store_rax(dependent_i);
+          } else if (node.function() == MathFunction::ramp) {
+            emit_mov_rax_immediate(0.0);
+            emit({0x66, 0x48, 0x0f, 0x6e, 0xc8});  // movq xmm1, rax
+            emit({0x66, 0x0f, 0x2e, 0xc1});        // ucomisd xmm0, xmm1
+            emit({0x77, 0x05});                    // ja +5, skipping the next `movq`.
+            emit({0x66, 0x48, 0x0f, 0x6e, 0xc0});  // movq xmm0, rax
+            emit_store_xmm0(dependent_i);
+          } else {
+            const FUNCTION_OF_ONE_ARGUMENT f = function_address(node.function());
+            CURRENT_ASSERT(f);
+            emit({0x57});  // push rdi
+            emit({0x56});  // push rsi
+            emit_mov_rax_immediate(static_cast<int64_t>(reinterpret_cast<uintptr_t>(f)));
+            emit({0xff, 0xd0});  // call rax
+            emit({0x5e});        // pop rsi
+            emit({0x5f});        // pop rdi
+            emit_store_xmm0(dependent_i);
+          }
+        } else {
+          CURRENT_ASSERT(false);
+        }
+      }
+    }
+  }
+};
+
 template <JIT JIT_IMPLEMENTATION>
 compiled_expression compile_eval_f(node_index_t index) {
   const std::string filebase(current::FileSystem::GenTmpFileName());
@@ -730,6 +1020,25 @@ compiled_expression compile_eval_g(node_index_t f_index, const std::vector<node_
   return compiled_expression(filename_so, g_indexes);
 }
 
+// The in-process JIT needs no temporary files.
+template <>
+inline compiled_expression compile_eval_f<JIT::X64>(node_index_t index) {
+  JITImplementation<JIT::X64> code_generator;
+  const size_t f = code_generator.compile_eval_f(index);
+  const size_t dim = code_generator.compile_dim();
+  const size_t heap_size = code_generator.compile_heap_size();
+  return compiled_expression(code_generator.finalize(), dim, heap_size, f, compiled_expression::npos);
+}
+
+template <>
+inline compiled_expression compile_eval_g<JIT::X64>(node_index_t f_index, const std::vector<node_index_t>& g_indexes) {
+  JITImplementation<JIT::X64> code_generator;
+  const size_t g = code_generator.compile_eval_g(f_index, g_indexes);
+  const size_t dim = code_generator.compile_dim();
+  const size_t heap_size = code_generator.compile_heap_size();
+  return compiled_expression(code_generator.finalize(), dim, heap_size, compiled_expression::npos, g, g_indexes);
+}
+
 template <JIT JIT_IMPLEMENTATION>
 inline compiled_expression compile_eval_g(const V& f_node, const std::vector<V>& g_nodes) {
   std::vector<node_index_t> g_node_indexes;
@@ -759,6 +1068,15 @@ struct f_compiled final : f_compiled_super {
 
   double operator()(const std::vector<double>& x) const override { return c_.compute_compiled_f(x); }
 
+  void evaluate_strided(const double* xs, size_t count, size_t stride, double* output) const override {
+    for (size_t i = 0; i < count; ++i) {
+      output[i] = c_.compute_compiled_f(xs + i * stride);
+    }
+  }
+  // The heap is thread-local or provided by the caller, and the compiled code itself is immutable.
+  bool supports_concurrent_evaluation() const override { return true; }
+  double evaluate(const double* x, double* heap) const override { return c_.compute_compiled_f(x, heap); }
+
   size_t dim() const override { return c_.dim(); }
   size_t heap_size() const override { return c_.heap_size(); }
 
@@ -782,6 +1100,11 @@ struct g_compiled final : g_compiled_super {
 
   std::vector<double_t> operator()(const std::vector<double_t>& x) const override { return c_.compute_compiled_g(x); }
 
+  bool supports_concurrent_evaluation() const override { return true; }
+  double evaluate(const double* x, double* heap, double* gradient) const override {
+    return c_.compute_compiled_g(x, heap, gradient);
+  }
+
   size_t dim() const override { return c_.dim(); }
   size_t heap_size() const override { return c_.heap_size(); }
 
@@ -804,6 +1127,11 @@ struct f_impl_selector<JIT::NASM> {
   using type = f_compiled<JIT::NASM>;
 };
 
+template <>
+struct f_impl_selector<JIT::X64> {
+  using type = f_compiled<JIT::X64>;
+};
+
 // Expose JIT-compiled gradients as `fncas::gradient_t<JIT::*>`.
 template <>
 struct g_impl_selector<JIT::AS> {
@@ -820,6 +1148,11 @@ struct g_impl_selector<JIT::NASM> {
   using type = g_compiled<JIT::NASM>;
 };
 
+template <>
+struct g_impl_selector<JIT::X64> {
+  using type = g_compiled<JIT::X64>;
+};
+
 }  // namespace fncas::impl
 }  // namespace fncas
 
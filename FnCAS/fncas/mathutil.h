@@ -191,6 +191,140 @@ ValueAndPoint Backtracking(F&& f,
   }
 }
 
+// The result of a line search: the new point with the value and the gradient of the function there.
+struct LineSearchResult {
+  ValueAndPoint value_and_point{0.0, std::vector<double_t>()};
+  std::vector<double_t> gradient;
+  double_t step = 0;
+};
+
+// Line search satisfying the strong Wolfe conditions, Algorithms 3.5 and 3.6 in Nocedal & Wright, "Numerical
+// Optimization". Starts in `current_point`, where the function to minimize has value `current_value` and
+// gradient `current_gradient`, and searches along `direction`, which must be a descent direction.
+// Parameters: 0 < c1 < c2 < 1; the step is initially `initial_step` and grows up to `max_step`.
+// The values and gradients passed in and returned are those of the function being minimized, i.e. with their sign
+// flipped for `OptimizationDirection::Maximize`.
+template <OptimizationDirection DIRECTION, class F, class G>
+LineSearchResult WolfeLineSearch(F&& f,
+                                 G&& g,
+                                 const std::vector<double_t>& current_point,
+                                 const double_t current_value,
+                                 const std::vector<double_t>& current_gradient,
+                                 const std::vector<double_t>& direction,
+                                 optimize::OptimizerStats& stats,
+                                 const double_t c1 = 1e-4,
+                                 const double_t c2 = 0.9,
+                                 const double_t initial_step = 1.0,
+                                 const double_t max_step = 1e10,
+                                 const size_t max_steps = 50) {
+  const double_t sign = (DIRECTION == OptimizationDirection::Minimize ? +1 : -1);
+  const double_t phi_0 = current_value;
+  const double_t dphi_0 = DotProduct(current_gradient, direction);
+  CURRENT_ASSERT(dphi_0 < 0);
+
+  size_t steps = 0;
+  const auto evaluate = [&](double_t step) {
+    ++steps;
+    LineSearchResult result;
+    result.step = step;
+    result.value_and_point.point = SumVectors(current_point, direction, step);
+    stats.JournalFunction();
+    result.value_and_point.value = f(result.value_and_point.point) * sign;
+    if (IsNormal(result.value_and_point.value)) {
+      stats.JournalGradient();
+      result.gradient = g(result.value_and_point.point);
+      if (DIRECTION == OptimizationDirection::Maximize) {
+        FlipSign(result.gradient);
+      }
+    }
+    return result;
+  };
+  const auto sufficient_decrease = [&](const LineSearchResult& r) {
+    return IsNormal(r.value_and_point.value) && r.value_and_point.value <= phi_0 + c1 * r.step * dphi_0;
+  };
+  const auto curvature = [&](const LineSearchResult& r) {
+    return std::abs(DotProduct(r.gradient, direction)) <= -c2 * dphi_0;
+  };
+
+  // The best point found so far satisfying the sufficient decrease condition, for when the steps run out.
+  LineSearchResult best;
+  const auto consider = [&](const LineSearchResult& r) {
+    if (sufficient_decrease(r) && (best.step == 0 || r.value_and_point.value < best.value_and_point.value)) {
+      best = r;
+    }
+  };
+
+  // Zooms into the interval between `lo`, which satisfies the sufficient decrease condition, and `hi`.
+  const auto zoom = [&](LineSearchResult lo, LineSearchResult hi) {
+    while (steps < max_steps) {
+      const double_t a = lo.step;
+      const double_t b = hi.step;
+      double_t step = 0.5 * (a + b);
+      if (IsNormal(hi.value_and_point.value)) {
+        // Minimum of the quadratic interpolating `phi(lo)`, `phi'(lo)` and `phi(hi)`, kept away from the ends.
+        const double_t d = b - a;
+        const double_t dphi_lo = DotProduct(lo.gradient, direction);
+        const double_t denominator = 2 * (hi.value_and_point.value - lo.value_and_point.value - dphi_lo * d);
+        if (denominator > 0) {
+          const double_t candidate = a - dphi_lo * d * d / denominator;
+          const double_t low = std::min(a, b) + 0.1 * std::abs(d);
+          const double_t high = std::max(a, b) - 0.1 * std::abs(d);
+          step = std::max(low, std::min(high, candidate));
+        }
+      }
+      const LineSearchResult r = evaluate(step);
+      consider(r);
+      if (!sufficient_decrease(r) || r.value_and_point.value >= lo.value_and_point.value) {
+        hi = r;
+      } else {
+        if (curvature(r)) {
+          return r;
+        }
+        if (DotProduct(r.gradient, direction) * (hi.step - lo.step) >= 0) {
+          hi = lo;
+        }
+        lo = r;
+      }
+    }
+    return best;
+  };
+
+  LineSearchResult previous;
+  previous.value_and_point = ValueAndPoint(phi_0, current_point);
+  previous.gradient = current_gradient;
+  double_t step = initial_step;
+  LineSearchResult result = best;
+  while (steps < max_steps) {
+    const LineSearchResult r = evaluate(step);
+    consider(r);
+    if (!sufficient_decrease(r) || (previous.step > 0 && r.value_and_point.value >= previous.value_and_point.value)) {
+      result = zoom(previous, r);
+      break;
+    }
+    if (curvature(r)) {
+      result = r;
+      break;
+    }
+    if (DotProduct(r.gradient, direction) >= 0) {
+      result = zoom(r, previous);
+      break;
+    }
+    previous = r;
+    if (step >= max_step) {
+      result = r;
+      break;
+    }
+    step = std::min(step * 2, max_step);
+  }
+  if (result.step == 0) {
+    result = best;
+  }
+  if (result.step == 0) {
+    CURRENT_THROW(exceptions::WolfeLineSearchException("No step satisfying the sufficient decrease condition."));
+  }
+  return result;
+}
+
 }  // namespace fncas::impl
 }  // namespace fncas
 
@@ -26,13 +26,17 @@
 #ifndef FNCAS_FNCAS_NODE_H
 #define FNCAS_FNCAS_NODE_H
 
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <functional>
 #include <limits>
 #include <map>
 #include <stack>
 #include <string>
 #include <sstream>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 #include <exception>
 
@@ -57,8 +61,21 @@ using function_impl::ramp;
 
 template <typename T>
 T apply_function(::fncas::impl::MathFunction function, T argument) {
+  // The casts pick the right overloads from `<cmath>`, which declares `float` and `long double` ones too.
+  using f_t = T (*)(T);
   static std::function<T(T)> evaluator[static_cast<size_t>(::fncas::impl::MathFunction::end)] = {
-      sqr, sqrt, exp, log, sin, cos, tan, asin, acos, atan, unit_step, ramp};
+      static_cast<f_t>(sqr),
+      static_cast<f_t>(sqrt),
+      static_cast<f_t>(exp),
+      static_cast<f_t>(log),
+      static_cast<f_t>(sin),
+      static_cast<f_t>(cos),
+      static_cast<f_t>(tan),
+      static_cast<f_t>(asin),
+      static_cast<f_t>(acos),
+      static_cast<f_t>(atan),
+      static_cast<f_t>(unit_step),
+      static_cast<f_t>(ramp)};
   return function < ::fncas::impl::MathFunction::end ? evaluator[static_cast<size_t>(function)](argument)
                                                      : std::numeric_limits<T>::quiet_NaN();
 }
@@ -95,6 +112,25 @@ T apply_operation(MathOperation operation, T lhs, T rhs) {
 
 struct node_impl;
 struct X;
+
+// The key by which identical nodes are found: the type and the operation or function in `kind`,
+// and the operands, or the bits of the value, in `a` and `b`.
+struct node_key {
+  uint64_t kind;
+  uint64_t a;
+  uint64_t b;
+  bool operator==(const node_key& rhs) const { return kind == rhs.kind && a == rhs.a && b == rhs.b; }
+};
+
+struct node_key_hash {
+  size_t operator()(const node_key& key) const {
+    uint64_t h = key.kind * 0x9e3779b97f4a7c15ull;
+    h = (h ^ key.a) * 0xff51afd7ed558ccdull;
+    h = (h ^ key.b) * 0xc4ceb9fe1a85ec53ull;
+    return static_cast<size_t>(h ^ (h >> 32));
+  }
+};
+
 struct internals_impl {
   // The dimensionality of the function that is currently being worked with.
   size_t dim_;
@@ -115,12 +151,20 @@ struct internals_impl {
   // A block of RAM to be used as the buffer for externally compiled functions.
   std::vector<double_t> heap_for_compiled_evaluations_;
 
+  // Structural hashing: the index of the already existing node for each value, operation, or function call.
+  std::unordered_map<node_key, node_index_t, node_key_hash> node_cache_;
+
+  // The number of nodes the expression would have taken without hash-consing and simplification.
+  size_t nodes_requested_;
+
   void reset() {
     dim_ = 0;
     x_ptr_ = nullptr;
     node_vector_.clear();
     df_.clear();
     heap_for_compiled_evaluations_.clear();
+    node_cache_.clear();
+    nodes_requested_ = 0;
   }
 };
 
@@ -223,6 +267,131 @@ inline double_t eval_node(node_index_t index,
   return V[index];
 }
 
+// Nodes are created via `make_value()`, `make_operation()` and `make_function()`, which simplify the expression
+// and reuse the existing node if an identical one has been created already. Since both the operands and the
+// result are simplified at construction, the graph, its derivatives, and the code compiled from it
+// contain no duplicate subexpressions, no `x * 1`, `x + 0`, or `x / 1` terms, and no operations on constants.
+// NOTE: `0 * x` and `x - x` are deliberately kept, as for an infinite or `NaN` `x` they are `NaN`, not `0`,
+// and the optimizers rely on `NaN`-s propagating to detect the points where the function is not defined.
+inline node_index_t intern_node(const node_key& key, const node_impl& node) {
+  internals_impl& internals = internals_singleton();
+  const auto cit = internals.node_cache_.find(key);
+  if (cit != internals.node_cache_.end()) {
+    return cit->second;
+  }
+  const node_index_t index = static_cast<node_index_t>(internals.node_vector_.size());
+  internals.node_vector_.push_back(node);
+  internals.node_cache_.emplace(key, index);
+  return index;
+}
+
+inline node_index_t make_value(double_t x) {
+  node_impl node;
+  node.type() = NodeType::value;
+  node.value() = x;
+  // Only the significant bytes: 8 for `double`, 10 for the x87 `long double`, the rest of which is padding.
+  node_key key{static_cast<uint64_t>(NodeType::value), 0u, 0u};
+  std::memcpy(&key.a, &x, std::min(sizeof(double_t), static_cast<size_t>(8)));
+  if (sizeof(double_t) > 8) {
+    std::memcpy(&key.b, reinterpret_cast<const uint8_t*>(&x) + 8, 2);
+  }
+  return intern_node(key, node);
+}
+
+inline bool node_is_value(node_index_t index) {
+  return node_vector_singleton()[index].type() == NodeType::value;
+}
+
+inline bool node_is_value(node_index_t index, double_t value) {
+  node_impl& node = node_vector_singleton()[index];
+  return node.type() == NodeType::value && node.value() == value;
+}
+
+inline node_index_t make_operation(MathOperation operation, node_index_t lhs, node_index_t rhs) {
+  ++internals_singleton().nodes_requested_;
+  if (node_is_value(lhs) && node_is_value(rhs)) {
+    return make_value(apply_operation<double_t>(operation,
+                                                node_vector_singleton()[lhs].value(),
+                                                node_vector_singleton()[rhs].value()));
+  }
+  switch (operation) {
+    case MathOperation::add:
+      if (node_is_value(lhs, 0)) {
+        return rhs;
+      }
+      if (node_is_value(rhs, 0)) {
+        return lhs;
+      }
+      break;
+    case MathOperation::subtract:
+      if (node_is_value(rhs, 0)) {
+        return lhs;
+      }
+      break;
+    case MathOperation::multiply:
+      if (node_is_value(lhs, 1)) {
+        return rhs;
+      }
+      if (node_is_value(rhs, 1)) {
+        return lhs;
+      }
+      break;
+    case MathOperation::divide:
+      if (node_is_value(rhs, 1)) {
+        return lhs;
+      }
+      break;
+    default:
+      break;
+  }
+  node_impl node;
+  node.type() = NodeType::operation;
+  node.operation() = operation;
+  node.lhs_index() = lhs;
+  node.rhs_index() = rhs;
+  if ((operation == MathOperation::add || operation == MathOperation::multiply) && lhs > rhs) {
+    // Addition and multiplication are commutative, also in floating point, so `a+b` and `b+a` are the same node.
+    std::swap(lhs, rhs);
+  }
+  return intern_node(node_key{static_cast<uint64_t>(NodeType::operation) | (static_cast<uint64_t>(operation) << 8),
+                              static_cast<uint64_t>(lhs),
+                              static_cast<uint64_t>(rhs)},
+                     node);
+}
+
+inline node_index_t make_function(MathFunction function, node_index_t argument) {
+  ++internals_singleton().nodes_requested_;
+  if (node_is_value(argument)) {
+    return make_value(::fncas::apply_function<double_t>(function, node_vector_singleton()[argument].value()));
+  }
+  node_impl node;
+  node.type() = NodeType::function;
+  node.function() = function;
+  node.argument_index() = argument;
+  return intern_node(node_key{static_cast<uint64_t>(NodeType::function) | (static_cast<uint64_t>(function) << 8),
+                              static_cast<uint64_t>(argument),
+                              0u},
+                     node);
+}
+
+// The number of nodes in the current expression graph, and the number it would have taken without
+// hash-consing and simplification.
+struct NodeStatistics {
+  size_t nodes;
+  size_t nodes_requested;
+};
+
+inline NodeStatistics node_statistics() {
+  const internals_impl& internals = internals_singleton();
+  return NodeStatistics{internals.node_vector_.size(), internals.nodes_requested_ + internals.dim_};
+}
+
+inline std::string node_count_as_string() {
+  const NodeStatistics stats = node_statistics();
+  return std::to_string(stats.nodes) + " nodes (" + std::to_string(stats.nodes_requested) +
+         " before simplification)";
+}
+
 // The code that deals with nodes directly uses class V as a wrapper to node_impl.
 // Since the storage for node_impl-s is global, class V just holds an index of node_impl.
 // User code that defines the function to work with is effectively dealing with class V objects:
@@ -254,10 +423,7 @@ struct GenericV : node_index_allocator {
 
  public:
   GenericV() : node_index_allocator(allocate_new()) {}
-  GenericV(double_t x) : node_index_allocator(allocate_new()) {
-    type() = NodeType::value;
-    value() = x;
-  }
+  GenericV(double_t x) : node_index_allocator(from_index(make_value(x))) { ++internals_singleton().nodes_requested_; }
   GenericV(from_index i) : node_index_allocator(i) {}
   NodeType& type() const { return node_vector_singleton()[index_].type(); }
   int32_t& variable() const { return node_vector_singleton()[index_].variable(); }
@@ -425,6 +591,64 @@ struct f_super : noncopyable {
   virtual size_t dim() const = 0;
   // The number of external `double_t` "registers" required to compute it, for compiled versions.
   virtual size_t heap_size() const { return 0; }
+
+  // Evaluates the function at `count` points, the `i`-th of which starts at `xs + i * stride`, in this thread.
+  // The default implementation calls `operator()` point by point; interpreted and compiled versions do better.
+  virtual void evaluate_strided(const double_t* xs, size_t count, size_t stride, double_t* output) const {
+    std::vector<double_t> x(dim());
+    for (size_t i = 0; i < count; ++i) {
+      std::copy(xs + i * stride, xs + i * stride + x.size(), x.begin());
+      output[i] = operator()(x);
+    }
+  }
+  // Whether `evaluate_strided()` and `evaluate()` may be called for the same function from several threads at once.
+  // Blueprints may not, as the nodes they refer to live in the thread-local storage of the thread that built them.
+  virtual bool supports_concurrent_evaluation() const { return false; }
+
+  // Evaluates the function using the caller-provided scratch `heap` of at least `heap_size()` doubles.
+  // Touches no thread-local state, so, if `supports_concurrent_evaluation()`, the same immutable function object
+  // can be shared by any number of threads, each with its own heap.
+  virtual double_t evaluate(const double_t* x, double_t* heap) const {
+    static_cast<void>(x);
+    static_cast<void>(heap);
+    CURRENT_THROW(exceptions::FnCASSharedEvaluationNotSupportedException());
+  }
+
+  // Evaluates the function at many points, splitting them into up to `threads` ranges evaluated in parallel,
+  // if the implementation supports concurrent evaluation.
+  void evaluate_batch(const double_t* xs, size_t count, size_t stride, double_t* output, size_t threads = 1) const {
+    if (!supports_concurrent_evaluation()) {
+      threads = 1;
+    }
+    threads = std::max(static_cast<size_t>(1), std::min(threads, count));
+    if (threads == 1) {
+      evaluate_strided(xs, count, stride, output);
+    } else {
+      std::vector<std::thread> workers;
+      workers.reserve(threads);
+      for (size_t t = 0; t < threads; ++t) {
+        const size_t begin = count * t / threads;
+        const size_t end = count * (t + 1) / threads;
+        workers.emplace_back([this, xs, begin, end, stride, output]() {
+          evaluate_strided(xs + begin * stride, end - begin, stride, output + begin);
+        });
+      }
+      for (auto& worker : workers) {
+        worker.join();
+      }
+    }
+  }
+  std::vector<double_t> evaluate_batch(const std::vector<std::vector<double_t>>& xs, size_t threads = 1) const {
+    const size_t d = dim();
+    std::vector<double_t> matrix(xs.size() * d);
+    for (size_t i = 0; i < xs.size(); ++i) {
+      CURRENT_ASSERT(xs[i].size() == d);
+      std::copy(xs[i].begin(), xs[i].end(), matrix.begin() + i * d);
+    }
+    std::vector<double_t> result(xs.size());
+    evaluate_batch(matrix.data(), xs.size(), d, result.data(), threads);
+    return result;
+  }
 };
 
 template <>
@@ -477,12 +701,8 @@ struct f_impl_selector<JIT::Super> {
 
 #define DECLARE_OP(OP, OP2, NAME)                                                                   \
   inline ::fncas::impl::V operator OP(const ::fncas::impl::V& lhs, const ::fncas::impl::V& rhs) {   \
-    ::fncas::impl::V result;                                                                        \
-    result.type() = ::fncas::impl::NodeType::operation;                                             \
-    result.operation() = ::fncas::impl::MathOperation::NAME;                                        \
-    result.lhs_index() = lhs.index_;                                                                \
-    result.rhs_index() = rhs.index_;                                                                \
-    return result;                                                                                  \
+    return ::fncas::impl::from_index(                                                               \
+        ::fncas::impl::make_operation(::fncas::impl::MathOperation::NAME, lhs.index_, rhs.index_)); \
   }                                                                                                 \
   inline const ::fncas::impl::V& operator OP2(::fncas::impl::V& lhs, const ::fncas::impl::V& rhs) { \
     lhs = lhs OP rhs;                                                                               \
@@ -501,37 +721,31 @@ using namespace std;
 
 #ifndef INJECT_FNCAS_INTO_NAMESPACE_STD
 // Put the "compile-as-you-execute" implementations of math functions into `fncas::impl::functions::`.
-#define DECLARE_FUNCTION(F)                                     \
-  namespace fncas {                                             \
-  using function_impl::F;                                       \
-  inline ::fncas::impl::V F(const ::fncas::impl::V& argument) { \
-    ::fncas::impl::V result;                                    \
-    result.type() = ::fncas::impl::NodeType::function;          \
-    result.function() = ::fncas::impl::MathFunction::F;         \
-    result.argument_index() = argument.index_;                  \
-    return result;                                              \
-  }                                                             \
-  }                                                             \
-  namespace fncas {                                             \
-  namespace impl {                                              \
-  using ::fncas::F;                                             \
-  }                                                             \
+#define DECLARE_FUNCTION(F)                                                             \
+  namespace fncas {                                                                     \
+  using function_impl::F;                                                               \
+  inline ::fncas::impl::V F(const ::fncas::impl::V& argument) {                         \
+    return ::fncas::impl::from_index(                                                   \
+        ::fncas::impl::make_function(::fncas::impl::MathFunction::F, argument.index_)); \
+  }                                                                                     \
+  }                                                                                     \
+  namespace fncas {                                                                     \
+  namespace impl {                                                                      \
+  using ::fncas::F;                                                                     \
+  }                                                                                     \
   }
 #else
 // Expose math functions into `std::` as well.
 // NOTE: This is in violation of `C++11: 17.6.4.2.1/1`, and hence guarded. CC @dkorolev, @mzhurovich.
-#define DECLARE_FUNCTION(F)                                     \
-  namespace fncas {                                             \
-  inline ::fncas::impl::V F(const ::fncas::impl::V& argument) { \
-    ::fncas::impl::V result;                                    \
-    result.type() = ::fncas::impl::NodeType::function;          \
-    result.function() = ::fncas::impl::MathFunction::F;         \
-    result.argument_index() = argument.index_;                  \
-    return result;                                              \
-  }                                                             \
-  }                                                             \
-  namespace std {                                               \
-  using ::fncas::F;                                             \
+#define DECLARE_FUNCTION(F)                                                             \
+  namespace fncas {                                                                     \
+  inline ::fncas::impl::V F(const ::fncas::impl::V& argument) {                         \
+    return ::fncas::impl::from_index(                                                   \
+        ::fncas::impl::make_function(::fncas::impl::MathFunction::F, argument.index_)); \
+  }                                                                                     \
+  }                                                                                     \
+  namespace std {                                                                       \
+  using ::fncas::F;                                                                     \
   }
 #endif
 
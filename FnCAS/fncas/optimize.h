@@ -27,9 +27,15 @@ SOFTWARE.
 #define FNCAS_FNCAS_OPTIMIZE_H
 
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
 #include <numeric>
 #include <map>
+#include <mutex>
 #include <string>
+#include <thread>
 
 #include "base.h"
 #include "differentiate.h"
@@ -188,8 +194,15 @@ class OptimizerParameters {
     return *this;
   }
 
+  // Evaluate the candidate steps of the line search in parallel, for functions that support concurrent evaluation.
+  OptimizerParameters& EnableParallelLineSearch() {
+    parallel_line_search_ = true;
+    return *this;
+  }
+
   bool IsJITEnabled() const { return jit_enabled_; }
   bool ShouldTrackProgress() const { return track_optimization_progress_; }
+  bool IsParallelLineSearchEnabled() const { return parallel_line_search_; }
 
   OptimizerParameters& SetPointBeautifier(point_beautifier_t point_beautifier) {
     point_beautifier_ = point_beautifier;
@@ -211,6 +224,106 @@ class OptimizerParameters {
   stopping_criterion_t stopping_criterion_;
   bool jit_enabled_ = true;
   bool track_optimization_progress_ = false;
+  bool parallel_line_search_ = false;
+};
+
+// Evaluates `f` at batches of points. If `parallel` is set and `f` supports concurrent evaluation, the points
+// of each batch are spread across the worker threads, each with its own heap, evaluating the very same immutable
+// function object. The workers are started on the first batch that needs them and reused for all the further ones,
+// as for a cheap compiled function starting a thread costs more than evaluating it. The calling thread takes
+// its share of the points too.
+template <typename F>
+class PointsEvaluator final : impl::noncopyable {
+ public:
+  PointsEvaluator(const F& f, bool parallel) : f_(f), parallel_(parallel && f.supports_concurrent_evaluation()) {}
+
+  ~PointsEvaluator() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      terminating_ = true;
+      points_available_.notify_all();
+    }
+    for (auto& thread : threads_) {
+      thread.join();
+    }
+  }
+
+  std::vector<double_t> operator()(const std::vector<std::vector<double_t>>& points) {
+    std::vector<double_t> values(points.size());
+    if (!parallel_ || points.size() <= 1u) {
+      for (size_t i = 0; i < points.size(); ++i) {
+        values[i] = f_(points[i]);
+      }
+      return values;
+    }
+    while (threads_.size() + 1u < points.size()) {
+      threads_.emplace_back(&PointsEvaluator::WorkerThread, this);
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      points_ = &points;
+      values_ = &values;
+      next_point_ = 0u;
+      points_remaining_ = points.size();
+      points_available_.notify_all();
+    }
+    if (heap_.size() != f_.heap_size()) {
+      heap_.resize(f_.heap_size());
+    }
+    EvaluateAvailablePoints(heap_);
+    std::unique_lock<std::mutex> lock(mutex_);
+    batch_done_.wait(lock, [this]() { return points_remaining_ == 0u; });
+    points_ = nullptr;
+    values_ = nullptr;
+    return values;
+  }
+
+ private:
+  // Evaluates the points of the current batch one by one, until there are none left to claim.
+  void EvaluateAvailablePoints(std::vector<double_t>& heap) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (points_ && next_point_ < points_->size()) {
+      const size_t i = next_point_++;
+      const std::vector<double_t>& point = (*points_)[i];
+      double_t& value = (*values_)[i];
+      lock.unlock();
+      value = f_.evaluate(point.data(), heap.data());
+      lock.lock();
+      if (--points_remaining_ == 0u) {
+        batch_done_.notify_all();
+      }
+    }
+  }
+
+  void WorkerThread() {
+    std::vector<double_t> heap(f_.heap_size());
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        points_available_.wait(
+            lock, [this]() { return terminating_ || (points_ && next_point_ < points_->size()); });
+        if (terminating_) {
+          return;
+        }
+      }
+      EvaluateAvailablePoints(heap);
+    }
+  }
+
+  const F& f_;
+  const bool parallel_;
+  std::vector<double_t> heap_;
+  std::vector<std::thread> threads_;
+
+  // The batch being evaluated, guarded by `mutex_`.
+  std::mutex mutex_;
+  std::condition_variable points_available_;
+  std::condition_variable batch_done_;
+  const std::vector<std::vector<double_t>>* points_ = nullptr;
+  std::vector<double_t>* values_ = nullptr;
+  size_t next_point_ = 0u;
+  size_t points_remaining_ = 0u;
+  bool terminating_ = false;
 };
 
 // The base class for the optimizer of the function of type `F`.
@@ -294,8 +407,7 @@ class OptimizeInvoker : public Optimizer<F, DIRECTION> {
     // the metadata that is expected to be present at the very end.
     const fncas::impl::f_impl<JIT::Blueprint> f_i(
         ExtractValueFromObjectiveFunctionValue(objective_function.ObjectiveFunction(gradient_helper)));
-    logger.Log("Optimizer: The objective function is " + current::ToString(impl::node_vector_singleton().size()) +
-               " nodes.");
+    logger.Log("Optimizer: The objective function is " + impl::node_count_as_string() + ".");
     if (JIT_IMPLEMENTATION != fncas::JIT::Blueprint &&
         (!Exists(super_t::Parameters()) || Value(super_t::Parameters()).IsJITEnabled())) {
       logger.Log("Optimizer: Compiling the objective function.");
@@ -326,7 +438,7 @@ class OptimizeInvoker : public Optimizer<F, DIRECTION> {
     logger.Log("Optimizer: Differentiating.");
     const fncas::impl::g_impl<fncas::JIT::Blueprint> g_i(gradient_helper, f_i);
     logger.Log("Optimizer: Augmented with the gradient the function is " +
-               current::ToString(impl::node_vector_singleton().size()) + " nodes.");
+               impl::node_count_as_string() + ".");
     if (JIT_IMPLEMENTATION != fncas::JIT::Blueprint &&
         (!Exists(super_t::Parameters()) || Value(super_t::Parameters()).IsJITEnabled())) {
       logger.Log("Optimizer: Compiling the gradient.");
@@ -360,8 +472,7 @@ class OptimizeInvoker<F, DIRECTION, fncas::JIT::Blueprint, IMPL> : public Optimi
     const fncas::impl::X gradient_helper(starting_point.size());
     // NOTE(dkorolev): Here, `fncas::impl::X` is magically cast into `std::vector<fncas::impl::V>`.
     const fncas::impl::f_impl<JIT::Blueprint> f_i(objective_function.ObjectiveFunction(gradient_helper));
-    logger.Log("Optimizer: The objective function is " + current::ToString(impl::node_vector_singleton().size()) +
-               " nodes.");
+    logger.Log("Optimizer: The objective function is " + impl::node_count_as_string() + ".");
     logger.Log("Optimizer: Not using JIT.");
     return DoOptimize(objective_function, f_i, f_i, starting_point, gradient_helper);
   }
@@ -377,7 +488,7 @@ class OptimizeInvoker<F, DIRECTION, fncas::JIT::Blueprint, IMPL> : public Optimi
     logger.Log("Optimizer: Differentiating.");
     const fncas::impl::g_impl<fncas::JIT::Blueprint> g_i(gradient_helper, f_i);
     logger.Log("Optimizer: Augmented with the gradient the function is " +
-               current::ToString(impl::node_vector_singleton().size()) + " nodes.");
+               impl::node_count_as_string() + ".");
     return OptimizeImpl<IMPL, DIRECTION>::template RunOptimize<F>(*this, original_f, f, g_i, starting_point);
   }
 };
@@ -413,6 +524,7 @@ struct OptimizeImpl<GradientDescentOptimizerSelector, DIRECTION> {
     double_t no_improvement_steps_to_terminate = 2;      // Wait for this # of consecutive no improvement iterations.
 
     bool track_progress = false;
+    bool parallel_line_search = false;
 
     if (Exists(super.Parameters())) {
       const auto& parameters = Value(super.Parameters());
@@ -426,10 +538,13 @@ struct OptimizeImpl<GradientDescentOptimizerSelector, DIRECTION> {
           parameters.GetValue("no_improvement_steps_to_terminate", no_improvement_steps_to_terminate);
 
       track_progress = parameters.ShouldTrackProgress();
+      parallel_line_search = parameters.IsParallelLineSearchEnabled();
     }
 
     logger.Log("GradientDescentOptimizer: Begin at " + super.PointAsString(starting_point));
 
+    PointsEvaluator<current::decay<F>> evaluate_at_points(f, parallel_line_search);
+
     ValueAndPoint current(f(starting_point), starting_point);
     if (DIRECTION == OptimizationDirection::Maximize) {
       current.value *= -1;
@@ -467,10 +582,17 @@ struct OptimizeImpl<GradientDescentOptimizerSelector, DIRECTION> {
 
         auto best_candidate = current;
         auto has_valid_candidate = false;
-        for (const double_t step : {0.01, 0.05, 0.2}) {  // TODO(dkorolev): Something more sophisticated maybe?
-          const auto candidate_point(impl::SumVectors(current.point, gradient, -step));
+        const std::vector<double_t> steps({0.01, 0.05, 0.2});  // TODO(dkorolev): Something more sophisticated maybe?
+        std::vector<std::vector<double_t>> candidate_points;
+        for (const double_t step : steps) {
+          candidate_points.push_back(impl::SumVectors(current.point, gradient, -step));
           stats.JournalFunction();
-          double_t value = f(candidate_point);
+        }
+        const std::vector<double_t> values = evaluate_at_points(candidate_points);
+        for (size_t i = 0; i < steps.size(); ++i) {
+          const double_t step = steps[i];
+          const auto& candidate_point = candidate_points[i];
+          double_t value = values[i];
           if (fncas::IsNormal(value)) {
             has_valid_candidate = true;
             if (DIRECTION == OptimizationDirection::Maximize) {
@@ -718,7 +840,7 @@ struct OptimizeImpl<ConjugateGradientOptimizerSelector, DIRECTION> {
     }
 
     logger.Log("ConjugateGradientOptimizer: The objective function with its gradient is " +
-               current::ToString(impl::node_vector_singleton().size()) + " nodes.");
+               impl::node_count_as_string() + ".");
 
     ValueAndPoint current(f(starting_point), starting_point);
     logger.Log("ConjugateGradientOptimizer: Original objective function = " + current::ToString(current.value));
@@ -823,6 +945,291 @@ struct OptimizeImpl<ConjugateGradientOptimizerSelector, DIRECTION> {
   }
 };
 
+// Limited-memory BFGS with the line search satisfying the strong Wolfe conditions.
+// Keeps the last `lbfgs_history` pairs of point and gradient differences to approximate the inverse Hessian,
+// which makes it converge in considerably fewer function evaluations than the conjugate gradient method.
+struct LBFGSOptimizerSelector;
+
+template <class F,
+          OptimizationDirection DIRECTION = OptimizationDirection::Minimize,
+          JIT JIT_IMPLEMENTATION = JIT::Default>
+class LBFGSOptimizer final : public OptimizeInvoker<F, DIRECTION, JIT_IMPLEMENTATION, LBFGSOptimizerSelector> {
+ public:
+  using super_t = OptimizeInvoker<F, DIRECTION, JIT_IMPLEMENTATION, LBFGSOptimizerSelector>;
+  using super_t::super_t;
+};
+
+template <OptimizationDirection DIRECTION>
+struct OptimizeImpl<LBFGSOptimizerSelector, DIRECTION> {
+  template <typename ORIGINAL_F, typename F, typename G>
+  static OptimizationResult RunOptimize(const Optimizer<ORIGINAL_F, DIRECTION>& super,
+                                        const ORIGINAL_F& original_f,
+                                        F&& f,
+                                        G&& g,
+                                        const std::vector<double_t>& starting_point) {
+    const auto& logger = impl::OptimizerLogger();
+
+    size_t min_steps = 3;                 // Minimum number of optimization steps (ignoring early stopping).
+    size_t max_steps = 250;               // Maximum number of optimization steps.
+    size_t lbfgs_history = 10;            // The number of most recent updates to approximate the inverse Hessian.
+    double_t wolfe_c1 = 1e-4;             // The sufficient decrease constant of the Wolfe conditions.
+    double_t wolfe_c2 = 0.9;              // The curvature constant of the Wolfe conditions.
+    size_t line_search_max_steps = 50;    // Maximum number of function evaluations per line search.
+    double_t grad_eps = 1e-8;             // Magnitude of gradient for early stopping.
+    double_t min_absolute_per_step_improvement = 1e-25;  // Terminate early if the absolute improvement is small.
+    double_t min_relative_per_step_improvement = 1e-25;  // Terminate early if the relative improvement is small.
+    double_t no_improvement_steps_to_terminate = 2;      // Wait for this # of consecutive no improvement iterations.
+
+    bool track_progress = false;
+
+    if (Exists(super.Parameters())) {
+      const auto& parameters = Value(super.Parameters());
+      min_steps = parameters.GetValue("min_steps", min_steps);
+      max_steps = parameters.GetValue("max_steps", max_steps);
+      lbfgs_history = parameters.GetValue("lbfgs_history", lbfgs_history);
+      wolfe_c1 = parameters.GetValue("wolfe_c1", wolfe_c1);
+      wolfe_c2 = parameters.GetValue("wolfe_c2", wolfe_c2);
+      line_search_max_steps = parameters.GetValue("line_search_max_steps", line_search_max_steps);
+      grad_eps = parameters.GetValue("grad_eps", grad_eps);
+      min_relative_per_step_improvement =
+          parameters.GetValue("min_relative_per_step_improvement", min_relative_per_step_improvement);
+      min_absolute_per_step_improvement =
+          parameters.GetValue("min_absolute_per_step_improvement", min_absolute_per_step_improvement);
+      no_improvement_steps_to_terminate =
+          parameters.GetValue("no_improvement_steps_to_terminate", no_improvement_steps_to_terminate);
+
+      track_progress = parameters.ShouldTrackProgress();
+    }
+    lbfgs_history = std::max(lbfgs_history, static_cast<size_t>(1));
+
+    logger.Log("LBFGSOptimizer: The objective function with its gradient is " + impl::node_count_as_string() + ".");
+
+    ValueAndPoint current(f(starting_point), starting_point);
+    logger.Log("LBFGSOptimizer: Original objective function = " + current::ToString(current.value));
+    if (!fncas::IsNormal(current.value)) {
+      CURRENT_THROW(exceptions::FnCASOptimizationException("!fncas::IsNormal(current.value)"));
+    }
+
+    OptimizationProgress progress;
+
+    std::vector<double_t> current_gradient = g(current.point);
+
+    if (DIRECTION == OptimizationDirection::Maximize) {
+      current.value *= -1;
+      fncas::impl::FlipSign(current_gradient);
+    }
+
+    // The history of the most recent steps: `s[i] = x[i+1] - x[i]`, `y[i] = g[i+1] - g[i]`, `rho[i] = 1 / (y[i] * s[i])`.
+    std::deque<std::vector<double_t>> s;
+    std::deque<std::vector<double_t>> y;
+    std::deque<double_t> rho;
+    std::vector<double_t> alpha(lbfgs_history);
+
+    logger.Log("LBFGSOptimizer: Begin at " + super.PointAsString(starting_point));
+    size_t iteration;
+    int no_improvement_steps = 0;
+    {
+      OptimizerStats stats("LBFGSOptimizer");
+      for (iteration = 0; iteration < max_steps; ++iteration) {
+        if (super.StoppingCriterionSatisfied(iteration, current, current_gradient) ==
+            EarlyStoppingCriterion::StopOptimization) {
+          logger.Log("LBFGSOptimizer: External stopping criterion satisfied, terminating.");
+          break;
+        }
+
+        if (track_progress) {
+          progress.TrackIteration(original_f.ObjectiveFunction(current.point));
+        }
+
+        // Simple early stopping by the norm of the gradient.
+        if (std::sqrt(impl::L2Norm(current_gradient)) < grad_eps && iteration >= min_steps) {
+          break;
+        }
+
+        stats.JournalIteration();
+        if (logger) {
+          // `PointAsString()` is an expensive call, don't make it if `logger` is not initialized.
+          logger.Log("LBFGSOptimizer: Iteration " + current::ToString(iteration + 1) + ", OF = " +
+                     current::ToString(current.value) + " @ " + super.PointAsString(current.point));
+        }
+
+        // The two-loop recursion computing the direction `-H * g`, Algorithm 7.4 in Nocedal & Wright.
+        std::vector<double_t> direction(current_gradient);
+        for (size_t i = s.size(); i-- > 0;) {
+          alpha[i] = rho[i] * impl::DotProduct(s[i], direction);
+          direction = impl::SumVectors(direction, y[i], -alpha[i]);
+        }
+        double_t initial_step = 1.0;
+        if (!s.empty()) {
+          const double_t gamma = impl::DotProduct(s.back(), y.back()) / impl::L2Norm(y.back());
+          for (auto& e : direction) {
+            e *= gamma;
+          }
+        } else {
+          // No curvature information yet: make the first step of unit length against the gradient.
+          initial_step = std::min(static_cast<double_t>(1), 1 / std::sqrt(impl::L2Norm(current_gradient)));
+        }
+        for (size_t i = 0; i < s.size(); ++i) {
+          const double_t beta = rho[i] * impl::DotProduct(y[i], direction);
+          direction = impl::SumVectors(direction, s[i], alpha[i] - beta);
+        }
+        fncas::impl::FlipSign(direction);
+
+        if (!(impl::DotProduct(direction, current_gradient) < 0)) {
+          // The approximation of the inverse Hessian has degraded, restart from the steepest descent.
+          logger.Log("LBFGSOptimizer: Not a descent direction, resetting the history.");
+          s.clear();
+          y.clear();
+          rho.clear();
+          direction = current_gradient;
+          fncas::impl::FlipSign(direction);
+          initial_step = std::min(static_cast<double_t>(1), 1 / std::sqrt(impl::L2Norm(current_gradient)));
+        }
+
+        try {
+          auto next = impl::WolfeLineSearch<DIRECTION>(f,
+                                                       g,
+                                                       current.point,
+                                                       current.value,
+                                                       current_gradient,
+                                                       direction,
+                                                       stats,
+                                                       wolfe_c1,
+                                                       wolfe_c2,
+                                                       initial_step,
+                                                       1e10,
+                                                       line_search_max_steps);
+
+          std::vector<double_t> step = impl::SumVectors(next.value_and_point.point, current.point, -1.0);
+          std::vector<double_t> gradient_change = impl::SumVectors(next.gradient, current_gradient, -1.0);
+          const double_t sy = impl::DotProduct(step, gradient_change);
+          // Only keep the updates preserving the positive definiteness of the inverse Hessian approximation.
+          if (sy > 1e-10 * std::sqrt(impl::L2Norm(step) * impl::L2Norm(gradient_change))) {
+            s.push_back(std::move(step));
+            y.push_back(std::move(gradient_change));
+            rho.push_back(1 / sy);
+            if (s.size() > lbfgs_history) {
+              s.pop_front();
+              y.pop_front();
+              rho.pop_front();
+            }
+          }
+
+          if (NoImprovement(next.value_and_point,
+                            current,
+                            min_relative_per_step_improvement,
+                            min_absolute_per_step_improvement)) {
+            ++no_improvement_steps;
+            if (no_improvement_steps >= no_improvement_steps_to_terminate) {
+              logger.Log("LBFGSOptimizer: Terminating due to no improvement.");
+              break;
+            }
+          } else {
+            no_improvement_steps = 0;
+          }
+
+          // Never step back to a worse point; `NoImprovement()` above is what terminates on a plateau.
+          if (next.value_and_point.value <= current.value) {
+            current = std::move(next.value_and_point);
+            current_gradient = std::move(next.gradient);
+          }
+        } catch (const exceptions::WolfeLineSearchException&) {
+          logger.Log("LBFGSOptimizer: Terminating due to no line search step possible.");
+          break;
+        }
+      }
+    }
+
+    if (DIRECTION == OptimizationDirection::Maximize) {
+      current.value *= -1;
+    }
+
+    logger.Log("LBFGSOptimizer: Result = " + super.PointAsString(current.point));
+    logger.Log("LBFGSOptimizer: Objective function = " + current::ToString(current.value));
+
+    OptimizationResult result(current);
+    result.optimization_iterations = iteration;
+
+    if (track_progress) {
+      result.progress = std::move(progress);
+    }
+
+    return result;
+  }
+};
+
+// Runs `optimizer` from each of `starting_points` and returns the best of the results, the one with the lowest
+// value of the objective function for `Minimize`, or with the highest for `Maximize`.
+// The optimizations are independent, and they run on a pool of `threads` threads, by default one per CPU core.
+// Each thread builds, differentiates and compiles the objective function on its own, as the expression graph
+// of FnCAS is thread-local. Starting points from which the optimization fails are skipped; if it fails from every
+// one of them, the exception of the first failed starting point is rethrown. Any other exception, be it
+// `std::bad_alloc` or one thrown by a user callback, stops the remaining optimizations and is rethrown once
+// all the threads are joined.
+// NOTE: All the threads share the very same `optimizer`, so the objective function object it refers to,
+// as well as its point beautifier and stopping criterion, if set, must be safe to call concurrently.
+template <class F, OptimizationDirection DIRECTION>
+OptimizationResult MultiStartOptimize(const Optimizer<F, DIRECTION>& optimizer,
+                                      const std::vector<std::vector<double_t>>& starting_points,
+                                      size_t threads = 0u) {
+  CURRENT_ASSERT(!starting_points.empty());
+  if (!threads) {
+    threads = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+  threads = std::min(threads, starting_points.size());
+
+  std::vector<Optional<OptimizationResult>> results(starting_points.size());
+  std::vector<std::exception_ptr> errors(starting_points.size());
+  std::vector<std::exception_ptr> fatal_errors(starting_points.size());
+  std::atomic_bool fatal_error_occurred(false);
+  std::atomic_size_t next_index(0u);
+  const auto worker = [&]() {
+    size_t i;
+    while (!fatal_error_occurred && (i = next_index++) < starting_points.size()) {
+      try {
+        results[i] = optimizer.Optimize(starting_points[i]);
+      } catch (const exceptions::FnCASOptimizationException&) {
+        errors[i] = std::current_exception();
+      } catch (...) {
+        fatal_errors[i] = std::current_exception();
+        fatal_error_occurred = true;
+      }
+    }
+  };
+  if (threads == 1u) {
+    worker();
+  } else {
+    std::vector<std::thread> pool;
+    pool.reserve(threads);
+    for (size_t t = 0; t < threads; ++t) {
+      pool.emplace_back(worker);
+    }
+    for (auto& thread : pool) {
+      thread.join();
+    }
+  }
+
+  for (const auto& error : fatal_errors) {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+
+  const double_t sign = (DIRECTION == OptimizationDirection::Minimize ? +1 : -1);
+  Optional<OptimizationResult> best;
+  for (auto& result : results) {
+    if (Exists(result) && (!Exists(best) || Value(result).value * sign < Value(best).value * sign)) {
+      best = std::move(result);
+    }
+  }
+  if (!Exists(best)) {
+    std::rethrow_exception(errors.front());
+  }
+  impl::OptimizerLogger().Log("MultiStartOptimize: Best objective function = " + current::ToString(Value(best).value) +
+                              " @ " + optimizer.PointAsString(Value(best).point));
+  return std::move(Value(best));
+}
+
 template <class F,
           OptimizationDirection DIRECTION = OptimizationDirection::Minimize,
           JIT JIT_IMPLEMENTATION = JIT::Default>
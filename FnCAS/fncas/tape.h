@@ -0,0 +1,395 @@
+/*******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * *******************************************************************************/
+
+// FnCAS linear tape: the expression graph flattened once into a topologically ordered instruction sequence,
+// evaluated by a tight loop over a struct-of-arrays representation. Needs no external tools, unlike `jit.h`.
+
+#ifndef FNCAS_FNCAS_TAPE_H
+#define FNCAS_FNCAS_TAPE_H
+
+#include <algorithm>
+#include <cmath>
+#include <stack>
+#include <vector>
+
+#include "base.h"
+#include "node.h"
+#include "differentiate.h"
+
+#include "../../Bricks/util/singleton.h"
+
+namespace fncas {
+namespace impl {
+
+// The opcodes of the tape. Operations and functions follow the order of `MathOperation` and `MathFunction`.
+enum class TapeOpcode : uint8_t {
+  variable,
+  value,
+  add,
+  subtract,
+  multiply,
+  divide,
+  sqr,
+  sqrt,
+  exp,
+  log,
+  sin,
+  cos,
+  tan,
+  asin,
+  acos,
+  atan,
+  unit_step,
+  ramp,
+  end
+};
+static_assert(static_cast<size_t>(TapeOpcode::divide) - static_cast<size_t>(TapeOpcode::add) + 1 ==
+                  static_cast<size_t>(MathOperation::end),
+              "`TapeOpcode` should list all `MathOperation`-s.");
+static_assert(static_cast<size_t>(TapeOpcode::end) - static_cast<size_t>(TapeOpcode::sqr) ==
+                  static_cast<size_t>(MathFunction::end),
+              "`TapeOpcode` should list all `MathFunction`-s.");
+
+// The scratch space for tape evaluations. Per thread, so that compiled tapes themselves stay immutable.
+struct tape_evaluation_buffer {
+  std::vector<double_t> slots_;
+  double_t* reserve(size_t size) {
+    if (slots_.size() < size) {
+      slots_.resize(size);
+    }
+    return slots_.data();
+  }
+};
+
+// The result of instruction `i` is always written into slot `i`. The `lhs_` of a `variable` is the index
+// of that variable in `x`, the `lhs_` of a `value` is its index in `constants_`.
+class tape final {
+ public:
+  using slot_t = uint32_t;
+
+  tape() = default;
+
+  // Record the nodes required to compute `index`, reusing the ones already on the tape. Returns the slot.
+  slot_t append(node_index_t index) {
+    std::stack<node_index_t> stack;
+    stack.push(index);
+    while (!stack.empty()) {
+      const node_index_t i = stack.top();
+      stack.pop();
+      const node_index_t dependent_i = ~i;
+      if (i > dependent_i) {
+        if (growing_vector_access(slot_of_node_, i, kUnassigned) == kUnassigned) {
+          node_impl& f = node_vector_singleton()[i];
+          if (f.type() == NodeType::variable) {
+            slot_of_node_[i] = emit(TapeOpcode::variable, static_cast<slot_t>(f.variable()), 0);
+          } else if (f.type() == NodeType::value) {
+            slot_of_node_[i] = emit(TapeOpcode::value, static_cast<slot_t>(constants_.size()), 0);
+            constants_.push_back(f.value());
+          } else if (f.type() == NodeType::operation) {
+            stack.push(~i);
+            stack.push(f.lhs_index());
+            stack.push(f.rhs_index());
+          } else if (f.type() == NodeType::function) {
+            stack.push(~i);
+            stack.push(f.argument_index());
+          } else {
+            CURRENT_ASSERT(false);
+          }
+        }
+      } else if (slot_of_node_[dependent_i] == kUnassigned) {
+        // The check is required since the same node may be pushed more than once before it is computed.
+        node_impl& f = node_vector_singleton()[dependent_i];
+        if (f.type() == NodeType::operation) {
+          slot_of_node_[dependent_i] =
+              emit(static_cast<TapeOpcode>(static_cast<uint8_t>(TapeOpcode::add) + static_cast<uint8_t>(f.operation())),
+                   slot_of_node_[f.lhs_index()],
+                   slot_of_node_[f.rhs_index()]);
+        } else if (f.type() == NodeType::function) {
+          slot_of_node_[dependent_i] =
+              emit(static_cast<TapeOpcode>(static_cast<uint8_t>(TapeOpcode::sqr) + static_cast<uint8_t>(f.function())),
+                   slot_of_node_[f.argument_index()],
+                   0);
+        } else {
+          CURRENT_ASSERT(false);
+        }
+      }
+    }
+    return slot_of_node_[index];
+  }
+
+  // Drop the node-to-slot mapping once recording is done; the tape does not refer to the nodes afterwards.
+  void finalize() { std::vector<slot_t>().swap(slot_of_node_); }
+
+  size_t size() const { return opcode_.size(); }
+
+  // Fills `slots[0 .. size())`.
+  void run(const double_t* x, double_t* slots) const {
+    const size_t n = opcode_.size();
+    const TapeOpcode* opcode = opcode_.data();
+    const slot_t* lhs = lhs_.data();
+    const slot_t* rhs = rhs_.data();
+    const double_t* constants = constants_.data();
+    for (size_t i = 0; i < n; ++i) {
+      switch (opcode[i]) {
+        case TapeOpcode::variable:
+          slots[i] = x[lhs[i]];
+          break;
+        case TapeOpcode::value:
+          slots[i] = constants[lhs[i]];
+          break;
+        case TapeOpcode::add:
+          slots[i] = slots[lhs[i]] + slots[rhs[i]];
+          break;
+        case TapeOpcode::subtract:
+          slots[i] = slots[lhs[i]] - slots[rhs[i]];
+          break;
+        case TapeOpcode::multiply:
+          slots[i] = slots[lhs[i]] * slots[rhs[i]];
+          break;
+        case TapeOpcode::divide:
+          slots[i] = slots[lhs[i]] / slots[rhs[i]];
+          break;
+        case TapeOpcode::sqr:
+          slots[i] = slots[lhs[i]] * slots[lhs[i]];
+          break;
+        case TapeOpcode::sqrt:
+          slots[i] = std::sqrt(slots[lhs[i]]);
+          break;
+        case TapeOpcode::exp:
+          slots[i] = std::exp(slots[lhs[i]]);
+          break;
+        case TapeOpcode::log:
+          slots[i] = std::log(slots[lhs[i]]);
+          break;
+        case TapeOpcode::sin:
+          slots[i] = std::sin(slots[lhs[i]]);
+          break;
+        case TapeOpcode::cos:
+          slots[i] = std::cos(slots[lhs[i]]);
+          break;
+        case TapeOpcode::tan:
+          slots[i] = std::tan(slots[lhs[i]]);
+          break;
+        case TapeOpcode::asin:
+          slots[i] = std::asin(slots[lhs[i]]);
+          break;
+        case TapeOpcode::acos:
+          slots[i] = std::acos(slots[lhs[i]]);
+          break;
+        case TapeOpcode::atan:
+          slots[i] = std::atan(slots[lhs[i]]);
+          break;
+        case TapeOpcode::unit_step:
+          slots[i] = slots[lhs[i]] >= 0 ? 1 : 0;
+          break;
+        case TapeOpcode::ramp:
+          slots[i] = slots[lhs[i]] > 0 ? slots[lhs[i]] : 0;
+          break;
+        default:
+          slots[i] = std::numeric_limits<double_t>::quiet_NaN();
+      }
+    }
+  }
+
+  // The number of points `run_lanes()` evaluates side by side. Slot `i` of lane `l` is `slots[i * kLanes + l]`,
+  // so that each instruction is a fixed-length loop over adjacent values, which compiles into packed SIMD code.
+  static constexpr size_t kLanes = 4;
+
+  // Fills `slots[0 .. size() * kLanes)`, evaluating the tape at the points `x[0] .. x[kLanes - 1]`.
+  void run_lanes(const double_t* const* x, double_t* slots) const {
+    const size_t n = opcode_.size();
+    for (size_t i = 0; i < n; ++i) {
+      double_t* out = slots + i * kLanes;
+      const TapeOpcode opcode = opcode_[i];
+      if (opcode == TapeOpcode::variable) {
+        for (size_t l = 0; l < kLanes; ++l) {
+          out[l] = x[l][lhs_[i]];
+        }
+      } else if (opcode == TapeOpcode::value) {
+        for (size_t l = 0; l < kLanes; ++l) {
+          out[l] = constants_[lhs_[i]];
+        }
+      } else {
+        const double_t* a = slots + static_cast<size_t>(lhs_[i]) * kLanes;
+        const double_t* b = slots + static_cast<size_t>(rhs_[i]) * kLanes;
+        switch (opcode) {
+          case TapeOpcode::add:
+            for (size_t l = 0; l < kLanes; ++l) {
+              out[l] = a[l] + b[l];
+            }
+            break;
+          case TapeOpcode::subtract:
+            for (size_t l = 0; l < kLanes; ++l) {
+              out[l] = a[l] - b[l];
+            }
+            break;
+          case TapeOpcode::multiply:
+            for (size_t l = 0; l < kLanes; ++l) {
+              out[l] = a[l] * b[l];
+            }
+            break;
+          case TapeOpcode::divide:
+            for (size_t l = 0; l < kLanes; ++l) {
+              out[l] = a[l] / b[l];
+            }
+            break;
+          case TapeOpcode::sqr:
+            for (size_t l = 0; l < kLanes; ++l) {
+              out[l] = a[l] * a[l];
+            }
+            break;
+          case TapeOpcode::unit_step:
+            for (size_t l = 0; l < kLanes; ++l) {
+              out[l] = a[l] >= 0 ? 1 : 0;
+            }
+            break;
+          case TapeOpcode::ramp:
+            for (size_t l = 0; l < kLanes; ++l) {
+              out[l] = a[l] > 0 ? a[l] : 0;
+            }
+            break;
+          default: {
+            // Library functions are called lane by lane.
+            const MathFunction function = static_cast<MathFunction>(static_cast<uint8_t>(opcode) -
+                                                                    static_cast<uint8_t>(TapeOpcode::sqr));
+            for (size_t l = 0; l < kLanes; ++l) {
+              out[l] = ::fncas::apply_function<double_t>(function, a[l]);
+            }
+          }
+        }
+      }
+    }
+  }
+
+  // Runs the tape in the thread-local buffer of this thread and returns that buffer.
+  const double_t* run(const std::vector<double_t>& x) const {
+    double_t* slots = current::ThreadLocalSingleton<tape_evaluation_buffer>().reserve(opcode_.size());
+    run(x.data(), slots);
+    return slots;
+  }
+
+ private:
+  static constexpr slot_t kUnassigned = static_cast<slot_t>(-1);
+
+  slot_t emit(TapeOpcode opcode, slot_t lhs, slot_t rhs) {
+    CURRENT_ASSERT(opcode_.size() < static_cast<size_t>(kUnassigned));
+    opcode_.push_back(opcode);
+    lhs_.push_back(lhs);
+    rhs_.push_back(rhs);
+    return static_cast<slot_t>(opcode_.size() - 1);
+  }
+
+  std::vector<TapeOpcode> opcode_;
+  std::vector<slot_t> lhs_;
+  std::vector<slot_t> rhs_;
+  std::vector<double_t> constants_;
+  std::vector<slot_t> slot_of_node_;
+};
+
+template <>
+struct f_impl<JIT::Tape> final : f_super {
+  tape tape_;
+  tape::slot_t result_;
+  size_t dim_;
+
+  explicit f_impl(const V& node) : result_(tape_.append(node.index_)), dim_(internals_singleton().dim_) {
+    tape_.finalize();
+  }
+  explicit f_impl(const f_impl<JIT::Blueprint>& f) : f_impl(f.f_) {}
+
+  double_t operator()(const std::vector<double_t>& x) const override {
+    CURRENT_ASSERT(x.size() == dim_);
+    return tape_.run(x)[result_];
+  }
+  size_t dim() const override { return dim_; }
+  size_t heap_size() const override { return tape_.size(); }
+
+  // Evaluates `tape::kLanes` points at a time; the last group is padded by repeating its last point.
+  void evaluate_strided(const double_t* xs, size_t count, size_t stride, double_t* output) const override {
+    const size_t kLanes = tape::kLanes;
+    double_t* slots = current::ThreadLocalSingleton<tape_evaluation_buffer>().reserve(tape_.size() * kLanes);
+    const double_t* x[tape::kLanes];
+    for (size_t begin = 0; begin < count; begin += kLanes) {
+      const size_t lanes = std::min(kLanes, count - begin);
+      for (size_t l = 0; l < kLanes; ++l) {
+        x[l] = xs + (begin + std::min(l, lanes - 1)) * stride;
+      }
+      tape_.run_lanes(x, slots);
+      for (size_t l = 0; l < lanes; ++l) {
+        output[begin + l] = slots[static_cast<size_t>(result_) * kLanes + l];
+      }
+    }
+  }
+  // The tape is immutable once built, and the slots are thread-local or provided by the caller.
+  bool supports_concurrent_evaluation() const override { return true; }
+  double_t evaluate(const double_t* x, double_t* heap) const override {
+    tape_.run(x, heap);
+    return heap[result_];
+  }
+};
+
+template <>
+struct g_impl<JIT::Tape> final : g_super {
+  tape tape_;
+  tape::slot_t f_;
+  std::vector<tape::slot_t> g_;
+
+  // The value of the function is recorded first, as the compiled gradients do, so that the nodes it shares
+  // with the derivatives are on the tape in the same order.
+  g_impl(const f_impl<JIT::Blueprint>& f, const g_impl<JIT::Blueprint>& g) {
+    f_ = tape_.append(f.f_.index_);
+    g_.reserve(g.g_.size());
+    for (const V& gi : g.g_) {
+      g_.push_back(tape_.append(gi.index_));
+    }
+    tape_.finalize();
+  }
+
+  std::vector<double_t> operator()(const std::vector<double_t>& x) const override {
+    CURRENT_ASSERT(x.size() == g_.size());
+    const double_t* slots = tape_.run(x);
+    std::vector<double_t> r(g_.size());
+    for (size_t i = 0; i < g_.size(); ++i) {
+      r[i] = slots[g_[i]];
+    }
+    return r;
+  }
+  size_t dim() const override { return g_.size(); }
+  size_t heap_size() const override { return tape_.size(); }
+
+  bool supports_concurrent_evaluation() const override { return true; }
+  double_t evaluate(const double_t* x, double_t* heap, double_t* gradient) const override {
+    tape_.run(x, heap);
+    for (size_t i = 0; i < g_.size(); ++i) {
+      gradient[i] = heap[g_[i]];
+    }
+    return heap[f_];
+  }
+};
+
+}  // namespace fncas::impl
+}  // namespace fncas
+
+#endif  // #ifndef FNCAS_FNCAS_TAPE_H
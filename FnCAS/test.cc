@@ -39,6 +39,7 @@ SOFTWARE.
 #include "fncas.h"
 
 #include <functional>
+#include <limits>
 #include <thread>
 
 #ifdef FNCAS_JIT_COMPILED
@@ -181,8 +182,289 @@ TEST(FnCAS, JITSmokeNASM) {
   EXPECT_EQ(2.0, d({0.0, +2.0, -1.0}));
   EXPECT_EQ(9.0, d({3.0, 0.0, -1.0}));
 }
+
+TEST(FnCAS, JITSmokeX64) {
+  fncas::variables_vector_t x(3);
+  fncas::function_t<fncas::JIT::Blueprint> a = SmokeTestFunction(x);
+  fncas::function_t<fncas::JIT::X64> e(a);
+  EXPECT_EQ(3u, e.dim());
+  EXPECT_EQ(0.0, e({0.0, 0.0, -2.0}));
+  EXPECT_EQ(1.0, e({0.0, 0.0, +0.0}));
+  EXPECT_EQ(1.0, e({0.0, 0.0, +2.0}));
+  EXPECT_EQ(0.0, e({0.0, -2.0, -1.0}));
+  EXPECT_EQ(0.0, e({0.0, +0.0, -1.0}));
+  EXPECT_EQ(2.0, e({0.0, +2.0, -1.0}));
+  EXPECT_EQ(9.0, e({3.0, 0.0, -1.0}));
+}
+#endif  // FNCAS_JIT_COMPILED
+
+TEST(FnCAS, JITSmokeTape) {
+  fncas::variables_vector_t x(3);
+  fncas::function_t<fncas::JIT::Blueprint> a = SmokeTestFunction(x);
+  fncas::function_t<fncas::JIT::Tape> t(a);
+  EXPECT_EQ(3u, t.dim());
+  EXPECT_EQ(0.0, t({0.0, 0.0, -2.0}));
+  EXPECT_EQ(1.0, t({0.0, 0.0, +0.0}));
+  EXPECT_EQ(1.0, t({0.0, 0.0, +2.0}));
+  EXPECT_EQ(0.0, t({0.0, -2.0, -1.0}));
+  EXPECT_EQ(0.0, t({0.0, +0.0, -1.0}));
+  EXPECT_EQ(2.0, t({0.0, +2.0, -1.0}));
+  EXPECT_EQ(9.0, t({3.0, 0.0, -1.0}));
+}
+
+template <typename T>
+T AllMathFunctions(const std::vector<T>& x) {
+  using namespace unittest_fncas_namespace;
+  const T s = sin(x[0]) * cos(x[1]) + tan(x[0] / 4) + atan(x[1]) - unittest_fncas_namespace::sqr(x[2]);
+  const T t = asin(x[0] / 10) + acos(x[1] / 10) + exp(x[2] / 5) + log(x[0] * x[0] + 1) + sqrt(x[1] * x[1] + 1);
+  // No `unit_step()` here, as it is not differentiable. `JITSmokeTape` covers it.
+  return s * t + fncas::ramp(x[0] - x[1]) - s / (t + 10);
+}
+
+TEST(FnCAS, TapeMatchesBlueprint) {
+  fncas::variables_vector_t x(3);
+  const fncas::function_t<fncas::JIT::Blueprint> fi = AllMathFunctions(x);
+  const fncas::gradient_t<fncas::JIT::Blueprint> gi(x, fi);
+  const fncas::function_t<fncas::JIT::Tape> ft(fi);
+  const fncas::gradient_t<fncas::JIT::Tape> gt(fi, gi);
+  EXPECT_EQ(3u, gt.dim());
+  // Every node of the function is on the tape exactly once, and the gradient tape reuses them.
+  EXPECT_LT(ft.heap_size(), fncas::impl::node_vector_singleton().size());
+  EXPECT_LT(ft.heap_size(), gt.heap_size());
+  for (double a = -2.0; a <= 2.0; a += 0.5) {
+    for (double b = -1.5; b <= 1.5; b += 0.75) {
+      for (double c = -1.0; c <= 1.0; c += 0.5) {
+        const std::vector<fncas::double_t> p({a, b, c});
+        EXPECT_DOUBLE_EQ(fi(p), ft(p));
+        EXPECT_DOUBLE_EQ(AllMathFunctions(p), ft(p));
+        const std::vector<fncas::double_t> g_blueprint = gi(p);
+        const std::vector<fncas::double_t> g_tape = gt(p);
+        ASSERT_EQ(3u, g_tape.size());
+        for (size_t i = 0; i < 3u; ++i) {
+          EXPECT_DOUBLE_EQ(g_blueprint[i], g_tape[i]);
+        }
+      }
+    }
+  }
+}
+
+#ifdef FNCAS_JIT_COMPILED
+TEST(FnCAS, X64MatchesBlueprint) {
+  fncas::variables_vector_t x(3);
+  const fncas::function_t<fncas::JIT::Blueprint> fi = AllMathFunctions(x);
+  const fncas::gradient_t<fncas::JIT::Blueprint> gi(x, fi);
+  const fncas::function_t<fncas::JIT::X64> fc(fi);
+  const fncas::gradient_t<fncas::JIT::X64> gc(fi, gi);
+  EXPECT_EQ(3u, fc.dim());
+  EXPECT_EQ(3u, gc.dim());
+  for (double a = -2.0; a <= 2.0; a += 0.5) {
+    for (double b = -1.5; b <= 1.5; b += 0.75) {
+      for (double c = -1.0; c <= 1.0; c += 0.5) {
+        const std::vector<fncas::double_t> p({a, b, c});
+        EXPECT_DOUBLE_EQ(fi(p), fc(p));
+        const std::vector<fncas::double_t> g_blueprint = gi(p);
+        const std::vector<fncas::double_t> g_compiled = gc(p);
+        ASSERT_EQ(3u, g_compiled.size());
+        for (size_t i = 0; i < 3u; ++i) {
+          EXPECT_DOUBLE_EQ(g_blueprint[i], g_compiled[i]);
+        }
+      }
+    }
+  }
+}
 #endif  // FNCAS_JIT_COMPILED
 
+TEST(FnCAS, BatchEvaluation) {
+  fncas::variables_vector_t x(3);
+  const fncas::function_t<fncas::JIT::Blueprint> fi = AllMathFunctions(x);
+  const fncas::function_t<fncas::JIT::Tape> ft(fi);
+  std::vector<std::vector<fncas::double_t>> points;
+  for (size_t i = 0; i < 1003u; ++i) {
+    // Not a multiple of the number of lanes, to test the padding of the last group.
+    points.push_back({std::sin(i * 0.1) * 2.0, std::cos(i * 0.3) * 1.5, (i % 7) * 0.25 - 0.75});
+  }
+  const std::vector<fncas::double_t> blueprint = fi.evaluate_batch(points);
+  ASSERT_EQ(points.size(), blueprint.size());
+  for (size_t i = 0; i < points.size(); ++i) {
+    EXPECT_DOUBLE_EQ(fi(points[i]), blueprint[i]);
+  }
+  // The blueprint can not be evaluated from other threads, so the `threads` parameter is ignored for it.
+  EXPECT_EQ(blueprint, fi.evaluate_batch(points, 4u));
+  EXPECT_EQ(blueprint, ft.evaluate_batch(points));
+  EXPECT_EQ(blueprint, ft.evaluate_batch(points, 4u));
+#ifdef FNCAS_JIT_COMPILED
+  const fncas::function_t<fncas::JIT::X64> fc(fi);
+  EXPECT_EQ(blueprint, fc.evaluate_batch(points));
+  EXPECT_EQ(blueprint, fc.evaluate_batch(points, 4u));
+#endif
+
+  // The strided form reads the points from a matrix with extra columns, and writes into the caller's buffer.
+  const size_t stride = 5u;
+  std::vector<fncas::double_t> matrix(points.size() * stride, -1e9);
+  for (size_t i = 0; i < points.size(); ++i) {
+    std::copy(points[i].begin(), points[i].end(), matrix.begin() + i * stride);
+  }
+  std::vector<fncas::double_t> output(points.size());
+  ft.evaluate_batch(matrix.data(), points.size(), stride, output.data(), 3u);
+  EXPECT_EQ(blueprint, output);
+}
+
+TEST(FnCAS, HashConsingAndSimplification) {
+  fncas::variables_vector_t x(2);
+  const auto& nodes = fncas::impl::node_vector_singleton();
+  const size_t initial_nodes = nodes.size();
+
+  // Identical subexpressions are the same node, including commutative ones with the operands swapped.
+  const fncas::term_t a = x[0] * x[1] + fncas::sin(x[0]);
+  EXPECT_EQ(initial_nodes + 3u, nodes.size());
+  const fncas::term_t b = fncas::sin(x[0]) + x[1] * x[0];
+  EXPECT_EQ(a.index(), b.index());
+  EXPECT_EQ(initial_nodes + 3u, nodes.size());
+
+  // Trivial terms are simplified away.
+  EXPECT_EQ(x[0].index(), (x[0] + 0).index());
+  EXPECT_EQ(x[0].index(), (0 + x[0]).index());
+  EXPECT_EQ(x[0].index(), (x[0] - 0).index());
+  EXPECT_EQ(x[0].index(), (x[0] * 1).index());
+  EXPECT_EQ(x[0].index(), (1 * x[0]).index());
+  EXPECT_EQ(x[0].index(), (x[0] / 1).index());
+  // Unlike the above, `0 * x` and `x - x` are kept, as they are `NaN` for an infinite or `NaN` `x`.
+  EXPECT_NE("0", (x[1] * 0).debug_as_string());
+  EXPECT_NE("0", (a - b).debug_as_string());
+
+  // Constants are folded.
+  EXPECT_EQ("7", (fncas::term_t(3.0) * 2 + 1).debug_as_string());
+  EXPECT_EQ("1", fncas::exp(fncas::term_t(0.0)).debug_as_string());
+  EXPECT_EQ("(x[0]*6)", (x[0] * (fncas::term_t(2.0) * 3)).debug_as_string());
+
+  const fncas::impl::NodeStatistics stats = fncas::impl::node_statistics();
+  EXPECT_EQ(nodes.size(), stats.nodes);
+  EXPECT_LT(stats.nodes * 2u, stats.nodes_requested);
+
+  // The simplified graph evaluates to the same values.
+  const fncas::function_t<fncas::JIT::Blueprint> f = a * (x[0] + 0) + b * 1 - (x[1] - x[1]);
+  EXPECT_DOUBLE_EQ((3.0 * 4.0 + std::sin(3.0)) * 4.0, f({3.0, 4.0}));
+
+  // The simplification does not turn the `NaN`-s of IEEE 754 into numbers.
+  const fncas::function_t<fncas::JIT::Blueprint> g = x[0] + (x[1] - x[1]);
+  EXPECT_TRUE(std::isnan(g({1.0, std::numeric_limits<fncas::double_t>::infinity()})));
+  const fncas::function_t<fncas::JIT::Blueprint> h = x[0] + 0 * x[1];
+  EXPECT_TRUE(std::isnan(h({1.0, std::numeric_limits<fncas::double_t>::infinity()})));
+  EXPECT_TRUE(std::isnan(h({1.0, std::numeric_limits<fncas::double_t>::quiet_NaN()})));
+}
+
+TEST(FnCAS, SimplificationShrinksGradients) {
+  fncas::variables_vector_t x(4);
+  const fncas::function_t<fncas::JIT::Blueprint> fi = AllMathFunctions(x) * fncas::sqr(x[3] - 1);
+  const fncas::gradient_t<fncas::JIT::Blueprint> gi(x, fi);
+  const fncas::impl::NodeStatistics stats = fncas::impl::node_statistics();
+  EXPECT_LT(stats.nodes, stats.nodes_requested);
+  const std::vector<fncas::double_t> p({0.5, -0.25, 0.75, 3.0});
+  const std::vector<fncas::double_t> g = gi(p);
+  const std::vector<fncas::double_t> g_approximate =
+      fncas::impl::approximate_gradient([](const std::vector<fncas::double_t>& x) {
+        return AllMathFunctions(x) * fncas::sqr(x[3] - 1);
+      }, p);
+  ASSERT_EQ(4u, g.size());
+  for (size_t i = 0; i < 4u; ++i) {
+    EXPECT_NEAR(g_approximate[i], g[i], 1e-5);
+  }
+}
+
+// Functions that do not refer to the thread-local expression graph can be evaluated from many threads at once.
+template <fncas::JIT JIT>
+void RunSharedEvaluationTest() {
+  std::unique_ptr<const fncas::function_t<JIT>> f;
+  std::unique_ptr<const fncas::gradient_t<JIT>> g;
+  {
+    fncas::variables_vector_t x(3);
+    const fncas::function_t<fncas::JIT::Blueprint> fi = AllMathFunctions(x);
+    const fncas::gradient_t<fncas::JIT::Blueprint> gi(x, fi);
+    f.reset(new fncas::function_t<JIT>(fi));
+    g.reset(new fncas::gradient_t<JIT>(fi, gi));
+    ASSERT_TRUE(f->supports_concurrent_evaluation());
+    ASSERT_TRUE(g->supports_concurrent_evaluation());
+    // The blueprint itself can only be evaluated in this thread, via the thread-local storage.
+    std::vector<fncas::double_t> heap(100);
+    std::vector<fncas::double_t> gradient(3);
+    const std::vector<fncas::double_t> p({0.5, 0.5, 0.5});
+    EXPECT_FALSE(fi.supports_concurrent_evaluation());
+    EXPECT_THROW(fi.evaluate(p.data(), heap.data()), fncas::exceptions::FnCASSharedEvaluationNotSupportedException);
+    EXPECT_THROW(gi.evaluate(p.data(), heap.data(), gradient.data()),
+                 fncas::exceptions::FnCASSharedEvaluationNotSupportedException);
+  }
+
+  const auto point = [](size_t thread, size_t i) {
+    return std::vector<fncas::double_t>({std::sin(thread + i * 0.01), std::cos(i * 0.02), (i % 5) * 0.2});
+  };
+  std::vector<std::thread> threads;
+  std::vector<size_t> mismatches(8u);
+  for (size_t t = 0; t < mismatches.size(); ++t) {
+    threads.emplace_back([&, t]() {
+      std::vector<fncas::double_t> heap(std::max(f->heap_size(), g->heap_size()));
+      std::vector<fncas::double_t> gradient(3u);
+      for (size_t i = 0; i < 1000u; ++i) {
+        const std::vector<fncas::double_t> p = point(t, i);
+        const fncas::double_t expected = AllMathFunctions(p);
+        if (std::abs(f->evaluate(p.data(), heap.data()) - expected) > 1e-9 ||
+            std::abs(g->evaluate(p.data(), heap.data(), gradient.data()) - expected) > 1e-9) {
+          ++mismatches[t];
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(std::vector<size_t>(8u, 0u), mismatches);
+
+  // The same gradient, via the thread-local heap.
+  std::vector<fncas::double_t> heap(g->heap_size());
+  std::vector<fncas::double_t> gradient(3u);
+  const std::vector<fncas::double_t> p = point(1u, 2u);
+  g->evaluate(p.data(), heap.data(), gradient.data());
+  EXPECT_EQ((*g)(p), gradient);
+}
+
+TEST(FnCAS, SharedEvaluationOfTape) { RunSharedEvaluationTest<fncas::JIT::Tape>(); }
+
+#ifdef FNCAS_JIT_COMPILED
+TEST(FnCAS, SharedEvaluationOfX64) { RunSharedEvaluationTest<fncas::JIT::X64>(); }
+TEST(FnCAS, SharedEvaluationOfAS) { RunSharedEvaluationTest<fncas::JIT::AS>(); }
+#endif  // FNCAS_JIT_COMPILED
+
+TEST(FnCAS, PointsEvaluatorReusesItsThreadsAcrossBatches) {
+  fncas::variables_vector_t x(2);
+  const fncas::function_t<fncas::JIT::Tape> f(fncas::function_t<fncas::JIT::Blueprint>(SimpleFunction(x)));
+  fncas::optimize::PointsEvaluator<fncas::function_t<fncas::JIT::Tape>> evaluate(f, true);
+  for (size_t batch = 0; batch < 100; ++batch) {
+    std::vector<std::vector<fncas::double_t>> points;
+    for (size_t i = 0; i < 1u + batch % 4u; ++i) {
+      points.push_back({static_cast<fncas::double_t>(batch), static_cast<fncas::double_t>(i)});
+    }
+    const std::vector<fncas::double_t> values = evaluate(points);
+    ASSERT_EQ(points.size(), values.size());
+    for (size_t i = 0; i < points.size(); ++i) {
+      EXPECT_EQ(f(points[i]), values[i]);
+    }
+  }
+}
+
+TEST(FnCAS, TapeOutlivesTheVariablesVector) {
+  std::unique_ptr<fncas::function_t<fncas::JIT::Tape>> f;
+  {
+    fncas::variables_vector_t x(2);
+    f = std::unique_ptr<fncas::function_t<fncas::JIT::Tape>>(
+        new fncas::function_t<fncas::JIT::Tape>(fncas::function_t<fncas::JIT::Blueprint>(SimpleFunction(x))));
+  }
+  // The tape does not refer to the nodes, so other functions can be recorded and evaluated in the meantime.
+  fncas::variables_vector_t y(2);
+  const fncas::function_t<fncas::JIT::Blueprint> other = ParametrizedFunction(y, 3u);
+  EXPECT_EQ(49, other({1.0, 2.0}));
+  EXPECT_EQ(25, (*f)({1.0, 2.0}));
+  EXPECT_EQ(2u, f->dim());
+}
+
 TEST(FnCAS, GradientsWrapper) {
   std::vector<fncas::double_t> p_3_3({3.0, 3.0});
 
@@ -198,6 +480,58 @@ TEST(FnCAS, GradientsWrapper) {
   EXPECT_EQ(36, d_3_3_intermediate[1]);
 }
 
+TEST(FnCAS, ReverseModeGradientMatchesForwardMode) {
+  fncas::variables_vector_t x(3);
+  const fncas::function_t<fncas::JIT::Blueprint> fi = AllMathFunctions(x);
+  const fncas::gradient_t<fncas::JIT::Blueprint> gi(x, fi);
+  fncas::term_vector_t forward(3u);
+  for (size_t i = 0; i < 3u; ++i) {
+    forward[i] = fi.differentiate(x, i);
+  }
+  for (double a = -2.0; a <= 2.0; a += 0.5) {
+    for (double b = -1.5; b <= 1.5; b += 0.75) {
+      const std::vector<fncas::double_t> p({a, b, 0.25});
+      const std::vector<fncas::double_t> g = gi(p);
+      const std::vector<fncas::double_t> g_approximate = fncas::impl::approximate_gradient(AllMathFunctions<fncas::double_t>, p);
+      ASSERT_EQ(3u, g.size());
+      for (size_t i = 0; i < 3u; ++i) {
+        EXPECT_NEAR(forward[i](p), g[i], 1e-9);
+        if (std::abs(a - b) > 1e-3) {
+          // The derivative of `ramp(x[0] - x[1])` is not continuous at `x[0] == x[1]`.
+          EXPECT_NEAR(g_approximate[i], g[i], 1e-5);
+        }
+      }
+    }
+  }
+}
+
+TEST(FnCAS, ReverseModeGradientSizeDoesNotDependOnDimensionality) {
+  const size_t dim = 10000u;
+  fncas::variables_vector_t x(dim);
+  fncas::term_t f = 0.0;
+  for (size_t i = 0; i < dim; ++i) {
+    f += fncas::sqr(x[i] - static_cast<fncas::double_t>(i)) * x[(i + 1) % dim];
+  }
+  const fncas::function_t<fncas::JIT::Blueprint> fi = f;
+  const size_t f_nodes = fncas::impl::node_vector_singleton().size();
+  const fncas::gradient_t<fncas::JIT::Blueprint> gi(x, fi);
+  EXPECT_LT(fncas::impl::node_vector_singleton().size(), f_nodes * 5u);
+
+  std::vector<fncas::double_t> p(dim);
+  for (size_t i = 0; i < dim; ++i) {
+    p[i] = static_cast<fncas::double_t>(i) + 1.0;
+  }
+  const std::vector<fncas::double_t> g = gi(p);
+  ASSERT_EQ(dim, g.size());
+  for (size_t i = 0; i < dim; ++i) {
+    // d/dx[i] of `sqr(x[i] - i) * x[i + 1] + sqr(x[i - 1] - (i - 1)) * x[i]`, with `x[i] == i + 1`.
+    const size_t next = (i + 1) % dim;
+    const size_t prev = (i + dim - 1) % dim;
+    const fncas::double_t expected = 2.0 * p[next] + fncas::sqr(p[prev] - static_cast<fncas::double_t>(prev));
+    EXPECT_EQ(expected, g[i]) << i;
+  }
+}
+
 #ifdef FNCAS_JIT_COMPILED
 TEST(FnCAS, CompiledGradientsWrapper) {
   std::vector<fncas::double_t> p_3_3({3.0, 3.0});
@@ -320,6 +654,22 @@ struct RosenbrockFunction {
   }
 };
 
+struct NegatedRosenbrockFunction {
+  template <typename T>
+  T ObjectiveFunction(const std::vector<T>& x) const {
+    return -RosenbrockFunction().ObjectiveFunction(x);
+  }
+};
+
+// Two local minima of different depth: the global one near x = -1, the local one near x = +1.
+struct TwoWellsFunction {
+  template <typename T>
+  T ObjectiveFunction(const std::vector<T>& x) const {
+    const auto d = (x[0] * x[0] - 1);
+    return (d * d + 0.3 * x[0]);
+  }
+};
+
 // http://en.wikipedia.org/wiki/Himmelblau%27s_function
 // Non-convex function with four local minima:
 // f(3.0, 2.0) = 0.0
@@ -344,6 +694,20 @@ TEST(FnCAS, OptimizationOfAStaticFunctionWithJIT) {
   EXPECT_NEAR(4.0, result.point[1], 1e-3);
 }
 
+TEST(FnCAS, OptimizationOfAStaticFunctionWithParallelLineSearch) {
+  const auto sequential = fncas::optimize::GradientDescentOptimizer<StaticFunction>().Optimize({0, 0});
+  const auto parallel = fncas::optimize::GradientDescentOptimizer<StaticFunction>(
+                            fncas::optimize::OptimizerParameters().EnableParallelLineSearch()).Optimize({0, 0});
+  EXPECT_EQ(sequential.optimization_iterations, parallel.optimization_iterations);
+  EXPECT_EQ(sequential.value, parallel.value);
+  EXPECT_EQ(sequential.point, parallel.point);
+  const auto tape = fncas::optimize::GradientDescentOptimizer<StaticFunction,
+                                                              fncas::OptimizationDirection::Minimize,
+                                                              fncas::JIT::Tape>(
+                        fncas::optimize::OptimizerParameters().EnableParallelLineSearch()).Optimize({0, 0});
+  EXPECT_EQ(sequential.value, tape.value);
+}
+
 TEST(FnCAS, OptimizationOfAMemberFunctionWithJIT) {
   MemberFunction f;
   f.a = 2.0;
@@ -517,6 +881,43 @@ TEST(FnCAS, OptimizationOfRosenbrockUsingConjugateGradientWithJIT) {
   EXPECT_NEAR(1.0, result.point[1], 1e-6);
 }
 
+TEST(FnCAS, OptimizationOfRosenbrockUsingConjugateGradientWithTape) {
+  const auto result =
+      fncas::optimize::ConjugateGradientOptimizer<RosenbrockFunction,
+                                                  fncas::OptimizationDirection::Minimize,
+                                                  fncas::JIT::Tape>().Optimize({-3.0, -4.0});
+  EXPECT_NEAR(0.0, result.value, 1e-6);
+  ASSERT_EQ(2u, result.point.size());
+  EXPECT_NEAR(1.0, result.point[0], 1e-6);
+  EXPECT_NEAR(1.0, result.point[1], 1e-6);
+}
+
+TEST(FnCAS, OptimizationOfRosenbrockUsingLBFGSWithJIT) {
+  const auto result = fncas::optimize::LBFGSOptimizer<RosenbrockFunction>().Optimize({-3.0, -4.0});
+  EXPECT_NEAR(0.0, result.value, 1e-6);
+  ASSERT_EQ(2u, result.point.size());
+  EXPECT_NEAR(1.0, result.point[0], 1e-6);
+  EXPECT_NEAR(1.0, result.point[1], 1e-6);
+}
+
+TEST(FnCAS, MaximizationUsingLBFGSWithJIT) {
+  const auto result =
+      fncas::optimize::LBFGSOptimizer<NegatedRosenbrockFunction, fncas::OptimizationDirection::Maximize>().Optimize(
+          {-3.0, -4.0});
+  EXPECT_NEAR(0.0, result.value, 1e-6);
+  ASSERT_EQ(2u, result.point.size());
+  EXPECT_NEAR(1.0, result.point[0], 1e-6);
+  EXPECT_NEAR(1.0, result.point[1], 1e-6);
+}
+
+TEST(FnCAS, MultiStartOptimizationOfTwoWellsWithJIT) {
+  const fncas::optimize::LBFGSOptimizer<TwoWellsFunction> optimizer;
+  const auto result = fncas::optimize::MultiStartOptimize(optimizer, {{2.0}, {0.5}, {-2.0}, {3.0}, {1.0}}, 3u);
+  ASSERT_EQ(1u, result.point.size());
+  EXPECT_NEAR(-1.0, result.point[0], 0.1);
+  EXPECT_LT(result.value, optimizer.Optimize({2.0}).value);
+}
+
 TEST(FnCAS, OptimizationOfHimmelblauUsingConjugateGradientWithJIT) {
   fncas::optimize::ConjugateGradientOptimizer<HimmelblauFunction> optimizer;
 
@@ -661,6 +1062,60 @@ TEST(FnCAS, ConjugateGDvsBacktrackingGDOnRosenbrockFunction100StepsNoJIT) {
   EXPECT_NEAR(1.0, result_cg.point[1], 1e-6);
 }
 
+TEST(FnCAS, OptimizationOfHimmelblauUsingLBFGSNoJIT) {
+  fncas::optimize::LBFGSOptimizer<HimmelblauFunction> optimizer(fncas::optimize::OptimizerParameters().DisableJIT());
+
+  const auto min1 = optimizer.Optimize({5.0, 5.0});
+  EXPECT_NEAR(0.0, min1.value, 1e-6);
+  ASSERT_EQ(2u, min1.point.size());
+  EXPECT_NEAR(3.0, min1.point[0], 1e-6);
+  EXPECT_NEAR(2.0, min1.point[1], 1e-6);
+
+  const auto min3 = optimizer.Optimize({-5.0, -5.0});
+  EXPECT_NEAR(0.0, min3.value, 1e-6);
+  ASSERT_EQ(2u, min3.point.size());
+  EXPECT_NEAR(-3.779310, min3.point[0], 1e-6);
+  EXPECT_NEAR(-3.283186, min3.point[1], 1e-6);
+}
+
+// Check that L-BFGS converges on Rosenbrock function in fewer iterations than conjugate gradient.
+TEST(FnCAS, LBFGSvsConjugateGDOnRosenbrockFunctionNoJIT) {
+  fncas::optimize::OptimizerParameters params;
+  params.DisableJIT();
+  const auto result_cg = fncas::optimize::ConjugateGradientOptimizer<RosenbrockFunction>(params).Optimize({-3.0, -4.0});
+  const auto result_lbfgs = fncas::optimize::LBFGSOptimizer<RosenbrockFunction>(params).Optimize({-3.0, -4.0});
+  EXPECT_NEAR(1.0, result_lbfgs.point[0], 1e-6);
+  EXPECT_NEAR(1.0, result_lbfgs.point[1], 1e-6);
+  EXPECT_LT(result_lbfgs.optimization_iterations, result_cg.optimization_iterations);
+}
+
+TEST(FnCAS, MultiStartOptimizationNoJIT) {
+  const fncas::optimize::LBFGSOptimizer<TwoWellsFunction> optimizer(
+      fncas::optimize::OptimizerParameters().DisableJIT());
+  const auto result = fncas::optimize::MultiStartOptimize(optimizer, {{2.0}, {3.0}, {-0.5}});
+  ASSERT_EQ(1u, result.point.size());
+  EXPECT_NEAR(-1.0, result.point[0], 0.1);
+
+  // The very same result with a single thread.
+  const auto sequential = fncas::optimize::MultiStartOptimize(optimizer, {{2.0}, {3.0}, {-0.5}}, 1u);
+  EXPECT_EQ(result.value, sequential.value);
+  EXPECT_EQ(result.point, sequential.point);
+}
+
+TEST(FnCAS, MultiStartOptimizationRethrowsUnexpectedExceptions) {
+  struct UnexpectedException : std::exception {};
+  const fncas::optimize::LBFGSOptimizer<TwoWellsFunction> optimizer(
+      fncas::optimize::OptimizerParameters().DisableJIT().SetStoppingCriterion(
+          [](size_t, const fncas::ValueAndPoint& value_and_point, const std::vector<fncas::double_t>&) {
+            if (value_and_point.point[0] < 0) {
+              throw UnexpectedException();
+            }
+            return fncas::optimize::EarlyStoppingCriterion::ContinueOptimization;
+          }));
+  EXPECT_THROW(fncas::optimize::MultiStartOptimize(optimizer, {{2.0}, {3.0}, {-0.5}}, 3u), UnexpectedException);
+  EXPECT_THROW(fncas::optimize::MultiStartOptimize(optimizer, {{2.0}, {3.0}, {-0.5}}, 1u), UnexpectedException);
+}
+
 // To test evaluation and differentiation.
 template <typename T>
 T ZeroOrXFunction(const std::vector<T> x) {
@@ -0,0 +1,235 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2016 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+
+// `KeepalivesAggregator` maintains, as keepalives arrive, the index of the most recent keepalive of each codename
+// per time bucket in the stream of keepalives, and the full most recent keepalive of each codename.
+// The fleet status over any time window within the retention period is then assembled from these buckets,
+// in O(codenames * log(buckets)), instead of replaying and re-parsing the stream of keepalives over that window.
+// Only the keepalives which are not the most recent ones of their codenames are read back from the stream, by index.
+
+#ifndef KARL_AGGREGATOR_H
+#define KARL_AGGREGATOR_H
+
+#include "../port.h"
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "schema_claire.h"
+
+#include "../Blocks/SS/idx_ts.h"
+#include "../TypeSystem/optional.h"
+
+namespace current {
+namespace karl {
+
+template <typename CLAIRE_STATUS>
+class KeepalivesAggregator final {
+ public:
+  struct AggregatedKeepalive {
+    std::chrono::microseconds timestamp;
+    ClaireServiceKey location;
+    CLAIRE_STATUS keepalive;  // With `build` dropped, as the status page takes it from the storage.
+  };
+
+  struct LastKeepalives {
+    // The last keepalive of each codename within the window, ordered by timestamp.
+    std::vector<AggregatedKeepalive> keepalives;
+    // If not zero, the keepalives in `[rescan_from, to]` should be replayed from the stream on top of `keepalives`.
+    // Only happens for the windows ending before the most recent keepalive, in the middle of a bucket.
+    std::chrono::microseconds rescan_from = std::chrono::microseconds(0);
+  };
+
+  // `covered_from` is the timestamp from which the keepalives are going to be added, i.e. from which the stream
+  // is replayed into this aggregator upon startup.
+  KeepalivesAggregator(std::chrono::microseconds bucket,
+                       std::chrono::microseconds retention,
+                       std::chrono::microseconds covered_from)
+      : bucket_(std::max(bucket, std::chrono::microseconds(1))),
+        retention_(retention),
+        covered_from_(covered_from),
+        last_eviction_(covered_from) {}
+
+  // Replays the keepalives of the retention period from the stream persister, upon startup.
+  template <class PERSISTER>
+  KeepalivesAggregator(std::chrono::microseconds bucket,
+                       std::chrono::microseconds retention,
+                       std::chrono::microseconds now,
+                       const PERSISTER& persister)
+      : KeepalivesAggregator(bucket, retention, now - retention) {
+    if (!persister.Empty()) {
+      for (const auto& e : persister.Iterate(covered_from_, std::chrono::microseconds(0))) {
+        Add(e.idx_ts, e.entry.location, e.entry.keepalive);
+      }
+    }
+  }
+
+  // Keepalives must be added in the order of their timestamps, the order in which they are published into the stream.
+  // `idx_ts` is where the keepalive is in the stream, from which it is read back if a window requires it.
+  void Add(idxts_t idx_ts, const ClaireServiceKey& location, const CLAIRE_STATUS& keepalive) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    PerCodename& per_codename = keepalives_[keepalive.codename];
+    if (per_codename.buckets.empty() || BucketOf(per_codename.buckets.back().timestamp) != BucketOf(idx_ts.us)) {
+      per_codename.buckets.emplace_back();
+    }
+    Bucket& placeholder = per_codename.buckets.back();
+    placeholder.timestamp = idx_ts.us;
+    placeholder.index = idx_ts.index;
+    per_codename.last.timestamp = idx_ts.us;
+    per_codename.last.location = location;
+    per_codename.last.keepalive = keepalive;
+    per_codename.last.keepalive.build = nullptr;
+    if (idx_ts.us - last_eviction_ >= bucket_) {
+      EvictExpired(idx_ts.us);
+    }
+  }
+
+  // Returns the last keepalive of each codename over `[from, to]`, or `nullptr` if the window starts before
+  // the retention period or is invalid, in which case the stream should be replayed. The keepalives
+  // which are not the most recent ones of their codenames are read from `persister`, the stream of keepalives.
+  template <class PERSISTER>
+  Optional<LastKeepalives> LastKeepalivesInRange(std::chrono::microseconds from,
+                                                 std::chrono::microseconds to,
+                                                 const PERSISTER& persister) const {
+    LastKeepalives result;
+    std::vector<uint64_t> indexes_to_read;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (from < covered_from_ || to < from) {
+        return nullptr;
+      }
+      for (const auto& per_codename : keepalives_) {
+        const std::deque<Bucket>& buckets = per_codename.second.buckets;
+        auto it = std::upper_bound(
+            buckets.begin(), buckets.end(), to, [](std::chrono::microseconds t, const Bucket& e) {
+              return t < e.timestamp;
+            });
+        if (it != buckets.end() && BucketOf(it->timestamp) == BucketOf(to)) {
+          // The last keepalive of the bucket containing `to` is past `to`, while the earlier ones from this bucket,
+          // which are not retained, may fall into the window.
+          result.rescan_from = std::max(from, BucketOf(to) * bucket_);
+        }
+        if (it != buckets.begin()) {
+          --it;
+          if (it->timestamp >= from) {
+            if (it->timestamp == per_codename.second.last.timestamp) {
+              result.keepalives.push_back(per_codename.second.last);
+            } else {
+              indexes_to_read.push_back(it->index);
+            }
+          }
+        }
+      }
+    }
+    // Read the older keepalives from the stream with the mutex unlocked, not to block the publishing thread.
+    for (uint64_t index : indexes_to_read) {
+      for (const auto& e : persister.Iterate(index, index + 1u)) {
+        AggregatedKeepalive keepalive;
+        keepalive.timestamp = e.idx_ts.us;
+        keepalive.location = e.entry.location;
+        keepalive.keepalive = e.entry.keepalive;
+        keepalive.keepalive.build = nullptr;
+        result.keepalives.push_back(std::move(keepalive));
+      }
+    }
+    if (result.rescan_from.count()) {
+      // The keepalives from the rescanned range will be replayed from the stream.
+      result.keepalives.erase(std::remove_if(result.keepalives.begin(),
+                                             result.keepalives.end(),
+                                             [&result](const AggregatedKeepalive& e) {
+                                               return e.timestamp >= result.rescan_from;
+                                             }),
+                              result.keepalives.end());
+    }
+    std::sort(result.keepalives.begin(),
+              result.keepalives.end(),
+              [](const AggregatedKeepalive& lhs, const AggregatedKeepalive& rhs) {
+                return lhs.timestamp < rhs.timestamp;
+              });
+    return result;
+  }
+
+  // The number of retained per-codename buckets, for the status page and for the tests.
+  size_t BucketsCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t result = 0u;
+    for (const auto& per_codename : keepalives_) {
+      result += per_codename.second.buckets.size();
+    }
+    return result;
+  }
+
+ private:
+  // The last keepalive of the codename within the bucket, as its timestamp and its index in the stream.
+  struct Bucket {
+    std::chrono::microseconds timestamp;
+    uint64_t index;
+  };
+
+  struct PerCodename {
+    // The buckets this codename has reported in, in the order of time.
+    std::deque<Bucket> buckets;
+    // The most recent keepalive of this codename, which is what the fleet view up to now is built from.
+    AggregatedKeepalive last;
+  };
+
+  int64_t BucketOf(std::chrono::microseconds timestamp) const { return timestamp.count() / bucket_.count(); }
+
+  void EvictExpired(std::chrono::microseconds now) {
+    last_eviction_ = now;
+    if (now - retention_ <= covered_from_) {
+      return;
+    }
+    covered_from_ = now - retention_;
+    for (auto it = keepalives_.begin(); it != keepalives_.end();) {
+      std::deque<Bucket>& buckets = it->second.buckets;
+      while (!buckets.empty() && buckets.front().timestamp < covered_from_) {
+        buckets.pop_front();
+      }
+      if (buckets.empty()) {
+        it = keepalives_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  const std::chrono::microseconds bucket_;
+  const std::chrono::microseconds retention_;
+  mutable std::mutex mutex_;
+  // The windows starting at or after this timestamp can be served from the aggregated buckets.
+  std::chrono::microseconds covered_from_;
+  std::chrono::microseconds last_eviction_;
+  // codename -> the buckets it has reported in, and its most recent keepalive.
+  std::unordered_map<std::string, PerCodename> keepalives_;
+};
+
+}  // namespace current::karl
+}  // namespace current
+
+#endif  // KARL_AGGREGATOR_H
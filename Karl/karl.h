@@ -27,8 +27,11 @@ SOFTWARE.
 // Karl's storage model contains of the following pieces:
 //
 // 1) The Sherlock `Stream` of all keepalives received. Persisted on disk, not stored in memory.
-//    Each "visualize production" request (be it JSON or SVG response) replays that stream over the desired
-//    period of time. Most commonly it's the past five minutes.
+//    The index of the most recent keepalive of each service per time bucket (a minute by default) over the retention
+//    period (a day by default), along with the full most recent keepalive of each service, is also kept in memory,
+//    in the `KeepalivesAggregator`, so that each "visualize production" request (be it JSON or SVG response)
+//    is served without replaying the stream. Only the requests for the periods of time starting before
+//    the retention period replay the stream.
 //
 // 2) The `Storage`, over a separate stream, to retain the information which may be required outside the
 //    "visualized" time window. Includes Karl's launch history, and per-service codename -> build::BuildInfo.
@@ -52,6 +55,7 @@ SOFTWARE.
 #include "current_build.h.mock"
 #endif
 
+#include "aggregator.h"
 #include "exceptions.h"
 #include "schema_karl.h"
 #include "schema_claire.h"
@@ -216,6 +220,7 @@ class GenericKarl final : private KarlStorage<STORAGE_TYPE>,
   using karl_status_t = GenericKarlStatus<runtime_status_variant_t>;
   using persisted_keepalive_t = KarlPersistedKeepalive<claire_status_t>;
   using stream_t = sherlock::Stream<persisted_keepalive_t, current::persistence::File>;
+  using aggregator_t = KeepalivesAggregator<claire_status_t>;
   using storage_t = typename KarlStorage<STORAGE_TYPE>::storage_t;
   using karl_notifiable_t = IKarlNotifiable<runtime_status_variant_t>;
   using fleet_view_renderer_t = IKarlFleetViewRenderer<runtime_status_variant_t>;
@@ -254,6 +259,25 @@ class GenericKarl final : private KarlStorage<STORAGE_TYPE>,
   using karl_nginx_manager_t::nginx_parameters_;
 
   struct PrivateConstructorSelector {};
+
+  // A keepalive accepted by `AcceptKeepaliveViaHTTP`, to be persisted by `KeepalivesPersistenceThread`.
+  struct PendingKeepalive {
+    Request request;
+    std::chrono::microseconds now;
+    ClaireServiceKey location;
+    claire_status_t status;
+    Optional<std::chrono::microseconds> behind_this_by;
+    PendingKeepalive(Request&& request,
+                     std::chrono::microseconds now,
+                     const ClaireServiceKey& location,
+                     claire_status_t&& status,
+                     const Optional<std::chrono::microseconds>& behind_this_by)
+        : request(std::move(request)),
+          now(now),
+          location(location),
+          status(std::move(status)),
+          behind_this_by(behind_this_by) {}
+  };
   template <typename T>
   GenericKarl(T& storage_or_file,
               const KarlParameters& parameters,
@@ -271,12 +295,17 @@ class GenericKarl final : private KarlStorage<STORAGE_TYPE>,
         notifiable_ref_(notifiable),
         fleet_view_renderer_ref_(renderer),
         keepalives_stream_(parameters_.stream_persistence_file),
+        keepalives_aggregator_(parameters_.status_aggregation_bucket,
+                               parameters_.status_aggregation_retention,
+                               current::time::Now(),
+                               keepalives_stream_.Persister()),
         state_update_thread_running_(false),
         state_update_thread_force_wakeup_(false),
         state_update_thread_([this]() {
           state_update_thread_running_ = true;
           StateUpdateThread();
         }),
+        keepalives_persistence_thread_([this]() { KeepalivesPersistenceThread(); }),
         http_scope_(HTTP(parameters_.keepalives_port)
                         .Register(parameters_.keepalives_url,
                                   URLPathArgs::CountMask::None | URLPathArgs::CountMask::One,
@@ -334,7 +363,14 @@ class GenericKarl final : private KarlStorage<STORAGE_TYPE>,
 
  public:
   ~GenericKarl() {
+    // Stop accepting keepalives first, so that every keepalive accepted is persisted by the final drain below.
+    http_scope_ = nullptr;
     destructing_ = true;
+    {
+      std::lock_guard<std::mutex> lock(pending_keepalives_mutex_);
+      pending_keepalives_condition_variable_.notify_one();
+    }
+    keepalives_persistence_thread_.join();
     storage_.ReadWriteTransaction([this](MutableFields<storage_t> fields) {
       KarlInfo self_info;
       self_info.up = false;
@@ -358,6 +394,10 @@ class GenericKarl final : private KarlStorage<STORAGE_TYPE>,
     return services_keepalive_time_cache_.size();
   }
 
+  // The number of keepalives accepted, and the number of batches they have been persisted in.
+  size_t AcceptedKeepalivesCount() const { return accepted_keepalives_; }
+  size_t PersistedKeepalivesBatchesCount() const { return persisted_keepalives_batches_; }
+
   std::set<std::string> LocalIPs() const {
     std::lock_guard<std::mutex> lock(local_ips_mutex_);
     return local_ips_;
@@ -492,7 +532,33 @@ class GenericKarl final : private KarlStorage<STORAGE_TYPE>,
           }
         }();
 
-        const auto parsed_status = ParseJSON<ClaireStatus>(json);
+        // Parse the keepalive in a single pass, along with its "runtime" variant. Only if the variant can not be
+        // parsed, for instance, as its type is unknown to this Karl, fall back to parsing the top-level status alone.
+        claire_status_t parsed_status = [&]() -> claire_status_t {
+          Optional<claire_status_t> parsed_opt = TryParseJSON<claire_status_t>(json);
+          if (!Exists(parsed_opt)) {  // Can't parse in Current format. Trying `Minimalistic`.
+            parsed_opt = TryParseJSON<claire_status_t, JSONFormat::Minimalistic>(json);
+          }
+          if (Exists(parsed_opt)) {
+            return std::move(Value(parsed_opt));
+          } else {
+            // Throws `TypeSystemParseJSONException` if even the top-level status can not be parsed.
+            const auto top_level_status = ParseJSON<ClaireStatus>(json);
+
+#ifdef EXTRA_KARL_LOGGING
+            std::cerr << "Could not parse: " << json << '\n';
+            reflection::StructSchema struct_schema;
+            struct_schema.AddType<claire_status_t>();
+            std::cerr << "As:\n" << struct_schema.GetSchemaInfo().Describe<reflection::Language::Current>() << '\n';
+#endif
+
+            claire_status_t status;
+            // Initialize `ClaireStatus` from `ClaireServiceStatus`, keep the `Variant<...> runtime` empty.
+            static_cast<ClaireStatus&>(status) = top_level_status;
+            return status;
+          }
+        }();
+
         if ((!qs.has("codename") || parsed_status.codename == qs["codename"]) &&
             (!qs.has("port") || parsed_status.local_port == current::FromString<uint16_t>(qs["port"]))) {
           ClaireServiceKey location;
@@ -500,162 +566,29 @@ class GenericKarl final : private KarlStorage<STORAGE_TYPE>,
           location.port = parsed_status.local_port;
           location.prefix = "/";  // TODO(dkorolev) + TODO(mzhurovich): Add support for `qs["prefix"]`.
 
-          // If the received status can be parsed in detail, including the "runtime" variant, persist it.
-          // If no, no big deal, keep the top-level one regardless.
-          const auto detailed_parsed_status = [&]() -> claire_status_t {
-            Optional<claire_status_t> parsed_opt = TryParseJSON<claire_status_t>(json);
-            if (!Exists(parsed_opt)) {  // Can't parse in Current format. Trying `Minimalistic`.
-              parsed_opt = TryParseJSON<claire_status_t, JSONFormat::Minimalistic>(json);
-            }
-            if (Exists(parsed_opt)) {
-              return Value(parsed_opt);
-            } else {
-
-#ifdef EXTRA_KARL_LOGGING
-              std::cerr << "Could not parse: " << json << '\n';
-              reflection::StructSchema struct_schema;
-              struct_schema.AddType<claire_status_t>();
-              std::cerr << "As:\n" << struct_schema.GetSchemaInfo().Describe<reflection::Language::Current>() << '\n';
-#endif
-
-              claire_status_t status;
-              // Initialize `ClaireStatus` from `ClaireServiceStatus`, keep the `Variant<...> runtime` empty.
-              static_cast<ClaireStatus&>(status) = parsed_status;
-              return status;
-            }
-          }();
-
           const auto now = current::time::Now();
 
-          {
-            persisted_keepalive_t record;
-            record.location = location;
-            record.keepalive = detailed_parsed_status;
-            {
-              std::lock_guard<std::mutex> lock(latest_keepalive_index_mutex_);
-              latest_keepalive_index_plus_one_[parsed_status.codename] =
-                  keepalives_stream_.Publish(std::move(record)).index;
-            }
-          }
-
           Optional<std::chrono::microseconds> optional_behind_this_by;
           if (Exists(parsed_status.last_successful_keepalive_ping_us)) {
             optional_behind_this_by =
                 now - parsed_status.now - Value(parsed_status.last_successful_keepalive_ping_us) / 2;
           }
 
-          auto& notifiable_ref = notifiable_ref_;
-          storage_.ReadWriteTransaction(
-                       [this,
-                        now,
-                        location,
-                        &parsed_status,
-                        &detailed_parsed_status,
-                        optional_behind_this_by,
-                        &notifiable_ref](MutableFields<storage_t> fields) -> Response {
-                         // OK to call from within a transaction.
-                         // The call is fast, and `storage_`'s transaction guarantees thread safety. -- D.K.
-                         notifiable_ref.OnKeepalive(now, location, parsed_status.codename, detailed_parsed_status);
-
-                         const auto& service = parsed_status.service;
-                         const auto& codename = parsed_status.codename;
-                         const auto& optional_build = parsed_status.build;
-                         const auto& optional_instance = parsed_status.cloud_instance_name;
-                         const auto& optional_av_group = parsed_status.cloud_availability_group;
-
-                         // Update per-server information in the `DB`.
-                         ServerInfo server;
-                         server.ip = location.ip;
-                         bool need_to_update_server_info = false;
-                         const ImmutableOptional<ServerInfo> current_server_info = fields.servers[location.ip];
-                         if (Exists(current_server_info)) {
-                           server = Value(current_server_info);
-                         }
-                         // Check the instance name.
-                         if (Exists(optional_instance)) {
-                           if (!Exists(server.cloud_instance_name) ||
-                               Value(server.cloud_instance_name) != Value(optional_instance)) {
-                             server.cloud_instance_name = Value(optional_instance);
-                             need_to_update_server_info = true;
-                           }
-                         }
-                         // Check the availability group.
-                         if (Exists(optional_av_group)) {
-                           if (!Exists(server.cloud_availability_group) ||
-                               Value(server.cloud_availability_group) != Value(optional_av_group)) {
-                             server.cloud_availability_group = Value(optional_av_group);
-                             need_to_update_server_info = true;
-                           }
-                         }
-                         // Check the time skew.
-                         if (Exists(optional_behind_this_by)) {
-                           const std::chrono::microseconds behind_this_by = Value(optional_behind_this_by);
-                           const auto time_skew_difference = server.behind_this_by - behind_this_by;
-                           if (static_cast<uint64_t>(std::abs(time_skew_difference.count())) >=
-                               kUpdateServerInfoThresholdByTimeSkewDifference) {
-                             server.behind_this_by = behind_this_by;
-                             need_to_update_server_info = true;
-                           }
-                         }
-                         if (need_to_update_server_info) {
-                           fields.servers.Add(server);
-                         }
-
-                         // Update the `DB` if the build information was not stored there yet.
-                         const ImmutableOptional<ClaireBuildInfo> current_claire_build_info = fields.builds[codename];
-                         if (Exists(optional_build) &&
-                             (!Exists(current_claire_build_info) ||
-                              Value(current_claire_build_info).build != Value(optional_build))) {
-                           ClaireBuildInfo build;
-                           build.codename = codename;
-                           build.build = Value(optional_build);
-                           fields.builds.Add(build);
-                         }
-
-                         // Update the `DB` if "codename", "location", or "dependencies" differ.
-                         const ImmutableOptional<ClaireInfo> current_claire_info = fields.claires[codename];
-                         if ([&]() {
-                               if (!Exists(current_claire_info)) {
-                                 return true;
-                               } else if (Value(current_claire_info).location != location) {
-                                 return true;
-                               } else if (Value(current_claire_info).registered_state !=
-                                          ClaireRegisteredState::Active) {
-                                 return true;
-                               } else {
-                                 return false;
-                               }
-                             }()) {
-                           ClaireInfo claire;
-                           if (Exists(current_claire_info)) {
-                             // Do not overwrite `build` with `null`.
-                             claire = Value(current_claire_info);
-                           }
-
-                           claire.codename = codename;
-                           claire.service = service;
-                           claire.location = location;
-                           claire.reported_timestamp = now;
-                           claire.url_status_page_direct = location.StatusPageURL();
-                           claire.registered_state = ClaireRegisteredState::Active;
-
-                           fields.claires.Add(claire);
-                         }
-                         return Response("OK\n");
-                       },
-                       std::move(r)).Wait();
+          // The keepalive is persisted, and responded to, by `KeepalivesPersistenceThread`, along with the other
+          // keepalives received while the previous batch was being persisted.
           {
-            std::lock_guard<std::mutex> lock(services_keepalive_cache_mutex_);
-            auto& placeholder = services_keepalive_time_cache_[parsed_status.codename];
-            if (placeholder.count() == 0) {
-              placeholder = now;
-              // Wake up state update thread only if the new codename has appeared in the cache.
-              state_update_thread_force_wakeup_ = true;
-              update_thread_condition_variable_.notify_one();
-            } else {
-              placeholder = now;
+            std::lock_guard<std::mutex> lock(pending_keepalives_mutex_);
+            if (destructing_) {
+              // The handler was already running when the route was unregistered, and the final drain
+              // of `KeepalivesPersistenceThread` may be over.
+              r("Karl is shutting down.\n", HTTPResponseCode.ServiceUnavailable);
+              return;
             }
+            pending_keepalives_.emplace_back(
+                std::move(r), now, location, std::move(parsed_status), optional_behind_this_by);
+            ++accepted_keepalives_;
           }
+          pending_keepalives_condition_variable_.notify_one();
         } else {
           r("Inconsistent URL/body parameters.\n", HTTPResponseCode.BadRequest);
         }
@@ -669,6 +602,174 @@ class GenericKarl final : private KarlStorage<STORAGE_TYPE>,
     }
   }
 
+  // Persists the batches of keepalives accumulated by `AcceptKeepaliveViaHTTP`: publishes them into the stream
+  // and applies them to the storage in a single transaction, then responds to each of their requests.
+  void KeepalivesPersistenceThread() {
+    while (true) {
+      std::vector<PendingKeepalive> batch;
+      {
+        std::unique_lock<std::mutex> lock(pending_keepalives_mutex_);
+        pending_keepalives_condition_variable_.wait(
+            lock, [this]() { return destructing_ || !pending_keepalives_.empty(); });
+        if (pending_keepalives_.empty()) {
+          return;
+        }
+        batch.swap(pending_keepalives_);
+      }
+      PersistKeepalives(batch);
+    }
+  }
+
+  void PersistKeepalives(std::vector<PendingKeepalive>& batch) {
+    try {
+      {
+        std::lock_guard<std::mutex> lock(latest_keepalive_index_mutex_);
+        for (const auto& keepalive : batch) {
+          persisted_keepalive_t record;
+          record.location = keepalive.location;
+          record.keepalive = keepalive.status;
+          const idxts_t idx_ts = keepalives_stream_.Publish(std::move(record));
+          latest_keepalive_index_plus_one_[keepalive.status.codename] = idx_ts.index;
+          keepalives_aggregator_.Add(idx_ts, keepalive.location, keepalive.status);
+        }
+      }
+      auto& notifiable_ref = notifiable_ref_;
+      storage_.ReadWriteTransaction([this, &batch, &notifiable_ref](MutableFields<storage_t> fields) -> void {
+        for (const auto& keepalive : batch) {
+          // OK to call from within a transaction.
+          // The call is fast, and `storage_`'s transaction guarantees thread safety. -- D.K.
+          notifiable_ref.OnKeepalive(keepalive.now, keepalive.location, keepalive.status.codename, keepalive.status);
+          UpdateStorageOnKeepalive(fields, keepalive);
+        }
+      }).Wait();
+    } catch (const Exception&) {
+      for (auto& keepalive : batch) {
+        RespondToKeepalive(keepalive, "Karl registration error.\n", HTTPResponseCode.InternalServerError);
+      }
+      return;
+    }
+    ++persisted_keepalives_batches_;
+    for (auto& keepalive : batch) {
+      RespondToKeepalive(keepalive, "OK\n");
+    }
+    {
+      std::lock_guard<std::mutex> lock(services_keepalive_cache_mutex_);
+      for (const auto& keepalive : batch) {
+        auto& placeholder = services_keepalive_time_cache_[keepalive.status.codename];
+        if (placeholder.count() == 0) {
+          // Wake up state update thread only if the new codename has appeared in the cache.
+          state_update_thread_force_wakeup_ = true;
+        }
+        placeholder = keepalive.now;
+      }
+      if (state_update_thread_force_wakeup_) {
+        update_thread_condition_variable_.notify_one();
+      }
+    }
+  }
+
+  // The responses are sent from `KeepalivesPersistenceThread`, and a client which has disconnected by then
+  // must not take it down, nor keep the rest of the batch from being responded to.
+  static void RespondToKeepalive(PendingKeepalive& keepalive,
+                                 const std::string& body,
+                                 net::HTTPResponseCodeValue code = HTTPResponseCode.OK) {
+    try {
+      keepalive.request(body, code);
+    } catch (const Exception&) {
+      // The client is gone, and there is no one to respond to.
+    }
+  }
+
+  void UpdateStorageOnKeepalive(MutableFields<storage_t>& fields, const PendingKeepalive& keepalive) {
+    const auto now = keepalive.now;
+    const auto& location = keepalive.location;
+    const auto& parsed_status = keepalive.status;
+    const auto& optional_behind_this_by = keepalive.behind_this_by;
+    const auto& service = parsed_status.service;
+    const auto& codename = parsed_status.codename;
+    const auto& optional_build = parsed_status.build;
+    const auto& optional_instance = parsed_status.cloud_instance_name;
+    const auto& optional_av_group = parsed_status.cloud_availability_group;
+
+    // Update per-server information in the `DB`.
+    ServerInfo server;
+    server.ip = location.ip;
+    bool need_to_update_server_info = false;
+    const ImmutableOptional<ServerInfo> current_server_info = fields.servers[location.ip];
+    if (Exists(current_server_info)) {
+      server = Value(current_server_info);
+    }
+    // Check the instance name.
+    if (Exists(optional_instance)) {
+      if (!Exists(server.cloud_instance_name) ||
+          Value(server.cloud_instance_name) != Value(optional_instance)) {
+        server.cloud_instance_name = Value(optional_instance);
+        need_to_update_server_info = true;
+      }
+    }
+    // Check the availability group.
+    if (Exists(optional_av_group)) {
+      if (!Exists(server.cloud_availability_group) ||
+          Value(server.cloud_availability_group) != Value(optional_av_group)) {
+        server.cloud_availability_group = Value(optional_av_group);
+        need_to_update_server_info = true;
+      }
+    }
+    // Check the time skew.
+    if (Exists(optional_behind_this_by)) {
+      const std::chrono::microseconds behind_this_by = Value(optional_behind_this_by);
+      const auto time_skew_difference = server.behind_this_by - behind_this_by;
+      if (static_cast<uint64_t>(std::abs(time_skew_difference.count())) >=
+          kUpdateServerInfoThresholdByTimeSkewDifference) {
+        server.behind_this_by = behind_this_by;
+        need_to_update_server_info = true;
+      }
+    }
+    if (need_to_update_server_info) {
+      fields.servers.Add(server);
+    }
+
+    // Update the `DB` if the build information was not stored there yet.
+    const ImmutableOptional<ClaireBuildInfo> current_claire_build_info = fields.builds[codename];
+    if (Exists(optional_build) &&
+        (!Exists(current_claire_build_info) ||
+         Value(current_claire_build_info).build != Value(optional_build))) {
+      ClaireBuildInfo build;
+      build.codename = codename;
+      build.build = Value(optional_build);
+      fields.builds.Add(build);
+    }
+
+    // Update the `DB` if "codename", "location", or "dependencies" differ.
+    const ImmutableOptional<ClaireInfo> current_claire_info = fields.claires[codename];
+    if ([&]() {
+          if (!Exists(current_claire_info)) {
+            return true;
+          } else if (Value(current_claire_info).location != location) {
+            return true;
+          } else if (Value(current_claire_info).registered_state != ClaireRegisteredState::Active) {
+            return true;
+          } else {
+            return false;
+          }
+        }()) {
+      ClaireInfo claire;
+      if (Exists(current_claire_info)) {
+        // Do not overwrite `build` with `null`.
+        claire = Value(current_claire_info);
+      }
+
+      claire.codename = codename;
+      claire.service = service;
+      claire.location = location;
+      claire.reported_timestamp = now;
+      claire.url_status_page_direct = location.StatusPageURL();
+      claire.registered_state = ClaireRegisteredState::Active;
+
+      fields.claires.Add(claire);
+    }
+  }
+
   void ServeFleetStatus(Request r) {
     const auto& qs = r.url.query;
     if (qs.has("schema")) {
@@ -801,35 +902,53 @@ class GenericKarl final : private KarlStorage<STORAGE_TYPE>,
     std::map<std::string, std::set<std::string>> codenames_per_service;
     std::map<ClaireServiceKey, std::string> service_key_into_codename;
 
-    for (const auto& e : keepalives_stream_.Persister().Iterate(from, to)) {
-      const claire_status_t& keepalive = e.entry.keepalive;
-
+    const auto add_keepalive = [&](std::chrono::microseconds timestamp,
+                                   const ClaireServiceKey& location,
+                                   const claire_status_t& keepalive) {
       codenames_to_resolve.insert(keepalive.codename);
-      service_key_into_codename[e.entry.location] = keepalive.codename;
+      service_key_into_codename[location] = keepalive.codename;
 
       codenames_per_service[keepalive.service].insert(keepalive.codename);
       // DIMA: More per-codename reporting fields go here; tailored to specific type, `.Call(populator)`, etc.
       ProtoReport report;
       const std::string last_keepalive =
-          current::strings::TimeIntervalAsHumanReadableString(now - e.idx_ts.us) + " ago";
-      if ((now - e.idx_ts.us) < parameters_.service_timeout_interval) {
+          current::strings::TimeIntervalAsHumanReadableString(now - timestamp) + " ago";
+      if ((now - timestamp) < parameters_.service_timeout_interval) {
         // Service is up.
         const auto projected_uptime_us =
-            (keepalive.now - keepalive.start_time_epoch_microseconds) + (now - e.idx_ts.us);
+            (keepalive.now - keepalive.start_time_epoch_microseconds) + (now - timestamp);
         report.currently =
             current_service_state::up(keepalive.start_time_epoch_microseconds,
                                       last_keepalive,
-                                      e.idx_ts.us,
+                                      timestamp,
                                       current::strings::TimeIntervalAsHumanReadableString(projected_uptime_us));
       } else {
         // Service is down.
         // TODO(dkorolev): Graceful shutdown case for `done`.
         report.currently = current_service_state::down(
-            keepalive.start_time_epoch_microseconds, last_keepalive, e.idx_ts.us, keepalive.uptime);
+            keepalive.start_time_epoch_microseconds, last_keepalive, timestamp, keepalive.uptime);
       }
       report.dependencies = keepalive.dependencies;
       report.runtime = keepalive.runtime;
       report_for_codename[keepalive.codename] = report;
+    };
+
+    // Only the last keepalive of each codename within the window matters, and, unless the window starts before
+    // the retention period, these are readily available from the aggregator, without replaying the stream.
+    const auto aggregated = keepalives_aggregator_.LastKeepalivesInRange(from, to, keepalives_stream_.Persister());
+    if (Exists(aggregated)) {
+      for (const auto& e : Value(aggregated).keepalives) {
+        add_keepalive(e.timestamp, e.location, e.keepalive);
+      }
+      if (Value(aggregated).rescan_from.count()) {
+        for (const auto& e : keepalives_stream_.Persister().Iterate(Value(aggregated).rescan_from, to)) {
+          add_keepalive(e.idx_ts.us, e.entry.location, e.entry.keepalive);
+        }
+      }
+    } else {
+      for (const auto& e : keepalives_stream_.Persister().Iterate(from, to)) {
+        add_keepalive(e.idx_ts.us, e.entry.location, e.entry.keepalive);
+      }
     }
 
     // To list only the services that are currently in `Active` state.
@@ -975,11 +1094,20 @@ class GenericKarl final : private KarlStorage<STORAGE_TYPE>,
   std::unordered_map<std::string, uint64_t> latest_keepalive_index_plus_one_;
 
   stream_t keepalives_stream_;
+  // The most recent keepalives per codename per time bucket, to build the fleet view without replaying the stream.
+  aggregator_t keepalives_aggregator_;
   std::atomic_bool state_update_thread_running_;
   std::atomic_bool state_update_thread_force_wakeup_;
   std::condition_variable update_thread_condition_variable_;
   std::thread state_update_thread_;
-  const HTTPRoutesScope http_scope_;
+  // The keepalives accepted since the last batch was persisted.
+  std::vector<PendingKeepalive> pending_keepalives_;
+  std::mutex pending_keepalives_mutex_;
+  std::condition_variable pending_keepalives_condition_variable_;
+  std::atomic_size_t accepted_keepalives_{0u};
+  std::atomic_size_t persisted_keepalives_batches_{0u};
+  std::thread keepalives_persistence_thread_;
+  HTTPRoutesScope http_scope_;
 };
 
 using Karl = GenericKarl<UseOwnStorage, default_user_status::status>;
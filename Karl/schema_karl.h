@@ -52,6 +52,8 @@ CURRENT_STRUCT(KarlNginxParameters) {
 // Karl's startup parameters.
 constexpr static const char* kDefaultFleetViewURL = "http://localhost:%d";  // Defaults to the nginx port.
 constexpr static std::chrono::microseconds k45Seconds = std::chrono::microseconds(1000ll * 1000ll * 45);
+constexpr static std::chrono::microseconds k1Minute = std::chrono::microseconds(1000ll * 1000ll * 60);
+constexpr static std::chrono::microseconds k24Hours = std::chrono::microseconds(1000ll * 1000ll * 60 * 60 * 24);
 CURRENT_STRUCT(KarlParameters) {
   CURRENT_FIELD(keepalives_port, uint16_t);
   CURRENT_FIELD_DESCRIPTION(keepalives_port, "The port on which keepalives are listened to.");
@@ -81,6 +83,14 @@ CURRENT_STRUCT(KarlParameters) {
   CURRENT_FIELD_DESCRIPTION(service_timeout_interval,
                             "The default period of keepalive-free inactivity, after which a service is "
                             "considered down for fleet browsability purposes.");
+  CURRENT_FIELD(status_aggregation_bucket, std::chrono::microseconds, k1Minute);
+  CURRENT_FIELD_DESCRIPTION(status_aggregation_bucket,
+                            "The time bucket within which only the index of the most recent keepalive of each "
+                            "service is kept in memory to serve the fleet view.");
+  CURRENT_FIELD(status_aggregation_retention, std::chrono::microseconds, k24Hours);
+  CURRENT_FIELD_DESCRIPTION(status_aggregation_retention,
+                            "How far back the fleet view is served from memory; "
+                            "the windows starting earlier are served by replaying the stream of keepalives.");
 
   KarlParameters& SetKeepalivesPort(uint16_t port) {
     keepalives_port = port;
@@ -114,6 +124,11 @@ CURRENT_STRUCT(KarlParameters) {
     nginx_parameters = value;
     return *this;
   }
+  KarlParameters& SetStatusAggregation(std::chrono::microseconds bucket, std::chrono::microseconds retention) {
+    status_aggregation_bucket = bucket;
+    status_aggregation_retention = retention;
+    return *this;
+  }
 };
 
 // Karl's persisted storage schema.
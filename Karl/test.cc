@@ -1178,6 +1178,142 @@ TEST(Karl, CustomStorage) {
   }
 }
 
+TEST(Karl, ConcurrentKeepalivesAreBatched) {
+  current::time::ResetToZero();
+
+  const auto stream_file_remover = current::FileSystem::ScopedRmFile(FLAGS_karl_test_stream_persistence_file);
+  const auto storage_file_remover = current::FileSystem::ScopedRmFile(FLAGS_karl_test_storage_persistence_file);
+  const unittest_karl_t karl(UnittestKarlParameters());
+
+  const size_t kThreads = 8u;
+  const size_t kKeepalivesPerThread = 25u;
+
+  // Hold the storage while the first keepalive from each thread arrives, so that the ones that arrive while
+  // the first batch is being persisted have to be persisted together, in the next batch.
+  std::atomic_bool storage_held(false);
+  std::atomic_bool release_storage(false);
+  std::thread storage_holder([&karl, &storage_held, &release_storage]() {
+    karl.InternalExposeStorage()
+        .ReadOnlyTransaction([&storage_held, &release_storage](ImmutableFields<unittest_karl_t::storage_t>) {
+          storage_held = true;
+          while (!release_storage) {
+            std::this_thread::yield();
+          }
+        })
+        .Go();
+  });
+  while (!storage_held) {
+    std::this_thread::yield();
+  }
+
+  std::atomic_size_t ok_responses(0u);
+  std::vector<std::thread> threads;
+  for (size_t t = 0u; t < kThreads; ++t) {
+    threads.emplace_back([t, &ok_responses]() {
+      for (size_t i = 0u; i < kKeepalivesPerThread; ++i) {
+        unittest_karl_t::claire_status_t claire;
+        claire.service = "unittest";
+        claire.codename = Printf("T%dK%d", static_cast<int>(t), static_cast<int>(i % 5u));
+        claire.local_port = static_cast<uint16_t>(10000u + t * 10u + i % 5u);
+        claire.runtime = unittest_karl_t::runtime_status_variant_t(karl_unittest::is_prime(i));
+        const auto response =
+            HTTP(POST(Printf("http://localhost:%d/?codename=%s&port=%d",
+                             FLAGS_karl_test_keepalives_port,
+                             claire.codename.c_str(),
+                             claire.local_port),
+                      claire));
+        if (static_cast<int>(response.code) == 200 && response.body == "OK\n") {
+          ++ok_responses;
+        }
+      }
+    });
+  }
+  // Each thread waits for its keepalive to be responded to before sending the next one.
+  while (karl.AcceptedKeepalivesCount() != kThreads) {
+    std::this_thread::yield();
+  }
+  release_storage = true;
+  storage_holder.join();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(kThreads * kKeepalivesPerThread, ok_responses);
+  EXPECT_EQ(kThreads * kKeepalivesPerThread, karl.AcceptedKeepalivesCount());
+
+  // The first keepalive from each thread has been persisted in at most two batches.
+  EXPECT_LE(karl.PersistedKeepalivesBatchesCount(), kThreads * kKeepalivesPerThread - (kThreads - 2u));
+
+  // By the time each keepalive is responded to, it is persisted, and the storage is updated.
+  EXPECT_EQ(kThreads * 5u, karl.ActiveServicesCount());
+  EXPECT_EQ(kThreads * 5u,
+            Value(karl.InternalExposeStorage()
+                      .ReadOnlyTransaction([](ImmutableFields<unittest_karl_t::storage_t> fields) -> size_t {
+                        return fields.claires.Size();
+                      })
+                      .Go()));
+
+  unittest_karl_status_t status;
+  ASSERT_NO_THROW(status = ParseJSON<unittest_karl_status_t>(
+                      HTTP(GET(Printf("http://localhost:%d?from=0&full", FLAGS_karl_test_fleet_view_port))).body));
+  ASSERT_EQ(1u, status.machines.size());
+  EXPECT_EQ(kThreads * 5u, status.machines.begin()->second.services.size());
+}
+
+TEST(Karl, KeepalivesAggregator) {
+  using claire_status_t = current::karl::ClaireServiceStatus<Variant<current::karl::default_user_status::status>>;
+  using aggregator_t = current::karl::KeepalivesAggregator<claire_status_t>;
+
+  // The keepalives which are not the most recent ones of their codenames are read back from the stream.
+  current::sherlock::Stream<current::karl::KarlPersistedKeepalive<claire_status_t>, current::persistence::Memory>
+      stream;
+
+  // Buckets of 10us, retained for 1000us.
+  aggregator_t aggregator(
+      std::chrono::microseconds(10), std::chrono::microseconds(1000), std::chrono::microseconds(0));
+  const auto add = [&stream, &aggregator](int64_t t, const std::string& codename) {
+    current::karl::KarlPersistedKeepalive<claire_status_t> record;
+    record.keepalive.service = "service_" + codename;
+    record.keepalive.codename = codename;
+    record.keepalive.uptime = current::ToString(t);
+    record.location.ip = "127.0.0.1";
+    record.location.port = (codename == "A" ? 8001 : 8002);
+    aggregator.Add(stream.Publish(record, std::chrono::microseconds(t)), record.location, record.keepalive);
+  };
+  const auto query = [&stream, &aggregator](int64_t from, int64_t to) -> std::string {
+    const auto result = aggregator.LastKeepalivesInRange(
+        std::chrono::microseconds(from), std::chrono::microseconds(to), stream.Persister());
+    if (!Exists(result)) {
+      return "N/A";
+    }
+    std::string s;
+    for (const auto& e : Value(result).keepalives) {
+      s += e.keepalive.codename + '@' + current::ToString(e.timestamp.count()) + ':' + e.keepalive.uptime + ' ';
+    }
+    return s + "rescan:" + current::ToString(Value(result).rescan_from.count());
+  };
+
+  add(1, "A");
+  add(3, "B");
+  add(5, "A");
+  add(12, "A");
+  add(25, "B");
+  EXPECT_EQ(4u, aggregator.BucketsCount());  // A: { 5, 12 }, B: { 3, 25 }.
+
+  EXPECT_EQ("A@12:12 B@25:25 rescan:0", query(0, 30));
+  EXPECT_EQ("B@25:25 rescan:0", query(13, 30));
+  EXPECT_EQ("B@3:3 A@5:5 rescan:0", query(0, 8));
+  EXPECT_EQ("A@5:5 rescan:0", query(4, 8));
+  // The last keepalive from `B` in the bucket of 20us..29us is past 22us, so that bucket has to be replayed.
+  EXPECT_EQ("B@3:3 A@12:12 rescan:20", query(0, 22));
+  EXPECT_EQ("N/A", query(10, 5));
+
+  // Evicting everything older than the retention period.
+  add(2000, "A");
+  EXPECT_EQ(1u, aggregator.BucketsCount());
+  EXPECT_EQ("N/A", query(0, 3000));
+  EXPECT_EQ("A@2000:2000 rescan:0", query(1500, 3000));
+}
+
 #if 0
 // TODO(dkorolev): This test is incomplete; revisit it some day soon. Thanks for understanding.
 TEST(Karl, Visualization) {
@@ -33,10 +33,43 @@ SOFTWARE.
 #include "../../Bricks/strings/strings.h"
 #include "../../Bricks/time/chrono.h"
 
+#include "../../Sherlock/sherlock.h"
+
 namespace current {
 namespace midichlorians {
 namespace server {
 
+// Passes each log entry to the consumer by calling it with the entry of the specific type.
+template <class LOG_ENTRY_CONSUMER>
+class LogEntryConsumerAdapter {
+ public:
+  explicit LogEntryConsumerAdapter(LOG_ENTRY_CONSUMER& consumer) : consumer_(consumer) {}
+  void operator()(log_entry_variant_t&& entry) { entry.Call(consumer_); }
+
+ private:
+  LOG_ENTRY_CONSUMER& consumer_;
+};
+
+// With a Sherlock stream as the consumer, the log entries are published into it as they are, timestamped by
+// their `server_us`. The timestamps of the stream must increase strictly, so the entries sharing the same
+// `server_us`, or preceding the head the stream had when the server started, are published a microsecond apart
+// past the previous one. The stream should be dedicated to this server.
+template <template <typename> class PERSISTENCE_LAYER>
+class LogEntryConsumerAdapter<current::sherlock::Stream<log_entry_variant_t, PERSISTENCE_LAYER>> {
+ public:
+  explicit LogEntryConsumerAdapter(current::sherlock::Stream<log_entry_variant_t, PERSISTENCE_LAYER>& stream)
+      : stream_(stream), last_published_us_(stream.Persister().CurrentHead()) {}
+  void operator()(log_entry_variant_t&& entry) {
+    const std::chrono::microseconds us =
+        std::max(Value<LogEntryBase>(entry).server_us, last_published_us_ + std::chrono::microseconds(1));
+    last_published_us_ = stream_.Publish(std::move(entry), us).us;
+  }
+
+ private:
+  current::sherlock::Stream<log_entry_variant_t, PERSISTENCE_LAYER>& stream_;
+  std::chrono::microseconds last_published_us_;
+};
+
 template <class LOG_ENTRY_CONSUMER>
 class MidichloriansHTTPServer {
  public:
@@ -190,11 +223,11 @@ class MidichloriansHTTPServer {
 
   template <typename LOG_ENTRY>
   void PassLogEntryToConsumer(LOG_ENTRY&& entry, bool is_valid_entry = true) {
-    log_entry_variant_t entry_variant(std::move(entry));
-    entry_variant.Call(log_entry_consumer_);
+    const std::chrono::microseconds server_us = entry.server_us;
+    log_entry_consumer_(log_entry_variant_t(std::move(entry)));
     if (is_valid_entry) {
       ++events_pushed_;
-      last_event_t_ = Value<LogEntryBase>(entry_variant).server_us;
+      last_event_t_ = server_us;
     }
   }
 
@@ -220,7 +253,7 @@ class MidichloriansHTTPServer {
  private:
   std::mutex mutex_;
   const int http_port_;
-  LOG_ENTRY_CONSUMER& log_entry_consumer_;
+  LogEntryConsumerAdapter<LOG_ENTRY_CONSUMER> log_entry_consumer_;
   const std::string route_;
   const std::string response_text_;
 
@@ -361,4 +361,50 @@ TEST(MidichloriansServer, WebEventsFromCPPSmokeTest) {
       Join(consumer.Events(), ','));
 }
 
+TEST(MidichloriansServer, PublishesIntoStream) {
+  current::time::ResetToZero();
+
+  using namespace midichlorians_server_test;
+  using namespace current::midichlorians::server;
+
+  using stream_t = current::sherlock::Stream<log_entry_variant_t>;
+  stream_t stream;
+  MidichloriansHTTPServer<stream_t> server(
+      FLAGS_midichlorians_server_test_port, stream, std::chrono::microseconds(0), "/log", "OK\n");
+  const std::string server_url = Printf("http://localhost:%d/log", FLAGS_midichlorians_server_test_port);
+
+  current::time::SetNow(std::chrono::microseconds(1000));
+  iOSIdentifyEvent identify_event;
+  identify_event.user_ms = std::chrono::milliseconds(42);
+  identify_event.client_id = "unit_test";
+  iOSFocusEvent focus_event;
+  focus_event.user_ms = std::chrono::milliseconds(50);
+  ios_variant_t event1(std::move(identify_event));
+  ios_variant_t event2(std::move(focus_event));
+  EXPECT_EQ("OK\n", HTTP(POST(server_url, JSON(event1) + "\nmeh\n" + JSON(event2))).body);
+
+  current::time::SetNow(std::chrono::microseconds(2000));
+  EXPECT_EQ("OK\n", HTTP(MockGETRequest(server_url, 2, "Fg")).body);
+
+  // The entries are in the stream by the time the request is responded to.
+  EXPECT_EQ(4u, stream.Persister().Size());
+  EXPECT_EQ(3u, server.EventsPushed());
+
+  GenericConsumer consumer;
+  std::vector<std::string> timestamps;
+  for (const auto& e : stream.Persister().Iterate()) {
+    e.entry.Call(consumer);
+    timestamps.push_back(current::ToString(e.idx_ts.us.count()));
+  }
+  // The entries sharing the same `server_us` are published into the stream a microsecond apart.
+  EXPECT_EQ("1000,1001,1002,2000", Join(timestamps, ','));
+  EXPECT_EQ(
+      "[1000][iOSIdentifyEvent user_ms=42 client_id=unit_test],"
+      "[1000][iOSFocusEvent user_ms=50 gained_focus=false],"
+      "[2000][WebForegroundEvent customer_id=test_customer user_ms=2 client_id=unit_test referer_host=myurl "
+      "referer_path=/page1 x=8]",
+      Join(consumer.Events(), ','));
+  EXPECT_EQ("[1000][Error]", Join(consumer.Errors(), ','));
+}
+
 #endif  // CURRENT_MIDICHLORIANS_CLIENT_SERVER_CC
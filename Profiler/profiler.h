@@ -22,10 +22,18 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 *******************************************************************************/
 
-// A simple profiler with a `PROFILER_SCOPE("my magical scope")` macro to declare scopes
+// A low-overhead profiler with a `PROFILER_SCOPE("my magical scope")` macro to declare scopes
 // and a `PROFILER_HTTP_ROUTE(port, "/route")` macro to define an HTTP endpoint exposing
-// a full snapshot of how much time did each thread spend in each scope.
-// Scopes are hierarchical, represented in the output as a full call stack tree.
+// a snapshot of how much time was spent in each scope, merged across all the threads.
+// Scopes are hierarchical, represented in the output as a full call stack tree, flattened in preorder.
+//
+// Each thread only ever writes into its own call stack tree, with no locks taken, so the profiler can be left on.
+// The time is measured with `std::chrono::steady_clock`, in nanoseconds, and the duration of each completed scope
+// is added into its histogram, to report the 50th, 99th and 99.9th percentiles, with the precision of 1/8.
+// The snapshot reads the trees while the threads keep running, so it is consistent per counter, not as a whole.
+// As a thread exits, its tree is merged into the one of all the exited threads, and its memory is released,
+// so that the servers spawning a thread per request, or a few, do not accumulate the trees of the threads long gone.
+// `?reset` makes further snapshots report the difference from the current one.
 
 #ifndef CURRENT_PROFILER_H
 #define CURRENT_PROFILER_H
@@ -42,224 +50,311 @@ SOFTWARE.
 #error "No `CURRENT_PROFILER` in `CURRENT_COVERAGE_REPORT_MODE` please."
 #endif
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
 #include <thread>
+#include <vector>
+
+#include "../TypeSystem/struct.h"
 
 #include "../Blocks/HTTP/api.h"
-#include "../Bricks/time/chrono.h"
+#include "../Bricks/util/metrics.h"
 #include "../Bricks/util/singleton.h"
 
-#ifdef CURRENT_MOCK_TIME
-#error "No `CURRENT_PROFILER` in `CURRENT_MOCK_TIME` please."
-#endif
+namespace current {
+namespace profiler {
 
-struct Profiler {
-  class StateMaintainer {
-   private:
-    struct State {
-      struct PerThread {
-        struct Trie {
-          uint64_t ms_entered = 0;               // `Now()` if within it, `0` if currently not there.
-          uint64_t ms_total = 0;                 // Total across all the times this scope was entered.
-          uint64_t entries = 0;                  // The number of times this scope was entered.
-          std::map<const char*, Trie> children;  // Sub-scopes within this scope, if any.
-          uint64_t ComputeTotalMilliseconds(uint64_t now) const {
-            if (ms_entered) {
-              CURRENT_ASSERT(now >= ms_entered);
-              return ms_total + (now - ms_entered);
-            } else {
-              return ms_total;
-            }
-          }
-          void RecursiveReset(uint64_t now) {
-            ms_total = 0;
-            if (ms_entered) {
-              ms_entered = now;
-            }
-            entries = 1;
-            for (auto& e : children) {
-              e.second.RecursiveReset(now);
-            }
-          }
-        };
-        Trie trie;
-        std::stack<std::pair<const char*, Trie*>> stack;
-        PerThread() {
-          trie.ms_entered = Now();
-          trie.entries = 1;
-          stack.push(std::make_pair("", &trie));
-        }
-      };
-      struct PerThreadReporting {
-        std::string scope;
-        uint64_t entries;
-        uint64_t ms;
-        double ms_per_entry;
-        double absolute_best_possible_qps;
-        double ratio_of_parent;
-        std::vector<PerThreadReporting> subscope;
-        double subscope_total_ratio_of_parent;
-        bool operator<(const PerThreadReporting& rhs) const {
-          return ms > rhs.ms;  // Naturally sort in reverse order of `ms`.
-        }
-        template <typename A>
-        void save(A& ar) const {
-          ar(CEREAL_NVP(scope),
-             CEREAL_NVP(entries),
-             CEREAL_NVP(ms),
-             CEREAL_NVP(ms_per_entry),
-             CEREAL_NVP(absolute_best_possible_qps),
-             CEREAL_NVP(ratio_of_parent),
-             CEREAL_NVP(subscope),
-             CEREAL_NVP(subscope_total_ratio_of_parent));
-        }
-      };
-      std::unordered_map<std::thread::id, PerThread> per_thread;
-      uint64_t total_spent_in_profiling = 0;
-      uint64_t spent_in_reporting = 0;
-      uint64_t spent_in_mutex_locking = 0;
-      void Reset() {
-        total_spent_in_profiling = 0;
-        spent_in_reporting = 0;
-        spent_in_mutex_locking = 0;
-        for (auto& e : per_thread) {
-          e.second.trie.RecursiveReset(Now());
-        }
+CURRENT_STRUCT(ProfilerScope) {
+  CURRENT_FIELD(scope, std::vector<std::string>);  // The full call stack, the outermost scope first.
+  CURRENT_FIELD(entries, uint64_t, 0u);
+  CURRENT_FIELD(ns, uint64_t, 0u);  // Including the time spent in the entries that are still in progress.
+  CURRENT_FIELD(ns_per_entry, double, 0.0);
+  CURRENT_FIELD(ratio_of_parent, double, 0.0);  // For the outermost scopes, the ratio of the lifetime of the threads.
+  CURRENT_FIELD(completed, uint64_t, 0u);       // The number of entries the percentiles are computed over.
+  CURRENT_FIELD(p50_ns, uint64_t, 0u);
+  CURRENT_FIELD(p99_ns, uint64_t, 0u);
+  CURRENT_FIELD(p999_ns, uint64_t, 0u);
+};
+
+CURRENT_STRUCT(ProfilerSnapshot) {
+  CURRENT_FIELD(threads, uint64_t, 0u);
+  CURRENT_FIELD(threads_exited, uint64_t, 0u);  // The threads that have exited, with their scopes merged.
+  CURRENT_FIELD(ns, uint64_t, 0u);  // The total lifetime of the threads, since they entered their first scope.
+  CURRENT_FIELD(scopes, std::vector<ProfilerScope>);
+};
+
+// The log-linear histogram of durations: eight buckets per each power of two.
+using ProfilerHistogram = current::metrics::LogLinearHistogram;
+
+struct ProfilerState {
+  // Only the thread that owns the call stack tree modifies it, so plain loads and stores are enough.
+  static void Add(std::atomic<uint64_t>& counter, uint64_t delta) {
+    counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+  }
+
+  static uint64_t NowNS() { return current::metrics::NowNS(); }
+
+  struct Node {
+    const char* const scope;
+    std::atomic<uint64_t> entries;
+    std::atomic<uint64_t> ns_total;
+    std::atomic<uint64_t> ns_entered;  // `NowNS()` if within it, `0` if currently not there.
+    std::atomic<uint64_t> histogram[ProfilerHistogram::kBuckets];
+    // The children are prepended to the list, and never removed, so the list can be read concurrently.
+    std::atomic<Node*> first_child;
+    std::atomic<Node*> next_sibling;
+
+    explicit Node(const char* scope)
+        : scope(scope), entries(0u), ns_total(0u), ns_entered(0u), first_child(nullptr), next_sibling(nullptr) {
+      for (auto& bucket : histogram) {
+        bucket.store(0u, std::memory_order_relaxed);
+      }
+    }
+
+    ~Node() {
+      Node* child = first_child.load(std::memory_order_relaxed);
+      while (child) {
+        Node* next = child->next_sibling.load(std::memory_order_relaxed);
+        delete child;
+        child = next;
       }
-      static const char* JSONEntryName() { return "milliseconds"; }
-      template <typename A>
-      void save(A& ar) const {
-        const uint64_t now = Now();
-        const uint64_t profiling_overhead = total_spent_in_profiling - spent_in_reporting;
-        const uint64_t reporting_overhead = spent_in_reporting;
-        const uint64_t profiling_mutex_overhead = spent_in_mutex_locking;
-        std::vector<PerThreadReporting> thread;
-        thread.reserve(per_thread.size());
-        for (const auto& per_thread_element : per_thread) {
-          std::function<void(
-              const PerThread::Trie& input, uint64_t total_ms, PerThreadReporting& output, const char* stack)>
-              recursive_fill;
-          recursive_fill = [now, &recursive_fill](
-              const PerThread::Trie& input, uint64_t total_ms, PerThreadReporting& output, const char* stack) {
-            output.scope = stack;
-            output.entries = input.entries;
-            CURRENT_ASSERT(output.entries);
-            output.ms = input.ComputeTotalMilliseconds(now);
-            output.ms_per_entry = 1.0 * output.ms / output.entries;
-            output.absolute_best_possible_qps = output.ms ? (1000.0 / output.ms_per_entry) : 1e9;
-            output.ratio_of_parent = total_ms ? (1.0 * output.ms / total_ms) : 1.0;
-            output.subscope.reserve(input.children.size());
-            for (const auto& scope : input.children) {
-              output.subscope.resize(output.subscope.size() + 1);
-              recursive_fill(scope.second, output.ms, output.subscope.back(), scope.first);
-            }
-            CURRENT_ASSERT(output.subscope.size() == input.children.size());
-            uint64_t subscope_total = 0;
-            for (const auto& subscope : output.subscope) {
-              subscope_total += subscope.ms;
-            }
-            CURRENT_ASSERT(subscope_total <= output.ms);
-            output.subscope_total_ratio_of_parent = output.ms ? (1.0 * subscope_total / output.ms) : 1.0;
-            std::sort(output.subscope.begin(), output.subscope.end());
-          };
-          thread.resize(thread.size() + 1);
-          std::ostringstream thread_id_as_string;
-          thread_id_as_string << "C++ thread with internal ID " << per_thread_element.first;
-          recursive_fill(per_thread_element.second.trie,
-                         per_thread_element.second.trie.ComputeTotalMilliseconds(now),
-                         thread.back(),
-                         thread_id_as_string.str().c_str());
+    }
+
+    Node* Child(const char* child_scope) {
+      Node* const head = first_child.load(std::memory_order_relaxed);
+      for (Node* child = head; child; child = child->next_sibling.load(std::memory_order_relaxed)) {
+        if (child->scope == child_scope) {
+          return child;
         }
-        CURRENT_ASSERT(thread.size() == per_thread.size());
-        ar(CEREAL_NVP(thread),
-           CEREAL_NVP(profiling_overhead),
-           CEREAL_NVP(profiling_mutex_overhead),
-           CEREAL_NVP(reporting_overhead));
       }
-    };
+      Node* child = new Node(child_scope);
+      child->next_sibling.store(head, std::memory_order_relaxed);
+      first_child.store(child, std::memory_order_release);
+      return child;
+    }
+  };
+
+  struct PerThread {
+    const uint64_t ns_started;
+    std::string name;
+    Node root;
+    std::vector<Node*> stack;  // Only accessed by the thread itself.
+
+    PerThread() : ns_started(NowNS()), root("") {
+      std::ostringstream os;
+      os << "C++ thread with internal ID " << std::this_thread::get_id();
+      name = os.str();
+      stack.push_back(&root);
+    }
 
-   public:
     void EnterScope(const char* scope) {
-      CURRENT_ASSERT(scope);
-      CURRENT_ASSERT(*scope);
-      Guarded([scope](uint64_t now, State::PerThread& per_thread) {
-        CURRENT_ASSERT(now);
-        CURRENT_ASSERT(!per_thread.stack.empty());
-        State::PerThread::Trie& node = (*per_thread.stack.top().second).children[scope];
-        node.ms_entered = now;
-        ++node.entries;
-        per_thread.stack.push(std::make_pair(scope, &node));
-      });
+      CURRENT_ASSERT(!stack.empty());
+      Node* node = stack.back()->Child(scope);
+      Add(node->entries, 1u);
+      node->ns_entered.store(NowNS(), std::memory_order_relaxed);
+      stack.push_back(node);
     }
 
     void LeaveScope(const char* scope) {
-      CURRENT_ASSERT(scope);
-      CURRENT_ASSERT(*scope);
-      Guarded([scope](uint64_t now, State::PerThread& per_thread) {
-        CURRENT_ASSERT(now);
-        CURRENT_ASSERT(!per_thread.stack.empty());
-        CURRENT_ASSERT(scope == per_thread.stack.top().first);
-        State::PerThread::Trie& node = (*per_thread.stack.top().second);
-        CURRENT_ASSERT(node.ms_entered <= now);
-        node.ms_total += (now - node.ms_entered);
-        node.ms_entered = 0;
-        per_thread.stack.pop();
-        CURRENT_ASSERT(!per_thread.stack.empty());  // Should have at least the root trie node left in the stack.
-      });
+      const uint64_t now = NowNS();
+      CURRENT_ASSERT(stack.size() > 1u);  // Should have at least the root trie node left in the stack.
+      Node* node = stack.back();
+      CURRENT_ASSERT(node->scope == scope);
+      static_cast<void>(scope);
+      const uint64_t ns_entered = node->ns_entered.load(std::memory_order_relaxed);
+      CURRENT_ASSERT(ns_entered <= now);
+      const uint64_t ns = now - ns_entered;
+      node->ns_entered.store(0u, std::memory_order_relaxed);
+      Add(node->ns_total, ns);
+      Add(node->histogram[ProfilerHistogram::BucketIndex(ns)], 1u);
+      stack.pop_back();
     }
+  };
 
-    void Report(Request request) {
-      Guarded([this, &request](uint64_t unused_now, const State::PerThread& unused_per_thread_state) {
-        static_cast<void>(unused_now);
-        static_cast<void>(unused_per_thread_state);
-        if (request.url.query.has("reset")) {
-          state_.Reset();
-          request("The profiler has been reset.\n");
-        } else {
-          const uint64_t pre_report = Now();
-          request(state_);
-          const uint64_t post_report = Now();
-          state_.spent_in_reporting += (post_report - pre_report);
+  // The merged view of the call stack trees of all the threads, keyed by scope names.
+  struct Merged {
+    uint64_t entries = 0u;
+    uint64_t ns = 0u;
+    std::vector<uint64_t> histogram = std::vector<uint64_t>(ProfilerHistogram::kBuckets, 0u);
+    std::map<std::string, Merged> children;
+
+    void Add(const Node& node, uint64_t now) {
+      entries += node.entries.load(std::memory_order_relaxed);
+      ns += node.ns_total.load(std::memory_order_relaxed);
+      const uint64_t ns_entered = node.ns_entered.load(std::memory_order_relaxed);
+      if (ns_entered && ns_entered <= now) {
+        ns += (now - ns_entered);
+      }
+      for (size_t i = 0u; i < ProfilerHistogram::kBuckets; ++i) {
+        histogram[i] += node.histogram[i].load(std::memory_order_relaxed);
+      }
+      for (const Node* child = node.first_child.load(std::memory_order_acquire); child;
+           child = child->next_sibling.load(std::memory_order_relaxed)) {
+        children[child->scope].Add(*child, now);
+      }
+    }
+
+    // Subtracts the values of the snapshot taken at the time of the last reset.
+    void Subtract(const Merged& baseline) {
+      entries -= std::min(entries, baseline.entries);
+      ns -= std::min(ns, baseline.ns);
+      for (size_t i = 0u; i < ProfilerHistogram::kBuckets; ++i) {
+        histogram[i] -= std::min(histogram[i], baseline.histogram[i]);
+      }
+      for (const auto& child : baseline.children) {
+        const auto cit = children.find(child.first);
+        if (cit != children.end()) {
+          cit->second.Subtract(child.second);
         }
-      });
+      }
+    }
+
+    uint64_t Percentile(uint64_t completed, double p) const {
+      return ProfilerHistogram::Percentile(histogram, completed, p);
     }
 
+    void Report(std::vector<std::string>& stack, uint64_t parent_ns, std::vector<ProfilerScope>& output) const {
+      std::vector<std::pair<uint64_t, const std::pair<const std::string, Merged>*>> sorted;
+      for (const auto& child : children) {
+        sorted.emplace_back(child.second.ns, &child);
+      }
+      // Naturally sort in reverse order of `ns`.
+      std::stable_sort(sorted.begin(),
+                       sorted.end(),
+                       [](const std::pair<uint64_t, const std::pair<const std::string, Merged>*>& lhs,
+                          const std::pair<uint64_t, const std::pair<const std::string, Merged>*>& rhs) {
+                         return lhs.first > rhs.first;
+                       });
+      for (const auto& element : sorted) {
+        const Merged& child = element.second->second;
+        stack.push_back(element.second->first);
+        ProfilerScope scope;
+        scope.scope = stack;
+        scope.entries = child.entries;
+        scope.ns = child.ns;
+        scope.ns_per_entry = child.entries ? (1.0 * child.ns / child.entries) : 0.0;
+        scope.ratio_of_parent = parent_ns ? (1.0 * child.ns / parent_ns) : 1.0;
+        for (uint64_t count : child.histogram) {
+          scope.completed += count;
+        }
+        if (scope.completed) {
+          scope.p50_ns = child.Percentile(scope.completed, 0.5);
+          scope.p99_ns = child.Percentile(scope.completed, 0.99);
+          scope.p999_ns = child.Percentile(scope.completed, 0.999);
+        }
+        output.push_back(std::move(scope));
+        child.Report(stack, child.ns, output);
+        stack.pop_back();
+      }
+    }
+  };
+};
+
+}  // namespace current::profiler
+}  // namespace current
+
+struct Profiler {
+  using ProfilerScope = current::profiler::ProfilerScope;
+  using ProfilerSnapshot = current::profiler::ProfilerSnapshot;
+
+  class StateMaintainer {
    private:
-    static uint64_t Now() { return static_cast<uint64_t>(current::time::Now()); }
+    using State = current::profiler::ProfilerState;
 
-    template <typename F>
-    void Guarded(F&& f) {
-      const uint64_t pre_mutex_lock = Now();
+   public:
+    // Called once per thread.
+    std::shared_ptr<State::PerThread> RegisterThread() {
+      auto per_thread = std::make_shared<State::PerThread>();
       std::lock_guard<std::mutex> lock(mutex_);
-      const uint64_t post_mutex_lock = Now();
-      f(post_mutex_lock, state_.per_thread[std::this_thread::get_id()]);
-      const uint64_t post_guarded_code = Now();
-      state_.total_spent_in_profiling += (post_guarded_code - pre_mutex_lock);
-      state_.spent_in_mutex_locking += (post_mutex_lock - pre_mutex_lock);
+      threads_.push_back(per_thread);
+      return per_thread;
     }
 
-    struct Scope {
-      Scope(const char*) {}
-      const char* scope;
-    };
+    // Called once per thread, as it exits. The data of the thread stays in the reports, but not its call stack tree.
+    void UnregisterThread(const std::shared_ptr<State::PerThread>& per_thread) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      const uint64_t now = State::NowNS();
+      exited_.Add(per_thread->root, now);
+      exited_.ns += (now - per_thread->ns_started);
+      ++threads_exited_;
+      threads_.erase(std::remove(threads_.begin(), threads_.end(), per_thread), threads_.end());
+    }
+
+    ProfilerSnapshot Snapshot() {
+      std::lock_guard<std::mutex> lock(mutex_);
+      State::Merged merged = Merge();
+      merged.Subtract(baseline_);
+      ProfilerSnapshot snapshot;
+      snapshot.threads = threads_.size() + threads_exited_;
+      snapshot.threads_exited = threads_exited_;
+      snapshot.ns = merged.ns;
+      std::vector<std::string> stack;
+      merged.Report(stack, merged.ns, snapshot.scopes);
+      return snapshot;
+    }
+
+    void Reset() {
+      std::lock_guard<std::mutex> lock(mutex_);
+      baseline_ = Merge();
+    }
+
+    void Report(Request request) {
+      if (request.url.query.has("reset")) {
+        Reset();
+        request("The profiler has been reset.\n");
+      } else {
+        request(Snapshot());
+      }
+    }
+
+   private:
+    // The root node of each thread accounts for the lifetime of the thread.
+    State::Merged Merge() const {
+      const uint64_t now = State::NowNS();
+      State::Merged merged = exited_;
+      for (const auto& per_thread : threads_) {
+        merged.Add(per_thread->root, now);
+        merged.ns += (now - per_thread->ns_started);
+      }
+      return merged;
+    }
+
+    std::mutex mutex_;  // Guards the list of threads and the merged trees, never taken by `PROFILER_SCOPE`-s.
+    std::vector<std::shared_ptr<State::PerThread>> threads_;
+    State::Merged exited_;  // The merged call stack trees of the threads that have exited.
+    uint64_t threads_exited_ = 0u;
+    State::Merged baseline_;
+  };
 
-    std::mutex mutex_;
-    State state_;
+  struct PerThreadStateHolder {
+    std::shared_ptr<current::profiler::ProfilerState::PerThread> state;
+    PerThreadStateHolder() : state(current::Singleton<StateMaintainer>().RegisterThread()) {}
+    ~PerThreadStateHolder() { current::Singleton<StateMaintainer>().UnregisterThread(state); }
   };
 
   class ScopedStateMaintainer {
    public:
-    explicit ScopedStateMaintainer(const char* scope) : scope_(scope) {
+    explicit ScopedStateMaintainer(const char* scope)
+        : scope_(scope), state_(*current::ThreadLocalSingleton<PerThreadStateHolder>().state) {
       CURRENT_ASSERT(scope);
       CURRENT_ASSERT(*scope);
-      current::Singleton<StateMaintainer>().EnterScope(scope_);
+      state_.EnterScope(scope_);
     }
-    ~ScopedStateMaintainer() { current::Singleton<StateMaintainer>().LeaveScope(scope_); }
+    ~ScopedStateMaintainer() { state_.LeaveScope(scope_); }
 
    private:
     ScopedStateMaintainer() = delete;
     const char* const scope_;
+    current::profiler::ProfilerState::PerThread& state_;
   };
 
+  static ProfilerSnapshot Snapshot() { return current::Singleton<StateMaintainer>().Snapshot(); }
+  static void Reset() { current::Singleton<StateMaintainer>().Reset(); }
   static void HTTPRoute(Request request) { current::Singleton<StateMaintainer>().Report(std::move(request)); }
 };
 
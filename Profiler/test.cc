@@ -0,0 +1,174 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2015 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+#define CURRENT_PROFILER
+
+#include "profiler.h"
+
+#include "../Bricks/strings/join.h"
+#include "../Bricks/strings/printf.h"
+
+#include "../Bricks/dflags/dflags.h"
+#include "../3rdparty/gtest/gtest-main-with-dflags.h"
+
+DEFINE_int32(profiler_test_port, PickPortForUnitTest(), "Local port to run the test.");
+
+namespace profiler_test {
+
+inline void Inner() { PROFILER_SCOPE("inner"); }
+
+inline void Outer(size_t inner_calls) {
+  PROFILER_SCOPE("outer");
+  for (size_t i = 0; i < inner_calls; ++i) {
+    Inner();
+  }
+}
+
+inline const Profiler::ProfilerScope* FindScope(const Profiler::ProfilerSnapshot& snapshot, const std::string& path) {
+  for (const auto& scope : snapshot.scopes) {
+    if (current::strings::Join(scope.scope, '/') == path) {
+      return &scope;
+    }
+  }
+  return nullptr;
+}
+
+}  // namespace profiler_test
+
+TEST(Profiler, Histogram) {
+  using current::profiler::ProfilerHistogram;
+  EXPECT_EQ(0u, ProfilerHistogram::BucketIndex(0u));
+  EXPECT_EQ(7u, ProfilerHistogram::BucketIndex(7u));
+  EXPECT_EQ(8u, ProfilerHistogram::BucketIndex(8u));
+  EXPECT_EQ(15u, ProfilerHistogram::BucketIndex(15u));
+  EXPECT_EQ(16u, ProfilerHistogram::BucketIndex(16u));
+  EXPECT_EQ(16u, ProfilerHistogram::BucketIndex(17u));
+  EXPECT_EQ(ProfilerHistogram::kBuckets - 1u, ProfilerHistogram::BucketIndex(static_cast<uint64_t>(-1)));
+  // Each bucket represents the values within 1/8 of its own value.
+  for (uint64_t ns : std::vector<uint64_t>({1u, 10u, 100u, 999u, 12345u, 1000000u, 1234567890123u})) {
+    const uint64_t value = ProfilerHistogram::BucketValue(ProfilerHistogram::BucketIndex(ns));
+    EXPECT_LE(static_cast<double>(value), ns * 1.125) << ns;
+    EXPECT_GE(static_cast<double>(value), ns * 0.875) << ns;
+  }
+  for (size_t i = 1u; i < ProfilerHistogram::kBuckets; ++i) {
+    ASSERT_LT(ProfilerHistogram::BucketValue(i - 1u), ProfilerHistogram::BucketValue(i)) << i;
+  }
+}
+
+TEST(Profiler, MergesThreadsWhileTheyRun) {
+  using namespace profiler_test;
+
+  Profiler::Reset();
+
+  std::atomic_bool done(false);
+  std::thread background([&done]() {
+    while (!done) {
+      Outer(1u);
+    }
+  });
+
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < 4u; ++i) {
+    threads.emplace_back([]() {
+      for (size_t j = 0; j < 1000u; ++j) {
+        Outer(2u);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  // The snapshot is taken while the background thread keeps entering and leaving the scopes.
+  const Profiler::ProfilerSnapshot snapshot = Profiler::Snapshot();
+  done = true;
+  background.join();
+
+  EXPECT_LE(5u, snapshot.threads);
+  const Profiler::ProfilerScope* outer = FindScope(snapshot, "outer");
+  const Profiler::ProfilerScope* inner = FindScope(snapshot, "outer/inner");
+  ASSERT_TRUE(outer != nullptr);
+  ASSERT_TRUE(inner != nullptr);
+  EXPECT_TRUE(FindScope(snapshot, "inner") == nullptr);
+  EXPECT_LE(4000u, outer->entries);
+  EXPECT_LE(8000u, inner->entries);
+  EXPECT_LE(4000u, outer->completed);
+  EXPECT_LE(outer->completed, outer->entries);
+  EXPECT_LE(inner->ns, outer->ns);
+  EXPECT_LE(outer->p50_ns, outer->p99_ns);
+  EXPECT_LE(outer->p99_ns, outer->p999_ns);
+  EXPECT_LE(inner->ratio_of_parent, 1.0);
+
+  // After the reset, only the scopes entered since are reported.
+  Profiler::Reset();
+  Outer(3u);
+  const Profiler::ProfilerSnapshot after_reset = Profiler::Snapshot();
+  const Profiler::ProfilerScope* outer_after_reset = FindScope(after_reset, "outer");
+  const Profiler::ProfilerScope* inner_after_reset = FindScope(after_reset, "outer/inner");
+  ASSERT_TRUE(outer_after_reset != nullptr);
+  ASSERT_TRUE(inner_after_reset != nullptr);
+  EXPECT_EQ(1u, outer_after_reset->entries);
+  EXPECT_EQ(3u, inner_after_reset->entries);
+}
+
+TEST(Profiler, MergesThreadsAsTheyExit) {
+  using namespace profiler_test;
+
+  Profiler::Reset();
+  const Profiler::ProfilerSnapshot before = Profiler::Snapshot();
+
+  for (size_t i = 0; i < 100u; ++i) {
+    std::thread([]() { Outer(2u); }).join();
+  }
+
+  // The data of the threads stays in the reports, while their call stack trees are gone.
+  const Profiler::ProfilerSnapshot snapshot = Profiler::Snapshot();
+  EXPECT_EQ(before.threads + 100u, snapshot.threads);
+  EXPECT_EQ(before.threads_exited + 100u, snapshot.threads_exited);
+  EXPECT_EQ(before.threads - before.threads_exited, snapshot.threads - snapshot.threads_exited);
+  const Profiler::ProfilerScope* outer = FindScope(snapshot, "outer");
+  const Profiler::ProfilerScope* inner = FindScope(snapshot, "outer/inner");
+  ASSERT_TRUE(outer != nullptr);
+  ASSERT_TRUE(inner != nullptr);
+  EXPECT_EQ(100u, outer->entries);
+  EXPECT_EQ(100u, outer->completed);
+  EXPECT_EQ(200u, inner->entries);
+}
+
+TEST(Profiler, HTTPRoute) {
+  using namespace profiler_test;
+
+  const auto scope = HTTP(FLAGS_profiler_test_port).Register("/profiler", Profiler::HTTPRoute);
+
+  Outer(1u);
+  EXPECT_EQ("The profiler has been reset.\n",
+            HTTP(GET(current::strings::Printf("http://localhost:%d/profiler?reset", FLAGS_profiler_test_port))).body);
+  Outer(1u);
+  const auto snapshot = ParseJSON<Profiler::ProfilerSnapshot>(
+      HTTP(GET(current::strings::Printf("http://localhost:%d/profiler", FLAGS_profiler_test_port))).body);
+  const Profiler::ProfilerScope* outer = FindScope(snapshot, "outer");
+  ASSERT_TRUE(outer != nullptr);
+  EXPECT_EQ(1u, outer->entries);
+  EXPECT_EQ(1u, outer->completed);
+}
@@ -48,13 +48,18 @@ SOFTWARE.
 #include "../port.h"
 
 #include "types.h"
+#include "scheduler.h"
 
+#include <chrono>
+#include <condition_variable>
 #include <functional>
 #include <iostream>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <tuple>
 #include <vector>
 
@@ -223,6 +228,8 @@ class SharedDefinition<LHSTypes<LHS_TYPES...>, RHSTypes<RHS_TYPES...>> {
 class GenericBlockOutgoingInterface {
  public:
   virtual ~GenericBlockOutgoingInterface() = default;
+  // `emit<>` passes `DefaultTimeArgument`, for the timestamp to be assigned by the MMPQ, from within its locked section.
+  virtual void OnThreadUnsafeEmitted(movable_message_t&&, time::DefaultTimeArgument) = 0;
   virtual void OnThreadUnsafeEmitted(movable_message_t&&, std::chrono::microseconds) = 0;
   virtual void OnThreadUnsafeScheduled(movable_message_t&&, std::chrono::microseconds) = 0;
   virtual void OnThreadUnsafeHeadUpdated(std::chrono::microseconds) = 0;
@@ -238,6 +245,10 @@ class BlockOutgoingInterface<ThreadUnsafeOutgoingTypes<TYPES...>> : public Gener
 template <>
 class BlockOutgoingInterface<ThreadUnsafeOutgoingTypes<>> : public GenericBlockOutgoingInterface {
  public:
+  void OnThreadUnsafeEmitted(movable_message_t&&, time::DefaultTimeArgument) override {
+    std::cerr << "Not expecting any entries from a non-emitting block.\n";
+    CURRENT_ASSERT(false);
+  }
   void OnThreadUnsafeEmitted(movable_message_t&&, std::chrono::microseconds) override {
     std::cerr << "Not expecting any entries from a non-emitting block.\n";
     CURRENT_ASSERT(false);
@@ -259,6 +270,12 @@ class GenericBlockIncomingInterface {
  public:
   virtual ~GenericBlockIncomingInterface() = default;
   virtual void OnThreadSafeMessage(movable_message_t&&) = 0;
+  // The batch of messages, in the order they should be processed. By default, passed on one by one.
+  virtual void OnThreadSafeMessages(std::vector<movable_message_t>&& messages) {
+    for (auto& message : messages) {
+      OnThreadSafeMessage(std::move(message));
+    }
+  }
 };
 
 template <class>
@@ -277,6 +294,240 @@ class BlockIncomingInterface<ThreadSafeIncomingTypes<>> : public GenericBlockInc
   }
 };
 
+// The parameters to run a RipCurrent flow with.
+// * `scheduler`: The scheduler to run the blocks on, or `nullptr` for a dedicated thread per each `|`.
+// * `max_batch_size`: The maximum number of messages delivered at the cost of a single lock acquisition, for both
+//   the incoming messages drained from the MMPQ and the outgoing calls a block makes while processing them.
+// * `max_batch_latency`: The longest time the outgoing calls made while processing a batch can be held back.
+struct RunParameters final {
+  std::shared_ptr<GenericScheduler> scheduler;
+  size_t max_batch_size = 1024u;
+  std::chrono::microseconds max_batch_latency = std::chrono::milliseconds(1);
+
+  RunParameters& SetScheduler(std::shared_ptr<GenericScheduler> value) {
+    scheduler = value;
+    return *this;
+  }
+  RunParameters& SetMaxBatchSize(size_t value) {
+    max_batch_size = value;
+    return *this;
+  }
+  RunParameters& SetMaxBatchLatency(std::chrono::microseconds value) {
+    max_batch_latency = value;
+    return *this;
+  }
+};
+
+// The parameters for the RipCurrent flow being started from the current thread.
+// The flow is constructed synchronously within `RipCurrent(parameters)`, which sets them for the duration of the call.
+class RunParametersForFlowBeingStarted final {
+ public:
+  const RunParameters& Get() const { return parameters_; }
+
+  class InjectedParametersScope final {
+   public:
+    InjectedParametersScope(RunParametersForFlowBeingStarted* parent, const RunParameters& parameters)
+        : parent_(parent), save_parameters_(parent->parameters_) {
+      parent_->parameters_ = parameters;
+    }
+    ~InjectedParametersScope() { parent_->parameters_ = save_parameters_; }
+
+   private:
+    RunParametersForFlowBeingStarted* parent_;
+    RunParameters save_parameters_;
+  };
+
+  InjectedParametersScope ScopedInjectParameters(const RunParameters& parameters) {
+    return InjectedParametersScope(this, parameters);
+  }
+
+ private:
+  RunParameters parameters_;
+};
+
+// Emit-side batching. While a block is processing a batch of incoming messages, the `emit<>`, `post<>`, `schedule<>`,
+// and `head<>` calls it makes are buffered in the thread running it, and are flushed into the next MMPQ once the batch
+// is processed, or once `max_batch_size` calls are buffered, or once `max_batch_latency` has passed since the first one.
+// The latter is enforced by `OutgoingCallsDeadlines`, so that a block busy processing a long batch, or a single slow
+// message, does not hold back the calls it has already made.
+// The calls made from outside the processing of incoming messages, e.g. from the constructor, are not buffered.
+class GenericBufferedCallsDestination;
+class OutgoingCallsBuffer;
+
+struct BufferedOutgoingCall final {
+  enum class Type : int { EmittedNow, Emitted, Scheduled, HeadUpdated };
+  GenericBufferedCallsDestination* destination;
+  Type type;
+  movable_message_t message;
+  std::chrono::microseconds us;
+  BufferedOutgoingCall(GenericBufferedCallsDestination* destination,
+                       Type type,
+                       movable_message_t&& message,
+                       std::chrono::microseconds us)
+      : destination(destination), type(type), message(std::move(message)), us(us) {}
+};
+
+class GenericBufferedCallsDestination {
+ public:
+  virtual ~GenericBufferedCallsDestination() = default;
+  virtual void FlushBufferedCalls(std::vector<BufferedOutgoingCall>::iterator begin,
+                                  std::vector<BufferedOutgoingCall>::iterator end) = 0;
+};
+
+// The single thread flushing the outgoing calls buffers which are past their `max_batch_latency`.
+// Holds `mutex_` while flushing, so that the buffer being flushed can not be destructed meanwhile.
+class OutgoingCallsDeadlines final {
+ public:
+  ~OutgoingCallsDeadlines() {
+    if (thread_.joinable()) {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        destructing_ = true;
+        condition_variable_.notify_one();
+      }
+      thread_.join();
+    }
+  }
+
+  inline void Register(std::chrono::steady_clock::time_point deadline, OutgoingCallsBuffer* buffer);
+  inline void Unregister(OutgoingCallsBuffer* buffer);
+
+ private:
+  inline void Thread();
+
+  std::mutex mutex_;
+  std::condition_variable condition_variable_;
+  std::multimap<std::chrono::steady_clock::time_point, OutgoingCallsBuffer*> deadlines_;
+  bool destructing_ = false;
+  std::thread thread_;
+};
+
+class OutgoingCallsBuffer final {
+ public:
+  OutgoingCallsBuffer(size_t max_batch_size, std::chrono::microseconds max_batch_latency)
+      : max_batch_size_(std::max(max_batch_size, static_cast<size_t>(1))),
+        // Capped, so that the deadline does not overflow `steady_clock`.
+        max_batch_latency_(std::min(max_batch_latency, std::chrono::microseconds(std::chrono::hours(24)))) {
+    // Constructed before the buffer, so that it is destructed after it.
+    current::Singleton<OutgoingCallsDeadlines>();
+  }
+
+  ~OutgoingCallsBuffer() { current::Singleton<OutgoingCallsDeadlines>().Unregister(this); }
+
+  void Add(BufferedOutgoingCall&& call) {
+    bool register_deadline = false;
+    std::chrono::steady_clock::time_point deadline;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      const auto now = std::chrono::steady_clock::now();
+      if (calls_.empty()) {
+        first_call_time_ = now;
+        register_deadline = true;
+        deadline = now + max_batch_latency_;
+      }
+      calls_.push_back(std::move(call));
+      if (calls_.size() >= max_batch_size_ || now - first_call_time_ >= max_batch_latency_) {
+        DoFlush();
+        register_deadline = false;
+      }
+    }
+    // Outside the lock of this buffer, as `OutgoingCallsDeadlines` locks it while holding its own lock.
+    if (register_deadline) {
+      current::Singleton<OutgoingCallsDeadlines>().Register(deadline, this);
+    }
+  }
+
+  // Passes the buffered calls to their destinations, preserving the order of calls made to each destination.
+  void Flush() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    DoFlush();
+  }
+
+  // Called by `OutgoingCallsDeadlines`. The buffer may have been flushed, and even refilled, since the deadline was set.
+  void FlushIfPastDeadline() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!calls_.empty() && std::chrono::steady_clock::now() - first_call_time_ >= max_batch_latency_) {
+      DoFlush();
+    }
+  }
+
+  // Makes this buffer the one the calls made from the current thread go to, for the lifetime of the returned object.
+  class ActiveScope final {
+   public:
+    explicit ActiveScope(OutgoingCallsBuffer* buffer) : save_buffer_(ActiveBuffer()) { ActiveBuffer() = buffer; }
+    ~ActiveScope() { ActiveBuffer() = save_buffer_; }
+
+   private:
+    OutgoingCallsBuffer* save_buffer_;
+  };
+
+  // The buffer of the current thread, if it is processing a batch of incoming messages, or `nullptr`.
+  static OutgoingCallsBuffer*& ActiveBuffer() { return ThreadLocalSingleton<ActiveBufferHolder>().buffer; }
+
+ private:
+  void DoFlush() {
+    auto begin = calls_.begin();
+    while (begin != calls_.end()) {
+      auto end = begin;
+      while (end != calls_.end() && end->destination == begin->destination) {
+        ++end;
+      }
+      begin->destination->FlushBufferedCalls(begin, end);
+      begin = end;
+    }
+    calls_.clear();
+  }
+
+  struct ActiveBufferHolder final {
+    OutgoingCallsBuffer* buffer = nullptr;
+  };
+
+  const size_t max_batch_size_;
+  const std::chrono::microseconds max_batch_latency_;
+  // Guards the calls, which are flushed either by the thread running the block, or by `OutgoingCallsDeadlines`.
+  std::mutex mutex_;
+  std::vector<BufferedOutgoingCall> calls_;
+  std::chrono::steady_clock::time_point first_call_time_;
+};
+
+void OutgoingCallsDeadlines::Register(std::chrono::steady_clock::time_point deadline, OutgoingCallsBuffer* buffer) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!thread_.joinable()) {
+    thread_ = std::thread([this]() { Thread(); });
+  }
+  const bool earliest = deadlines_.empty() || deadline < deadlines_.begin()->first;
+  deadlines_.emplace(deadline, buffer);
+  if (earliest) {
+    condition_variable_.notify_one();
+  }
+}
+
+void OutgoingCallsDeadlines::Unregister(OutgoingCallsBuffer* buffer) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto it = deadlines_.begin(); it != deadlines_.end();) {
+    if (it->second == buffer) {
+      it = deadlines_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void OutgoingCallsDeadlines::Thread() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!destructing_) {
+    if (deadlines_.empty()) {
+      condition_variable_.wait(lock);
+    } else if (std::chrono::steady_clock::now() < deadlines_.begin()->first) {
+      condition_variable_.wait_until(lock, deadlines_.begin()->first);
+    } else {
+      OutgoingCallsBuffer* buffer = deadlines_.begin()->second;
+      deadlines_.erase(deadlines_.begin());
+      buffer->FlushIfPastDeadline();
+    }
+  }
+}
+
 // Consider the following setup: `Produce(A, B, C, D) | Consume(A) + Consume(B) + Consume(C) + Consume(D)`.
 //
 // There are several ways the right hand side of the pipe operator could be constructed, specifically:
@@ -409,6 +660,21 @@ class SharedCurrent<LHSTypes<LHS_TYPES...>, RHSTypes<RHS_TYPES...>>
     return RipCurrentScope(Run(std::make_shared<BlockOutgoingInterface<ThreadUnsafeOutgoingTypes<>>>()), os.str());
   }
 
+  // Same as `RipCurrent()`, but with non-default `RunParameters`, such as the scheduler or the batch sizes.
+  template <int IN_N = sizeof...(LHS_TYPES), int OUT_N = sizeof...(RHS_TYPES)>
+  std::enable_if_t<IN_N == 0 && OUT_N == 0, RipCurrentScope> RipCurrent(const RunParameters& parameters) const {
+    const auto parameters_scope =
+        ThreadLocalSingleton<RunParametersForFlowBeingStarted>().ScopedInjectParameters(parameters);
+    return RipCurrent();
+  }
+
+  // Same as `RipCurrent()`, but runs the blocks on the provided scheduler instead of a thread per `|`.
+  template <int IN_N = sizeof...(LHS_TYPES), int OUT_N = sizeof...(RHS_TYPES)>
+  std::enable_if_t<IN_N == 0 && OUT_N == 0, RipCurrentScope> RipCurrent(
+      std::shared_ptr<GenericScheduler> scheduler) const {
+    return RipCurrent(RunParameters().SetScheduler(std::move(scheduler)));
+  }
+
  private:
   std::shared_ptr<super_t> super_;
 };
@@ -490,7 +756,7 @@ class CallsGeneratingBlock<EmittableTypes<EMITTED_TYPES...>> : public GenericCal
   std::enable_if_t<TypeListContains<TypeListImpl<EMITTED_TYPES...>, T>::value> emit(ARGS&&... args) const {
     // A seemingly unnecessary `release()` is due to `std::make_unique()` not supporting a custom deleter. -- D.K
     handler_->OnThreadUnsafeEmitted(movable_message_t(std::make_unique<T>(std::forward<ARGS>(args)...).release()),
-                                    time::Now());
+                                    time::DefaultTimeArgument());
   }
 
   template <typename T, typename... ARGS>
@@ -513,10 +779,35 @@ class CallsGeneratingBlock<EmittableTypes<EMITTED_TYPES...>> : public GenericCal
   outgoing_interface_t* handler_;
 };
 
+// Whether the user class accepts batches of messages of type `T` via `f(std::vector<T>&&)`.
+// A catch-all templated `f()` does not count, as it would be the one to accept anything.
+namespace sfinae {
+
+struct NotAnIncomingType final {};
+
+template <typename USER_CLASS, typename T>
+constexpr bool HasBatchF(char) {
+  return false;
+}
+
+template <typename USER_CLASS, typename T>
+constexpr auto HasBatchF(int) -> decltype(std::declval<USER_CLASS&>().f(std::declval<std::vector<T>&&>()), bool()) {
+  return true;
+}
+
+template <typename USER_CLASS, typename T>
+constexpr bool AcceptsBatchesOf() {
+  return HasBatchF<USER_CLASS, T>(0) && !HasBatchF<USER_CLASS, NotAnIncomingType>(0);
+}
+
+}  // namespace current::ripcurrent::sfinae
+
 // `UserClassInstantiator` instantiates the user class passed in as `USER_CLASS`.
 // It serves two purposes:
 // 1) Itself, it inherits from `BlockIncomingInterface<ThreadSafeIncomingTypes<LHS_TYPES...>>`, and can accept entries.
 //    Those entries are assumed thread safe, and are proxied directly to the user code's `.f()` method.
+//    If the user code defines `f(std::vector<T>&&)`, the messages of type `T` are passed to it in batches instead,
+//    each batch being the longest run of consecutive messages of type `T` delivered together.
 // 2) It requires the `next_` parameter, which is a `BlockOutgoingInterface<ThreadUnsafeOutgoingTypes<RHS_TYPES...>>`.
 //    Prior to instantiating user class, it uses the `BlockCallsConsumersManager::CallsConsumerLifetimeScope` mechanism
 //    to enable user code to make the calls to `emit<>`, `post<>`, `schedule<>`, and `head<>` from its constructor.
@@ -535,11 +826,19 @@ class UserClassInstantiator<LHSTypes<LHS_TYPES...>, RHSTypes<RHS_TYPES...>, USER
 
   void OnThreadSafeMessage(movable_message_t&& x) override {
     RTTIDynamicCall<TypeListImpl<LHS_TYPES...>, CurrentSuper>(std::move(*x), *this);
+    FlushPendingBatch();
+  }
+
+  void OnThreadSafeMessages(std::vector<movable_message_t>&& xs) override {
+    for (auto& x : xs) {
+      RTTIDynamicCall<TypeListImpl<LHS_TYPES...>, CurrentSuper>(std::move(*x), *this);
+    }
+    FlushPendingBatch();
   }
 
   template <typename X>
   void operator()(X&& x) {
-    impl_.f(std::forward<X>(x));
+    Dispatch(std::forward<X>(x), std::integral_constant<bool, sfinae::AcceptsBatchesOf<USER_CLASS, current::decay<X>>()>());
   }
 
   void operator()(CurrentSuper&&) {
@@ -549,8 +848,54 @@ class UserClassInstantiator<LHSTypes<LHS_TYPES...>, RHSTypes<RHS_TYPES...>, USER
   }
 
  private:
+  struct GenericPendingBatch {
+    virtual ~GenericPendingBatch() = default;
+    virtual void PassTo(USER_CLASS& impl) = 0;
+  };
+
+  template <typename T>
+  struct PendingBatch final : GenericPendingBatch {
+    std::vector<T> messages;
+    void PassTo(USER_CLASS& impl) override { impl.f(std::move(messages)); }
+  };
+
+  // A unique address per type, to tell which type the pending batch is of without RTTI.
+  template <typename T>
+  static const void* PendingBatchTypeTag() {
+    static const char tag = 0;
+    return &tag;
+  }
+
+  template <typename X>
+  void Dispatch(X&& x, std::false_type) {
+    FlushPendingBatch();
+    impl_.f(std::forward<X>(x));
+  }
+
+  template <typename X>
+  void Dispatch(X&& x, std::true_type) {
+    using batch_t = PendingBatch<current::decay<X>>;
+    if (pending_batch_type_tag_ != PendingBatchTypeTag<current::decay<X>>()) {
+      FlushPendingBatch();
+      pending_batch_ = std::make_unique<batch_t>();
+      pending_batch_type_tag_ = PendingBatchTypeTag<current::decay<X>>();
+    }
+    static_cast<batch_t*>(pending_batch_.get())->messages.push_back(std::forward<X>(x));
+  }
+
+  void FlushPendingBatch() {
+    if (pending_batch_) {
+      // Detach the pending batch before passing it on, so that it is never passed on twice.
+      std::unique_ptr<GenericPendingBatch> batch = std::move(pending_batch_);
+      pending_batch_type_tag_ = nullptr;
+      batch->PassTo(impl_);
+    }
+  }
+
   const BlockCallsConsumersManager::CallsConsumerLifetimeScope scope_;
   USER_CLASS impl_;
+  std::unique_ptr<GenericPendingBatch> pending_batch_;
+  const void* pending_batch_type_tag_ = nullptr;
 };
 
 // Base classes for user-defined code, for `is_base_of<>` `static_assert()`-s.
@@ -609,6 +954,10 @@ class UserCodeInstantiator<LHSTypes<LHS_TYPES...>, RHSTypes<RHS_TYPES...>, USER_
       spawned_user_class_instance_->OnThreadSafeMessage(std::move(x));
     }
 
+    void OnThreadSafeMessages(std::vector<movable_message_t>&& xs) override {
+      spawned_user_class_instance_->OnThreadSafeMessages(std::move(xs));
+    }
+
    private:
     std::unique_ptr<UserClassInstantiator<instantiator_input_t, instantiator_output_t, USER_CLASS>>
         spawned_user_class_instance_;
@@ -698,51 +1047,148 @@ class SharedSequenceImpl<LHSTypes<LHS_TYPES...>, RHSTypes<RHS_TYPES...>, VIAType
 
     void OnThreadSafeMessage(movable_message_t&& x) override { from_->OnThreadSafeMessage(std::move(x)); }
 
+    void OnThreadSafeMessages(std::vector<movable_message_t>&& xs) override {
+      from_->OnThreadSafeMessages(std::move(xs));
+    }
+
    private:
-    class MMPQWrapper final : public BlockOutgoingInterface<ThreadUnsafeOutgoingTypes<VIA_X, VIA_XS...>> {
+    class MMPQWrapper final : public BlockOutgoingInterface<ThreadUnsafeOutgoingTypes<VIA_X, VIA_XS...>>,
+                              public GenericBufferedCallsDestination {
      public:
       explicit MMPQWrapper(
           std::shared_ptr<BlockIncomingInterface<ThreadSafeIncomingTypes<VIA_X, VIA_XS...>>> destination)
-          : single_threaded_processor_(waitable_counters_, destination), mmpq_(single_threaded_processor_) {}
+          : parameters_(ThreadLocalSingleton<RunParametersForFlowBeingStarted>().Get()),
+            single_threaded_processor_(waitable_counters_, destination, parameters_) {
+        if (parameters_.scheduler) {
+          scheduled_mmpq_ = std::make_unique<scheduled_mmpq_t>(
+              single_threaded_processor_, parameters_.scheduler, parameters_.max_batch_size);
+        } else {
+          mmpq_ = std::make_unique<mmpq_t>(single_threaded_processor_, parameters_.max_batch_size);
+        }
+      }
 
       ~MMPQWrapper() {
         waitable_counters_.Wait([](const ThreadMessageCounters& counters) { return counters.ProcessedEverything(); });
       }
 
+      void OnThreadUnsafeEmitted(movable_message_t&& x, time::DefaultTimeArgument) override {
+        OnThreadUnsafeCall(BufferedOutgoingCall::Type::EmittedNow, std::move(x), std::chrono::microseconds(0));
+      }
+
       void OnThreadUnsafeEmitted(movable_message_t&& x, std::chrono::microseconds t) override {
-        waitable_counters_.MutableUse([](ThreadMessageCounters& p) { p.ReportMessagePublished(); });
-        try {
-          mmpq_.Publish(std::move(x), t);
-        } catch (const ss::InconsistentTimestampException& e) {
-          current::Singleton<RipCurrentMockableErrorHandler>().HandleError(e.DetailedDescription());
-          waitable_counters_.MutableUse([](ThreadMessageCounters& p) { p.ReportMessageNotQuitePublished(); });
-        }
+        OnThreadUnsafeCall(BufferedOutgoingCall::Type::Emitted, std::move(x), t);
       }
 
       void OnThreadUnsafeScheduled(movable_message_t&& x, std::chrono::microseconds t) override {
-        waitable_counters_.MutableUse([](ThreadMessageCounters& p) { p.ReportMessagePublished(); });
-        try {
-          mmpq_.PublishIntoTheFuture(std::move(x), t);
-        } catch (const ss::InconsistentTimestampException& e) {
-          current::Singleton<RipCurrentMockableErrorHandler>().HandleError(e.DetailedDescription());
-          waitable_counters_.MutableUse([](ThreadMessageCounters& p) { p.ReportMessageNotQuitePublished(); });
-        }
+        OnThreadUnsafeCall(BufferedOutgoingCall::Type::Scheduled, std::move(x), t);
       }
 
       void OnThreadUnsafeHeadUpdated(std::chrono::microseconds t) override {
+        OnThreadUnsafeCall(BufferedOutgoingCall::Type::HeadUpdated, nullptr, t);
+      }
+
+      void FlushBufferedCalls(std::vector<BufferedOutgoingCall>::iterator begin,
+                              std::vector<BufferedOutgoingCall>::iterator end) override {
+        size_t messages = 0u;
+        for (auto it = begin; it != end; ++it) {
+          if (it->type != BufferedOutgoingCall::Type::HeadUpdated) {
+            ++messages;
+          }
+        }
+        if (messages) {
+          waitable_counters_.MutableUse([messages](ThreadMessageCounters& p) { p.ReportMessagesPublished(messages); });
+        }
+        // Report errors, if any, once the MMPQ is unlocked.
+        std::vector<std::string> errors;
+        size_t not_published = 0u;
+        const auto publish_all = [this, begin, end, &errors, &not_published]() {
+          for (auto it = begin; it != end; ++it) {
+            try {
+              Call<current::locks::MutexLockStatus::AlreadyLocked>(*it);
+            } catch (const ss::InconsistentTimestampException& e) {
+              errors.push_back(e.DetailedDescription());
+              if (it->type != BufferedOutgoingCall::Type::HeadUpdated) {
+                ++not_published;
+              }
+            }
+          }
+        };
+        if (scheduled_mmpq_) {
+          scheduled_mmpq_->WithLockedMutex(publish_all);
+        } else {
+          mmpq_->WithLockedMutex(publish_all);
+        }
+        for (const auto& error : errors) {
+          current::Singleton<RipCurrentMockableErrorHandler>().HandleError(error);
+        }
+        if (not_published) {
+          waitable_counters_.MutableUse(
+              [not_published](ThreadMessageCounters& p) { p.ReportMessagesNotQuitePublished(not_published); });
+        }
+      }
+
+     private:
+      void OnThreadUnsafeCall(BufferedOutgoingCall::Type type, movable_message_t&& x, std::chrono::microseconds t) {
+        OutgoingCallsBuffer* buffer = OutgoingCallsBuffer::ActiveBuffer();
+        if (buffer) {
+          buffer->Add(BufferedOutgoingCall(this, type, std::move(x), t));
+          return;
+        }
+        const bool is_message = (type != BufferedOutgoingCall::Type::HeadUpdated);
+        if (is_message) {
+          waitable_counters_.MutableUse([](ThreadMessageCounters& p) { p.ReportMessagesPublished(1u); });
+        }
         try {
-          mmpq_.UpdateHead(t);
+          BufferedOutgoingCall call(this, type, std::move(x), t);
+          Call<current::locks::MutexLockStatus::NeedToLock>(call);
         } catch (const ss::InconsistentTimestampException& e) {
           current::Singleton<RipCurrentMockableErrorHandler>().HandleError(e.DetailedDescription());
+          if (is_message) {
+            waitable_counters_.MutableUse([](ThreadMessageCounters& p) { p.ReportMessagesNotQuitePublished(1u); });
+          }
+        }
+      }
+
+      template <current::locks::MutexLockStatus MLS>
+      void Call(BufferedOutgoingCall& call) {
+        if (scheduled_mmpq_) {
+          switch (call.type) {
+            case BufferedOutgoingCall::Type::EmittedNow:
+              scheduled_mmpq_->template Publish<MLS>(std::move(call.message), time::DefaultTimeArgument());
+              break;
+            case BufferedOutgoingCall::Type::Emitted:
+              scheduled_mmpq_->template Publish<MLS>(std::move(call.message), call.us);
+              break;
+            case BufferedOutgoingCall::Type::Scheduled:
+              scheduled_mmpq_->template PublishIntoTheFuture<MLS>(std::move(call.message), call.us);
+              break;
+            case BufferedOutgoingCall::Type::HeadUpdated:
+              scheduled_mmpq_->template UpdateHead<MLS>(call.us);
+              break;
+          }
+        } else {
+          switch (call.type) {
+            case BufferedOutgoingCall::Type::EmittedNow:
+              mmpq_->template Publish<MLS>(std::move(call.message));
+              break;
+            case BufferedOutgoingCall::Type::Emitted:
+              mmpq_->template Publish<MLS>(std::move(call.message), call.us);
+              break;
+            case BufferedOutgoingCall::Type::Scheduled:
+              mmpq_->template PublishIntoTheFuture<MLS>(std::move(call.message), call.us);
+              break;
+            case BufferedOutgoingCall::Type::HeadUpdated:
+              mmpq_->template UpdateHead<MLS>(call.us);
+              break;
+          }
         }
       }
 
-     private:
       class ThreadMessageCounters {
        public:
-        void ReportMessagePublished() { ++published_; }
-        void ReportMessageNotQuitePublished() { --published_; }
-        void ReportMessageProcessed() { ++processed_; }
+        void ReportMessagesPublished(size_t n) { published_ += n; }
+        void ReportMessagesNotQuitePublished(size_t n) { published_ -= n; }
+        void ReportMessagesProcessed(size_t n) { processed_ += n; }
         bool ProcessedEverything() const { return published_ == processed_; }
 
        private:
@@ -750,25 +1196,51 @@ class SharedSequenceImpl<LHSTypes<LHS_TYPES...>, RHSTypes<RHS_TYPES...>, VIAType
         size_t processed_ = 0u;
       };
 
+      // Collects the messages drained from the MMPQ, and, once the batch is complete, passes them on together,
+      // with the outgoing calls made while processing them buffered, and flushed once the batch is processed.
       struct SingleThreadedProcessorImpl {
         SingleThreadedProcessorImpl(
             WaitableAtomic<ThreadMessageCounters>& waitable_counters,
-            std::shared_ptr<BlockIncomingInterface<ThreadSafeIncomingTypes<VIA_X, VIA_XS...>>> next)
-            : waitable_counters_(waitable_counters), next_(next) {}
+            std::shared_ptr<BlockIncomingInterface<ThreadSafeIncomingTypes<VIA_X, VIA_XS...>>> next,
+            const RunParameters& parameters)
+            : waitable_counters_(waitable_counters),
+              next_(next),
+              outgoing_calls_buffer_(parameters.max_batch_size, parameters.max_batch_latency) {}
 
         ss::EntryResponse operator()(movable_message_t&& e, idxts_t, idxts_t) {
-          next_->OnThreadSafeMessage(std::move(e));
-          waitable_counters_.MutableUse([](ThreadMessageCounters& p) { p.ReportMessageProcessed(); });
+          batch_.push_back(std::move(e));
           return ss::EntryResponse::More;
         }
 
+        void OnBatchEnd() {
+          if (!batch_.empty()) {
+            const size_t size = batch_.size();
+            {
+              const OutgoingCallsBuffer::ActiveScope scope(&outgoing_calls_buffer_);
+              next_->OnThreadSafeMessages(std::move(batch_));
+            }
+            batch_.clear();
+            outgoing_calls_buffer_.Flush();
+            waitable_counters_.MutableUse([size](ThreadMessageCounters& p) { p.ReportMessagesProcessed(size); });
+          }
+        }
+
         WaitableAtomic<ThreadMessageCounters>& waitable_counters_;
         std::shared_ptr<BlockIncomingInterface<ThreadSafeIncomingTypes<VIA_X, VIA_XS...>>> next_;
+        std::vector<movable_message_t> batch_;
+        OutgoingCallsBuffer outgoing_calls_buffer_;
       };
 
+      using processor_t = current::ss::EntrySubscriber<SingleThreadedProcessorImpl, movable_message_t>;
+      using mmpq_t = mmq::MMPQ<movable_message_t, processor_t>;
+      using scheduled_mmpq_t = ScheduledMMPQ<movable_message_t, processor_t>;
+
+      const RunParameters parameters_;
       WaitableAtomic<ThreadMessageCounters> waitable_counters_;
-      current::ss::EntrySubscriber<SingleThreadedProcessorImpl, movable_message_t> single_threaded_processor_;
-      mmq::MMPQ<movable_message_t, current::ss::EntrySubscriber<SingleThreadedProcessorImpl, movable_message_t>> mmpq_;
+      processor_t single_threaded_processor_;
+      // Exactly one of `mmpq_` and `scheduled_mmpq_` is used, depending on whether the flow is run on a scheduler.
+      std::unique_ptr<mmpq_t> mmpq_;
+      std::unique_ptr<scheduled_mmpq_t> scheduled_mmpq_;
     };
 
     // Construction / destruction order matters: { next, into, from }.
@@ -882,11 +1354,61 @@ class SharedParallelImpl<LHSTypes<AB_LHS...>,
           std::move(*x), Router(this));
     }
 
+    // Tells whether the message should be routed to A or to B, without touching the message itself.
+    class SideDetector {
+     public:
+      explicit SideDetector(bool& goes_to_a) : goes_to_a_(goes_to_a) {}
+
+      template <typename X>
+      void operator()(const X&) {
+        goes_to_a_ = metaprogramming::TypeListContains<TypeListImpl<A_LHS...>, X>::value;
+      }
+
+      void operator()(const CurrentSuper&) {
+        // Should define this method to make sure the RTTI call compiles.
+        CURRENT_ASSERT(false);
+      }
+
+     private:
+      bool& goes_to_a_;
+    };
+
+    // Passes on each run of consecutive messages going to the same side as a batch, preserving the order of messages.
+    void OnThreadSafeMessages(std::vector<movable_message_t>&& xs) override {
+      std::vector<movable_message_t> run;
+      bool run_goes_to_a = false;
+      for (auto& x : xs) {
+        bool goes_to_a = false;
+        RTTIDynamicCall<metaprogramming::TypeListUnion<TypeListImpl<A_LHS...>, TypeListImpl<B_LHS...>>,
+                        const CurrentSuper&>(*x, SideDetector(goes_to_a));
+        if (!run.empty() && goes_to_a != run_goes_to_a) {
+          PassOnRun(std::move(run), run_goes_to_a);
+          run.clear();
+        }
+        run_goes_to_a = goes_to_a;
+        run.push_back(std::move(x));
+      }
+      if (!run.empty()) {
+        PassOnRun(std::move(run), run_goes_to_a);
+      }
+    }
+
    private:
+    void PassOnRun(std::vector<movable_message_t>&& run, bool goes_to_a) {
+      if (goes_to_a) {
+        a_->OnThreadSafeMessages(std::move(run));
+      } else {
+        b_->OnThreadSafeMessages(std::move(run));
+      }
+    }
+
     // Helper passthrough `next` handlers.
     struct PassOnToNextA : BlockOutgoingInterface<ThreadUnsafeOutgoingTypes<A_RHS...>> {
       std::shared_ptr<BlockOutgoingInterface<ThreadUnsafeOutgoingTypes<AB_RHS...>>> next;
       PassOnToNextA(std::shared_ptr<BlockOutgoingInterface<ThreadUnsafeOutgoingTypes<AB_RHS...>>> next) : next(next) {}
+      void OnThreadUnsafeEmitted(movable_message_t&& x, time::DefaultTimeArgument t) override {
+        next->OnThreadUnsafeEmitted(std::move(x), t);
+      }
       void OnThreadUnsafeEmitted(movable_message_t&& x, std::chrono::microseconds t) override {
         next->OnThreadUnsafeEmitted(std::move(x), t);
       }
@@ -898,6 +1420,9 @@ class SharedParallelImpl<LHSTypes<AB_LHS...>,
     struct PassOnToNextB : BlockOutgoingInterface<ThreadUnsafeOutgoingTypes<B_RHS...>> {
       std::shared_ptr<BlockOutgoingInterface<ThreadUnsafeOutgoingTypes<AB_RHS...>>> next;
       PassOnToNextB(std::shared_ptr<BlockOutgoingInterface<ThreadUnsafeOutgoingTypes<AB_RHS...>>> next) : next(next) {}
+      void OnThreadUnsafeEmitted(movable_message_t&& x, time::DefaultTimeArgument t) override {
+        next->OnThreadUnsafeEmitted(std::move(x), t);
+      }
       void OnThreadUnsafeEmitted(movable_message_t&& x, std::chrono::microseconds t) override {
         next->OnThreadUnsafeEmitted(std::move(x), t);
       }
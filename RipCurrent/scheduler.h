@@ -0,0 +1,409 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2016 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+// Schedulers to run RipCurrent blocks.
+//
+// By default, each `|` boundary of a RipCurrent flow owns an `mmq::MMPQ`, which spawns its own consumer thread.
+// For wide flows this results in dozens of mostly idle threads. The alternative is to run the flow on a scheduler:
+// each block gets a `ScheduledMMPQ` inbox, and a fixed pool of worker threads runs the inboxes that have ready messages.
+//
+// The guarantees are the same as with the thread-per-MMPQ model:
+// * An inbox is never processed by more than one worker at a time, so the user code remains single-threaded.
+// * Messages are delivered in the order of their timestamps, with `schedule<>` and `head<>` respected.
+//
+// Usage: `auto scheduler = std::make_shared<WorkStealingScheduler>(8); (...).RipCurrent(scheduler).Join();`.
+
+#ifndef CURRENT_RIPCURRENT_SCHEDULER_H
+#define CURRENT_RIPCURRENT_SCHEDULER_H
+
+#include "../port.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "../Blocks/MMQ/mmpq.h"
+#include "../Blocks/SS/ss.h"
+
+#include "../Bricks/sync/locks.h"
+#include "../Bricks/time/chrono.h"
+#include "../Bricks/util/singleton.h"
+
+namespace current {
+namespace ripcurrent {
+
+// The unit of work for the scheduler: the inbox of a single RipCurrent block.
+class GenericSchedulableInbox {
+ public:
+  virtual ~GenericSchedulableInbox() = default;
+
+  // Processes up to `max_messages` ready messages.
+  // Returns `true` if there are more ready messages, and the inbox should be scheduled again.
+  virtual bool ProcessReadyMessages(size_t max_messages) = 0;
+};
+
+// The interface of the scheduler. `Schedule()` is only called for an inbox that is not already scheduled,
+// and the inbox is guaranteed to outlive the call to its `ProcessReadyMessages()` by the scheduler.
+class GenericScheduler {
+ public:
+  virtual ~GenericScheduler() = default;
+  virtual void Schedule(GenericSchedulableInbox*) = 0;
+};
+
+// A fixed pool of worker threads, each with its own deque of scheduled inboxes.
+// A worker takes the most recently scheduled inbox from its own deque, as it is most likely to be cache-hot,
+// and, when its own deque is empty, steals the least recently scheduled inbox from the deques of other workers.
+// Inboxes scheduled from within a worker (i.e., by the blocks it runs) go into this worker's deque.
+class WorkStealingScheduler final : public GenericScheduler {
+ public:
+  explicit WorkStealingScheduler(size_t number_of_threads = std::thread::hardware_concurrency(),
+                                 size_t max_messages_per_turn = 64)
+      : max_messages_per_turn_(std::max(max_messages_per_turn, static_cast<size_t>(1))) {
+    const size_t n = std::max(number_of_threads, static_cast<size_t>(1));
+    queues_.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+      queues_.emplace_back(std::make_unique<WorkerQueue>());
+    }
+    threads_.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+      threads_.emplace_back(&WorkStealingScheduler::WorkerThread, this, i);
+    }
+  }
+
+  // The destructor processes everything that has been scheduled, and joins the worker threads.
+  // All the RipCurrent flows run on this scheduler must be joined before it is destroyed.
+  ~WorkStealingScheduler() {
+    {
+      std::lock_guard<std::mutex> lock(sleep_mutex_);
+      destructing_ = true;
+    }
+    sleep_condition_variable_.notify_all();
+    for (auto& thread : threads_) {
+      thread.join();
+    }
+  }
+
+  size_t NumberOfThreads() const { return threads_.size(); }
+
+  void Schedule(GenericSchedulableInbox* inbox) override {
+    const WorkerIdentity& worker = ThreadLocalSingleton<WorkerIdentity>();
+    const size_t index =
+        (worker.scheduler == this) ? worker.index : (round_robin_index_++ % queues_.size());
+    {
+      WorkerQueue& queue = *queues_[index];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      queue.deque.push_back(inbox);
+    }
+    ++pending_;
+    if (sleeping_) {
+      std::lock_guard<std::mutex> lock(sleep_mutex_);
+      sleep_condition_variable_.notify_one();
+    }
+  }
+
+ private:
+  WorkStealingScheduler(const WorkStealingScheduler&) = delete;
+  WorkStealingScheduler(WorkStealingScheduler&&) = delete;
+  void operator=(const WorkStealingScheduler&) = delete;
+  void operator=(WorkStealingScheduler&&) = delete;
+
+  struct WorkerQueue final {
+    std::mutex mutex;
+    std::deque<GenericSchedulableInbox*> deque;
+  };
+
+  // Which scheduler, if any, is the current thread the worker of, to keep the inboxes it schedules local.
+  struct WorkerIdentity final {
+    const WorkStealingScheduler* scheduler = nullptr;
+    size_t index = 0u;
+  };
+
+  // Reserves one of the `pending_` inboxes for the calling worker, if there is one.
+  bool ReservePendingInbox() {
+    size_t pending = pending_;
+    while (pending) {
+      if (pending_.compare_exchange_weak(pending, pending - 1)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Blocks until one of the `pending_` inboxes is reserved for the calling worker.
+  // Returns `false` if the scheduler is terminating and nothing is pending anymore.
+  bool WaitForPendingInbox() {
+    if (ReservePendingInbox()) {
+      return true;
+    }
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    ++sleeping_;
+    bool reserved = false;
+    sleep_condition_variable_.wait(lock,
+                                   [this, &reserved]() {
+                                     reserved = ReservePendingInbox();
+                                     return reserved || destructing_;
+                                   });
+    --sleeping_;
+    return reserved;
+  }
+
+  // Takes the inbox reserved via `WaitForPendingInbox()`: first from the back of own deque, then from the fronts
+  // of other deques. The reservation guarantees some deque has an inbox not reserved by another worker.
+  GenericSchedulableInbox* TakeReservedInbox(size_t index) {
+    while (true) {
+      {
+        WorkerQueue& own = *queues_[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.deque.empty()) {
+          GenericSchedulableInbox* result = own.deque.back();
+          own.deque.pop_back();
+          return result;
+        }
+      }
+      for (size_t i = 1; i < queues_.size(); ++i) {
+        WorkerQueue& victim = *queues_[(index + i) % queues_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.deque.empty()) {
+          GenericSchedulableInbox* result = victim.deque.front();
+          victim.deque.pop_front();
+          return result;
+        }
+      }
+      std::this_thread::yield();
+    }
+  }
+
+  void WorkerThread(size_t index) {
+    WorkerIdentity& worker = ThreadLocalSingleton<WorkerIdentity>();
+    worker.scheduler = this;
+    worker.index = index;
+    while (WaitForPendingInbox()) {
+      GenericSchedulableInbox* inbox = TakeReservedInbox(index);
+      if (inbox->ProcessReadyMessages(max_messages_per_turn_)) {
+        // Still has ready messages. Put it on the stealable end of own deque, to let other inboxes make progress.
+        {
+          WorkerQueue& own = *queues_[index];
+          std::lock_guard<std::mutex> lock(own.mutex);
+          own.deque.push_front(inbox);
+        }
+        ++pending_;
+      }
+    }
+    worker.scheduler = nullptr;
+  }
+
+  const size_t max_messages_per_turn_;
+  std::vector<std::unique_ptr<WorkerQueue>> queues_;
+  std::atomic_size_t pending_{0u};
+  std::atomic_size_t sleeping_{0u};
+  std::atomic_size_t round_robin_index_{0u};
+  std::mutex sleep_mutex_;
+  std::condition_variable sleep_condition_variable_;
+  bool destructing_ = false;
+  std::vector<std::thread> threads_;
+};
+
+// `ScheduledMMPQ` is the scheduler-driven counterpart of `mmq::MMPQ`, with the same timestamp semantics:
+// `Publish()` requires strictly increasing timestamps and moves the head, `PublishIntoTheFuture()` keeps the head
+// where it is, and `UpdateHead()` moves the head forward. Messages are dispatched in the order of their timestamps
+// once the head reaches them. Instead of owning a thread, the inbox asks the scheduler to run it when a message
+// becomes ready. Just as with `mmq::MMPQ`, ready messages are drained in batches of up to `max_batch_size`,
+// the consumer is called with the lock released, and its `OnBatchEnd()`, if defined, is called after each batch.
+template <typename MESSAGE, typename CONSUMER>
+class ScheduledMMPQ final : public GenericSchedulableInbox {
+  static_assert(current::ss::IsEntrySubscriber<CONSUMER, MESSAGE>::value, "");
+
+ public:
+  using message_t = MESSAGE;
+  using consumer_t = CONSUMER;
+
+  ScheduledMMPQ(consumer_t& consumer, std::shared_ptr<GenericScheduler> scheduler, size_t max_batch_size = 1024u)
+      : consumer_(consumer),
+        scheduler_(scheduler),
+        max_batch_size_(std::max(max_batch_size, static_cast<size_t>(1))) {}
+
+  // The destructor waits until the scheduler is done with this inbox. The messages still queued are dropped,
+  // which is consistent with `mmq::MMPQ`; RipCurrent waits for all the messages to be processed beforehand.
+  ~ScheduledMMPQ() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    condition_variable_.wait(lock, [this]() { return !scheduled_; });
+  }
+
+  // `US` is either `std::chrono::microseconds` or `current::time::DefaultTimeArgument`, as in `mmq::MMPQ`.
+  template <current::locks::MutexLockStatus MLS = current::locks::MutexLockStatus::NeedToLock, typename US>
+  idxts_t Publish(message_t&& message, const US timestamp) {
+    idxts_t result;
+    bool schedule;
+    {
+      locks::SmartMutexLockGuard<MLS> lock(mutex_);
+      const std::chrono::microseconds us = current::time::GetTimestampFromLockedSection(timestamp, last_idx_ts_.us);
+      if (!(us > last_idx_ts_.us)) {
+        CURRENT_THROW(ss::InconsistentTimestampException(last_idx_ts_.us + std::chrono::microseconds(1), us));
+      }
+      ++last_idx_ts_.index;
+      last_idx_ts_.us = us;
+      queue_.emplace(std::move(message), last_idx_ts_);
+      result = last_idx_ts_;
+      schedule = (MLS == current::locks::MutexLockStatus::NeedToLock) && MarkScheduledIfReady();
+    }
+    if (schedule) {
+      scheduler_->Schedule(this);
+    }
+    return result;
+  }
+
+  template <current::locks::MutexLockStatus MLS = current::locks::MutexLockStatus::NeedToLock>
+  idxts_t PublishIntoTheFuture(message_t&& message, const std::chrono::microseconds us) {
+    locks::SmartMutexLockGuard<MLS> lock(mutex_);
+    if (!(us > last_idx_ts_.us)) {
+      CURRENT_THROW(ss::InconsistentTimestampException(last_idx_ts_.us + std::chrono::microseconds(1), us));
+    }
+    ++last_idx_ts_.index;
+    // Don't update the timestamp.
+    queue_.emplace(std::move(message), idxts_t(last_idx_ts_.index, us));
+    return last_idx_ts_;
+  }
+
+  template <current::locks::MutexLockStatus MLS = current::locks::MutexLockStatus::NeedToLock>
+  void UpdateHead(const std::chrono::microseconds us) {
+    bool schedule;
+    {
+      locks::SmartMutexLockGuard<MLS> lock(mutex_);
+      if (!(us > last_idx_ts_.us)) {
+        CURRENT_THROW(ss::InconsistentTimestampException(last_idx_ts_.us + std::chrono::microseconds(1), us));
+      }
+      last_idx_ts_.us = us;
+      schedule = (MLS == current::locks::MutexLockStatus::NeedToLock) && MarkScheduledIfReady();
+    }
+    if (schedule) {
+      scheduler_->Schedule(this);
+    }
+  }
+
+  // Runs `f()` with the mutex locked, for the caller to make a series of `MutexLockStatus::AlreadyLocked` calls
+  // at the cost of a single lock acquisition and at most one call to the scheduler. `f()` must not throw.
+  template <typename F>
+  void WithLockedMutex(F&& f) {
+    bool schedule;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      f();
+      schedule = MarkScheduledIfReady();
+    }
+    if (schedule) {
+      scheduler_->Schedule(this);
+    }
+  }
+
+  bool ProcessReadyMessages(size_t max_messages) override {
+    size_t processed = 0u;
+    while (processed < max_messages) {
+      idxts_t last_idx_ts;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!HasReadyMessage()) {
+          scheduled_ = false;
+          condition_variable_.notify_all();
+          return false;
+        }
+        const size_t batch_size = std::min(max_batch_size_, max_messages - processed);
+        while (batch_.size() < batch_size && HasReadyMessage()) {
+          auto it = queue_.begin();
+          batch_.emplace_back(std::move(const_cast<Entry&>(*it).message_body), it->index_timestamp);
+          queue_.erase(it);
+        }
+        last_idx_ts = last_idx_ts_;
+      }
+      for (auto& entry : batch_) {
+        consumer_(std::move(entry.message_body), entry.index_timestamp, last_idx_ts);
+      }
+      processed += batch_.size();
+      batch_.clear();
+      mmq::impl::CallOnBatchEndIfDefined(consumer_);
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (HasReadyMessage()) {
+      return true;
+    } else {
+      scheduled_ = false;
+      condition_variable_.notify_all();
+      return false;
+    }
+  }
+
+ private:
+  ScheduledMMPQ(const ScheduledMMPQ&) = delete;
+  ScheduledMMPQ(ScheduledMMPQ&&) = delete;
+  void operator=(const ScheduledMMPQ&) = delete;
+  void operator=(ScheduledMMPQ&&) = delete;
+
+  bool HasReadyMessage() const { return !queue_.empty() && queue_.begin()->index_timestamp.us <= last_idx_ts_.us; }
+
+  // Must be called with `mutex_` locked. Returns `true` if the caller should schedule this inbox once unlocked.
+  bool MarkScheduledIfReady() {
+    if (!scheduled_ && HasReadyMessage()) {
+      scheduled_ = true;
+      return true;
+    } else {
+      return false;
+    }
+  }
+
+  struct Entry {
+    idxts_t index_timestamp;
+    message_t message_body;
+    Entry() = default;
+    Entry(Entry&&) = default;
+    Entry(message_t&& message_body, idxts_t index_timestamp)
+        : index_timestamp(index_timestamp), message_body(std::move(message_body)) {}
+    bool operator<(const Entry& rhs) const { return index_timestamp.us < rhs.index_timestamp.us; }
+  };
+
+  consumer_t& consumer_;
+  const std::shared_ptr<GenericScheduler> scheduler_;
+  const size_t max_batch_size_;
+
+  std::set<Entry> queue_;
+  idxts_t last_idx_ts_ = idxts_t(0, std::chrono::microseconds(-1));
+  std::mutex mutex_;
+  std::condition_variable condition_variable_;
+
+  // Whether this inbox is in the scheduler's queue or being processed by a worker.
+  bool scheduled_ = false;
+
+  // Only accessed by the worker processing this inbox.
+  std::vector<Entry> batch_;
+};
+
+}  // namespace current::ripcurrent
+}  // namespace current
+
+#endif  // CURRENT_RIPCURRENT_SCHEDULER_H
@@ -27,6 +27,7 @@ SOFTWARE.
 #include "../port.h"
 
 #include <atomic>
+#include <numeric>
 
 #include "ripcurrent.h"
 
@@ -98,6 +99,40 @@ RIPCURRENT_NODE(RCDump, Integer, void) {
 };
 #define RCDump(...) RIPCURRENT_MACRO(RCDump, __VA_ARGS__)
 
+// `RCBatchDump`: The destination of events which accepts them in batches. Collects the integers and the batch sizes.
+RIPCURRENT_NODE(RCBatchDump, Integer, void) {
+  static std::string UnitTestClassName() { return "RCBatchDump"; }
+  std::vector<int>* ptr;
+  std::vector<size_t>* batch_sizes;
+  RCBatchDump() : ptr(nullptr), batch_sizes(nullptr) {}  // LCOV_EXCL_LINE
+  RCBatchDump(std::vector<int>& ref, std::vector<size_t>& batch_sizes) : ptr(&ref), batch_sizes(&batch_sizes) {}
+  void f(std::vector<Integer>&& xs) {
+    CURRENT_ASSERT(ptr);
+    CURRENT_ASSERT(!xs.empty());
+    for (const auto& x : xs) {
+      ptr->push_back(x.value);
+    }
+    batch_sizes->push_back(xs.size());
+  }
+};
+#define RCBatchDump(...) RIPCURRENT_MACRO(RCBatchDump, __VA_ARGS__)
+
+// `RCMultAndStall`: Multiplies each integer, and then keeps processing it until released.
+RIPCURRENT_NODE(RCMultAndStall, Integer, Integer) {
+  static std::string UnitTestClassName() { return "RCMultAndStall"; }
+  int k;
+  std::atomic_bool* released;
+  RCMultAndStall() : k(1), released(nullptr) {}  // LCOV_EXCL_LINE
+  RCMultAndStall(int k, std::atomic_bool& released) : k(k), released(&released) {}
+  void f(Integer x) {
+    emit<Integer>(x.value * k);
+    while (!*released) {
+      std::this_thread::yield();
+    }
+  }
+};
+#define RCMultAndStall(...) RIPCURRENT_MACRO(RCMultAndStall, __VA_ARGS__)
+
 }  // namespace ripcurrent_unittest
 // clang-format on
 
@@ -1035,3 +1070,157 @@ TEST(RipCurrent, TemplatedFlow) {
   ((TemplatedEmitter(Integer) + TemplatedEmitter(String)) | DumpIntegerAndString(std::ref(result))).RipCurrent().Join();
   EXPECT_EQ("42, 'The Answer'", current::strings::Join(result, ", "));
 }
+
+TEST(RipCurrent, WorkStealingScheduler) {
+  current::time::ResetToZero();
+
+  using namespace ripcurrent_unittest;
+
+  const auto scheduler = std::make_shared<current::ripcurrent::WorkStealingScheduler>(2u);
+  EXPECT_EQ(2u, scheduler->NumberOfThreads());
+
+  {
+    std::vector<int> result;
+    (RCEmit(1, 2, 3) | RCMult(2) | RCMult(5) | RCMult(10) | RCDump(std::ref(result))).RipCurrent(scheduler).Join();
+    EXPECT_EQ("100,200,300", current::strings::Join(result, ','));
+  }
+
+  {
+    std::vector<std::string> result;
+    ((EmitInteger() + EmitBool(false) + EmitString() + EmitBool(true)) |
+     (DumpInteger(std::ref(result)) + (DumpBool(std::ref(result)) + DumpString(std::ref(result)))))
+        .RipCurrent(scheduler)
+        .Join();
+    EXPECT_EQ("42, False, 'Answer', True", current::strings::Join(result, ", "));
+  }
+
+  {
+    // More concurrently running flows than worker threads.
+    std::vector<std::vector<int>> results(10);
+    std::vector<current::ripcurrent::RipCurrentScope> scopes;
+    for (size_t i = 0; i < results.size(); ++i) {
+      scopes.push_back((RCEmit(1, 2, 3) | RCMult(static_cast<int>(i)) | RCMult(10) | RCDump(std::ref(results[i])))
+                           .RipCurrent(scheduler));
+    }
+    for (auto& scope : scopes) {
+      scope.Join();
+    }
+    for (size_t i = 0; i < results.size(); ++i) {
+      EXPECT_EQ(current::strings::Join(std::vector<size_t>({10 * i, 20 * i, 30 * i}), ','),
+                current::strings::Join(results[i], ','));
+    }
+  }
+}
+
+TEST(RipCurrent, WorkStealingSchedulerRespectsHead) {
+  using namespace ripcurrent_unittest;
+
+  const auto scheduler = std::make_shared<current::ripcurrent::WorkStealingScheduler>(2u);
+
+  std::function<void(int, std::chrono::microseconds)> post;
+  std::function<void(int, std::chrono::microseconds)> schedule;
+  std::function<void(std::chrono::microseconds)> head;
+  std::atomic_size_t counter(0u);
+  std::vector<int> result;
+
+  {
+    const auto scope = std::move((RCEmitterWithTimestamps(std::ref(post), std::ref(schedule), std::ref(head)) |
+                                  RCDump(std::ref(result), std::ref(counter)))
+                                     .RipCurrent(scheduler)
+                                     .Async());
+
+    post(4, std::chrono::microseconds(4));
+    schedule(9, std::chrono::microseconds(9));
+    post(5, std::chrono::microseconds(5));
+    schedule(7, std::chrono::microseconds(7));
+
+    while (counter != 2u) {
+      std::this_thread::yield();
+    }
+    EXPECT_EQ("4,5", current::strings::Join(result, ','));
+
+    head(std::chrono::microseconds(8));
+    while (counter != 3u) {
+      std::this_thread::yield();
+    }
+    EXPECT_EQ("4,5,7", current::strings::Join(result, ','));
+
+    post(10, std::chrono::microseconds(10));
+    while (counter != 5u) {
+      std::this_thread::yield();
+    }
+    EXPECT_EQ("4,5,7,9,10", current::strings::Join(result, ','));
+  }
+}
+
+TEST(RipCurrent, BatchedDelivery) {
+  current::time::ResetToZero();
+
+  using namespace ripcurrent_unittest;
+
+  {
+    std::vector<int> result;
+    std::vector<size_t> batch_sizes;
+    (RCEmit(1, 2, 3) | RCMult(2) | RCBatchDump(std::ref(result), std::ref(batch_sizes))).RipCurrent().Join();
+    EXPECT_EQ("2,4,6", current::strings::Join(result, ','));
+    EXPECT_EQ(3u, std::accumulate(batch_sizes.begin(), batch_sizes.end(), 0u));
+  }
+
+  {
+    std::vector<int> result;
+    std::vector<size_t> batch_sizes;
+    (RCEmit(1, 2, 3) | RCMult(3) | RCBatchDump(std::ref(result), std::ref(batch_sizes)))
+        .RipCurrent(current::ripcurrent::RunParameters().SetMaxBatchSize(1u))
+        .Join();
+    EXPECT_EQ("3,6,9", current::strings::Join(result, ','));
+    EXPECT_EQ("1,1,1", current::strings::Join(batch_sizes, ','));
+  }
+
+  {
+    std::vector<int> result;
+    std::vector<size_t> batch_sizes;
+    (RCEmit(1, 2, 3) | RCMult(4) | RCMult(5) | RCBatchDump(std::ref(result), std::ref(batch_sizes)))
+        .RipCurrent(current::ripcurrent::RunParameters()
+                        .SetScheduler(std::make_shared<current::ripcurrent::WorkStealingScheduler>(2u))
+                        .SetMaxBatchSize(2u))
+        .Join();
+    EXPECT_EQ("20,40,60", current::strings::Join(result, ','));
+    EXPECT_EQ(3u, std::accumulate(batch_sizes.begin(), batch_sizes.end(), 0u));
+    for (const size_t size : batch_sizes) {
+      EXPECT_LE(size, 2u);
+    }
+  }
+
+  {
+    // Batches are split between the blocks combined with `+`, preserving the order of messages.
+    std::vector<std::string> result;
+    (EmitIntegerAndString() | MultIntegerOrString(2) | (DumpInteger(std::ref(result)) + DumpString(std::ref(result))))
+        .RipCurrent(current::ripcurrent::RunParameters().SetMaxBatchLatency(std::chrono::microseconds(0)))
+        .Join();
+    EXPECT_EQ("'Yo? Answer Yo!', 84", current::strings::Join(result, ", "));
+  }
+}
+
+TEST(RipCurrent, BatchLatencyIsEnforcedWhileTheBlockIsBusy) {
+  current::time::ResetToZero();
+
+  using namespace ripcurrent_unittest;
+
+  std::vector<int> result;
+  std::atomic_size_t count(0u);
+  std::atomic_bool released(false);
+  {
+    // The message emitted by `RCMultAndStall` must arrive within `max_batch_latency`, although the block,
+    // having emitted it, keeps processing, and no more messages follow.
+    auto scope = (RCEmit(1) | RCMultAndStall(2, std::ref(released)) | RCDump(std::ref(result), std::ref(count)))
+                     .RipCurrent(current::ripcurrent::RunParameters().SetMaxBatchLatency(std::chrono::milliseconds(10)));
+    const auto begin = std::chrono::steady_clock::now();
+    while (!count && std::chrono::steady_clock::now() - begin < std::chrono::seconds(10)) {
+      std::this_thread::yield();
+    }
+    EXPECT_EQ(1u, count);
+    released = true;
+    scope.Join();
+  }
+  EXPECT_EQ("2", current::strings::Join(result, ','));
+}
@@ -164,10 +164,14 @@ class StreamImpl {
     idxts_t PublishImpl(ARGS&&... args) {
       try {
         auto& data = *data_;
+        const uint64_t begin_ns = current::metrics::NowNS();
         current::locks::SmartMutexLockGuard<MLS> lock(data.publish_mutex);
         const auto result = data.persistence.template Publish<current::locks::MutexLockStatus::AlreadyLocked>(
             std::forward<ARGS>(args)...);
         data.notifier.NotifyAllOfExternalWaitableEvent();
+        data.metrics.published.Add();
+        data.metrics.size.Set(static_cast<int64_t>(result.index + 1u));
+        data.metrics.publish_ns.Record(current::metrics::NowNS() - begin_ns);
         return result;
       } catch (const current::sync::InDestructingModeException&) {
         CURRENT_THROW(StreamInGracefulShutdownException());
@@ -341,7 +345,9 @@ class StreamImpl {
       // Keep the subscriber thread exception-safe. By construction, it's guaranteed to live
       // strictly within the scope of existence of `stream_data_t` contained in `data_`.
       stream_data_t& bare_data = data_.ObjectAccessorDespitePossiblyDestructing();
+      bare_data.metrics.subscribers.Add(1);
       ThreadImpl(bare_data, begin_idx_);
+      bare_data.metrics.subscribers.Add(-1);
       subscriber_thread_done_ = true;
       std::lock_guard<std::mutex> lock(bare_data.http_subscriptions_mutex);
       if (done_callback_) {
@@ -367,13 +373,15 @@ class StreamImpl {
         size = Exists(head_idx.idxts) ? Value(head_idx.idxts).index + 1 : 0;
         if (head_idx.head > head) {
           if (size > index) {
-            for (const auto& e : bare_data.persistence.Iterate(index, size)) {
+            bare_data.metrics.lag.Record(size - index);
+            for (const auto& e : bare_data.persistence.template IterateOfType<TYPE_SUBSCRIBED_TO>(index, size)) {
               if (!terminate_sent && terminate_signal_) {
                 terminate_sent = true;
                 if (subscriber_.Terminate() != ss::TerminationResponse::Wait) {
                   return;
                 }
               }
+              bare_data.metrics.delivered.Add();
               if (current::ss::PassEntryToSubscriberIfTypeMatches<TYPE_SUBSCRIBED_TO, entry_t>(
                       subscriber_,
                       [this]() -> ss::EntryResponse { return subscriber_.EntryResponseIfNoMorePassTypeFilter(); },
@@ -31,6 +31,8 @@ SOFTWARE.
 #include <thread>
 
 #include "../Blocks/Persistence/persistence.h"
+#include "../Blocks/SS/signature.h"
+#include "../Bricks/util/metrics.h"
 #include "../Bricks/util/random.h"
 #include "../Bricks/util/sha256.h"
 #include "../Bricks/util/waitable_terminate_signal.h"
@@ -96,6 +98,28 @@ class AbstractSubscriberObject {
   virtual ~AbstractSubscriberObject() = default;
 };
 
+// The metrics of the stream, labeled by its namespace and entry names. Streams of the same names share them.
+struct StreamMetrics {
+  current::metrics::Counter& published;
+  current::metrics::Histogram& publish_ns;  // Including the time spent waiting for `publish_mutex`.
+  current::metrics::Gauge& size;
+  current::metrics::Gauge& subscribers;
+  current::metrics::Counter& delivered;  // Entries passed to the subscribers, summed over the subscribers.
+  current::metrics::Histogram& lag;      // How many entries behind the subscriber is when it wakes up.
+
+  explicit StreamMetrics(const ss::StreamNamespaceName& name)
+      : StreamMetrics(current::metrics::Labels{{"namespace", name.namespace_name}, {"entry", name.entry_name}}) {}
+
+ private:
+  explicit StreamMetrics(const current::metrics::Labels& labels)
+      : published(current::metrics::Registry().GetCounter("current_stream_published_total", labels)),
+        publish_ns(current::metrics::Registry().GetHistogram("current_stream_publish_ns", labels)),
+        size(current::metrics::Registry().GetGauge("current_stream_size", labels)),
+        subscribers(current::metrics::Registry().GetGauge("current_stream_subscribers", labels)),
+        delivered(current::metrics::Registry().GetCounter("current_stream_delivered_total", labels)),
+        lag(current::metrics::Registry().GetHistogram("current_stream_subscriber_lag", labels)) {}
+};
+
 template <typename ENTRY, template <typename> class PERSISTENCE_LAYER>
 struct StreamData {
   using entry_t = ENTRY;
@@ -110,9 +134,11 @@ struct StreamData {
   http_subscriptions_t http_subscriptions;
   std::mutex http_subscriptions_mutex;
 
+  StreamMetrics metrics;
+
   template <typename... ARGS>
-  StreamData(ARGS&&... args)
-      : persistence(publish_mutex, std::forward<ARGS>(args)...) {}
+  StreamData(const ss::StreamNamespaceName& namespace_name, ARGS&&... args)
+      : persistence(publish_mutex, namespace_name, std::forward<ARGS>(args)...), metrics(namespace_name) {}
 
   static std::string GenerateRandomHTTPSubscriptionID() {
     return current::SHA256("sherlock_http_subscription_" +
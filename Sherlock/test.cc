@@ -257,6 +257,35 @@ TEST(Sherlock, SubscribeSynchronously) {
       << Join(expected_values, ',') << " != " << d.results_;
 }
 
+TEST(Sherlock, Metrics) {
+  current::time::ResetToZero();
+
+  using namespace sherlock_unittest;
+
+  auto stream = current::sherlock::Stream<Record>(current::ss::StreamNamespaceName("SherlockMetrics", "Record"));
+  const current::metrics::Labels labels{{"namespace", "SherlockMetrics"}, {"entry", "Record"}};
+  auto& registry = current::metrics::Registry();
+
+  current::time::SetNow(std::chrono::microseconds(1));
+  stream.Publish(1);
+  current::time::SetNow(std::chrono::microseconds(2));
+  stream.Publish(2);
+  EXPECT_EQ(2u, registry.GetCounter("current_stream_published_total", labels).Value());
+  EXPECT_EQ(2u, registry.GetHistogram("current_stream_publish_ns", labels).Values().count);
+  EXPECT_EQ(2, registry.GetGauge("current_stream_size", labels).Value());
+
+  Data d;
+  {
+    SherlockTestProcessor p(d, false);
+    p.SetMax(2u);
+    stream.Subscribe(p);
+    EXPECT_EQ(2u, d.seen_);
+  }
+  EXPECT_EQ(2u, registry.GetCounter("current_stream_delivered_total", labels).Value());
+  EXPECT_EQ(2u, registry.GetHistogram("current_stream_subscriber_lag", labels).Values().sum);
+  EXPECT_EQ(0, registry.GetGauge("current_stream_subscribers", labels).Value());
+}
+
 TEST(Sherlock, SubscribeHandleGoesOutOfScopeBeforeAnyProcessing) {
   current::time::ResetToZero();
 
@@ -339,6 +368,64 @@ TEST(Sherlock, SubscribeProcessedThreeEntriesBecauseWeWaitInTheScope) {
 
 namespace sherlock_unittest {
 
+// Checks that the entries are replayed in order, with no gaps, and counts them.
+struct ReplayCheckerImpl {
+  std::atomic_size_t& seen_;
+  bool& in_order_;
+
+  ReplayCheckerImpl(std::atomic_size_t& seen, bool& in_order) : seen_(seen), in_order_(in_order) {}
+
+  EntryResponse operator()(const Record& entry, idxts_t current, idxts_t) {
+    if (current.index != seen_ || entry.x != static_cast<int>(seen_) ||
+        current.us != std::chrono::microseconds(seen_ + 1u)) {
+      in_order_ = false;  // LCOV_EXCL_LINE
+    }
+    ++seen_;
+    return EntryResponse::More;
+  }
+
+  EntryResponse operator()(std::chrono::microseconds) const { return EntryResponse::More; }
+
+  static EntryResponse EntryResponseIfNoMorePassTypeFilter() { return EntryResponse::More; }
+
+  TerminationResponse Terminate() { return TerminationResponse::Terminate; }
+};
+
+using ReplayChecker = current::ss::StreamSubscriber<ReplayCheckerImpl, Record>;
+
+}  // namespace sherlock_unittest
+
+TEST(Sherlock, ReplayWhilePublishing) {
+  current::time::ResetToZero();
+
+  using namespace sherlock_unittest;
+
+  // The in-memory persister lets the subscriber replay the entries without grabbing the mutex of the stream,
+  // so replaying the ones published before does not stall, and is not stalled by, the concurrent publisher.
+  const size_t N = 50000u;
+  auto stream = current::sherlock::Stream<Record>();
+  for (size_t i = 0u; i < N; ++i) {
+    stream.Publish(static_cast<int>(i), std::chrono::microseconds(i + 1u));
+  }
+
+  std::atomic_size_t seen(0u);
+  bool in_order = true;
+  ReplayChecker checker(seen, in_order);
+  {
+    const auto scope = stream.Subscribe(checker);
+    for (size_t i = N; i < 2u * N; ++i) {
+      stream.Publish(static_cast<int>(i), std::chrono::microseconds(i + 1u));
+    }
+    while (seen < 2u * N) {
+      std::this_thread::yield();
+    }
+  }
+  EXPECT_EQ(2u * N, seen);
+  EXPECT_TRUE(in_order);
+}
+
+namespace sherlock_unittest {
+
 // Collector class for `SubscribeToStreamViaHTTP` test.
 struct RecordsCollectorImpl {
   std::atomic_size_t count_;
@@ -1016,6 +1103,34 @@ TEST(Sherlock, SubscribeWithFilterByType) {
     stream.Subscribe<AnotherRecord>(c);
     EXPECT_EQ("Y=2 Y=4", Join(c.results_, ' '));
   }
+
+  // Same with the stream persisted into a file, which does not parse the entries of other types.
+  const std::string persistence_file_name = current::FileSystem::JoinPath(FLAGS_sherlock_test_tmpdir, "data");
+  const auto persistence_file_remover = current::FileSystem::ScopedRmFile(persistence_file_name);
+  auto persisted =
+      current::sherlock::Stream<Variant<Record, AnotherRecord>, current::persistence::File>(persistence_file_name);
+  for (int i = 1; i <= 5; ++i) {
+    current::time::SetNow(std::chrono::microseconds(i + 10));
+    if (i & 1) {
+      persisted.Publish(Record(i));
+    } else {
+      persisted.Publish(AnotherRecord(i));
+    }
+  }
+
+  {
+    using Collector = current::ss::StreamSubscriber<CollectorImpl, Record>;
+    Collector c(3);
+    persisted.Subscribe<Record>(c);
+    EXPECT_EQ("X=1 X=3 X=5", Join(c.results_, ' '));
+  }
+
+  {
+    using Collector = current::ss::StreamSubscriber<CollectorImpl, AnotherRecord>;
+    Collector c(2);
+    persisted.Subscribe<AnotherRecord>(c);
+    EXPECT_EQ("Y=2 Y=4", Join(c.results_, ' '));
+  }
 }
 
 TEST(Sherlock, ReleaseAndAcquirePublisher) {
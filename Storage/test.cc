@@ -1275,6 +1275,30 @@ TEST(TransactionalStorage, TransactionMetaFields) {
   }
 }
 
+TEST(TransactionalStorage, TransactionMetrics) {
+  current::time::ResetToZero();
+
+  using namespace transactional_storage_test;
+  using Storage = TestStorage<SherlockInMemoryStreamPersister>;
+
+  const auto& metrics = current::storage::transaction_policy::TransactionMetrics::ReadWrite();
+  const auto& read_only_metrics = current::storage::transaction_policy::TransactionMetrics::ReadOnly();
+  const uint64_t wait_count = metrics.wait_ns.Values().count;
+  const uint64_t held_count = metrics.held_ns.Values().count;
+  const uint64_t read_only_count = read_only_metrics.held_ns.Values().count;
+
+  Storage storage;
+  current::time::SetNow(std::chrono::microseconds(100));
+  EXPECT_TRUE(WasCommitted(
+      storage.ReadWriteTransaction([](MutableFields<Storage> fields) { fields.d.Add(Record{"one", 1}); }).Go()));
+  EXPECT_TRUE(WasCommitted(
+      storage.ReadOnlyTransaction([](ImmutableFields<Storage> fields) { EXPECT_EQ(1u, fields.d.Size()); }).Go()));
+
+  EXPECT_EQ(wait_count + 1u, metrics.wait_ns.Values().count);
+  EXPECT_EQ(held_count + 1u, metrics.held_ns.Values().count);
+  EXPECT_EQ(read_only_count + 1u, read_only_metrics.held_ns.Values().count);
+}
+
 TEST(TransactionalStorage, LastModifiedInDictionaryContainer) {
   current::time::ResetToZero();
 
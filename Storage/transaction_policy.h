@@ -32,6 +32,7 @@ SOFTWARE.
 #include "transaction_result.h"
 
 #include "../Bricks/util/future.h"
+#include "../Bricks/util/metrics.h"
 
 #include "../Blocks/SS/ss.h"
 #include "../Blocks/Persistence/exceptions.h"
@@ -40,13 +41,38 @@ namespace current {
 namespace storage {
 namespace transaction_policy {
 
+// The time transactions spend waiting for the storage mutex and holding it, summed over all the storages.
+struct TransactionMetrics {
+  current::metrics::Histogram& wait_ns;
+  current::metrics::Histogram& held_ns;
+
+  explicit TransactionMetrics(const std::string& mode)
+      : wait_ns(current::metrics::Registry().GetHistogram("current_storage_transaction_wait_ns", {{"mode", mode}})),
+        held_ns(current::metrics::Registry().GetHistogram("current_storage_transaction_held_ns", {{"mode", mode}})) {}
+
+  static const TransactionMetrics& ReadWrite() {
+    static TransactionMetrics metrics("read_write");
+    return metrics;
+  }
+
+  static const TransactionMetrics& ReadOnly() {
+    static TransactionMetrics metrics("read_only");
+    return metrics;
+  }
+};
+
 template <class PERSISTER>
 class Synchronous final {
  public:
   using transaction_t = typename PERSISTER::transaction_t;
+  using timed_lock_t = current::metrics::TimedLockGuard<std::mutex>;
 
   Synchronous(std::mutex& storage_mutex, PERSISTER& persister, MutationJournal& journal)
-      : storage_mutex_ref_(storage_mutex), persister_(persister), journal_(journal) {}
+      : storage_mutex_ref_(storage_mutex),
+        persister_(persister),
+        journal_(journal),
+        read_write_metrics_(TransactionMetrics::ReadWrite()),
+        read_only_metrics_(TransactionMetrics::ReadOnly()) {}
 
   ~Synchronous() {
     std::lock_guard<std::mutex> lock(storage_mutex_ref_);
@@ -60,7 +86,7 @@ class Synchronous final {
   template <typename F, class = std::enable_if_t<!std::is_void<f_result_t<F>>::value>>
   Future<TransactionResult<f_result_t<F>>, StrictFuture::Strict> Transaction(F&& f) {
     using result_t = f_result_t<F>;
-    std::lock_guard<std::mutex> lock(storage_mutex_ref_);
+    timed_lock_t lock(storage_mutex_ref_, read_write_metrics_.wait_ns, read_write_metrics_.held_ns);
     journal_.AssertEmpty();
     std::promise<TransactionResult<result_t>> promise;
     if (destructing_) {
@@ -102,7 +128,7 @@ class Synchronous final {
   template <typename F, class = std::enable_if_t<!std::is_void<f_result_t<F>>::value>>
   Future<TransactionResult<f_result_t<F>>, StrictFuture::Strict> Transaction(F&& f) const {
     using result_t = f_result_t<F>;
-    std::lock_guard<std::mutex> lock(storage_mutex_ref_);
+    timed_lock_t lock(storage_mutex_ref_, read_only_metrics_.wait_ns, read_only_metrics_.held_ns);
     journal_.AssertEmpty();
     std::promise<TransactionResult<result_t>> promise;
     if (destructing_) {
@@ -137,7 +163,7 @@ class Synchronous final {
   // Read-write transaction returning void type.
   template <typename F, class = std::enable_if_t<std::is_void<f_result_t<F>>::value>>
   Future<TransactionResult<void>, StrictFuture::Strict> Transaction(F&& f) {
-    std::lock_guard<std::mutex> lock(storage_mutex_ref_);
+    timed_lock_t lock(storage_mutex_ref_, read_write_metrics_.wait_ns, read_write_metrics_.held_ns);
     journal_.AssertEmpty();
     std::promise<TransactionResult<void>> promise;
     if (destructing_) {
@@ -176,7 +202,7 @@ class Synchronous final {
   // Read-only transaction returning void type.
   template <typename F, class = std::enable_if_t<std::is_void<f_result_t<F>>::value>>
   Future<TransactionResult<void>, StrictFuture::Strict> Transaction(F&& f) const {
-    std::lock_guard<std::mutex> lock(storage_mutex_ref_);
+    timed_lock_t lock(storage_mutex_ref_, read_only_metrics_.wait_ns, read_only_metrics_.held_ns);
     journal_.AssertEmpty();
     std::promise<TransactionResult<void>> promise;
     if (destructing_) {
@@ -210,7 +236,7 @@ class Synchronous final {
   template <typename F1, typename F2, class = std::enable_if_t<!std::is_void<f_result_t<F1>>::value>>
   Future<TransactionResult<void>, StrictFuture::Strict> Transaction(F1&& f1, F2&& f2) {
     using result_t = f_result_t<F1>;
-    std::lock_guard<std::mutex> lock(storage_mutex_ref_);
+    timed_lock_t lock(storage_mutex_ref_, read_write_metrics_.wait_ns, read_write_metrics_.held_ns);
     journal_.AssertEmpty();
     std::promise<TransactionResult<void>> promise;
     if (destructing_) {
@@ -252,7 +278,7 @@ class Synchronous final {
   template <typename F1, typename F2, class = std::enable_if_t<!std::is_void<f_result_t<F1>>::value>>
   Future<TransactionResult<void>, StrictFuture::Strict> Transaction(F1&& f1, F2&& f2) const {
     using result_t = f_result_t<F1>;
-    std::lock_guard<std::mutex> lock(storage_mutex_ref_);
+    timed_lock_t lock(storage_mutex_ref_, read_only_metrics_.wait_ns, read_only_metrics_.held_ns);
     journal_.AssertEmpty();
     std::promise<TransactionResult<void>> promise;
     if (destructing_) {
@@ -309,6 +335,8 @@ class Synchronous final {
   MutationJournal& journal_;
   std::mutex mutex_;
   bool destructing_ = false;
+  const TransactionMetrics& read_write_metrics_;
+  const TransactionMetrics& read_only_metrics_;
 };
 
 }  // namespace transaction_policy
@@ -26,6 +26,7 @@ SOFTWARE.
 #ifndef CURRENT_TYPE_SYSTEM_REFLECTION_TYPES_H
 #define CURRENT_TYPE_SYSTEM_REFLECTION_TYPES_H
 
+#include <functional>
 #include <string>
 #include <sstream>
 #include <vector>
@@ -74,6 +74,15 @@ struct SUPER : REFLECTION_HELPER, SUPER_SELECTOR<INSTANTIATION_TYPE, T>::type {
   constexpr static const char* CURRENT_STRUCT_NAME() { return REFLECTION_HELPER::CURRENT_STRUCT_NAME(); }
   using CURRENT_FIELD_COUNT_STRUCT = typename REFLECTION_HELPER::CURRENT_FIELD_COUNT_STRUCT;
   static const char* CURRENT_REFLECTION_FIELD_DESCRIPTION(...) { return nullptr; }
+
+  // Overrides `CurrentSuper::CurrentRTTITypeID()` in the `DF` instantiation, and adds no vtable to the `FC` one.
+  // On non-Windows platforms the `SUPER`-s of all the instantiations of a `CURRENT_STRUCT_T` are the same type,
+  // so templated structs are left to the `std::type_index`-based dispatching.
+  static size_t CurrentStaticRTTITypeID() {
+    return std::is_same<TEMPLATE_INNER, std::true_type>::value ? ::current::metaprogramming::kUnknownRTTITypeID
+                                                               : ::current::metaprogramming::RTTITypeID<SUPER>();
+  }
+  size_t CurrentRTTITypeID() const { return CurrentStaticRTTITypeID(); }
 #ifdef CURRENT_WINDOWS
   using FIELD_INDEX_BASE = typename REFLECTION_HELPER::FIELD_INDEX_BASE;
 #endif
@@ -1487,3 +1487,177 @@ TEST(TypeSystemTest, DISABLED_NestedVariants)
     EXPECT_EQ(3u, Value<Bar>(Value<Variant<Bar, Baz>>(v)).j);
   }
 }
+
+namespace struct_definition_test {
+
+// The `tracker` is not a field, it is only here to confirm each object gets destroyed exactly once.
+CURRENT_STRUCT(WithTracker) {
+  CURRENT_FIELD(k, uint64_t, 0u);
+  std::shared_ptr<int> tracker;
+  CURRENT_CONSTRUCTOR(WithTracker)(std::shared_ptr<int> tracker = nullptr) : tracker(tracker) {}
+};
+
+}  // namespace struct_definition_test
+
+TEST(TypeSystemTest, VariantInlineAndHeapStorage) {
+  using namespace struct_definition_test;
+  using variant_t = Variant<Foo, Baz, WithTracker, DerivedFromFoo>;
+
+  const auto stored_inline = [](const variant_t& v, const void* object) {
+    return object >= static_cast<const void*>(&v) && object < static_cast<const void*>(&v + 1);
+  };
+
+  {
+    // Small objects live within the `Variant` itself, large ones are allocated on the heap.
+    variant_t foo(Foo(1u));
+    variant_t baz(Baz{});
+    EXPECT_EQ(static_cast<bool>(CURRENT_VARIANT_INLINE_STORAGE_BYTES), stored_inline(foo, &Value<Foo>(foo)));
+    EXPECT_FALSE(stored_inline(baz, &Value<Baz>(baz)));
+    EXPECT_EQ(1u, Value<Foo>(foo).i);
+
+    // `DerivedFromFoo` is both itself and `Foo`, while a `Foo` is not a `DerivedFromFoo`.
+    variant_t derived(DerivedFromFoo(2u));
+    EXPECT_TRUE(Exists<DerivedFromFoo>(derived));
+    EXPECT_TRUE(Exists<Foo>(derived));
+    EXPECT_FALSE(Exists<DerivedFromFoo>(foo));
+    EXPECT_EQ(2002u, Value<Foo>(derived).i);
+
+    // Moving an inline object moves it; moving a heap-allocated one just moves the pointer.
+    const Baz* baz_ptr = &Value<Baz>(baz);
+    variant_t moved_foo(std::move(foo));
+    variant_t moved_baz(std::move(baz));
+    EXPECT_FALSE(Exists(foo));
+    EXPECT_FALSE(Exists(baz));
+    EXPECT_EQ(1u, Value<Foo>(moved_foo).i);
+    EXPECT_EQ(baz_ptr, &Value<Baz>(moved_baz));
+
+    // Copies are deep, and assignments replace the object of any type with the object of any other type.
+    variant_t copy(moved_foo);
+    Value<Foo>(copy).i = 3u;
+    EXPECT_EQ(1u, Value<Foo>(moved_foo).i);
+    EXPECT_EQ(3u, Value<Foo>(copy).i);
+    copy = moved_baz;
+    EXPECT_TRUE(Exists<Baz>(copy));
+    EXPECT_NE(baz_ptr, &Value<Baz>(copy));
+    copy = moved_foo;
+    EXPECT_EQ(1u, Value<Foo>(copy).i);
+
+    // Self-assignment and assigning the own object do nothing.
+    copy = copy;
+    EXPECT_EQ(1u, Value<Foo>(copy).i);
+    copy = Value<Foo>(copy);
+    EXPECT_EQ(1u, Value<Foo>(copy).i);
+    copy = std::move(copy);
+    EXPECT_EQ(1u, Value<Foo>(copy).i);
+
+    // Moving into a `Variant` of a wider type keeps the object.
+    Variant<Foo, Bar, Baz, WithTracker, DerivedFromFoo> wider(std::move(moved_baz));
+    EXPECT_FALSE(Exists(moved_baz));
+    EXPECT_EQ(baz_ptr, &Value<Baz>(wider));
+    wider = std::move(moved_foo);
+    EXPECT_FALSE(Exists(moved_foo));
+    EXPECT_EQ(1u, Value<Foo>(wider).i);
+
+    // Moving into a `Variant` which can not hold the object throws, and keeps the source intact.
+    Variant<Bar> narrow;
+    variant_t source(Foo(4u));
+    EXPECT_THROW(narrow = std::move(source), IncompatibleVariantTypeException<Foo>);
+    EXPECT_FALSE(Exists(narrow));
+    EXPECT_EQ(4u, Value<Foo>(source).i);
+  }
+
+  {
+    // Each object is destroyed exactly once.
+    std::shared_ptr<int> tracker = std::make_shared<int>(0);
+    {
+      variant_t a(WithTracker{tracker});
+      EXPECT_EQ(2, tracker.use_count());
+      variant_t b(a);
+      EXPECT_EQ(3, tracker.use_count());
+      variant_t c(std::move(a));
+      EXPECT_EQ(3, tracker.use_count());
+      b = Foo();
+      EXPECT_EQ(2, tracker.use_count());
+      c = std::move(b);
+      EXPECT_EQ(1, tracker.use_count());
+      b = WithTracker{tracker};
+      c = b;
+      EXPECT_EQ(3, tracker.use_count());
+      c = nullptr;
+      EXPECT_EQ(2, tracker.use_count());
+    }
+    EXPECT_EQ(1, tracker.use_count());
+  }
+
+  {
+    // The JSON format and the behavior of the objects passed in as `std::unique_ptr`-s do not change.
+    variant_t foo(Foo(5u));
+    const variant_t parsed = ParseJSON<variant_t>(JSON(foo));
+    EXPECT_EQ(5u, Value<Foo>(parsed).i);
+    EXPECT_EQ(JSON(foo), JSON(parsed));
+
+    variant_t baz(current::BypassVariantTypeCheck(), std::make_unique<Baz>());
+    EXPECT_TRUE(Exists<Baz>(baz));
+    EXPECT_EQ(JSON(variant_t(Baz())), JSON(baz));
+  }
+}
+
+namespace struct_definition_test {
+
+struct RTTIDynamicCallByTypeIDHelper {
+  std::string s;
+  void operator()(const Foo& x) { s += "const Foo " + current::ToString(x.i) + '\n'; }
+  void operator()(Foo& x) { s += "Foo " + current::ToString(x.i) + '\n'; }
+  void operator()(Foo&& x) { s += "Foo&& " + current::ToString(x.i) + '\n'; }
+  void operator()(const DerivedFromFoo& x) { s += "const DerivedFromFoo " + current::ToString(x.i) + '\n'; }
+  void operator()(const Templated<Foo>& x) { s += "const Templated<Foo> " + current::ToString(x.i) + '\n'; }
+  void operator()(const Empty&) { s += "const Empty\n"; }
+  void operator()(const NotCurrentStructDerivedFromCurrentStruct&) { s += "const NotCurrentStruct\n"; }
+};
+
+}  // namespace struct_definition_test
+
+TEST(TypeSystemTest, RTTIDynamicCallByTypeID) {
+  using namespace struct_definition_test;
+  using current::metaprogramming::kUnknownRTTITypeID;
+  using current::CurrentSuper;
+
+  // Each non-templated `CURRENT_STRUCT` has its own id, and reports it through the base class.
+  EXPECT_NE(kUnknownRTTITypeID, Foo::CurrentStaticRTTITypeID());
+  EXPECT_NE(kUnknownRTTITypeID, DerivedFromFoo::CurrentStaticRTTITypeID());
+  EXPECT_NE(Foo::CurrentStaticRTTITypeID(), DerivedFromFoo::CurrentStaticRTTITypeID());
+  EXPECT_NE(Foo::CurrentStaticRTTITypeID(), Bar::CurrentStaticRTTITypeID());
+  EXPECT_EQ(DerivedFromFoo::CurrentStaticRTTITypeID(),
+            static_cast<const CurrentSuper&>(DerivedFromFoo()).CurrentRTTITypeID());
+#ifndef CURRENT_WINDOWS
+  EXPECT_EQ(kUnknownRTTITypeID, Templated<Foo>::CurrentStaticRTTITypeID());
+#endif  // CURRENT_WINDOWS
+
+  using typelist_t = TypeList<Foo, DerivedFromFoo, Templated<Foo>, Empty, NotCurrentStructDerivedFromCurrentStruct>;
+  RTTIDynamicCallByTypeIDHelper helper;
+
+  Foo foo(1u);
+  const DerivedFromFoo derived(2u);
+  const Templated<Foo> templated(3u, Foo());
+  const NotCurrentStructDerivedFromCurrentStruct not_current_struct;
+  RTTIDynamicCall<typelist_t>(static_cast<const CurrentSuper&>(foo), helper);
+  RTTIDynamicCall<typelist_t>(static_cast<CurrentSuper&>(foo), helper);
+  RTTIDynamicCall<typelist_t>(static_cast<CurrentSuper&&>(foo), helper);
+  RTTIDynamicCall<typelist_t>(static_cast<const CurrentSuper&>(derived), helper);
+  RTTIDynamicCall<typelist_t>(static_cast<const CurrentSuper&>(templated), helper);
+  RTTIDynamicCall<typelist_t>(static_cast<const CurrentSuper&>(Empty()), helper);
+  // Shares the id of `Empty`, and is still dispatched to its own handler.
+  RTTIDynamicCall<typelist_t>(static_cast<const CurrentSuper&>(not_current_struct), helper);
+  EXPECT_EQ(
+      "const Foo 1\n"
+      "Foo 1\n"
+      "Foo&& 1\n"
+      "const DerivedFromFoo 2002\n"
+      "const Templated<Foo> 3\n"
+      "const Empty\n"
+      "const NotCurrentStruct\n",
+      helper.s);
+
+  EXPECT_THROW(RTTIDynamicCall<TypeList<Foo>>(static_cast<const CurrentSuper&>(Bar()), helper),
+               current::metaprogramming::UnlistedTypeException);
+}
@@ -36,6 +36,7 @@ SOFTWARE.
 #include "../Bricks/template/decay.h"
 #include "../Bricks/template/enable_if.h"
 #include "../Bricks/template/pod.h"
+#include "../Bricks/template/rtti_dynamic_call.h"
 #include "../Bricks/template/variadic_indexes.h"
 
 namespace crnt {
@@ -43,6 +44,8 @@ namespace crnt {
 // The superclass for all Current-defined types, to enable polymorphic serialization and deserialization.
 struct CurrentSuper {
   virtual ~CurrentSuper() = default;
+  // The dense per-type id for `RTTIDynamicCall<>`, overridden by each non-templated `CURRENT_STRUCT`.
+  virtual size_t CurrentRTTITypeID() const { return ::current::metaprogramming::kUnknownRTTITypeID; }
 };
 
 // For `unique_ptr<>`-s.
@@ -35,6 +35,8 @@ SOFTWARE.
 #include "../port.h"  // `make_unique`.
 
 #include <memory>
+#include <new>
+#include <type_traits>
 
 #ifdef VARIANT_CHECKS_AT_RUNTIME_INSTEAD_OF_COMPILE_TIME
 // For runtime, not compile-time, extra checks.
@@ -66,8 +68,49 @@ using object_base_t = CurrentSuper;
 
 struct BypassVariantTypeCheck {};
 
+// The objects of the types that fit into `CURRENT_VARIANT_INLINE_STORAGE_BYTES` bytes, and can be moved without
+// throwing, are stored within the `Variant` itself. Larger objects are allocated on the heap.
+// Define `CURRENT_VARIANT_INLINE_STORAGE_BYTES` as zero to always allocate the objects on the heap.
+#ifndef CURRENT_VARIANT_INLINE_STORAGE_BYTES
+#define CURRENT_VARIANT_INLINE_STORAGE_BYTES 64
+#endif
+
 namespace variant {
 
+constexpr size_t kInlineStorageBytes = CURRENT_VARIANT_INLINE_STORAGE_BYTES;
+using inline_storage_t = typename std::aligned_storage<(kInlineStorageBytes ? kInlineStorageBytes : 1u)>::type;
+
+template <typename T>
+struct StoredInline {
+  constexpr static bool value = kInlineStorageBytes && sizeof(T) <= sizeof(inline_storage_t) &&
+                                alignof(T) <= alignof(inline_storage_t) && std::is_nothrow_move_constructible<T>::value;
+};
+
+// The index of the type of the object held by the `Variant`, when it is not known, or when there is no object.
+constexpr size_t kUnknownTypeIndex = static_cast<size_t>(-1);
+
+// `TypeIndex<T, TS...>::value` is the index of the first occurrence of `T` in `TS...`, or `kUnknownTypeIndex`.
+template <size_t I, typename T, typename... TS>
+struct TypeIndexImpl;
+
+template <size_t I, typename T>
+struct TypeIndexImpl<I, T> {
+  constexpr static size_t value = kUnknownTypeIndex;
+};
+
+template <size_t I, typename T, typename... TS>
+struct TypeIndexImpl<I, T, T, TS...> {
+  constexpr static size_t value = I;
+};
+
+template <size_t I, typename T, typename U, typename... TS>
+struct TypeIndexImpl<I, T, U, TS...> {
+  constexpr static size_t value = TypeIndexImpl<I + 1u, T, TS...>::value;
+};
+
+template <typename T, typename... TS>
+using TypeIndex = TypeIndexImpl<0u, T, TS...>;
+
 #ifdef VARIANT_CHECKS_AT_RUNTIME_INSTEAD_OF_COMPILE_TIME
 template <typename T>
 struct RegisterType {
@@ -124,10 +167,10 @@ struct IHasUncheckedMoveFromUniquePtr : CurrentVariant {
 // The user hold the risk of having duplicate types, and it's their responsibility to pass in a `TypeList<...>`
 // instead of a `TypeListImpl<...>` in such a case, to ensure type de-duplication takes place.
 
-// Initializes an `std::unique_ptr<current::variant::object_base_t>` given the object of the right type.
-// The input object could be an object itself (in which case it's copied),
-// an `std::move()`-d `std::unique_ptr` to that object (in which case it's moved),
-// or a bare pointer (in which case it's captured).
+// The `Variant` keeps the index of the type of its object in `TYPES...`, so that `Call()` is a jump table lookup,
+// with no RTTI involved. The object itself lives either in the inline storage of the `Variant`, or on the heap.
+// The objects passed in as an `std::unique_ptr<current::variant::object_base_t>` remain on the heap,
+// and their type index is looked up once, when they are moved in.
 template <typename NAME, typename TYPE_LIST>
 struct VariantImpl;
 
@@ -142,8 +185,9 @@ struct VariantImpl<NAME, TypeListImpl<TYPES...>> : IHasUncheckedMoveFromUniquePt
 
   VariantImpl() {}
 
-  VariantImpl(BypassVariantTypeCheck, std::unique_ptr<current::variant::object_base_t>&& rhs)
-      : object_(std::move(rhs)) {}
+  VariantImpl(BypassVariantTypeCheck, std::unique_ptr<current::variant::object_base_t>&& rhs) {
+    Adopt(std::move(rhs));
+  }
 
   // Use deep copy helper for all Variant types, including our own.
   VariantImpl(const VariantImpl& rhs) { CopyFrom(rhs); }
@@ -152,8 +196,8 @@ struct VariantImpl<NAME, TypeListImpl<TYPES...>> : IHasUncheckedMoveFromUniquePt
     CopyFrom(rhs);
   }
 
-  // Default move constructor for the same Variant type as ours.
-  VariantImpl(VariantImpl&& rhs) = default;
+  // Move constructor for the same Variant type as ours, leaves `rhs` empty.
+  VariantImpl(VariantImpl&& rhs) noexcept { StealFrom(rhs); }
 
 #ifdef VARIANT_CHECKS_AT_RUNTIME_INSTEAD_OF_COMPILE_TIME
   template <typename... RHS>
@@ -172,25 +216,32 @@ struct VariantImpl<NAME, TypeListImpl<TYPES...>> : IHasUncheckedMoveFromUniquePt
   VariantImpl(X&& input) {
     using decayed_t = current::decay<X>;
     variant::RuntimeTypeListHelpers<typelist_t>::template AssertContains<decayed_t>();
-    object_ = std::make_unique<decayed_t>(std::forward<X>(input));
+    Construct<decayed_t>(std::forward<X>(input));
   }
 #else
   template <typename X, class ENABLE = std::enable_if_t<TypeListContains<typelist_t, current::decay<X>>::value>>
   VariantImpl(X&& input) {
     using decayed_t = current::decay<X>;
-    object_ = std::make_unique<decayed_t>(std::forward<X>(input));
+    Construct<decayed_t>(std::forward<X>(input));
   }
 #endif  // VARIANT_CHECKS_AT_RUNTIME_INSTEAD_OF_COMPILE_TIME
 
-  void operator=(std::nullptr_t) { object_ = nullptr; }
+  ~VariantImpl() { Reset(); }
+
+  void operator=(std::nullptr_t) { Reset(); }
 
   VariantImpl& operator=(const VariantImpl& rhs) {
-    CopyFrom(rhs);
+    if (&rhs != this) {
+      CopyFrom(rhs);
+    }
     return *this;
   }
 
-  VariantImpl& operator=(VariantImpl&& rhs) {
-    object_ = std::move(rhs.object_);
+  VariantImpl& operator=(VariantImpl&& rhs) noexcept {
+    if (&rhs != this) {
+      Reset();
+      StealFrom(rhs);
+    }
     return *this;
   }
 
@@ -204,19 +255,24 @@ struct VariantImpl<NAME, TypeListImpl<TYPES...>> : IHasUncheckedMoveFromUniquePt
 #ifdef VARIANT_CHECKS_AT_RUNTIME_INSTEAD_OF_COMPILE_TIME
     variant::RuntimeTypeListHelpers<typelist_t>::template AssertContains<decayed_t>();
 #endif  // VARIANT_CHECKS_AT_RUNTIME_INSTEAD_OF_COMPILE_TIME
-    object_ = std::make_unique<decayed_t>(std::forward<X>(input));
+    Assign<decayed_t>(std::forward<X>(input));
     return *this;
   }
 
   void UncheckedMoveFromUniquePtr(std::unique_ptr<current::variant::object_base_t> input) override {
-    object_ = std::move(input);
+    Reset();
+    Adopt(std::move(input));
   }
 
   operator bool() const { return object_ ? true : false; }
 
   template <typename F>
   void Call(F&& f) {
-    if (object_) {
+    if (type_index_ != variant::kUnknownTypeIndex) {
+      using handler_t = void (*)(void*, F&&);
+      static const handler_t handlers[] = {&VariantImpl::template CallHandler<TYPES, F>...};
+      handlers[type_index_](object_as_is_, std::forward<F>(f));
+    } else if (object_) {
       current::metaprogramming::RTTIDynamicCall<typelist_t>(*object_, std::forward<F>(f));
     } else {
       CURRENT_THROW(UninitializedVariantOfTypeException<TYPES...>());
@@ -225,8 +281,13 @@ struct VariantImpl<NAME, TypeListImpl<TYPES...>> : IHasUncheckedMoveFromUniquePt
 
   template <typename F>
   void Call(F&& f) const {
-    if (object_) {
-      current::metaprogramming::RTTIDynamicCall<typelist_t>(*object_, std::forward<F>(f));
+    if (type_index_ != variant::kUnknownTypeIndex) {
+      using handler_t = void (*)(const void*, F&&);
+      static const handler_t handlers[] = {&VariantImpl::template ConstCallHandler<TYPES, F>...};
+      handlers[type_index_](object_as_is_, std::forward<F>(f));
+    } else if (object_) {
+      current::metaprogramming::RTTIDynamicCall<typelist_t>(
+          *static_cast<const current::variant::object_base_t*>(object_), std::forward<F>(f));
     } else {
       CURRENT_THROW(UninitializedVariantOfTypeException<TYPES...>());
     }
@@ -237,17 +298,18 @@ struct VariantImpl<NAME, TypeListImpl<TYPES...>> : IHasUncheckedMoveFromUniquePt
   // and thus will successfully retrieve a derived type as a base one,
   // regardless of whether the base one is present in `typelist_t`.
   // Use `Call()` to run a strict check.
+  // When the object is exactly of type `X`, no `dynamic_cast<>` is involved.
 
-  bool ExistsImpl() const { return (object_.get() != nullptr); }
+  bool ExistsImpl() const { return (object_ != nullptr); }
 
   template <typename X>
   std::enable_if_t<!std::is_same<X, current::variant::object_base_t>::value, bool> VariantExistsImpl() const {
-    return dynamic_cast<const X*>(object_.get()) != nullptr;
+    return HoldsExactly<X>() || dynamic_cast<const X*>(object_) != nullptr;
   }
 
   template <typename X>
   std::enable_if_t<!std::is_same<X, current::variant::object_base_t>::value, X&> VariantValueImpl() {
-    X* ptr = dynamic_cast<X*>(object_.get());
+    X* ptr = HoldsExactly<X>() ? static_cast<X*>(object_as_is_) : dynamic_cast<X*>(object_);
     if (ptr) {
       return *ptr;
     } else {
@@ -257,7 +319,7 @@ struct VariantImpl<NAME, TypeListImpl<TYPES...>> : IHasUncheckedMoveFromUniquePt
 
   template <typename X>
   const X& VariantValueImpl() const {
-    const X* ptr = dynamic_cast<const X*>(object_.get());
+    const X* ptr = HoldsExactly<X>() ? static_cast<const X*>(object_as_is_) : dynamic_cast<const X*>(object_);
     if (ptr) {
       return *ptr;
     } else {
@@ -275,21 +337,155 @@ struct VariantImpl<NAME, TypeListImpl<TYPES...>> : IHasUncheckedMoveFromUniquePt
   }
 
  private:
+  template <typename T, typename F>
+  static void CallHandler(void* object, F&& f) {
+    f(*static_cast<T*>(object));
+  }
+
+  template <typename T, typename F>
+  static void ConstCallHandler(const void* object, F&& f) {
+    f(*static_cast<const T*>(object));
+  }
+
+  template <typename T>
+  static void DestroyInlineHandler(void* object) {
+    static_cast<T*>(object)->~T();
+  }
+
+  template <typename T>
+  static void MoveInlineHandler(void* from, VariantImpl& into) {
+    into.template Construct<T>(std::move(*static_cast<T*>(from)));
+  }
+
+  template <typename X>
+  bool HoldsExactly() const {
+    return type_index_ != variant::kUnknownTypeIndex && type_index_ == variant::TypeIndex<X, TYPES...>::value;
+  }
+
+  bool StoredInline() const { return object_as_is_ == static_cast<const void*>(&inline_storage_); }
+
+  template <typename T, typename... ARGS>
+  std::enable_if_t<variant::StoredInline<T>::value> Construct(ARGS&&... args) {
+    ConstructInline<T>(std::forward<ARGS>(args)...);
+  }
+
+  template <typename T, typename... ARGS>
+  std::enable_if_t<!variant::StoredInline<T>::value> Construct(ARGS&&... args) {
+    T* object = new T(std::forward<ARGS>(args)...);
+    SetObject<T>(object);
+  }
+
+  template <typename T, typename... ARGS>
+  void ConstructInline(ARGS&&... args) {
+    T* object = new (&inline_storage_) T(std::forward<ARGS>(args)...);
+    SetObject<T>(object);
+  }
+
+  template <typename T>
+  void SetObject(T* object) {
+    type_index_ = variant::TypeIndex<T, TYPES...>::value;
+    object_ = object;
+    object_as_is_ = object;
+  }
+
+  // Constructs the new object before destroying the old one, as `input` may well be, or be part of, the old one.
+  template <typename T, typename X>
+  std::enable_if_t<variant::StoredInline<T>::value> Assign(X&& input) {
+    if (object_) {
+      T copy(std::forward<X>(input));
+      Reset();
+      ConstructInline<T>(std::move(copy));
+    } else {
+      ConstructInline<T>(std::forward<X>(input));
+    }
+  }
+
+  template <typename T, typename X>
+  std::enable_if_t<!variant::StoredInline<T>::value> Assign(X&& input) {
+    T* object = new T(std::forward<X>(input));
+    Reset();
+    SetObject<T>(object);
+  }
+
+  void Reset() {
+    if (object_) {
+      if (StoredInline()) {
+        using handler_t = void (*)(void*);
+        static const handler_t handlers[] = {&VariantImpl::template DestroyInlineHandler<TYPES>...};
+        handlers[type_index_](object_as_is_);
+      } else {
+        delete object_;
+      }
+      type_index_ = variant::kUnknownTypeIndex;
+      object_ = nullptr;
+      object_as_is_ = nullptr;
+    }
+  }
+
+  // Takes over the object of `rhs`, which must be of the same `TYPES...`, leaving `rhs` empty. Never throws.
+  template <typename RHS>
+  void StealFrom(RHS& rhs) noexcept {
+    if (rhs.object_) {
+      if (rhs.StoredInline()) {
+        using handler_t = void (*)(void*, VariantImpl&);
+        static const handler_t handlers[] = {&VariantImpl::template MoveInlineHandler<TYPES>...};
+        handlers[rhs.type_index_](rhs.object_as_is_, *this);
+        rhs.Reset();
+      } else {
+        type_index_ = rhs.type_index_;
+        object_ = rhs.object_;
+        object_as_is_ = rhs.object_as_is_;
+        rhs.type_index_ = variant::kUnknownTypeIndex;
+        rhs.object_ = nullptr;
+        rhs.object_as_is_ = nullptr;
+      }
+    }
+  }
+
+  // Finds out the type of the heap-allocated object, and takes ownership of it.
+  struct TypeAwareAdopt {
+    VariantImpl& self;
+    current::variant::object_base_t* object;
+    TypeAwareAdopt(VariantImpl& self, current::variant::object_base_t* object) : self(self), object(object) {}
+
+    template <typename U>
+    void operator()(U& instance) {
+      self.type_index_ = variant::TypeIndex<current::decay<U>, TYPES...>::value;
+      self.object_ = object;
+      self.object_as_is_ = &instance;
+    }
+  };
+
+  void Adopt(std::unique_ptr<current::variant::object_base_t>&& input) {
+    if (input) {
+      try {
+        TypeAwareAdopt adopter(*this, input.get());
+        current::metaprogramming::RTTIDynamicCall<typelist_t>(*input, adopter);
+      } catch (const current::metaprogramming::UnlistedTypeException&) {
+        // The object of a type not from `TYPES...` is kept as is, for `Call()` to throw when attempted.
+        type_index_ = variant::kUnknownTypeIndex;
+        object_ = input.get();
+        object_as_is_ = nullptr;
+      }
+      input.release();
+    }
+  }
+
   struct TypeAwareClone {
-    std::unique_ptr<current::variant::object_base_t>& into;
-    TypeAwareClone(std::unique_ptr<current::variant::object_base_t>& into) : into(into) {}
+    VariantImpl& into;
+    TypeAwareClone(VariantImpl& into) : into(into) {}
 
 #ifdef VARIANT_CHECKS_AT_RUNTIME_INSTEAD_OF_COMPILE_TIME
     template <typename U>
     void operator()(const U& instance) {
       using decayed_u = current::decay<U>;
       variant::RuntimeTypeListHelpers<typelist_t>::template AssertContains<decayed_u>();
-      into = std::make_unique<decayed_u>(instance);
+      into.template Assign<decayed_u>(instance);
     }
 #else
     template <typename U>
     std::enable_if_t<TypeListContains<typelist_t, current::decay<U>>::value> operator()(const U& instance) {
-      into = std::make_unique<current::decay<U>>(instance);
+      into.template Assign<current::decay<U>>(instance);
     }
 
     template <typename U>
@@ -299,25 +495,25 @@ struct VariantImpl<NAME, TypeListImpl<TYPES...>> : IHasUncheckedMoveFromUniquePt
 #endif  // VARIANT_CHECKS_AT_RUNTIME_INSTEAD_OF_COMPILE_TIME
   };
 
+  // Moves the object from another `Variant`. The heap-allocated objects are taken over, not moved.
+  template <typename... RHS>
   struct TypeAwareMove {
-    // `from` should not be an rvalue reference, as the move operation in `operator()` may still throw.
-    std::unique_ptr<current::variant::object_base_t>& from;
-    std::unique_ptr<current::variant::object_base_t>& into;
-    TypeAwareMove(std::unique_ptr<current::variant::object_base_t>& from,
-                  std::unique_ptr<current::variant::object_base_t>& into)
-        : from(from), into(into) {}
+    // `from` is left intact if the move operation in `operator()` throws.
+    VariantImpl<RHS...>& from;
+    VariantImpl& into;
+    TypeAwareMove(VariantImpl<RHS...>& from, VariantImpl& into) : from(from), into(into) {}
 
 #ifdef VARIANT_CHECKS_AT_RUNTIME_INSTEAD_OF_COMPILE_TIME
     template <typename U>
-    void operator()(U&&) {
+    void operator()(U&& instance) {
       using decayed_u = current::decay<U>;
       variant::RuntimeTypeListHelpers<typelist_t>::template AssertContains<decayed_u>();
-      into = std::move(from);
+      Move<decayed_u>(instance);
     }
 #else
     template <typename U>
-    std::enable_if_t<TypeListContains<typelist_t, current::decay<U>>::value> operator()(U&&) {
-      into = std::move(from);
+    std::enable_if_t<TypeListContains<typelist_t, current::decay<U>>::value> operator()(U&& instance) {
+      Move<current::decay<U>>(instance);
     }
 
     template <typename U>
@@ -325,30 +521,49 @@ struct VariantImpl<NAME, TypeListImpl<TYPES...>> : IHasUncheckedMoveFromUniquePt
       CURRENT_THROW(IncompatibleVariantTypeException<current::decay<U>>());
     }
 #endif  // VARIANT_CHECKS_AT_RUNTIME_INSTEAD_OF_COMPILE_TIME
+
+    template <typename T>
+    void Move(T& instance) {
+      if (from.StoredInline()) {
+        into.template Assign<T>(std::move(instance));
+        from.Reset();
+      } else {
+        into.Reset();
+        into.type_index_ = variant::TypeIndex<T, TYPES...>::value;
+        into.object_ = from.object_;
+        into.object_as_is_ = &instance;
+        from.type_index_ = variant::kUnknownTypeIndex;
+        from.object_ = nullptr;
+        from.object_as_is_ = nullptr;
+      }
+    }
   };
 
   template <typename... RHS>
   void CopyFrom(const VariantImpl<RHS...>& rhs) {
     if (rhs.object_) {
-      TypeAwareClone cloner(object_);
+      TypeAwareClone cloner(*this);
       rhs.Call(cloner);
     } else {
-      object_ = nullptr;
+      Reset();
     }
   }
 
   template <typename... RHS>
   void MoveFrom(VariantImpl<RHS...>&& rhs) {
     if (rhs.object_) {
-      TypeAwareMove mover(rhs.object_, object_);
+      TypeAwareMove<RHS...> mover(rhs, *this);
       rhs.Call(mover);
     } else {
-      object_ = nullptr;
+      Reset();
     }
   }
 
  private:
-  std::unique_ptr<current::variant::object_base_t> object_;
+  size_t type_index_ = variant::kUnknownTypeIndex;  // The index of the type of the object in `TYPES...`, if known.
+  current::variant::object_base_t* object_ = nullptr;  // The object, inline or on the heap, as the base type.
+  void* object_as_is_ = nullptr;                       // The object as its own type, if `type_index_` is known.
+  variant::inline_storage_t inline_storage_;
 };
 
 // `Variant<...>` can accept either a list of types, or a `TypeList<...>`.
@@ -38,6 +38,9 @@ struct Scenario {
   virtual ~Scenario() = default;
 
   virtual void RunOneQuery() = 0;
+
+  // The flags the scenario is run with, to include into its report. Empty unless the scenario has any.
+  virtual std::string Parameters() const { return std::string(); }
 };
 
 #define SCENARIO(name, description)                          \
@@ -54,7 +57,8 @@ struct ScenariosRegisterer {
   }
   void Synopsis() const {
     std::cout << "./.current/run --scenario={scenario} [--threads={threads_to_query_from}] "
-                 "[--secons={seconds_to_run_benchmark_for}." << std::endl;
+                 "[--seconds={seconds_to_run_benchmark_for}] [--qps={open_loop_target_rate}] [--report_json]."
+              << std::endl;
     for (const auto& scenario : map) {
       std::cout << "\t--scenario=" << scenario.first << " : " << scenario.second.first << std::endl;
     }
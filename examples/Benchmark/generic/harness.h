@@ -0,0 +1,202 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2016 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+#ifndef BENCHMARK_HARNESS_H
+#define BENCHMARK_HARNESS_H
+
+#include "../../../port.h"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "benchmark.h"
+
+#include "../../../TypeSystem/struct.h"
+
+#include "../../../Bricks/util/metrics.h"
+
+CURRENT_STRUCT(BenchmarkReport) {
+  CURRENT_FIELD(scenario, std::string);
+  CURRENT_FIELD(threads, uint32_t, 0u);
+  CURRENT_FIELD(seconds, double, 0.0);
+  CURRENT_FIELD(target_qps, double, 0.0);  // Zero for the closed-loop mode.
+  CURRENT_FIELD(queries, uint64_t, 0u);
+  CURRENT_FIELD(dropped, uint64_t, 0u);  // The queries scheduled in the open-loop mode, but not sent in time.
+  CURRENT_FIELD(qps, double, 0.0);
+  CURRENT_FIELD(p50_ns, uint64_t, 0u);
+  CURRENT_FIELD(p90_ns, uint64_t, 0u);
+  CURRENT_FIELD(p99_ns, uint64_t, 0u);
+  CURRENT_FIELD(p999_ns, uint64_t, 0u);
+  CURRENT_FIELD(max_ns, uint64_t, 0u);
+  CURRENT_FIELD(allocations_per_query, double, 0.0);  // Zero unless the binary includes `allocations.cc.h`.
+  CURRENT_FIELD(parameters, Optional<std::string>);  // The flags of the scenario, missing in the older baselines.
+};
+
+// The number of heap allocations made by the current thread, maintained by `allocations.cc.h`.
+inline uint64_t& ThreadAllocations() {
+  static thread_local uint64_t allocations = 0u;
+  return allocations;
+}
+
+// The latencies, in nanoseconds, with the precision of 1/256.
+using LatencyBuckets = current::metrics::LogLinearBuckets<7u>;
+
+// Runs the queries of `scenario` from `threads` threads for `seconds` seconds. With `qps` of zero, runs closed-loop,
+// each thread running the queries back to back. Otherwise runs open-loop, at the total rate of `qps`.
+inline BenchmarkReport RunBenchmark(Scenario& scenario,
+                                    const std::string& name,
+                                    size_t threads_count,
+                                    double seconds,
+                                    double qps) {
+  struct Thread {
+    Thread(Scenario& scenario, size_t index, size_t threads, double qps, uint64_t begin_ns, uint64_t end_ns)
+        : scenario_(scenario),
+          index_(index),
+          threads_(threads),
+          qps_(qps),
+          begin_ns_(begin_ns),
+          end_ns_(end_ns),
+          latencies_(LatencyBuckets::kBuckets, 0u),
+          thread_(&Thread::ThreadFunction, this) {}
+
+    void Join() { thread_.join(); }
+
+    Scenario& scenario_;
+    const size_t index_;
+    const size_t threads_;
+    const double qps_;
+    const uint64_t begin_ns_;
+    const uint64_t end_ns_;
+    uint64_t queries_ = 0u;
+    uint64_t dropped_ = 0u;
+    uint64_t max_ns_ = 0u;
+    uint64_t allocations_ = 0u;
+    std::vector<uint64_t> latencies_;
+    std::thread thread_;
+
+    void Record(uint64_t ns, uint64_t allocations) {
+      ++queries_;
+      allocations_ += allocations;
+      ++latencies_[LatencyBuckets::BucketIndex(ns)];
+      max_ns_ = std::max(max_ns_, ns);
+    }
+
+    void ThreadFunction() {
+      if (qps_ > 0) {
+        OpenLoop();
+      } else {
+        ClosedLoop();
+      }
+    }
+
+    // Runs the queries back to back. Only counts the queries completed within the desired number of seconds.
+    void ClosedLoop() {
+      while (true) {
+        const uint64_t allocations = ThreadAllocations();
+        const uint64_t query_begin_ns = current::metrics::NowNS();
+        scenario_.RunOneQuery();
+        const uint64_t query_end_ns = current::metrics::NowNS();
+        if (query_end_ns >= end_ns_) {
+          break;
+        }
+        Record(query_end_ns - query_begin_ns, ThreadAllocations() - allocations);
+      }
+    }
+
+    // Runs the queries at their scheduled times, the `i`-th query of this thread scheduled at
+    // `(i * threads + index) / qps` seconds from the beginning. If the previous query took longer
+    // than the interval, the next one is run right away, and its latency includes the time it has waited.
+    void OpenLoop() {
+      const double interval_ns = 1e9 * threads_ / qps_;
+      for (uint64_t i = 0u;; ++i) {
+        const uint64_t scheduled_ns = begin_ns_ + static_cast<uint64_t>(1e9 * index_ / qps_ + interval_ns * i);
+        if (scheduled_ns >= end_ns_) {
+          break;
+        }
+        uint64_t now_ns = current::metrics::NowNS();
+        if (now_ns >= end_ns_) {
+          // The queries which did not get to run within the desired number of seconds.
+          dropped_ += static_cast<uint64_t>((end_ns_ - scheduled_ns) / interval_ns) + 1u;
+          break;
+        }
+        // Sleep until shortly before the scheduled time, then yield, as sleeping alone tends to oversleep.
+        constexpr static uint64_t kSpinNS = 200000u;
+        if (scheduled_ns > now_ns + kSpinNS) {
+          std::this_thread::sleep_for(std::chrono::nanoseconds(scheduled_ns - now_ns - kSpinNS));
+        }
+        while ((now_ns = current::metrics::NowNS()) < scheduled_ns) {
+          std::this_thread::yield();
+        }
+        const uint64_t allocations = ThreadAllocations();
+        scenario_.RunOneQuery();
+        Record(current::metrics::NowNS() - scheduled_ns, ThreadAllocations() - allocations);
+      }
+    }
+  };
+
+  const uint64_t begin_ns = current::metrics::NowNS();
+  const uint64_t end_ns = begin_ns + static_cast<uint64_t>(seconds * 1e9);
+
+  std::vector<std::unique_ptr<Thread>> threads(threads_count);
+  for (size_t i = 0u; i < threads.size(); ++i) {
+    threads[i] = std::make_unique<Thread>(scenario, i, threads_count, qps, begin_ns, end_ns);
+  }
+
+  for (auto& t : threads) {
+    t->Join();
+  }
+
+  BenchmarkReport report;
+  report.scenario = name;
+  report.threads = static_cast<uint32_t>(threads_count);
+  report.seconds = seconds;
+  report.target_qps = qps;
+  const std::string parameters = scenario.Parameters();
+  if (!parameters.empty()) {
+    report.parameters = parameters;
+  }
+  std::vector<uint64_t> latencies(LatencyBuckets::kBuckets, 0u);
+  uint64_t allocations = 0u;
+  for (auto& t : threads) {
+    allocations += t->allocations_;
+    report.queries += t->queries_;
+    report.dropped += t->dropped_;
+    report.max_ns = std::max(report.max_ns, t->max_ns_);
+    for (size_t i = 0u; i < LatencyBuckets::kBuckets; ++i) {
+      latencies[i] += t->latencies_[i];
+    }
+  }
+  report.qps = report.queries / seconds;
+  report.allocations_per_query = report.queries ? static_cast<double>(allocations) / report.queries : 0.0;
+  report.p50_ns = LatencyBuckets::Percentile(latencies, report.queries, 0.5);
+  report.p90_ns = LatencyBuckets::Percentile(latencies, report.queries, 0.9);
+  report.p99_ns = LatencyBuckets::Percentile(latencies, report.queries, 0.99);
+  report.p999_ns = LatencyBuckets::Percentile(latencies, report.queries, 0.999);
+  return report;
+}
+
+#endif  // BENCHMARK_HARNESS_H
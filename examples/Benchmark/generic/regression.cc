@@ -0,0 +1,373 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2016 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+// The performance regression suite: runs a fixed matrix of the scenarios, saves the results along with
+// the description of the machine as JSON, and compares them against the baseline, which is checked in.
+//
+// NDEBUG=1 make .current/regression && ./.current/regression
+//
+// Exits with a nonzero code if the throughput of any case dropped, or its p99 latency grew, beyond the tolerance.
+// The tolerances are set by the flags, and can be overridden per case in the baseline.
+// Each run also times a fixed CPU-bound calibration loop, and the baseline numbers are scaled by the ratio of its
+// speed on this machine to its speed on the baseline machine, so that a baseline taken on a slower or faster machine
+// still guards against the regressions.
+// Run with `--regression_update_baseline` to save the results as the new baseline. The baseline is only saved on
+// a machine with at least `--regression_baseline_min_cores` cores, as the smaller ones are too noisy to be compared to.
+
+#include "../../../current.h"
+
+#include <fstream>
+#include <map>
+
+#include <unistd.h>
+
+#include "harness.h"
+#include "allocations.cc.h"
+
+#include "scenario_json.h"
+#include "scenario_json_types.h"
+#include "scenario_simple_http.h"
+#include "scenario_storage.h"
+#include "scenario_sherlock_replay.h"
+#include "scenario_persister_publish.h"
+#include "scenario_ripcurrent.h"
+#include "scenario_fncas.h"
+
+using namespace current;
+
+DEFINE_string(regression_output, "", "The file to save the results into, `current_regression.json` in `$TMPDIR` if empty.");
+DEFINE_string(regression_baseline, "golden/regression.json", "The baseline to compare the results against.");
+DEFINE_bool(regression_update_baseline, false, "Save the results as the new baseline, instead of comparing.");
+DEFINE_double(regression_seconds, 1.0, "Run each case for this many seconds.");
+DEFINE_uint32(regression_repetitions, 3, "Run each case this many times, and keep the fastest run, to reduce noise.");
+DEFINE_double(regression_qps_tolerance, 0.25, "The maximum relative drop of throughput from the baseline.");
+DEFINE_double(regression_p99_tolerance, 1.0, "The maximum relative growth of p99 latency from the baseline.");
+DEFINE_double(regression_p99_slack_ns, 5000.0, "Ignore the growth of p99 latency by less than this, it is noise.");
+DEFINE_string(regression_filter, "", "Only run the cases with this substring in the name.");
+DEFINE_uint32(regression_baseline_min_cores, 4u, "Refuse to save the baseline on a machine with fewer cores.");
+DEFINE_bool(regression_calibrate, true, "Scale the baseline by the relative speed of the calibration loop.");
+
+CURRENT_STRUCT(RegressionMachine) {
+  CURRENT_FIELD(hostname, std::string);
+  CURRENT_FIELD(cpu, std::string);
+  CURRENT_FIELD(cores, uint32_t, 0u);
+  CURRENT_FIELD(compiler, std::string);
+  CURRENT_FIELD(optimized, bool, false);  // Whether built with `NDEBUG=1`.
+  CURRENT_FIELD(calibration_qps, Optional<double>);  // The speed of `Calibrate()`, missing in the older baselines.
+  CURRENT_FIELD(timestamp, std::chrono::microseconds);
+};
+
+CURRENT_STRUCT(RegressionCase) {
+  CURRENT_FIELD(name, std::string);
+  CURRENT_FIELD(report, BenchmarkReport);
+  // Edit the baseline to set the per-case tolerances, for the cases that are noisier than the others.
+  CURRENT_FIELD(qps_tolerance, Optional<double>);
+  CURRENT_FIELD(p99_tolerance, Optional<double>);
+};
+
+CURRENT_STRUCT(RegressionRun) {
+  CURRENT_FIELD(machine, RegressionMachine);
+  CURRENT_FIELD(cases, std::vector<RegressionCase>);
+};
+
+struct RegressionMatrixEntry {
+  std::string name;
+  std::string scenario;
+  size_t threads;
+  std::function<void()> set_flags;
+};
+
+inline std::function<void()> JSONTypes(const std::string& action, const std::string& format) {
+  return [action, format]() {
+    FLAGS_json_types_shape = "all";
+    FLAGS_json_types_action = action;
+    FLAGS_json_types_format = format;
+  };
+}
+
+// The matrix of the cases. Each case sets the flags of its scenario before the scenario is constructed.
+inline std::vector<RegressionMatrixEntry> RegressionMatrix() {
+  return {
+      {"json_gen", "json", 1u, []() { FLAGS_json = "gen"; }},
+      {"json_parse", "json", 1u, []() { FLAGS_json = "parse"; }},
+      {"json_types_gen_current", "json_types", 1u, JSONTypes("gen", "current")},
+      {"json_types_parse_current", "json_types", 1u, JSONTypes("parse", "current")},
+      {"json_types_gen_minimalistic", "json_types", 1u, JSONTypes("gen", "minimalistic")},
+      {"json_types_parse_minimalistic", "json_types", 1u, JSONTypes("parse", "minimalistic")},
+      {"json_types_gen_javascript", "json_types", 1u, JSONTypes("gen", "javascript")},
+      {"json_types_parse_javascript", "json_types", 1u, JSONTypes("parse", "javascript")},
+      {"json_types_gen_fsharp", "json_types", 1u, JSONTypes("gen", "fsharp")},
+      {"json_types_parse_fsharp", "json_types", 1u, JSONTypes("parse", "fsharp")},
+      {"persister_publish_memory", "persister_publish", 1u, []() { FLAGS_persister_publish_file = ""; }},
+      {"persister_publish_file",
+       "persister_publish",
+       1u,
+       []() { FLAGS_persister_publish_file = ".current/regression_persister_publish.json"; }},
+      {"persister_replay",
+       "sherlock_replay",
+       1u,
+       []() {
+         FLAGS_sherlock_replay_entries = 10000u;
+         FLAGS_sherlock_replay_publish = false;
+       }},
+      {"storage_get",
+       "storage",
+       1u,
+       []() {
+         FLAGS_storage_transaction = "get";
+         FLAGS_storage_initial_size = 10000u;
+       }},
+      {"storage_put",
+       "storage",
+       1u,
+       []() {
+         FLAGS_storage_transaction = "put";
+         FLAGS_storage_initial_size = 10000u;
+       }},
+      {"http_qps",
+       "current_http_server",
+       4u,
+       []() { FLAGS_simple_http_local_top_port = FLAGS_simple_http_local_port; }},
+      {"ripcurrent", "ripcurrent", 1u, []() { FLAGS_ripcurrent_entries = 1000u; }},
+      {"fncas_eval", "fncas_function", 1u, []() { FLAGS_fncas_eval = "tape"; }},
+      {"fncas_gradient", "fncas_function", 1u, []() { FLAGS_fncas_eval = "gradient"; }},
+  };
+}
+
+inline RegressionMachine DescribeMachine() {
+  RegressionMachine machine;
+  char hostname[256] = {0};
+  if (!::gethostname(hostname, sizeof(hostname) - 1u)) {
+    machine.hostname = hostname;
+  }
+  // `FileSystem::ReadFileAsString()` can not be used, as the files in `/proc` report their size as zero.
+  // The x86 kernels report `model name`, the ARM ones `Hardware` or `CPU part`; keep the most specific one found.
+  std::ifstream cpuinfo("/proc/cpuinfo");
+  std::map<std::string, std::string> cpu_keys;
+  std::string line;
+  while (std::getline(cpuinfo, line)) {
+    const size_t colon = line.find(':');
+    if (colon != std::string::npos) {
+      const std::string key = strings::Trim(line.substr(0u, colon));
+      const std::string value = strings::Trim(line.substr(colon + 1u));
+      if (!value.empty() && !cpu_keys.count(key)) {
+        cpu_keys[key] = value;
+      }
+    }
+  }
+  for (const char* key : {"model name", "Hardware", "cpu model", "cpu", "CPU part"}) {
+    if (cpu_keys.count(key)) {
+      machine.cpu = cpu_keys[key];
+      break;
+    }
+  }
+  if (machine.cpu.empty()) {
+    machine.cpu = "unknown";
+  }
+  machine.cores = std::thread::hardware_concurrency();
+  machine.compiler = __VERSION__;
+#ifdef NDEBUG
+  machine.optimized = true;
+#endif
+  machine.timestamp = time::Now();
+  return machine;
+}
+
+// The calibration loop: a fixed mix of integer arithmetic, string formatting, allocations and tree lookups, roughly
+// what the scenarios do. Returns its iterations per second, the best of `--regression_repetitions` runs.
+// Run both before and after the cases, keeping the best, so that a transient slowdown of the machine does not skew it.
+inline double Calibrate() {
+  double best_qps = 0.0;
+  for (uint32_t i = 0u; i < std::max(FLAGS_regression_repetitions, 1u); ++i) {
+    volatile size_t sink = 0u;
+    uint64_t iterations = 0u;
+    const std::chrono::microseconds begin = time::Now();
+    const std::chrono::microseconds end =
+        begin + std::chrono::microseconds(static_cast<int64_t>(1e6 * FLAGS_regression_seconds));
+    std::chrono::microseconds now;
+    do {
+      std::map<std::string, uint64_t> map;
+      uint64_t x = iterations + 1u;
+      for (uint32_t j = 0u; j < 100u; ++j) {
+        x = x * 6364136223846793005ull + 1442695040888963407ull;
+        map[std::to_string(x % 1000u)] += x;
+      }
+      for (const auto& kv : map) {
+        sink = sink + kv.first.length() + static_cast<size_t>(kv.second);
+      }
+      ++iterations;
+      now = time::Now();
+    } while (now < end);
+    best_qps = std::max(best_qps, 1e6 * iterations / static_cast<double>((now - begin).count()));
+  }
+  return best_qps;
+}
+
+// Returns whether the case is within the tolerances, printing the comparison. The baseline is scaled by `speedup`,
+// the relative speed of this machine to the baseline one.
+inline bool Compare(const RegressionCase& baseline, const BenchmarkReport& report, double speedup) {
+  const double qps_tolerance = Exists(baseline.qps_tolerance) ? Value(baseline.qps_tolerance)
+                                                               : FLAGS_regression_qps_tolerance;
+  const double p99_tolerance = Exists(baseline.p99_tolerance) ? Value(baseline.p99_tolerance)
+                                                               : FLAGS_regression_p99_tolerance;
+  const double baseline_qps = baseline.report.qps * speedup;
+  const double baseline_p99_ns = baseline.report.p99_ns / speedup;
+  const bool qps_ok = report.qps >= baseline_qps * (1.0 - qps_tolerance);
+  const bool p99_ok = report.p99_ns <= baseline_p99_ns * (1.0 + p99_tolerance) ||
+                      report.p99_ns <= baseline_p99_ns + FLAGS_regression_p99_slack_ns;
+  const auto delta = [](double value, double baseline) {
+    return baseline ? strings::Printf("%+.1lf%%", 100.0 * (value - baseline) / baseline) : std::string("n/a");
+  };
+  std::cout << strings::Printf("%-30s %12.1lf QPS (%s)%s, p99 %10.1lfus (%s)%s, %.1lf allocations (%s)",
+                               baseline.name.c_str(),
+                               report.qps,
+                               delta(report.qps, baseline_qps).c_str(),
+                               qps_ok ? "" : " REGRESSION",
+                               1e-3 * report.p99_ns,
+                               delta(report.p99_ns, baseline_p99_ns).c_str(),
+                               p99_ok ? "" : " REGRESSION",
+                               report.allocations_per_query,
+                               delta(report.allocations_per_query, baseline.report.allocations_per_query).c_str())
+            << std::endl;
+  return qps_ok && p99_ok;
+}
+
+int main(int argc, char** argv) {
+  ParseDFlags(&argc, &argv);
+
+  const auto& registerer = Singleton<ScenariosRegisterer>();
+
+  RegressionRun run;
+  run.machine = DescribeMachine();
+  if (FLAGS_regression_update_baseline && run.machine.cores < FLAGS_regression_baseline_min_cores) {
+    std::cout << "Not saving the baseline on a machine with " << run.machine.cores << " cores, fewer than "
+              << FLAGS_regression_baseline_min_cores << ", as its results would be too noisy. "
+              << "Use a representative machine, or lower `--regression_baseline_min_cores`." << std::endl;
+    return 1;
+  }
+  const double calibration_qps_before = Calibrate();
+  for (const auto& entry : RegressionMatrix()) {
+    if (entry.name.find(FLAGS_regression_filter) == std::string::npos) {
+      continue;
+    }
+    entry.set_flags();
+    RegressionCase result;
+    result.name = entry.name;
+    for (uint32_t i = 0u; i < std::max(FLAGS_regression_repetitions, 1u); ++i) {
+      const auto scenario = registerer.map.at(entry.scenario).second();
+      const BenchmarkReport report =
+          RunBenchmark(*scenario, entry.scenario, entry.threads, FLAGS_regression_seconds, 0.0);
+      if (!i || report.qps > result.report.qps) {
+        result.report = report;
+      }
+    }
+    run.cases.push_back(std::move(result));
+  }
+  run.machine.calibration_qps = std::max(calibration_qps_before, Calibrate());
+
+  // Outside the source tree by default, so that the results of the runs never end up checked in.
+  std::string output = FLAGS_regression_output;
+  if (output.empty()) {
+    const char* tmpdir = std::getenv("TMPDIR");
+    output = FileSystem::JoinPath(tmpdir && *tmpdir ? tmpdir : "/tmp", "current_regression.json");
+  }
+  FileSystem::WriteStringToFile(JSON(run) + '\n', output.c_str());
+  std::cout << "Saved the results into `" << output << "`." << std::endl;
+
+  RegressionRun baseline;
+  bool has_baseline = false;
+  try {
+    baseline = ParseJSON<RegressionRun>(FileSystem::ReadFileAsString(FLAGS_regression_baseline));
+    has_baseline = true;
+  } catch (const CannotReadFileException&) {
+  }
+
+  const auto find_baseline_case = [&baseline](const std::string& name) {
+    return std::find_if(
+        baseline.cases.begin(), baseline.cases.end(), [&name](const RegressionCase& c) { return c.name == name; });
+  };
+
+  if (FLAGS_regression_update_baseline) {
+    // Keep the per-case tolerances of the previous baseline, and, with `--regression_filter`, the other cases.
+    std::vector<RegressionCase> cases;
+    for (const auto& c : baseline.cases) {
+      if (c.name.find(FLAGS_regression_filter) == std::string::npos) {
+        cases.push_back(c);
+      }
+    }
+    for (auto& result : run.cases) {
+      const auto cit = find_baseline_case(result.name);
+      if (cit != baseline.cases.end()) {
+        result.qps_tolerance = cit->qps_tolerance;
+        result.p99_tolerance = cit->p99_tolerance;
+      }
+      cases.push_back(result);
+    }
+    run.cases = std::move(cases);
+    const size_t slash = FLAGS_regression_baseline.rfind(FileSystem::GetPathSeparator());
+    if (slash != std::string::npos) {
+      FileSystem::MkDir(FLAGS_regression_baseline.substr(0u, slash), FileSystem::MkDirParameters::Silent);
+    }
+    FileSystem::WriteStringToFile(JSON(run) + '\n', FLAGS_regression_baseline.c_str());
+    std::cout << "Saved the results of " << run.cases.size() << " cases as the baseline." << std::endl;
+    return 0;
+  }
+
+  if (!has_baseline) {
+    std::cout << "No baseline in `" << FLAGS_regression_baseline << "`, run with `--regression_update_baseline` "
+              << "on a representative machine to record it." << std::endl;
+    return 1;
+  }
+  if (baseline.machine.cpu != run.machine.cpu || baseline.machine.cores != run.machine.cores ||
+      baseline.machine.optimized != run.machine.optimized) {
+    std::cout << "WARNING: The baseline was taken on `" << baseline.machine.cpu << "`, " << baseline.machine.cores
+              << " cores" << (baseline.machine.optimized ? ", optimized" : ", not optimized") << ", comparing against `"
+              << run.machine.cpu << "`, " << run.machine.cores << " cores"
+              << (run.machine.optimized ? ", optimized" : ", not optimized") << '.' << std::endl;
+  }
+  double speedup = 1.0;
+  if (!Exists(baseline.machine.calibration_qps)) {
+    std::cout << "WARNING: The baseline has no calibration, comparing the absolute numbers." << std::endl;
+  } else if (FLAGS_regression_calibrate) {
+    speedup = Value(run.machine.calibration_qps) / Value(baseline.machine.calibration_qps);
+    std::cout << strings::Printf("Calibration: %.1lf QPS, %.1lf QPS in the baseline, scaling the baseline by %.3lf.",
+                                 Value(run.machine.calibration_qps),
+                                 Value(baseline.machine.calibration_qps),
+                                 speedup)
+              << std::endl;
+  }
+
+  bool ok = true;
+  for (const auto& result : run.cases) {
+    const auto cit = find_baseline_case(result.name);
+    if (cit == baseline.cases.end()) {
+      std::cout << strings::Printf("%-30s %12.1lf QPS, no baseline", result.name.c_str(), result.report.qps)
+                << std::endl;
+    } else if (!Compare(*cit, result.report, speedup)) {
+      ok = false;
+    }
+  }
+  std::cout << (ok ? "OK." : "Performance regression detected.") << std::endl;
+  return ok ? 0 : 1;
+}
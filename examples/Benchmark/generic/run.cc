@@ -24,12 +24,20 @@ SOFTWARE.
 
 #include "../../../current.h"
 
+#include "harness.h"
+#include "allocations.cc.h"
+
 #include "scenario_golden_1k_qps.h"
 #include "scenario_json.h"
+#include "scenario_json_types.h"
 #include "scenario_simple_http.h"
 #include "scenario_storage.h"
 #include "scenario_nginx_client.h"
 #include "scenario_replication.h"
+#include "scenario_sherlock_replay.h"
+#include "scenario_persister_publish.h"
+#include "scenario_ripcurrent.h"
+#include "scenario_fncas.h"
 
 using namespace current;
 
@@ -43,60 +51,30 @@ DEFINE_int32(threads,
              "the measurement may be imprecise when run against a high-latency network,"
              "as more time would be spent waiting than running. Thus, this tool is only good for local tests.");
 
-static double NowInSeconds() {
-  // Don't use `current::time::Now()`, as it's under a mutex, and guaranteed to increase by at least 1 per call.
-  return 1e-6 *
-         std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch())
-             .count();
-}
-
-template <typename SCENARIO>
-void Run(const SCENARIO& scenario) {
-  struct Thread {
-    Thread(const SCENARIO& scenario, double total_seconds)
-        : scenario_(scenario),
-          wall_time_second_end_(NowInSeconds() + total_seconds),
-          queries_completed_within_desired_timeframe_(0u),
-          thread_(&Thread::ThreadFunction, this) {}
-
-    void Join() { thread_.join(); }
-
-    const SCENARIO& scenario_;
-    const double wall_time_second_end_;
-    size_t queries_completed_within_desired_timeframe_;
-    std::thread thread_;
-
-    // The thread function runs the queries continuously. It only counts the queries
-    // completed within the originally desired number of seconds in the final number.
-    void ThreadFunction() {
-      while (true) {
-        scenario_->RunOneQuery();
-
-        if (NowInSeconds() >= wall_time_second_end_) {
-          break;
-        }
-
-        ++queries_completed_within_desired_timeframe_;
-      }
-    }
-  };
+DEFINE_double(qps,
+              0.0,
+              "The target rate, in queries per second, for the open-loop mode. The queries are scheduled evenly "
+              "across the threads, and their latencies are measured from the scheduled times, so that a slow query "
+              "is not hidden by the queries it delayed. Set to zero to run closed-loop, at the maximum rate.");
 
-  std::vector<std::unique_ptr<Thread>> threads(FLAGS_threads);
-  for (auto& t : threads) {
-    t = std::make_unique<Thread>(scenario, FLAGS_seconds);
-  }
+DEFINE_bool(report_json, false, "Print the results as a single line of JSON, for regression tracking.");
 
-  for (auto& t : threads) {
-    t->Join();
-  }
-
-  size_t total_queries = 0u;
-  for (auto& t : threads) {
-    total_queries += t->queries_completed_within_desired_timeframe_;
+void Print(const BenchmarkReport& report) {
+  if (FLAGS_report_json) {
+    std::cout << JSON(report) << std::endl;
+  } else {
+    const auto us = [](uint64_t ns) { return strings::Printf("%.1lfus", 1e-3 * ns); };
+    if (Exists(report.parameters)) {
+      std::cout << Value(report.parameters) << ": ";
+    }
+    std::cout << std::setw(3) << report.qps << " QPS, p50 " << us(report.p50_ns) << ", p90 " << us(report.p90_ns)
+              << ", p99 " << us(report.p99_ns) << ", p999 " << us(report.p999_ns) << ", max " << us(report.max_ns);
+    std::cout << ", " << strings::Printf("%.1lf", report.allocations_per_query) << " allocations per query";
+    if (report.dropped) {
+      std::cout << ", " << report.dropped << " dropped";
+    }
+    std::cout << '.' << std::endl;
   }
-
-  const double qps = total_queries / FLAGS_seconds;
-  std::cout << std::setw(3) << qps << " QPS." << std::endl;
 }
 
 int main(int argc, char** argv) {
@@ -108,7 +86,8 @@ int main(int argc, char** argv) {
     return 1;
   } else {
     try {
-      Run(registerer.map.at(FLAGS_scenario).second());
+      const auto scenario = registerer.map.at(FLAGS_scenario).second();
+      Print(RunBenchmark(*scenario, FLAGS_scenario, FLAGS_threads, FLAGS_seconds, FLAGS_qps));
       return 0;
     } catch (const std::out_of_range&) {
       std::cout << "Scenario `" << FLAGS_scenario << "` is not defined." << std::endl;
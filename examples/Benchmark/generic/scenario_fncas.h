@@ -0,0 +1,88 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2016 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+#ifndef BENCHMARK_SCENARIO_FNCAS_H
+#define BENCHMARK_SCENARIO_FNCAS_H
+
+#include "../../../port.h"
+
+#include "benchmark.h"
+
+#include "../../../FnCAS/fncas.h"
+
+#include "../../../Bricks/dflags/dflags.h"
+
+#ifndef CURRENT_MAKE_CHECK_MODE
+DEFINE_string(fncas_eval, "tape", "The FnCAS evaluation to benchmark, `blueprint`, `tape` or `gradient`.");
+#else
+DECLARE_string(fncas_eval);
+#endif
+
+namespace benchmark {
+namespace fncas_eval {
+
+template <typename T>
+T Function(const std::vector<T>& x) {
+  const T s = fncas::sin(x[0]) * fncas::cos(x[1]) + fncas::atan(x[1]) - fncas::sqr(x[2]);
+  const T t = fncas::exp(x[2] / 5) + fncas::log(x[0] * x[0] + 1) + fncas::sqrt(x[1] * x[1] + 1);
+  return s * t + fncas::ramp(x[0] - x[1]) - s / (t + 10);
+}
+
+}  // namespace benchmark::fncas_eval
+}  // namespace benchmark
+
+// Each query evaluates a function of three variables, or its gradient, at a point.
+// The blueprint can only be evaluated from the thread that built it, so run `--fncas_eval=blueprint` with one thread.
+SCENARIO(fncas_function, "Evaluate an FnCAS function or its gradient.") {
+  std::unique_ptr<fncas::function_t<fncas::JIT::Blueprint>> blueprint;
+  std::unique_ptr<fncas::function_t<fncas::JIT::Tape>> tape;
+  std::unique_ptr<fncas::gradient_t<fncas::JIT::Blueprint>> gradient_blueprint;
+  std::unique_ptr<fncas::gradient_t<fncas::JIT::Tape>> gradient;
+  std::function<void()> f;
+
+  fncas_function() {
+    const fncas::variables_vector_t x(3);
+    blueprint = std::make_unique<fncas::function_t<fncas::JIT::Blueprint>>(benchmark::fncas_eval::Function(x));
+    const std::vector<fncas::double_t> point({0.5, -0.25, 1.0});
+    if (FLAGS_fncas_eval == "blueprint") {
+      f = [this, point]() { (*blueprint)(point); };
+    } else if (FLAGS_fncas_eval == "tape") {
+      tape = std::make_unique<fncas::function_t<fncas::JIT::Tape>>(*blueprint);
+      f = [this, point]() { (*tape)(point); };
+    } else if (FLAGS_fncas_eval == "gradient") {
+      gradient_blueprint = std::make_unique<fncas::gradient_t<fncas::JIT::Blueprint>>(x, *blueprint);
+      gradient = std::make_unique<fncas::gradient_t<fncas::JIT::Tape>>(*blueprint, *gradient_blueprint);
+      f = [this, point]() { (*gradient)(point); };
+    } else {
+      std::cerr << "The `--fncas_eval` flag must be 'blueprint', 'tape', or 'gradient'." << std::endl;
+      CURRENT_ASSERT(false);
+    }
+  }
+
+  void RunOneQuery() override { f(); }
+};
+
+REGISTER_SCENARIO(fncas_function);
+
+#endif  // BENCHMARK_SCENARIO_FNCAS_H
@@ -0,0 +1,386 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2016 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+#ifndef BENCHMARK_SCENARIO_JSON_TYPES_H
+#define BENCHMARK_SCENARIO_JSON_TYPES_H
+
+#include "../../../port.h"
+
+#include "../../../TypeSystem/struct.h"
+#include "../../../TypeSystem/enum.h"
+#include "../../../TypeSystem/optional.h"
+#include "../../../TypeSystem/variant.h"
+#include "../../../TypeSystem/Serialization/json.h"
+
+#include "benchmark.h"
+
+#include "../../../Bricks/dflags/dflags.h"
+
+#ifndef CURRENT_MAKE_CHECK_MODE
+DEFINE_string(json_types_shape,
+              "all",
+              "The shape of the object for `json_types`: `primitives`, `deep`, `vectors`, `maps`, `optionals`, "
+              "`variants`, `strings`, or `all`, which combines them.");
+DEFINE_string(json_types_action, "gen", "The action for `json_types` to benchmark, `gen` or `parse`.");
+DEFINE_string(json_types_format,
+              "current",
+              "The JSON format for `json_types`: `current`, `minimalistic`, `javascript`, or `fsharp`.");
+DEFINE_uint32(json_types_size, 100, "The number of elements in each container of the `json_types` object.");
+DEFINE_uint32(json_types_string_length, 1000, "The length of each string of the `strings` shape of `json_types`.");
+DEFINE_uint32(json_types_depth, 8, "The levels of nesting of the `deep` shape of `json_types`, from 1 to 12.");
+DEFINE_uint32(json_types_width, 1, "The number of children at each level of nesting of the `deep` shape.");
+#else
+DECLARE_string(json_types_shape);
+DECLARE_string(json_types_action);
+DECLARE_string(json_types_format);
+DECLARE_uint32(json_types_size);
+DECLARE_uint32(json_types_string_length);
+DECLARE_uint32(json_types_depth);
+DECLARE_uint32(json_types_width);
+#endif
+
+namespace benchmark {
+namespace json_types {
+
+CURRENT_ENUM(Color, uint8_t){Red = 1u, Green = 2u, Blue = 3u};
+
+CURRENT_STRUCT(Primitives) {
+  CURRENT_FIELD(b, bool, true);
+  CURRENT_FIELD(i8, int8_t, -8);
+  CURRENT_FIELD(u16, uint16_t, 16u);
+  CURRENT_FIELD(i32, int32_t, -32);
+  CURRENT_FIELD(u64, uint64_t, 1ull << 60);
+  CURRENT_FIELD(f, float, 0.5f);
+  CURRENT_FIELD(d, double, 0.125);
+  CURRENT_FIELD(s, std::string, "primitives");
+  CURRENT_FIELD(color, Color, Color::Green);
+  CURRENT_FIELD(us, std::chrono::microseconds, std::chrono::microseconds(1000000));
+};
+
+// The innermost level of nesting, and a level of nesting with `--json_types_width` children one level deeper.
+CURRENT_STRUCT(Depth1) {
+  CURRENT_FIELD(level, uint32_t, 1u);
+  CURRENT_FIELD(leaf, Primitives);
+};
+CURRENT_STRUCT_T(Nested) {
+  CURRENT_FIELD(level, uint32_t, 0u);
+  CURRENT_FIELD(name, std::string, "depth");
+  CURRENT_FIELD(next, std::vector<T>);
+};
+
+// `Depth<N>` is the type with `N` levels of nesting, up to `kMaxDepth`.
+constexpr static uint32_t kMaxDepth = 12u;
+template <uint32_t N>
+struct DepthImpl {
+  using type = Nested<typename DepthImpl<N - 1u>::type>;
+};
+template <>
+struct DepthImpl<1u> {
+  using type = Depth1;
+};
+template <uint32_t N>
+using Depth = typename DepthImpl<N>::type;
+
+using Depth2 = Depth<2u>;
+
+CURRENT_STRUCT(WithOptionals) {
+  CURRENT_FIELD(i, Optional<uint32_t>);
+  CURRENT_FIELD(s, Optional<std::string>);
+  CURRENT_FIELD(d, Optional<double>);
+  CURRENT_FIELD(p, Optional<Primitives>);
+};
+
+CURRENT_STRUCT(WithVariant) {
+  CURRENT_FIELD(id, uint32_t, 0u);
+  CURRENT_FIELD(inner, (Variant<Primitives, WithOptionals>));
+};
+
+using variant_t = Variant<Primitives, Depth2, WithOptionals, WithVariant>;
+
+// The objects to benchmark, one per shape, with `--json_types_size` elements in each container.
+// The `deep` shape, alone or within `all`, is templated on its rows, of `--json_types_depth` levels of nesting.
+CURRENT_STRUCT(PrimitivesShape) { CURRENT_FIELD(rows, std::vector<Primitives>); };
+
+CURRENT_STRUCT_T(DeepShape) { CURRENT_FIELD(rows, std::vector<T>); };
+
+CURRENT_STRUCT(VectorsShape) {
+  CURRENT_FIELD(integers, std::vector<uint64_t>);
+  CURRENT_FIELD(reals, std::vector<double>);
+  CURRENT_FIELD(words, std::vector<std::string>);
+  CURRENT_FIELD(matrix, std::vector<std::vector<int32_t>>);
+};
+
+CURRENT_STRUCT(MapsShape) {
+  CURRENT_FIELD(by_name, (std::map<std::string, uint64_t>));        // An object in JSON.
+  CURRENT_FIELD(by_id, (std::map<uint32_t, Primitives>));           // An array of pairs in JSON.
+  CURRENT_FIELD(hashed, (std::unordered_map<std::string, double>));  // An object in JSON.
+};
+
+CURRENT_STRUCT(OptionalsShape) { CURRENT_FIELD(rows, std::vector<WithOptionals>); };
+
+CURRENT_STRUCT(VariantsShape) { CURRENT_FIELD(rows, std::vector<variant_t>); };
+
+CURRENT_STRUCT(StringsShape) { CURRENT_FIELD(rows, std::vector<std::string>); };
+
+CURRENT_STRUCT_T(AllShape) {
+  CURRENT_FIELD(primitives, PrimitivesShape);
+  CURRENT_FIELD(deep, DeepShape<T>);
+  CURRENT_FIELD(vectors, VectorsShape);
+  CURRENT_FIELD(maps, MapsShape);
+  CURRENT_FIELD(optionals, OptionalsShape);
+  CURRENT_FIELD(variants, VariantsShape);
+  CURRENT_FIELD(strings, StringsShape);
+};
+
+// The values are chosen to print and parse back exactly, so that the round trip can be checked.
+inline Primitives MakePrimitives(size_t i) {
+  Primitives result;
+  result.b = (i % 2u) != 0u;
+  result.i32 = -static_cast<int32_t>(i);
+  result.u64 += i;
+  result.d = 0.25 * i;
+  result.s = "primitives" + current::ToString(i);
+  result.us = std::chrono::microseconds(1000000 + i);
+  return result;
+}
+
+inline WithOptionals MakeWithOptionals(size_t i) {
+  WithOptionals result;
+  if (i % 2u) {
+    result.i = static_cast<uint32_t>(i);
+    result.d = 0.5 * i;
+  } else {
+    result.s = "optional" + current::ToString(i);
+    result.p = MakePrimitives(i);
+  }
+  return result;
+}
+
+inline void Fill(PrimitivesShape& shape, size_t n) {
+  for (size_t i = 0u; i < n; ++i) {
+    shape.rows.push_back(MakePrimitives(i));
+  }
+}
+
+inline void MakeDeep(Depth1& node, size_t i) { node.leaf = MakePrimitives(i); }
+
+template <typename T>
+void MakeDeep(Nested<T>& node, size_t i) {
+  node.next.resize(FLAGS_json_types_width);
+  for (auto& child : node.next) {
+    MakeDeep(child, i);
+  }
+  node.level = node.next.front().level + 1u;
+}
+
+template <typename T>
+void Fill(DeepShape<T>& shape, size_t n) {
+  shape.rows.resize(n);
+  for (size_t i = 0u; i < n; ++i) {
+    MakeDeep(shape.rows[i], i);
+  }
+}
+
+inline void Fill(VectorsShape& shape, size_t n) {
+  for (size_t i = 0u; i < n; ++i) {
+    shape.integers.push_back(static_cast<uint64_t>(i) * 1000003u);
+    shape.reals.push_back(0.125 * i);
+    shape.words.push_back("word" + current::ToString(i));
+    shape.matrix.emplace_back(10u, static_cast<int32_t>(i));
+  }
+}
+
+inline void Fill(MapsShape& shape, size_t n) {
+  for (size_t i = 0u; i < n; ++i) {
+    shape.by_name["key" + current::ToString(i)] = i;
+    shape.by_id[static_cast<uint32_t>(i)] = MakePrimitives(i);
+    shape.hashed["key" + current::ToString(i)] = 0.5 * i;
+  }
+}
+
+inline void Fill(OptionalsShape& shape, size_t n) {
+  for (size_t i = 0u; i < n; ++i) {
+    shape.rows.push_back(MakeWithOptionals(i));
+  }
+}
+
+inline void Fill(VariantsShape& shape, size_t n) {
+  for (size_t i = 0u; i < n; ++i) {
+    if (i % 4u == 0u) {
+      shape.rows.emplace_back(MakePrimitives(i));
+    } else if (i % 4u == 1u) {
+      Depth2 deep;
+      MakeDeep(deep, i);
+      shape.rows.emplace_back(std::move(deep));
+    } else if (i % 4u == 2u) {
+      shape.rows.emplace_back(MakeWithOptionals(i));
+    } else {
+      WithVariant nested;
+      nested.id = static_cast<uint32_t>(i);
+      if (i % 8u == 3u) {
+        nested.inner = MakePrimitives(i);
+      } else {
+        nested.inner = MakeWithOptionals(i);
+      }
+      shape.rows.emplace_back(std::move(nested));
+    }
+  }
+}
+
+// Long strings of plain text, with the characters JSON has to escape, and with multibyte UTF-8.
+inline void Fill(StringsShape& shape, size_t n) {
+  const std::string pattern = "The quick brown fox jumps over the lazy dog. \"Quoted\", back\\slashed,\ttabbed\n"
+                              "\xd0\x9f\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82, \xe4\xb8\x96\xe7\x95\x8c! ";
+  for (size_t i = 0u; i < n; ++i) {
+    std::string s;
+    s.reserve(FLAGS_json_types_string_length);
+    while (s.length() + pattern.length() <= FLAGS_json_types_string_length) {
+      s += pattern;
+    }
+    s.append(FLAGS_json_types_string_length - s.length(), static_cast<char>('a' + i % 26u));
+    shape.rows.push_back(std::move(s));
+  }
+}
+
+template <typename T>
+void Fill(AllShape<T>& shape, size_t n) {
+  Fill(shape.primitives, n);
+  Fill(shape.deep, n);
+  Fill(shape.vectors, n);
+  Fill(shape.maps, n);
+  Fill(shape.optionals, n);
+  Fill(shape.variants, n);
+  Fill(shape.strings, n);
+}
+
+template <typename T, class J>
+std::function<void()> Query() {
+  auto object = std::make_shared<T>();
+  Fill(*object, FLAGS_json_types_size);
+  const auto json = std::make_shared<std::string>(JSON<J>(*object));
+  // Compare the lengths, not the JSONs themselves, as the order of the `std::unordered_map` may change.
+  if (JSON<J>(ParseJSON<T, J>(*json)).length() != json->length()) {
+    std::cerr << "The `json_types` object does not survive the JSON round trip." << std::endl;
+    CURRENT_ASSERT(false);
+  }
+  if (FLAGS_json_types_action == "gen") {
+    return [object]() { JSON<J>(*object); };
+  } else if (FLAGS_json_types_action == "parse") {
+    return [json]() { ParseJSON<T, J>(*json); };
+  } else {
+    std::cerr << "The `--json_types_action` flag must be 'gen' or 'parse'." << std::endl;
+    CURRENT_ASSERT(false);
+    return nullptr;
+  }
+}
+
+template <typename T>
+std::function<void()> QueryInFormat() {
+  if (FLAGS_json_types_format == "current") {
+    return Query<T, JSONFormat::Current>();
+  } else if (FLAGS_json_types_format == "minimalistic") {
+    return Query<T, JSONFormat::Minimalistic>();
+  } else if (FLAGS_json_types_format == "javascript") {
+    return Query<T, JSONFormat::JavaScript>();
+  } else if (FLAGS_json_types_format == "fsharp") {
+    return Query<T, JSONFormat::NewtonsoftFSharp>();
+  } else {
+    std::cerr << "The `--json_types_format` flag must be 'current', 'minimalistic', 'javascript', or 'fsharp'."
+              << std::endl;
+    CURRENT_ASSERT(false);
+    return nullptr;
+  }
+}
+
+// Dispatches the shape templated on its deep rows, `SHAPE<Depth<N>>`, on the `--json_types_depth` flag.
+template <template <typename> class SHAPE, uint32_t N>
+struct QueryAtDepth {
+  static std::function<void()> Get() {
+    if (FLAGS_json_types_depth == N) {
+      return QueryInFormat<SHAPE<Depth<N>>>();
+    } else {
+      return QueryAtDepth<SHAPE, N - 1u>::Get();
+    }
+  }
+};
+
+template <template <typename> class SHAPE>
+struct QueryAtDepth<SHAPE, 0u> {
+  static std::function<void()> Get() {
+    std::cerr << "The `--json_types_depth` flag must be between 1 and " << kMaxDepth << '.' << std::endl;
+    CURRENT_ASSERT(false);
+    return nullptr;
+  }
+};
+
+}  // namespace benchmark::json_types
+}  // namespace benchmark
+
+// Each query serializes or parses an object of the shape given by `--json_types_shape`, in the given format.
+// Run with `--threads=1`, and compare the allocations per query along with the throughput.
+SCENARIO(json_types, "JSON serialization and parsing of the objects of various shapes and formats.") {
+  std::function<void()> f;
+
+  json_types() {
+    using namespace benchmark::json_types;
+    if (!FLAGS_json_types_width) {
+      std::cerr << "The `--json_types_width` flag must be positive." << std::endl;
+      CURRENT_ASSERT(false);
+    }
+    if (FLAGS_json_types_shape == "primitives") {
+      f = QueryInFormat<PrimitivesShape>();
+    } else if (FLAGS_json_types_shape == "deep") {
+      f = QueryAtDepth<DeepShape, kMaxDepth>::Get();
+    } else if (FLAGS_json_types_shape == "vectors") {
+      f = QueryInFormat<VectorsShape>();
+    } else if (FLAGS_json_types_shape == "maps") {
+      f = QueryInFormat<MapsShape>();
+    } else if (FLAGS_json_types_shape == "optionals") {
+      f = QueryInFormat<OptionalsShape>();
+    } else if (FLAGS_json_types_shape == "variants") {
+      f = QueryInFormat<VariantsShape>();
+    } else if (FLAGS_json_types_shape == "strings") {
+      f = QueryInFormat<StringsShape>();
+    } else if (FLAGS_json_types_shape == "all") {
+      f = QueryAtDepth<AllShape, kMaxDepth>::Get();
+    } else {
+      std::cerr << "The `--json_types_shape` flag must be 'primitives', 'deep', 'vectors', 'maps', 'optionals', "
+                   "'variants', 'strings', or 'all'." << std::endl;
+      CURRENT_ASSERT(false);
+    }
+  }
+
+  std::string Parameters() const override {
+    return "shape=" + FLAGS_json_types_shape + " action=" + FLAGS_json_types_action + " format=" +
+           FLAGS_json_types_format + " size=" + current::ToString(FLAGS_json_types_size) + " string_length=" +
+           current::ToString(FLAGS_json_types_string_length) + " depth=" + current::ToString(FLAGS_json_types_depth) +
+           " width=" + current::ToString(FLAGS_json_types_width);
+  }
+
+  void RunOneQuery() override { f(); }
+};
+
+REGISTER_SCENARIO(json_types);
+
+#endif  // BENCHMARK_SCENARIO_JSON_TYPES_H
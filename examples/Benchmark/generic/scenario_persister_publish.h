@@ -0,0 +1,90 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2016 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+#ifndef BENCHMARK_SCENARIO_PERSISTER_PUBLISH_H
+#define BENCHMARK_SCENARIO_PERSISTER_PUBLISH_H
+
+#include "../../../port.h"
+
+#include "benchmark.h"
+
+#include "../../../Sherlock/sherlock.h"
+#include "../../../TypeSystem/struct.h"
+
+#include "../../../Bricks/dflags/dflags.h"
+#include "../../../Bricks/file/file.h"
+
+#ifndef CURRENT_MAKE_CHECK_MODE
+DEFINE_string(persister_publish_file,
+              "",
+              "The file for the `persister_publish` scenario to publish into. Leave empty to publish in memory.");
+#else
+DECLARE_string(persister_publish_file);
+#endif
+
+namespace benchmark {
+namespace persister_publish {
+
+CURRENT_STRUCT(Entry) {
+  CURRENT_FIELD(key, std::string);
+  CURRENT_FIELD(value, uint64_t, 0u);
+  CURRENT_CONSTRUCTOR(Entry)(uint64_t value = 0u) : key("key" + current::ToString(value)), value(value) {}
+};
+
+}  // namespace benchmark::persister_publish
+}  // namespace benchmark
+
+// Each query publishes one entry into a Sherlock stream, persisted either in memory or into a file.
+SCENARIO(persister_publish, "Publish into a Sherlock stream, in memory or persisted into a file.") {
+  using entry_t = benchmark::persister_publish::Entry;
+  using memory_stream_t = current::sherlock::Stream<entry_t, current::persistence::Memory>;
+  using file_stream_t = current::sherlock::Stream<entry_t, current::persistence::File>;
+
+  std::unique_ptr<current::FileSystem::ScopedRmFile> file_remover;
+  std::unique_ptr<memory_stream_t> memory_stream;
+  std::unique_ptr<file_stream_t> file_stream;
+  std::atomic<uint64_t> value;
+
+  persister_publish() : value(0u) {
+    if (FLAGS_persister_publish_file.empty()) {
+      memory_stream = std::make_unique<memory_stream_t>();
+    } else {
+      file_remover = std::make_unique<current::FileSystem::ScopedRmFile>(FLAGS_persister_publish_file);
+      file_stream = std::make_unique<file_stream_t>(FLAGS_persister_publish_file);
+    }
+  }
+
+  void RunOneQuery() override {
+    const entry_t entry(++value);
+    if (memory_stream) {
+      memory_stream->Publish(entry);
+    } else {
+      file_stream->Publish(entry);
+    }
+  }
+};
+
+REGISTER_SCENARIO(persister_publish);
+
+#endif  // BENCHMARK_SCENARIO_PERSISTER_PUBLISH_H
@@ -0,0 +1,94 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2016 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+#ifndef BENCHMARK_SCENARIO_RIPCURRENT_H
+#define BENCHMARK_SCENARIO_RIPCURRENT_H
+
+#include "../../../port.h"
+
+#include <atomic>
+
+#include "benchmark.h"
+
+#include "../../../RipCurrent/ripcurrent.h"
+#include "../../../TypeSystem/struct.h"
+
+#include "../../../Bricks/dflags/dflags.h"
+
+#ifndef CURRENT_MAKE_CHECK_MODE
+DEFINE_uint32(ripcurrent_entries, 10000, "The number of entries each `ripcurrent` query runs through the flow.");
+#else
+DECLARE_uint32(ripcurrent_entries);
+#endif
+
+// clang-format off
+namespace benchmark {
+namespace ripcurrent {
+
+CURRENT_STRUCT(Integer) {
+  CURRENT_FIELD(value, uint64_t, 0u);
+  CURRENT_CONSTRUCTOR(Integer)(uint64_t value = 0u) : value(value) {}
+};
+
+RIPCURRENT_NODE(BenchmarkEmit, void, Integer) {
+  BenchmarkEmit() {}
+  BenchmarkEmit(uint64_t count) {
+    for (uint64_t i = 1u; i <= count; ++i) {
+      emit<Integer>(i);
+    }
+  }
+};
+#define BenchmarkEmit(...) RIPCURRENT_MACRO(BenchmarkEmit, __VA_ARGS__)
+
+RIPCURRENT_NODE(BenchmarkDouble, Integer, Integer) {
+  void f(Integer x) { emit<Integer>(x.value * 2u); }
+};
+#define BenchmarkDouble(...) RIPCURRENT_MACRO(BenchmarkDouble, __VA_ARGS__)
+
+RIPCURRENT_NODE(BenchmarkSum, Integer, void) {
+  uint64_t* sum;
+  BenchmarkSum() : sum(nullptr) {}
+  BenchmarkSum(uint64_t& sum) : sum(&sum) {}
+  void f(Integer x) { *sum += x.value; }
+};
+#define BenchmarkSum(...) RIPCURRENT_MACRO(BenchmarkSum, __VA_ARGS__)
+
+}  // namespace benchmark::ripcurrent
+}  // namespace benchmark
+// clang-format on
+
+// Each query runs `--ripcurrent_entries` entries through a three-node RipCurrent flow, from start to finish.
+SCENARIO(ripcurrent, "Run entries through a RipCurrent flow.") {
+  void RunOneQuery() override {
+    using namespace benchmark::ripcurrent;
+    const uint64_t n = FLAGS_ripcurrent_entries;
+    uint64_t sum = 0u;
+    (BenchmarkEmit(n) | BenchmarkDouble() | BenchmarkSum(std::ref(sum))).RipCurrent().Join();
+    CURRENT_ASSERT(sum == n * (n + 1u));
+  }
+};
+
+REGISTER_SCENARIO(ripcurrent);
+
+#endif  // BENCHMARK_SCENARIO_RIPCURRENT_H
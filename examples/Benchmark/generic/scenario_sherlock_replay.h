@@ -0,0 +1,98 @@
+/*******************************************************************************
+The MIT License (MIT)
+
+Copyright (c) 2016 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*******************************************************************************/
+
+
+#ifndef BENCHMARK_SCENARIO_SHERLOCK_REPLAY_H
+#define BENCHMARK_SCENARIO_SHERLOCK_REPLAY_H
+
+#include "../../../port.h"
+
+#include <atomic>
+#include <thread>
+
+#include "benchmark.h"
+
+#include "../../../Sherlock/sherlock.h"
+#include "../../../TypeSystem/struct.h"
+
+#include "../../../Bricks/dflags/dflags.h"
+
+#ifndef CURRENT_MAKE_CHECK_MODE
+DEFINE_uint32(sherlock_replay_entries, 100000, "The number of entries in the in-memory stream to replay.");
+DEFINE_bool(sherlock_replay_publish, true, "Keep publishing into the stream while it is being replayed.");
+#else
+DECLARE_uint32(sherlock_replay_entries);
+DECLARE_bool(sherlock_replay_publish);
+#endif
+
+namespace benchmark {
+namespace sherlock_replay {
+
+CURRENT_STRUCT(Entry) {
+  CURRENT_FIELD(x, uint64_t, 0u);
+  CURRENT_CONSTRUCTOR(Entry)(uint64_t x = 0u) : x(x) {}
+};
+
+}  // namespace benchmark::sherlock_replay
+}  // namespace benchmark
+
+// Each query replays the first `--sherlock_replay_entries` entries of an in-memory stream,
+// optionally while another thread keeps publishing into the very same stream.
+SCENARIO(sherlock_replay, "Replay an in-memory Sherlock stream, with or without concurrent publishing.") {
+  using entry_t = benchmark::sherlock_replay::Entry;
+
+  current::sherlock::Stream<entry_t, current::persistence::Memory> stream;
+  const uint64_t entries_count;
+  std::atomic_bool publishing;
+  std::thread publisher;
+
+  sherlock_replay() : entries_count(FLAGS_sherlock_replay_entries), publishing(FLAGS_sherlock_replay_publish) {
+    for (uint64_t i = 0u; i < entries_count; ++i) {
+      stream.Publish(entry_t(i));
+    }
+    publisher = std::thread([this]() {
+      uint64_t i = entries_count;
+      while (publishing) {
+        stream.Publish(entry_t(i++));
+      }
+    });
+  }
+
+  ~sherlock_replay() {
+    publishing = false;
+    publisher.join();
+  }
+
+  void RunOneQuery() override {
+    uint64_t sum = 0u;
+    for (const auto& e : stream.Persister().Iterate(0u, entries_count)) {
+      sum += e.entry.x;
+    }
+    CURRENT_ASSERT(sum == entries_count * (entries_count - 1u) / 2u);
+  }
+};
+
+REGISTER_SCENARIO(sherlock_replay);
+
+#endif  // BENCHMARK_SCENARIO_SHERLOCK_REPLAY_H
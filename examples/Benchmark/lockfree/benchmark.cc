@@ -28,6 +28,30 @@
 DEFINE_uint32(threads, 24, "The number of threads to iterate from.");
 DEFINE_uint32(iterations, 1000, "Call the Now() functions from each thread this many times.");
 
+namespace current_time_with_atomic {
+// The previous implementation of `current::time::Now()`, strictly increasing across all the threads.
+struct EpochClockGuaranteeingMonotonicity {
+  mutable std::atomic<int64_t> monotonic_now_us;
+
+  EpochClockGuaranteeingMonotonicity() : monotonic_now_us(0ll) {}
+
+  inline std::chrono::microseconds Now() const {
+    int64_t now, previous_now;
+    do {
+      now = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch())
+                .count();
+      previous_now = monotonic_now_us.load();
+      if (!(now > previous_now)) {
+        now = previous_now + 1;
+      }
+    } while (!monotonic_now_us.compare_exchange_strong(previous_now, now));
+    return std::chrono::microseconds(now);
+  }
+};
+
+inline std::chrono::microseconds Now() { return current::Singleton<EpochClockGuaranteeingMonotonicity>().Now(); }
+}
+
 namespace current_time_with_mutex {
 struct EpochClockGuaranteeingMonotonicity {
   mutable uint64_t monotonic_now_us = 0ull;
@@ -71,7 +95,8 @@ std::chrono::microseconds Run() {
   for (auto& thread : threads) {
     thread->Join();
   }
-  return (std::chrono::system_clock::now() - start) / FLAGS_threads;
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - start) /
+         FLAGS_threads;
 }
 
 int main(int argc, char** argv) {
@@ -82,9 +107,14 @@ int main(int argc, char** argv) {
   };
 
   struct NowWithAtomic {
+    inline std::chrono::microseconds operator()() { return current_time_with_atomic::Now(); }
+  };
+
+  struct NowPerThread {
     inline std::chrono::microseconds operator()() { return current::time::Now(); }
   };
 
+  std::cout << "Now() per thread:\t" << Run<NowPerThread>().count() << std::endl;
   std::cout << "Now() with atomic:\t" << Run<NowWithAtomic>().count() << std::endl;
   std::cout << "Now() with mutex:\t" << Run<NowWithMutex>().count() << std::endl;
   return 0;
@@ -0,0 +1,105 @@
+/*******************************************************************************
+ The MIT License (MIT)
+
+ Copyright (c) 2016 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ *******************************************************************************/
+
+// Measures the throughput of `mmq::MMPQ`: the lock-free path for the messages published in order,
+// the mutex-guarded path for the messages published into the future, and the bounded modes.
+
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "../../../Blocks/MMQ/mmpq.h"
+
+#include "../../../Bricks/dflags/dflags.h"
+#include "../../../Bricks/time/chrono.h"
+
+DEFINE_uint32(threads, 4, "The number of publishing threads.");
+DEFINE_uint32(messages, 100000, "The number of messages to publish from each thread.");
+DEFINE_uint32(max_queue_size, 1000, "The maximum queue size for the bounded runs.");
+
+struct CountingConsumerImpl {
+  std::atomic_size_t processed;
+  CountingConsumerImpl() : processed(0u) {}
+  current::ss::EntryResponse operator()(uint64_t, idxts_t, idxts_t) {
+    ++processed;
+    return current::ss::EntryResponse::More;
+  }
+};
+
+using CountingConsumer = current::ss::EntrySubscriber<CountingConsumerImpl, uint64_t>;
+using Queue = current::mmq::MMPQ<uint64_t, CountingConsumer>;
+
+// Publishes `FLAGS_messages` from each of `FLAGS_threads` threads, and waits for all of them to be consumed.
+template <typename PUBLISH>
+void Run(const std::string& name, const current::mmq::MMPQParameters& parameters, PUBLISH&& publish) {
+  CountingConsumer consumer;
+  Queue queue(consumer, parameters);
+
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (uint32_t t = 0; t < FLAGS_threads; ++t) {
+    threads.emplace_back([&queue, &publish]() {
+      for (uint32_t i = 0; i < FLAGS_messages; ++i) {
+        publish(queue, i);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  const size_t total = static_cast<size_t>(FLAGS_threads) * FLAGS_messages;
+  while (queue.Stats().consumed + queue.Stats().dropped != total) {
+    std::this_thread::yield();
+  }
+  const double seconds = 1e-6 * std::chrono::duration_cast<std::chrono::microseconds>(
+                                    std::chrono::steady_clock::now() - start).count();
+
+  const auto stats = queue.Stats();
+  std::cout << name << ":\t" << static_cast<uint64_t>(total / seconds) << " messages per second, " << stats.consumed
+            << " consumed, " << stats.dropped << " dropped, " << stats.blocked << " blocked publishes." << std::endl;
+}
+
+int main(int argc, char** argv) {
+  ParseDFlags(&argc, &argv);
+
+  const auto in_order = [](Queue& queue, uint64_t x) { queue.Publish(x); };
+  const auto into_the_future = [](Queue& queue, uint64_t x) {
+    // Each message becomes ready right away, yet goes through the ordered set guarded by the mutex.
+    queue.PublishIntoTheFuture(x);
+    queue.UpdateHead();
+  };
+
+  Run("In order, unbounded", current::mmq::MMPQParameters(), in_order);
+  Run("Into the future, unbounded", current::mmq::MMPQParameters(), into_the_future);
+  Run("In order, bounded, blocking",
+      current::mmq::MMPQParameters().SetMaxQueueSize(FLAGS_max_queue_size),
+      in_order);
+  Run("In order, bounded, dropping oldest",
+      current::mmq::MMPQParameters()
+          .SetMaxQueueSize(FLAGS_max_queue_size)
+          .SetOverflowPolicy(current::mmq::MMPQOverflowPolicy::DropOldest),
+      in_order);
+  return 0;
+}
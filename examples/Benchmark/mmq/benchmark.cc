@@ -0,0 +1,108 @@
+/*******************************************************************************
+ The MIT License (MIT)
+
+ Copyright (c) 2016 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ *******************************************************************************/
+
+// Compares the throughput and the publish-to-consume latency of the mutex-guarded and of the lock-free `mmq::MMQ`,
+// with 1, 4, and 16 publishing threads.
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "../../../Blocks/MMQ/mmq.h"
+
+#include "../../../Bricks/dflags/dflags.h"
+#include "../../../Bricks/strings/printf.h"
+
+DEFINE_uint32(messages, 1000000, "The total number of messages to publish, split evenly between the threads.");
+
+// The message carries the moment it was published at.
+struct Message {
+  std::chrono::steady_clock::time_point published;
+};
+
+struct LatencyRecordingConsumerImpl {
+  std::vector<int64_t> latencies_ns;
+  std::atomic_size_t processed;
+  LatencyRecordingConsumerImpl() : processed(0u) {}
+  current::ss::EntryResponse operator()(const Message& message, idxts_t, idxts_t) {
+    latencies_ns.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() -
+                                                                                 message.published).count());
+    ++processed;
+    return current::ss::EntryResponse::More;
+  }
+};
+
+using LatencyRecordingConsumer = current::ss::EntrySubscriber<LatencyRecordingConsumerImpl, Message>;
+
+template <bool LOCK_FREE>
+void Run(const std::string& name, size_t threads_count) {
+  LatencyRecordingConsumer consumer;
+  consumer.latencies_ns.reserve(FLAGS_messages);
+  const size_t per_thread = FLAGS_messages / threads_count;
+  const size_t total = per_thread * threads_count;
+  double seconds;
+  {
+    current::mmq::MMQ<Message, LatencyRecordingConsumer, 1024, false, LOCK_FREE> mmq(consumer);
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < threads_count; ++t) {
+      threads.emplace_back([&mmq, per_thread]() {
+        for (size_t i = 0; i < per_thread; ++i) {
+          mmq.Publish(Message{std::chrono::steady_clock::now()});
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    while (consumer.processed != total) {
+      std::this_thread::yield();
+    }
+    seconds = 1e-9 * std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start)
+                         .count();
+  }
+
+  std::vector<int64_t>& latencies = consumer.latencies_ns;
+  std::sort(latencies.begin(), latencies.end());
+  const auto percentile = [&latencies](double p) {
+    return latencies[std::min(latencies.size() - 1, static_cast<size_t>(p * latencies.size()))] * 1e-3;
+  };
+  std::cout << current::strings::Printf("%-10s %2d producers: %10.0f msg/s, latency p50 %8.1fus, p99 %8.1fus",
+                                        name.c_str(),
+                                        static_cast<int>(threads_count),
+                                        total / seconds,
+                                        percentile(0.5),
+                                        percentile(0.99)) << std::endl;
+}
+
+int main(int argc, char** argv) {
+  ParseDFlags(&argc, &argv);
+  for (size_t threads_count : {1u, 4u, 16u}) {
+    Run<false>("Mutex", threads_count);
+    Run<true>("Lock-free", threads_count);
+  }
+  return 0;
+}
@@ -0,0 +1,191 @@
+/*******************************************************************************
+ The MIT License (MIT)
+
+ Copyright (c) 2016 Dmitry "Dima" Korolev <dmitry.korolev@gmail.com>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ *******************************************************************************/
+
+// Compares the two ways `RTTIDynamicCall<>` dispatches on the type of the object:
+// the flat table by the per-type id of a `CURRENT_STRUCT`, and the `std::type_index`-keyed map for other types.
+
+#include "../../../TypeSystem/struct.h"
+
+#include "../../../Bricks/dflags/dflags.h"
+#include "../../../Bricks/template/rtti_dynamic_call.h"
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+DEFINE_uint32(objects, 10000, "The number of objects to dispatch on, of types evenly spread over the type list.");
+DEFINE_uint32(iterations, 1000, "The number of times to dispatch on each object.");
+
+namespace benchmark {
+
+struct PlainBase {
+  virtual ~PlainBase() = default;
+};
+
+#define BENCHMARK_RTTI_TYPE(n)                  \
+  CURRENT_STRUCT(Current##n) {                  \
+    CURRENT_FIELD(x, uint32_t, n);              \
+  };                                            \
+  struct Plain##n : PlainBase {                 \
+    uint32_t x = n;                             \
+  };                                            \
+  inline uint32_t Value(const Current##n& o) {  \
+    return o.x;                                 \
+  }                                             \
+  inline uint32_t Value(const Plain##n& o) {    \
+    return o.x;                                 \
+  }
+
+#define BENCHMARK_RTTI_TEN_TYPES(n) \
+  BENCHMARK_RTTI_TYPE(n##0)         \
+  BENCHMARK_RTTI_TYPE(n##1)         \
+  BENCHMARK_RTTI_TYPE(n##2)         \
+  BENCHMARK_RTTI_TYPE(n##3)         \
+  BENCHMARK_RTTI_TYPE(n##4)         \
+  BENCHMARK_RTTI_TYPE(n##5)         \
+  BENCHMARK_RTTI_TYPE(n##6)         \
+  BENCHMARK_RTTI_TYPE(n##7)         \
+  BENCHMARK_RTTI_TYPE(n##8)         \
+  BENCHMARK_RTTI_TYPE(n##9)
+
+BENCHMARK_RTTI_TYPE(0)
+BENCHMARK_RTTI_TYPE(1)
+BENCHMARK_RTTI_TYPE(2)
+BENCHMARK_RTTI_TYPE(3)
+BENCHMARK_RTTI_TYPE(4)
+BENCHMARK_RTTI_TYPE(5)
+BENCHMARK_RTTI_TYPE(6)
+BENCHMARK_RTTI_TYPE(7)
+BENCHMARK_RTTI_TYPE(8)
+BENCHMARK_RTTI_TYPE(9)
+BENCHMARK_RTTI_TEN_TYPES(1)
+BENCHMARK_RTTI_TEN_TYPES(2)
+BENCHMARK_RTTI_TEN_TYPES(3)
+BENCHMARK_RTTI_TEN_TYPES(4)
+BENCHMARK_RTTI_TEN_TYPES(5)
+BENCHMARK_RTTI_TEN_TYPES(6)
+BENCHMARK_RTTI_TEN_TYPES(7)
+BENCHMARK_RTTI_TEN_TYPES(8)
+BENCHMARK_RTTI_TEN_TYPES(9)
+
+#undef BENCHMARK_RTTI_TEN_TYPES
+#undef BENCHMARK_RTTI_TYPE
+
+using current_2_t = current::metaprogramming::TypeListImpl<
+    Current0, Current1>;
+using plain_2_t = current::metaprogramming::TypeListImpl<
+    Plain0, Plain1>;
+using current_16_t = current::metaprogramming::TypeListImpl<
+    Current0, Current1, Current2, Current3, Current4, Current5, Current6, Current7, Current8, Current9,
+    Current10, Current11, Current12, Current13, Current14, Current15>;
+using plain_16_t = current::metaprogramming::TypeListImpl<
+    Plain0, Plain1, Plain2, Plain3, Plain4, Plain5, Plain6, Plain7, Plain8, Plain9, Plain10, Plain11,
+    Plain12, Plain13, Plain14, Plain15>;
+using current_100_t = current::metaprogramming::TypeListImpl<
+    Current0, Current1, Current2, Current3, Current4, Current5, Current6, Current7, Current8, Current9,
+    Current10, Current11, Current12, Current13, Current14, Current15, Current16, Current17, Current18,
+    Current19, Current20, Current21, Current22, Current23, Current24, Current25, Current26, Current27,
+    Current28, Current29, Current30, Current31, Current32, Current33, Current34, Current35, Current36,
+    Current37, Current38, Current39, Current40, Current41, Current42, Current43, Current44, Current45,
+    Current46, Current47, Current48, Current49, Current50, Current51, Current52, Current53, Current54,
+    Current55, Current56, Current57, Current58, Current59, Current60, Current61, Current62, Current63,
+    Current64, Current65, Current66, Current67, Current68, Current69, Current70, Current71, Current72,
+    Current73, Current74, Current75, Current76, Current77, Current78, Current79, Current80, Current81,
+    Current82, Current83, Current84, Current85, Current86, Current87, Current88, Current89, Current90,
+    Current91, Current92, Current93, Current94, Current95, Current96, Current97, Current98, Current99>;
+using plain_100_t = current::metaprogramming::TypeListImpl<
+    Plain0, Plain1, Plain2, Plain3, Plain4, Plain5, Plain6, Plain7, Plain8, Plain9, Plain10, Plain11,
+    Plain12, Plain13, Plain14, Plain15, Plain16, Plain17, Plain18, Plain19, Plain20, Plain21, Plain22,
+    Plain23, Plain24, Plain25, Plain26, Plain27, Plain28, Plain29, Plain30, Plain31, Plain32, Plain33,
+    Plain34, Plain35, Plain36, Plain37, Plain38, Plain39, Plain40, Plain41, Plain42, Plain43, Plain44,
+    Plain45, Plain46, Plain47, Plain48, Plain49, Plain50, Plain51, Plain52, Plain53, Plain54, Plain55,
+    Plain56, Plain57, Plain58, Plain59, Plain60, Plain61, Plain62, Plain63, Plain64, Plain65, Plain66,
+    Plain67, Plain68, Plain69, Plain70, Plain71, Plain72, Plain73, Plain74, Plain75, Plain76, Plain77,
+    Plain78, Plain79, Plain80, Plain81, Plain82, Plain83, Plain84, Plain85, Plain86, Plain87, Plain88,
+    Plain89, Plain90, Plain91, Plain92, Plain93, Plain94, Plain95, Plain96, Plain97, Plain98, Plain99>;
+
+struct Summer {
+  uint64_t sum = 0u;
+  template <typename T>
+  void operator()(const T& object) {
+    sum += Value(object);
+  }
+};
+
+// Creates the objects of the types from `TYPELIST` in a round robin fashion.
+template <typename BASE, typename TYPELIST>
+struct Populate;
+
+template <typename BASE, typename... TS>
+struct Populate<BASE, current::metaprogramming::TypeListImpl<TS...>> {
+  static std::vector<std::unique_ptr<BASE>> DoIt(size_t n) {
+    using creator_t = std::unique_ptr<BASE> (*)();
+    const creator_t creators[] = {&Create<TS>...};
+    std::vector<std::unique_ptr<BASE>> result;
+    for (size_t i = 0; i < n; ++i) {
+      result.push_back(creators[i % sizeof...(TS)]());
+    }
+    return result;
+  }
+  template <typename T>
+  static std::unique_ptr<BASE> Create() {
+    return std::unique_ptr<BASE>(new T());
+  }
+};
+
+// Returns the average time of a single `RTTIDynamicCall<>`, in nanoseconds.
+template <typename BASE, typename TYPELIST>
+double Run() {
+  const auto objects = Populate<BASE, TYPELIST>::DoIt(FLAGS_objects);
+  Summer summer;
+  const auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < FLAGS_iterations; ++i) {
+    for (const auto& object : objects) {
+      current::metaprogramming::RTTIDynamicCall<TYPELIST>(static_cast<const BASE&>(*object), summer);
+    }
+  }
+  const auto end = std::chrono::steady_clock::now();
+  if (!summer.sum) {
+    std::cout << "Unexpected zero checksum." << std::endl;
+  }
+  return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()) /
+         (static_cast<double>(FLAGS_objects) * FLAGS_iterations);
+}
+
+}  // namespace benchmark
+
+int main(int argc, char** argv) {
+  ParseDFlags(&argc, &argv);
+
+  using namespace benchmark;
+  using current::CurrentSuper;
+
+  std::cout << "Types\tBy type id, ns\tBy type_index, ns" << std::endl;
+  std::cout << "2\t" << Run<CurrentSuper, current_2_t>() << '\t' << Run<PlainBase, plain_2_t>() << std::endl;
+  std::cout << "16\t" << Run<CurrentSuper, current_16_t>() << '\t' << Run<PlainBase, plain_16_t>() << std::endl;
+  std::cout << "100\t" << Run<CurrentSuper, current_100_t>() << '\t' << Run<PlainBase, plain_100_t>() << std::endl;
+
+  return 0;
+}